@@ -19,27 +19,70 @@
 
 
 #include "convolution\channelpaths.h"
+#include <map>
+#include <algorithm>
+#include <limits>
 
-ChannelPaths::ChannelPaths(const TCHAR szChannelPathsFileName[MAX_PATH], const WORD& nPartitions, const unsigned int& nPlanningRigour) :
-nInputChannels_(0),
-nOutputChannels_(0),
-nSamplesPerSec_(0),
-dwChannelMask_(0),
-nPaths_(0),
-nPartitions(nPartitions),
-nPartitionLength_(0),
-nHalfPartitionLength_(0),
-nFilterLength_(0),
-#ifdef FFTW
-nFFTWPartitionLength_(2),
-#endif
-config_(szChannelPathsFileName)
+namespace
 {
-	//USES_CONVERSION;
+	// A filter sound file named relative to its config (eg, filters\IR.wav) is resolved against the config's
+	// directory, so that a config and its filters can be moved together.  Absolute paths (C:\.., \.., \\server\..)
+	// are left alone
+	void resolveFilterPath(const TCHAR szConfigFileName[MAX_PATH], TCHAR szFilterFileName[MAX_PATH])
+	{
+		if (szFilterFileName[0] == TEXT('\\') || szFilterFileName[0] == TEXT('/') ||
+			(szFilterFileName[0] != 0 && szFilterFileName[1] == TEXT(':')))
+			return;
+
+		const TCHAR* szSeparator = _tcsrchr(szConfigFileName, TEXT('\\'));
+		const TCHAR* const szForwardSlash = _tcsrchr(szConfigFileName, TEXT('/'));
+		if (szSeparator == NULL || (szForwardSlash != NULL && szForwardSlash > szSeparator))
+			szSeparator = szForwardSlash;
+		if (szSeparator == NULL)
+			return;		// the config is in the current directory, and so the filter is relative to that already
+
+		const size_t nDirectory = szSeparator - szConfigFileName + 1;
+		if (nDirectory + _tcslen(szFilterFileName) >= MAX_PATH)
+			throw channelPathsException("Filter path too long", szFilterFileName);
+
+		TCHAR szResolved[MAX_PATH];
+		_tcsncpy(szResolved, szConfigFileName, nDirectory);
+		_tcscpy(szResolved + nDirectory, szFilterFileName);
+		_tcscpy(szFilterFileName, szResolved);
+	}
+}
 
-#if defined(DEBUG) | defined(_DEBUG)
-	DEBUGGING(3, cdebug << "ChannelPaths::ChannelPaths " << CT2A(szChannelPathsFileName) << " " << nPartitions << " " << std::endl;);
-#endif
+void ChannelPaths::makePaths(const std::vector<PathSpec>& Specs, const unsigned int nPlanningRigour,
+							 const DWORD nHalfPrecisionFrom)
+{
+	// The channels wanted from each filter file
+	std::map<std::basic_string<TCHAR>, std::vector<DWORD> > nFilterChannels;
+	for(std::vector<PathSpec>::size_type i = 0; i < Specs.size(); ++i)
+	{
+		nFilterChannels[Specs[i].szFilterFileName].push_back(Specs[i].nFilterChannel);
+	}
+
+	boost::ptr_vector<FilterFile> Files;
+	std::map<std::basic_string<TCHAR>, boost::ptr_vector<FilterFile>::size_type> nFile;
+	for(std::map<std::basic_string<TCHAR>, std::vector<DWORD> >::const_iterator it = nFilterChannels.begin();
+		it != nFilterChannels.end(); ++it)
+	{
+		Files.push_back(new FilterFile(it->first.c_str(), nPartitions, it->second, nSamplesPerSec_, nPlanningRigour, Backend_,
+			nHalfPrecisionFrom));
+		nFile[it->first] = Files.size() - 1;
+	}
+
+	for(std::vector<PathSpec>::size_type i = 0; i < Specs.size(); ++i)
+	{
+		Paths_.push_back(new ChannelPath(Files[nFile[Specs[i].szFilterFileName]], Specs[i].inChannel, Specs[i].outChannel,
+			Specs[i].nFilterChannel));
+		++nPaths_;
+	}
+}
+
+std::vector<ChannelPaths::PathSpec> ChannelPaths::readSpecs(const TCHAR szChannelPathsFileName[MAX_PATH])
+{
+	std::vector<PathSpec> Specs;
 
 	if(0 == *szChannelPathsFileName)
 	{
@@ -81,13 +124,13 @@ config_(szChannelPathsFileName)
 			nOutputSamplesDelay_.push_back(0);  // No delay, where a sound file is used as a filter
 		}
 
+		Specs.resize(nInputChannels_);
 		for(WORD nChannel=0; nChannel < nInputChannels_; ++nChannel)
 		{
-			std::vector<ChannelPath::ScaledChannel> inChannel(1, ChannelPath::ScaledChannel(nChannel, 1.0f));
-			std::vector<ChannelPath::ScaledChannel> outChannel(1, ChannelPath::ScaledChannel(nChannel, 1.0f));
-			Paths_.push_back(new ChannelPath(szChannelPathsFileName, nPartitions, inChannel, outChannel, nChannel, 
-				nSamplesPerSec_, nPlanningRigour));  // 0 = no delay
-			++nPaths_;
+			Specs[nChannel].szFilterFileName = szChannelPathsFileName;
+			Specs[nChannel].nFilterChannel = nChannel;
+			Specs[nChannel].inChannel.push_back(ChannelPath::ScaledChannel(nChannel, 1.0f));
+			Specs[nChannel].outChannel.push_back(ChannelPath::ScaledChannel(nChannel, 1.0f));
 		}
 	}
 	catch(const wavfileException&)
@@ -171,6 +214,7 @@ config_(szChannelPathsFileName)
 				{
 					config_().getline(szFilterFilename, MAX_PATH);
 				}
+				resolveFilterPath(szChannelPathsFileName, szFilterFilename);
 #if defined(DEBUG) | defined(_DEBUG)
 				cdebug << "Reading specification for " << CT2A(szFilterFilename) << std::endl;
 #endif
@@ -263,9 +307,11 @@ config_(szChannelPathsFileName)
 					}
 				}
 
-				Paths_.push_back(new ChannelPath(szFilterFilename, nPartitions, inChannel, outChannel, nFilterChannel, 
-					nSamplesPerSec_, nPlanningRigour));
-				++nPaths_;
+				Specs.push_back(PathSpec());
+				Specs.back().szFilterFileName = szFilterFilename;
+				Specs.back().nFilterChannel = nFilterChannel;
+				Specs.back().inChannel = inChannel;
+				Specs.back().outChannel = outChannel;
 
 				got_path_spec = true;
 			}
@@ -325,6 +371,33 @@ config_(szChannelPathsFileName)
 		throw channelPathsException("Unexpected exception", szChannelPathsFileName);
 	}
 
+	return Specs;
+}
+
+ChannelPaths::ChannelPaths(const TCHAR szChannelPathsFileName[MAX_PATH], const WORD& nPartitions, const unsigned int& nPlanningRigour,
+						   const unsigned int& nFFTBackend, const DWORD& nHalfPrecisionFrom) :
+nInputChannels_(0),
+nOutputChannels_(0),
+nSamplesPerSec_(0),
+dwChannelMask_(0),
+nPaths_(0),
+nPartitions(nPartitions),
+nPartitionLength_(0),
+nHalfPartitionLength_(0),
+nFilterLength_(0),
+nFFTWPartitionLength_(2),
+nPathStride_(0),
+Backend_(FFTBackend::Get(nFFTBackend)),
+config_(szChannelPathsFileName)
+{
+	//USES_CONVERSION;
+
+#if defined(DEBUG) | defined(_DEBUG)
+	DEBUGGING(3, cdebug << "ChannelPaths::ChannelPaths " << CT2A(szChannelPathsFileName) << " " << nPartitions << " " << std::endl;);
+#endif
+
+	makePaths(readSpecs(szChannelPathsFileName), nPlanningRigour, nHalfPrecisionFrom);
+
 	// Verify
 	if (nPaths_ > 0)
 	{
@@ -332,9 +405,7 @@ config_(szChannelPathsFileName)
 		nHalfPartitionLength_ = Paths_[0].filter.nHalfPartitionLength();	// in frames
 		nFilterLength_ = Paths_[0].filter.nFilterLength();				// nFilterLength_ = nPartitions_ * nPartitionLength_
 		nSamplesPerSec_ = Paths_[0].filter.nSamplesPerSec();
-#ifdef FFTW
 		nFFTWPartitionLength_ = Paths_[0].filter.nFFTWPartitionLength();	// Needs an extra element
-#endif
 	}
 	else
 	{
@@ -382,11 +453,115 @@ config_(szChannelPathsFileName)
 			throw channelPathsException("Filters must all have the same sample rate", szChannelPathsFileName);
 		}
 	}
+
+	// Compile the routing
+	std::vector<MixingMatrix::Entry> InputGains;
+	std::vector<MixingMatrix::Entry> OutputGains;
+	for(WORD nPath = 0; nPath < nPaths_; ++nPath)
+	{
+		for(ChannelPath::size_type i = 0; i < Paths_[nPath].inChannel.size(); ++i)
+		{
+			InputGains.push_back(MixingMatrix::Entry(nPath, Paths_[nPath].inChannel[i].nChannel, Paths_[nPath].inChannel[i].fScale));
+		}
+		for(ChannelPath::size_type i = 0; i < Paths_[nPath].outChannel.size(); ++i)
+		{
+			OutputGains.push_back(MixingMatrix::Entry(Paths_[nPath].outChannel[i].nChannel, nPath, Paths_[nPath].outChannel[i].fScale));
+		}
+	}
+	InputMix_ = MixingMatrix(static_cast<WORD>(nPaths_), static_cast<WORD>(nInputChannels_), InputGains);
+	OutputMix_ = MixingMatrix(static_cast<WORD>(nOutputChannels_), static_cast<WORD>(nPaths_), OutputGains);
+
+	// Plan the batched transforms of all the paths
+	nPathStride_ = nStride(nFFTWPartitionLength_);
+	BatchPlan_.set_ptr(Backend_.plan(nPartitionLength_, nPaths_, nPathStride_, nPlanningRigour));
+
+
 #if defined(DEBUG) | defined(_DEBUG)
 	Dump();
 #endif
 }
 
+ChannelPaths::ChannelPaths(const TCHAR szChannelPathsFileName[MAX_PATH], const WORD& nPartitions, const unsigned int& nFFTBackend,
+						   std::vector<PathSpec>& Specs) :
+nInputChannels_(0),
+nOutputChannels_(0),
+nSamplesPerSec_(0),
+dwChannelMask_(0),
+nPaths_(0),
+nPartitions(nPartitions),
+nPartitionLength_(0),
+nHalfPartitionLength_(0),
+nFilterLength_(0),
+nFFTWPartitionLength_(2),
+nPathStride_(0),
+Backend_(FFTBackend::Get(nFFTBackend)),
+config_(szChannelPathsFileName)
+{
+	Specs = readSpecs(szChannelPathsFileName);
+}
+
+Footprint ChannelPaths::footprint(const TCHAR szChannelPathsFileName[MAX_PATH], const WORD& nPartitions,
+								  const unsigned int& nFFTBackend, const DWORD& nHalfPrecisionFrom)
+{
+	std::vector<PathSpec> Specs;
+	const ChannelPaths Config(szChannelPathsFileName, nPartitions, nFFTBackend, Specs);
+	if (Specs.empty())
+	{
+		throw channelPathsException("Must specify at least one filter", szChannelPathsFileName);
+	}
+
+	// The filters must all be of the same length, so the first sizes them all
+	DWORD nFrames = 0;
+	DWORD nChannels = 0;
+	FilterFile::probe(Specs[0].szFilterFileName.c_str(), Config.nSamplesPerSec_, nFrames, nChannels);
+
+	const DWORD nPartitionLength = FilterFile::nPaddedLength(nFrames, nPartitions, Config.Backend_);
+	const DWORD nSpectrumLength = FFTBackend::nSpectrumLength(nPartitionLength);
+	const ULONGLONG nPaths = Specs.size();
+	const ULONGLONG nBatch = nPaths * nStride(nSpectrumLength);
+
+	Footprint result;
+	// Each path's filter has its own spectra, and plan, and there is the batch plan
+	const ULONGLONG nHalfPartitions = nPartitions - std::min<DWORD>(nHalfPrecisionFrom, nPartitions);
+	result.nCoefficients = nPaths * nSpectrumLength * ((nPartitions - nHalfPartitions) * sizeof(float) + nHalfPartitions * sizeof(WORD));
+	result.nPlans = Config.Backend_.nPlanBytes(nPartitionLength, static_cast<DWORD>(nPaths) + 1);
+	// Convolution's buffers, as its constructor allocates them: the input and output batches, a batch for each
+	// partition, and a partition's length of each input and output channel
+	result.nWorking = (2 * nBatch + nPartitions * nBatch +
+		(static_cast<ULONGLONG>(Config.nInputChannels_) + Config.nOutputChannels_) * nPartitionLength) * sizeof(float);
+	return result;
+}
+
+void ChannelPaths::probe(const TCHAR szChannelPathsFileName[MAX_PATH], DWORD& nFilterFrames, DWORD& nPaths,
+						 WORD& nInputChannels, WORD& nOutputChannels, DWORD& nMaxSamplesDelay)
+{
+	std::vector<PathSpec> Specs;
+	const ChannelPaths Config(szChannelPathsFileName, 1, 0, Specs);
+	if (Specs.empty())
+	{
+		throw channelPathsException("Must specify at least one filter", szChannelPathsFileName);
+	}
+
+	DWORD nChannels = 0;
+	FilterFile::probe(Specs[0].szFilterFileName.c_str(), Config.nSamplesPerSec_, nFilterFrames, nChannels);
+
+	nPaths = static_cast<DWORD>(Specs.size());
+	nInputChannels = static_cast<WORD>(Config.nInputChannels_);
+	nOutputChannels = static_cast<WORD>(Config.nOutputChannels_);
+	nMaxSamplesDelay = std::max<DWORD>(*std::max_element(Config.nInputSamplesDelay_.begin(), Config.nInputSamplesDelay_.end()),
+		*std::max_element(Config.nOutputSamplesDelay_.begin(), Config.nOutputSamplesDelay_.end()));
+}
+
+double ChannelPaths::fHalfPrecisionSNR() const
+{
+	double fSNR = std::numeric_limits<double>::infinity();
+	for(size_type nPath = 0; nPath < nPaths(); ++nPath)
+	{
+		fSNR = std::min<double>(fSNR, Paths()[nPath].filter.fHalfPrecisionSNR());
+	}
+	return fSNR;
+}
+
 const std::string ChannelPaths::DisplayChannelPaths() const
 {
 	std::ostringstream result;
@@ -423,6 +598,12 @@ const std::string ChannelPaths::DisplayChannelPaths() const
 			<< nSamplesPerSec()/1000.0f << "kHz, " 
 			<< nFilterLength() << " taps, " 
 			<< std::setprecision(2) << (static_cast<float>(nPartitionLength() * float(2.0)) / static_cast<float>(nSamplesPerSec())) << "s lag";
+
+		if (Paths()[0].filter.nHalfPrecisionFrom() < nPartitions)
+		{
+			result << ", half precision from partition " << Paths()[0].filter.nHalfPrecisionFrom() << " ("
+				<< std::setprecision(3) << fHalfPrecisionSNR() << "dB SNR)";
+		}
 	}
 	return result.str();
 }
@@ -450,6 +631,8 @@ void ChannelPaths::Dump() const
 
 	for(unsigned int i = 0; i < nPaths(); ++i) 
 		Paths()[i].Dump();
+
+	cdebug << "Input mix: " << InputMix_.DisplayMixingMatrix() << " Output mix: " << OutputMix_.DisplayMixingMatrix() << std::endl;
 }
 
 void ChannelPaths::ChannelPath::Dump() const
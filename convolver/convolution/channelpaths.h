@@ -26,6 +26,10 @@
 #include <boost\ptr_container\ptr_vector.hpp>
 #include <mediaerr.h>
 #include "convolution\filter.h"
+#include "convolution\fftbackend.h"
+#include "convolution\footprint.h"
+#include "convolution\holder.h"
+#include "convolution\mixingmatrix.h"
 
 class configFile
 {
@@ -132,11 +136,10 @@ public:
 		const Filter filter;
 		const std::vector<ScaledChannel> outChannel;
 
-		ChannelPath(const TCHAR szChannelPathsFileName[MAX_PATH], const DWORD nPartitions,
-			const std::vector<ScaledChannel>& inChannel, const std::vector<ScaledChannel>& outChannel,
-			const DWORD nFilterChannel, const DWORD nSampleRate, const unsigned int nPlanningRigour) :
-				filter(szChannelPathsFileName, nPartitions, nFilterChannel, nSampleRate, nPlanningRigour),
-					inChannel(inChannel), outChannel(outChannel)
+		// Takes its filter from channel nFilterChannel of File
+		ChannelPath(FilterFile& File, const std::vector<ScaledChannel>& inChannel, const std::vector<ScaledChannel>& outChannel,
+			const DWORD nFilterChannel) :
+				filter(File, nFilterChannel), inChannel(inChannel), outChannel(outChannel)
 		{
 #if defined(DEBUG) | defined(_DEBUG)
 			DEBUGGING(3, cdebug << "ChannelPath::ChannelPath" << std::endl;);
@@ -220,15 +223,62 @@ private:
 		return nFilterLength_;
 	}
 
-#ifdef FFTW
+	// The paths (rows) from the input channels (columns), and the output channels (rows) from the paths (columns)
+	const MixingMatrix& InputMix() const
+	{
+		assert(InputMix_.nRows() == nPaths());
+		return InputMix_;
+	}
+
+	const MixingMatrix& OutputMix() const
+	{
+		assert(OutputMix_.nColumns() == nPaths());
+		return OutputMix_;
+	}
+
 	DWORD nFFTWPartitionLength() const
 	{
 		assert(nFFTWPartitionLength_ == 2*(nPartitionLength() / 2 + 1));
 		return nFFTWPartitionLength_;
 	}
-#endif
 
-	ChannelPaths(const TCHAR szChannelPathsFileName[MAX_PATH], const WORD& nPartitions, const unsigned int& nPlanningRigour);
+	// The FFT library that made the filter spectra, and must transform everything convolved with them
+	const FFTBackend& Backend() const
+	{
+		return Backend_;
+	}
+
+	// Transforms a batch of nPaths() arrays, nPathStride() floats apart, in place.  The engines share it
+	const FFTPlan& BatchPlan() const
+	{
+		return *BatchPlan_;
+	}
+
+	// The distance between the paths' arrays in a batch: the (padded) partition length, rounded up to keep each
+	// array aligned
+	DWORD nPathStride() const
+	{
+		return nPathStride_;
+	}
+
+	// nFFTBackend indexes FFTBackend::Get.  The filters store partitions nHalfPrecisionFrom on at half precision
+	ChannelPaths(const TCHAR szChannelPathsFileName[MAX_PATH], const WORD& nPartitions, const unsigned int& nPlanningRigour,
+		const unsigned int& nFFTBackend = 0, const DWORD& nHalfPrecisionFrom = nNoHalfPrecision);
+
+	// The memory that an engine for szChannelPathsFileName would need, worked out from the config and the headers of
+	// its filter files, without reading or transforming the filters
+	static Footprint footprint(const TCHAR szChannelPathsFileName[MAX_PATH], const WORD& nPartitions,
+		const unsigned int& nFFTBackend = 0, const DWORD& nHalfPrecisionFrom = nNoHalfPrecision);
+
+	// The shape of an engine for szChannelPathsFileName, from the config and the header of its first filter file alone:
+	// the frames of each filter (they must all be the same length), the paths, the input and output channels and the
+	// longest input or output delay
+	static void probe(const TCHAR szChannelPathsFileName[MAX_PATH], DWORD& nFilterFrames, DWORD& nPaths,
+		WORD& nInputChannels, WORD& nOutputChannels, DWORD& nMaxSamplesDelay);
+
+	// The worst of the paths' filters (see Filter::fHalfPrecisionSNR).  Infinite, if none stores any partitions at
+	// half precision
+	double fHalfPrecisionSNR() const;
 
 	const std::string DisplayChannelPaths() const;
 
@@ -261,9 +311,38 @@ private:
 	DWORD	nPartitionLength_;				// in frames (a frame/block contains the samples for each channel)
 	DWORD	nHalfPartitionLength_;			// in frames
 	DWORD	nFilterLength_;					// nFilterLength = nPartitions * nPartitionLength
-#ifdef FFTW
-	DWORD		nFFTWPartitionLength_;	// 2*(nPartitionLength / 2 + 1)
-#endif
+	MixingMatrix InputMix_;
+	MixingMatrix OutputMix_;
+	DWORD	nFFTWPartitionLength_;			// 2*(nPartitionLength / 2 + 1)
+	DWORD	nPathStride_;
+	const FFTBackend& Backend_;
+	Holder<FFTPlan> BatchPlan_;
+
+	// A path, as specified, before its filter is read
+	struct PathSpec
+	{
+		std::basic_string<TCHAR>				szFilterFileName;
+		DWORD									nFilterChannel;
+		std::vector<ChannelPath::ScaledChannel>	inChannel;
+		std::vector<ChannelPath::ScaledChannel>	outChannel;
+	};
+
+	// Reads the config (or takes each channel of a filter sound file as a path), setting the channels and delays
+	std::vector<PathSpec> readSpecs(const TCHAR szChannelPathsFileName[MAX_PATH]);
+
+	// Reads the filters of the paths specified, each filter file once for all the channels taken from it, and
+	// makes the paths, in order
+	void makePaths(const std::vector<PathSpec>& Specs, const unsigned int nPlanningRigour, const DWORD nHalfPrecisionFrom);
+
+	// Reads the config alone, for footprint and probe
+	ChannelPaths(const TCHAR szChannelPathsFileName[MAX_PATH], const WORD& nPartitions, const unsigned int& nFFTBackend,
+		std::vector<PathSpec>& Specs);
+
+	// Rounds a spectrum length up, to keep each array of a batch aligned
+	static DWORD nStride(const DWORD nSpectrumLength)
+	{
+		return (nSpectrumLength + 3) & ~3;
+	}
 
 	ChannelPaths();											// No construction
 	ChannelPaths(const ChannelPaths&);						// No copy ctor
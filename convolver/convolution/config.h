@@ -117,21 +117,14 @@ const DWORD MAXSTRING = 1024;	// length
 // Base type for convolution (float/double)
 typedef float			BaseT;
 
-// FFT routines
-//#define OOURA	1
-//#define SIMPLE_OOURA	1
+// FFT routines.  The engines choose between those built in at runtime (see fftbackend.h).  The built-in
+// transform (see realfft.h) and the bundled Ooura routines are always built; FFTW is optional.  fftw3.h is
+// needed regardless, for fftwf_complex
 #define FFTW	1
 
-#if defined(OOURA) || defined(SIMPLE_OOURA)
 #include "fft\fftsg_h.h"
-
-#elif defined(FFTW)
 #include "fftw\fftw3.h"
 
-#else
-#error "No FFT package defined"
-#endif
-
 // using home grown array
 #define FASTARRAY
 // User array initialization, rather than vector initialization
@@ -141,6 +134,13 @@ typedef float			BaseT;
 // Use LibSndFile, rather than the DirectX samples
 #define LIBSNDFILE 1
 
+// SSE2 is not available to the PIII build, which falls back to scalar sample conversion, noise shaping
+// and FFT butterflies
+#if defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SSE2_CONVERSION	1
+#include <emmintrin.h>
+#endif
+
 
 const DWORD MAX_ATTENUATION = 1000; // dB
 
@@ -29,41 +29,60 @@ template class ConvolutionList<float>;
 //template HRESULT calculateOptimumAttenuation<float>(float& fAttenuation, TCHAR szConfigFileName[MAX_PATH], 
 //													const WORD& nPartitions, const unsigned int& nPlanningRigour);
 
-// Convolution Constructor
+// Load the filter paths, which the engine owns.  The engine takes them only once it is built, so that they are
+// freed if it cannot be
 template <typename T>
-Convolution<T>::Convolution(const TCHAR szConfigFileName[MAX_PATH], 
-							const DWORD& nPartitions,
-							const unsigned int& nPlanningRigour) :
-nPartitions_(nPartitions),
-Mixer(szConfigFileName, nPartitions, nPlanningRigour),
-#ifdef FFTW
-InputBufferAccumulator_(Mixer.nFFTWPartitionLength()),
-OutputBuffer_(Mixer.nFFTWPartitionLength()),
-#ifdef ARRAY
-ComputationCircularBuffer_(Mixer.nPaths(), nPartitions, Mixer.nFFTWPartitionLength()),
-#else
-ComputationCircularBuffer_(Mixer.nPaths(), SampleBuffer(nPartitions, ChannelBuffer(Mixer.nFFTWPartitionLength()))),
-#endif
-#else
-InputBufferAccumulator_(Mixer.nPartitionLength()),
-OutputBuffer_(Mixer.nPartitionLength()), // NB. Actually, only need half partition length for DoPartitionedConvolution
+Convolution<T>* Convolution<T>::load(const TCHAR szConfigFileName[MAX_PATH], 
+									 const DWORD& nPartitions,
+									 const unsigned int& nPlanningRigour,
+									 const unsigned int& nFFTBackend,
+									 const DWORD& nHalfPrecisionFrom)
+{
+	Holder<const ChannelPaths> LoadedMixer(new ChannelPaths(szConfigFileName, nPartitions, nPlanningRigour, nFFTBackend,
+		nHalfPrecisionFrom));
+	Convolution<T>* conv = new Convolution<T>(*LoadedMixer);
+	conv->OwnedMixer_.set_ptr(LoadedMixer.release_ptr());
+	return conv;
+}
+
+// Convolution Constructor.  Everything is sized from SharedMixer, which load's engines own, and a worker's do not
+template <typename T>
+Convolution<T>::Convolution(const ChannelPaths& SharedMixer) :
+OwnedMixer_(),
+Mixer(SharedMixer),
 #ifdef ARRAY
-ComputationCircularBuffer_(Mixer.nPaths(), nPartitions, Mixer.nPartitionLength()),
+InputBuffer_(Mixer.nInputChannels(), Mixer.nPartitionLength()),
 #else
-ComputationCircularBuffer_(Mixer.nPaths(), SampleBuffer(nPartitions, ChannelBuffer(Mixer.nPartitionLength()))),
-#endif
+InputBuffer_(Mixer.nInputChannels(), ChannelBuffer(Mixer.nPartitionLength())),
 #endif
+InputBufferAccumulator_(Mixer.nPaths() * Mixer.nPathStride()),
+OutputBuffer_(Mixer.nPaths() * Mixer.nPathStride()),	// Only used by doConvolution
 #ifdef ARRAY
-InputBuffer_(Mixer.nInputChannels(), Mixer.nPartitionLength()),
 OutputBufferAccumulator_(Mixer.nOutputChannels(), Mixer.nPartitionLength()),
+ComputationCircularBuffer_(Mixer.nPartitions, Mixer.nPaths() * Mixer.nPathStride()),
 #else
-InputBuffer_(Mixer.nInputChannels(), ChannelBuffer(Mixer.nPartitionLength())),
 OutputBufferAccumulator_(Mixer.nOutputChannels(), ChannelBuffer(Mixer.nPartitionLength())),
+ComputationCircularBuffer_(Mixer.nPartitions, ChannelBuffer(Mixer.nPaths() * Mixer.nPathStride())),
 #endif
+nPartitions_(Mixer.nPartitions),
 nInputBufferIndex_(Mixer.nHalfPartitionLength()),
 nPartitionIndex_(0),
-nPreviousPartitionIndex_(nPartitions-1),
-bStartWriting_(false)
+nPreviousPartitionIndex_(Mixer.nPartitions-1),
+bStartWriting_(false),
+InputChannels_(Mixer.nInputChannels()),
+OutputChannels_(Mixer.nOutputChannels()),
+MixSources_(std::max<DWORD>(Mixer.nPaths(), Mixer.nInputChannels())),
+MixDestinations_(std::max<DWORD>(Mixer.nPaths(), Mixer.nOutputChannels())),
+nInputOffsets_(ringOffsets(Mixer.nInputSamplesDelay(), Mixer.nPartitionLength(), false)),
+nOutputOffsets_(ringOffsets(Mixer.nOutputSamplesDelay(), Mixer.nPartitionLength(), true)),
+nInputWraps_(ringWraps(nInputOffsets_, Mixer.nPartitionLength())),
+nOutputWraps_(ringWraps(nOutputOffsets_, Mixer.nPartitionLength())),
+ComplexMul_(select_complex_mul(Mixer.nPartitionLength())),
+ComplexMulAdd_(select_complex_mul_add(Mixer.nPartitionLength())),
+Deadlines_(Mixer.nSamplesPerSec())
+#ifdef CONVOLUTION_STATS
+, Stats_(Mixer.nPaths())
+#endif
 {
 #if defined(DEBUG) | defined(_DEBUG)
 	DEBUGGING(3, cdebug << "Convolution" << std::endl;)
@@ -91,313 +110,188 @@ void Convolution<T>::Flush()
 	bStartWriting_ = false;
 }
 
-
-// This version of the convolution routine does partitioned convolution
+// Each channel's delay, folded into a ring of nLength: channel c's sample for ring index i is at i + offset[c],
+// less nLength if that is past the end.  Inputs are delayed by writing ahead; outputs by reading behind (bLag)
 template <typename T>
-DWORD
-Convolution<T>::doPartitionedConvolution(const BYTE pbInputData[], BYTE pbOutputData[],
-										 const ConvertSample<T>* input_sample_convertor,	// The functionoid for converting between BYTE* and T
-										 const ConvertSample<T>* output_sample_convertor,	// The functionoid for converting between T and BYTE*
-										 DWORD dwBlocksToProcess,					// A block contains a sample for each channel
-										 const T fAttenuation_db)					// Returns bytes processed
+std::vector<DWORD> Convolution<T>::ringOffsets(const std::vector<DWORD>& nDelays, const DWORD nLength, const bool bLag)
 {
-#if defined(DEBUG) | defined(_DEBUG)
-	DEBUGGING(3, cdebug << "Convolution<T>::doPartitionedConvolution" << std::endl;);
-#endif
-#ifndef FFTW
-	// FFTW takes arbitrararily-sized args
-	assert(isPowerOf2(Mixer.nPartitionLength()));
-#endif
-
-	DWORD cbInputBytesProcessed = 0;
-	DWORD cbOutputBytesGenerated = 0;
+	std::vector<DWORD> nOffsets(nDelays.size());
+	for (std::vector<DWORD>::size_type nChannel = 0; nChannel < nDelays.size(); ++nChannel)
+	{
+		const DWORD nDelay = nDelays[nChannel] % nLength;
+		nOffsets[nChannel] = bLag && nDelay != 0 ? nLength - nDelay : nDelay;
+	}
+	return nOffsets;
+}
 
-	const BYTE* pbInputDataPointer = pbInputData;
-	BYTE* pbOutputDataPointer = pbOutputData;
+// The ring indices at which any channel's offset position wraps round to 0, ascending and ending with nLength
+template <typename T>
+std::vector<DWORD> Convolution<T>::ringWraps(const std::vector<DWORD>& nOffsets, const DWORD nLength)
+{
+	std::vector<DWORD> nWraps;
+	nWraps.reserve(nOffsets.size() + 1);
+	for (std::vector<DWORD>::size_type nChannel = 0; nChannel < nOffsets.size(); ++nChannel)
+	{
+		if(nOffsets[nChannel] != 0)
+		{
+			nWraps.push_back(nLength - nOffsets[nChannel]);
+		}
+	}
+	nWraps.push_back(nLength);
+	std::sort(nWraps.begin(), nWraps.end());
+	nWraps.erase(std::unique(nWraps.begin(), nWraps.end()), nWraps.end());
+	return nWraps;
+}
 
-	const float fAttenuationFactor = powf(10, fAttenuation_db / 20.0f);
+// The span of nFrames starting at nInputBufferIndex_ never passes the end of the ring, as convolve stops at each
+// half partition.  Planar channels are copied in at most two segments each.  The convertors take all the
+// channels at once, so interleaved frames are split at the precomputed ring indices where any channel wraps
+template <typename T>
+void Convolution<T>::getFrames(Frames& frames, const DWORD nFrames)
+{
+	const DWORD nLength = Mixer.nPartitionLength();
+	assert(nInputBufferIndex_ + nFrames <= nLength);
 
-	while (dwBlocksToProcess--)	// Frames to process
+	if(frames.pInput != NULL)
 	{
-		// Channels are stored sequentially in a frame (ie, they are interleaved on the channel)
-
-		if(bStartWriting_)
+		// Planar: no conversion, just the attenuation
+#pragma loop count (8)
+		for (SampleBuffer::size_type nChannel = 0; nChannel<Mixer.nInputChannels(); ++nChannel)
 		{
-			for (SampleBuffer::size_type nChannel = 0; nChannel<Mixer.nOutputChannels(); ++nChannel)
+			T* Ring = c_ptr(InputBuffer_, nChannel);
+			DWORD nIndex = nInputBufferIndex_ + nInputOffsets_[nChannel];
+			if(nIndex >= nLength)
 			{
-				int nDelayedIndex = nInputBufferIndex_ - Mixer.nOutputSamplesDelay()[nChannel];
-				if(nDelayedIndex < 0)
-				{
-					nDelayedIndex += Mixer.nPartitionLength();
-				}
-				output_sample_convertor->PutSample(pbOutputDataPointer,
-					OutputBufferAccumulator_[nChannel][nDelayedIndex],
-					nChannel, cbOutputBytesGenerated);
+				nIndex -= nLength;
 			}
+			const DWORD nFirst = std::min<DWORD>(nFrames, nLength - nIndex);
+			const T* Input = frames.pInput[nChannel] + frames.nInputFrames;
+			scale_copy(Input, frames.fAttenuationFactor, Ring + nIndex, nFirst);
+			scale_copy(Input + nFirst, frames.fAttenuationFactor, Ring, nFrames - nFirst);
 		}
+		frames.nInputFrames += nFrames;
+		return;
+	}
 
-		// Get the next frame from pbInputDataPointer to InputBuffer_
-		// Output lags input by half a partition length
+	const DWORD nEnd = nInputBufferIndex_ + nFrames;
+	std::vector<DWORD>::const_iterator nWrap = std::upper_bound(nInputWraps_.begin(), nInputWraps_.end(), nInputBufferIndex_);
+	for (DWORD nIndex = nInputBufferIndex_; nIndex < nEnd; )
+	{
+		const DWORD nRun = std::min<DWORD>(nEnd, *nWrap) - nIndex;
 #pragma loop count (8)
 		for (SampleBuffer::size_type nChannel = 0; nChannel<Mixer.nInputChannels(); ++nChannel)
 		{
-			// Get the next input sample and convert it to a float, and scale it and delay it circularly
-			DWORD nDelayedIndex = nInputBufferIndex_ + Mixer.nInputSamplesDelay()[nChannel];
-			if(nDelayedIndex >= Mixer.nPartitionLength())
-			{
-				nDelayedIndex -= Mixer.nPartitionLength();
-			}
-			input_sample_convertor->GetSample(InputBuffer_[nChannel][nDelayedIndex],
-				pbInputDataPointer, fAttenuationFactor, cbInputBytesProcessed);
-		} // nChannel
-
-		// Got a frame
-
-		if (nInputBufferIndex_ == Mixer.nHalfPartitionLength() - 1 ||
-			nInputBufferIndex_ == Mixer.nPartitionLength() - 1) // Got half a partition-length's worth of frames
-		{		
-			if(++nInputBufferIndex_ == Mixer.nPartitionLength())
-			{
-				nInputBufferIndex_ = 0;
-			};
-
-			// Apply the filters
+			const DWORD nDelayedIndex = nIndex + nInputOffsets_[nChannel];
+			InputChannels_[nChannel] = c_ptr(InputBuffer_, nChannel) +
+				(nDelayedIndex >= nLength ? nDelayedIndex - nLength : nDelayedIndex);
+		}
+		frames.input_sample_convertor->GetSamples(&InputChannels_[0], frames.pbInput, Mixer.nInputChannels(), nRun,
+			frames.fAttenuationFactor, frames.cbInputBytesProcessed);
+		nIndex += nRun;
+		if(nIndex == *nWrap)
+		{
+			++nWrap;
+		}
+	}
+}
 
-			// Initialize the OutputBufferAccumulator_
-#pragma loop count(8)
-#pragma ivdep
-			for(SampleBuffer::size_type nChannel = 0; nChannel < Mixer.nOutputChannels(); ++nChannel)
-			{
-				// void Zero(const size_type start, const size_type len)
-				OutputBufferAccumulator_[nChannel].Zero(nInputBufferIndex_, Mixer.nHalfPartitionLength());
-			}
+template <typename T>
+void Convolution<T>::putFrames(Frames& frames, const DWORD nFrames)
+{
+	const DWORD nLength = Mixer.nPartitionLength();
+	assert(nInputBufferIndex_ + nFrames <= nLength);
 
+	if(frames.pOutput != NULL)
+	{
+		// Planar: float output is not clipped, as for ConvertSample_ieeefloat
 #pragma loop count (8)
-			for (SampleBuffer::size_type nPath = 0; nPath < Mixer.nPaths(); ++nPath)
-			{
-				// Zero the partition from circular coeffs that we have just used, for the next cycle
-				ComputationCircularBuffer_[nPath][nPreviousPartitionIndex_] = 0;
-
-				// Mix the input samples for this filter path
-				mix_input(Mixer.Paths()[nPath], InputBuffer_, InputBufferAccumulator_);
-
-				// get DFT of InputBufferAccumulator_
-#ifdef FFTW
-				fftwf_execute_dft_r2c(Mixer.Paths()[nPath].filter.plan(), InputBufferAccumulator_.c_ptr(),
-					reinterpret_cast<fftwf_complex*>(InputBufferAccumulator_.c_ptr()));
-#elif defined(SIMPLE_OOURA)
-				rdft(Mixer.nPartitionLength(), OouraRForward, InputBufferAccumulator_.c_ptr();
-#elif defined(OOURA)
-				// TODO: rationalize the ip, w references
-				rdft(Mixer.nPartitionLength(), OouraRForward, InputBufferAccumulator_.c_ptr(), 
-					&Mixer.Paths()[0].filter.ip[0], &Mixer.Paths()[0].filter.w[0]);
-#else
-#error "No FFT package defined"
-#endif
-
-#pragma loop count(4)
-				for (PartitionedBuffer::size_type nPartitionIndex = 0; nPartitionIndex < nPartitions_; ++nPartitionIndex)
-				{
-					// Complex vector multiplication of InputBufferAccumulator_ and Mixer.Paths()[nPath].filter,
-					// added to ComputationCircularBuffer_
-#ifdef FFTW
-					complex_mul_add(reinterpret_cast<fftwf_complex*>(InputBufferAccumulator_.c_ptr()),
-						reinterpret_cast<fftwf_complex*>(c_ptr(Mixer.Paths()[nPath].filter.coeffs(), nPartitionIndex)),
-						reinterpret_cast<fftwf_complex*>(c_ptr(ComputationCircularBuffer_, nPath, nPartitionIndex_)),
-						Mixer.nPartitionLength());
-#elif defined(__ICC) || defined(__INTEL_COMPILER)
-					// Vectorizable
-					cmuladd(InputBufferAccumulator_.c_ptr(), c_ptr(Mixer.Paths()[nPath].filter.coeffs(), nPartitionIndex),
-						c_ptr(ComputationCircularBuffer_, nPath, nPartitionIndex_), Mixer.nPartitionLength());
-#else
-					// Non-vectorizable
-					cmultadd(InputBufferAccumulator_.c_ptr(), c_ptr(Mixer.Paths()[nPath].filter.coeffs(), nPartitionIndex),
-						c_ptr(ComputationCircularBuffer_, nPath, nPartitionIndex_), Mixer.nPartitionLength());
-#endif
-					nPartitionIndex_ = (nPartitionIndex_ + 1) % nPartitions_;	// circular
-				} // nPartitionIndex
-
-				//get back the yi: take the Inverse DFT. Not necessary to scale here, as did so when reading filter
-#ifdef FFTW
-				fftwf_execute_dft_c2r(Mixer.Paths()[nPath].filter.reverse_plan(),
-					reinterpret_cast<fftwf_complex*>(c_ptr(ComputationCircularBuffer_, nPath, nPartitionIndex_)),
-					c_ptr(ComputationCircularBuffer_, nPath, nPartitionIndex_));
-#elif defined(SIMPLE_OOURA)
-				rdft(Mixer.nPartitionLength(), OouraRBackward, c_ptr(ComputationCircularBuffer_, nPath, nPartitionIndex_));
-#elif defined(OOURA)
-				rdft(Mixer.nPartitionLength(), OouraRBackward, c_ptr(ComputationCircularBuffer_, nPath, nPartitionIndex_),
-					&Mixer.Paths()[0].filter.ip[0], &Mixer.Paths()[0].filter.w[0]);
-#else
-#error "No FFT package defined"
-#endif
-				// Mix the outputs
-				mix_output(Mixer.Paths()[nPath], OutputBufferAccumulator_, 
-					ComputationCircularBuffer_[nPath][nPartitionIndex_],
-					nInputBufferIndex_);
-
-			} // nPath
-
-			// Save the partition to be used for output
-			nPreviousPartitionIndex_ = nPartitionIndex_;
-			if(++nPartitionIndex_ == nPartitions_)
+		for (SampleBuffer::size_type nChannel = 0; nChannel<Mixer.nOutputChannels(); ++nChannel)
+		{
+			const T* Ring = c_ptr(OutputBufferAccumulator_, nChannel);
+			DWORD nIndex = nInputBufferIndex_ + nOutputOffsets_[nChannel];
+			if(nIndex >= nLength)
 			{
-				nPartitionIndex_ = 0;
+				nIndex -= nLength;
 			}
-
-			bStartWriting_ = true;
+			const DWORD nFirst = std::min<DWORD>(nFrames, nLength - nIndex);
+			T* Output = frames.pOutput[nChannel] + frames.nOutputFrames;
+			std::copy(Ring + nIndex, Ring + nIndex + nFirst, Output);
+			std::copy(Ring, Ring + (nFrames - nFirst), Output + nFirst);
 		}
-		else
-			++nInputBufferIndex_ ;		// get next frame
-
-	} // while
-
-#if defined(DEBUG) | defined(_DEBUG)
-	cdebug << "cbInputBytesProcessed: " << cbInputBytesProcessed  << ", cbOutputBytesGenerated: " << cbOutputBytesGenerated << std::endl;
-#endif
+		frames.nOutputFrames += nFrames;
+		return;
+	}
 
-	return cbOutputBytesGenerated;
+	const DWORD nEnd = nInputBufferIndex_ + nFrames;
+	std::vector<DWORD>::const_iterator nWrap = std::upper_bound(nOutputWraps_.begin(), nOutputWraps_.end(), nInputBufferIndex_);
+	for (DWORD nIndex = nInputBufferIndex_; nIndex < nEnd; )
+	{
+		const DWORD nRun = std::min<DWORD>(nEnd, *nWrap) - nIndex;
+#pragma loop count (8)
+		for (SampleBuffer::size_type nChannel = 0; nChannel<Mixer.nOutputChannels(); ++nChannel)
+		{
+			const DWORD nDelayedIndex = nIndex + nOutputOffsets_[nChannel];
+			OutputChannels_[nChannel] = c_ptr(OutputBufferAccumulator_, nChannel) +
+				(nDelayedIndex >= nLength ? nDelayedIndex - nLength : nDelayedIndex);
+		}
+		frames.output_sample_convertor->PutSamples(frames.pbOutput, &OutputChannels_[0], Mixer.nOutputChannels(), nRun,
+			frames.cbOutputBytesGenerated);
+		nIndex += nRun;
+		if(nIndex == *nWrap)
+		{
+			++nWrap;
+		}
+	}
 }
 
-
-// This version of the convolution routine is just plain overlap-save.
+// The frames of a call are taken a half partition at a time.  Output lags input by half a partition length,
+// whichever way the frames arrive
 template <typename T>
-DWORD
-Convolution<T>::doConvolution(const BYTE pbInputData[], BYTE pbOutputData[],
-							  const ConvertSample<T>* input_sample_convertor,		// The functionoid for converting between BYTE* and T
-							  const ConvertSample<T>* output_sample_convertor,		// The functionoid for converting between T and BYTE*
-							  DWORD dwBlocksToProcess,						// A block contains a sample for each channel
-							  const T fAttenuation_db)						// Returns bytes processed
+void Convolution<T>::convolve(Frames& frames, DWORD dwBlocksToProcess, const bool bOverlapSave)
 {
-#if defined(DEBUG) | defined(_DEBUG)
-	DEBUGGING(3, cdebug << "Convolution<T>::doConvolution" << std::endl;);
-#endif
-
-	// This convolution algorithm assumes that the filter is stored in the first, and only, partition
-	if(nPartitions_ != 1)
-	{
-		throw convolutionException("Internal error: attempted to execute plain overlap-save without using 1 partition");
-	}
-#ifndef FFTW
-	// FFTW does not need powers of 2
-	assert(isPowerOf2(Mixer.nPartitionLength()));
-#endif
-	assert(Mixer.nPartitionLength() == Mixer.nFilterLength());
+	const LONGLONG nDeadlineStart = Deadlines_.start();
+	const DWORD nFrames = dwBlocksToProcess;
+	STATS(const ULONGLONG nCallStart = readTSC());
+	STATS(ULONGLONG nFilterCycles = 0);
 
-	DWORD cbInputBytesProcessed = 0;
-	DWORD cbOutputBytesGenerated = 0;
-
-	const BYTE* pbInputDataPointer = pbInputData;
-	BYTE* pbOutputDataPointer = pbOutputData;
-
-	const float fAttenuationFactor = powf(10, fAttenuation_db / 20.0f);
-
-	while (dwBlocksToProcess--)
+	while (dwBlocksToProcess > 0)
 	{
-		// Channels are stored sequentially in a frame (ie, they are interleaved on the channel)
+		// Take as many frames as fit into the current half partition
+		const DWORD nHalfEnd = nInputBufferIndex_ < Mixer.nHalfPartitionLength() ? 
+			Mixer.nHalfPartitionLength() : Mixer.nPartitionLength();
+		const DWORD nRun = std::min<DWORD>(dwBlocksToProcess, nHalfEnd - nInputBufferIndex_);
 
+		// Output lags input by half a partition length
 		if(bStartWriting_)
 		{
-#pragma loop count(8)
-			for (SampleBuffer::size_type nChannel = 0; nChannel<Mixer.nOutputChannels(); ++nChannel)
-			{
-				int nDelayedIndex = nInputBufferIndex_ - Mixer.nOutputSamplesDelay()[nChannel];
-				if(nDelayedIndex < 0)
-				{
-					nDelayedIndex += Mixer.nPartitionLength();
-				}
-				output_sample_convertor->PutSample(pbOutputDataPointer,
-					OutputBufferAccumulator_[nChannel][nDelayedIndex],
-					nChannel, cbOutputBytesGenerated);
-			}
+			putFrames(frames, nRun);
 		}
 
-		// Get the next frame from pbInputDataPointer to InputBuffer_
-#pragma loop count(8)
-		for (SampleBuffer::size_type nChannel = 0; nChannel<Mixer.nInputChannels(); ++nChannel)
-		{
-			// Get the next input sample and convert it to a float, and scale it and delay it circularly
-			DWORD nDelayedIndex = nInputBufferIndex_ + Mixer.nInputSamplesDelay()[nChannel];
-			if(nDelayedIndex >= Mixer.nPartitionLength())
-			{
-				nDelayedIndex -= Mixer.nPartitionLength();
-			}
-			input_sample_convertor->GetSample(InputBuffer_[nChannel][nDelayedIndex],
-				pbInputDataPointer, fAttenuationFactor, cbInputBytesProcessed);
-		} // nChannel
+		// Get the next frames into InputBuffer_
+		getFrames(frames, nRun);
 
-		// Got a frame
+		nInputBufferIndex_ += nRun;
+		dwBlocksToProcess -= nRun;
 
-		if (nInputBufferIndex_ == Mixer.nHalfPartitionLength() - 1 ||
-			nInputBufferIndex_ == Mixer.nPartitionLength() - 1) // Got half a partition-length's worth of frames
+		if (nInputBufferIndex_ == nHalfEnd) // Got half a partition-length's worth of frames
 		{
-			if(++nInputBufferIndex_ == Mixer.nPartitionLength())
+			if(nInputBufferIndex_ == Mixer.nPartitionLength())
 			{
 				nInputBufferIndex_ = 0;
 			};
 
-			// Apply the filters
+			// Apply the filters.  The output mix overwrites this half of OutputBufferAccumulator_
 
-			// Initialize the OutputBufferAccumulator_
-#pragma loop count(8)
-#pragma ivdep
-			for(SampleBuffer::size_type nChannel = 0; nChannel < Mixer.nOutputChannels(); ++nChannel)
+			STATS(const ULONGLONG nFilterStart = readTSC());
+			if(bOverlapSave)
 			{
-				// void Zero(const size_type start, const size_type len)
-				OutputBufferAccumulator_[nChannel].Zero(nInputBufferIndex_, Mixer.nHalfPartitionLength());
+				filterOverlapSave();
 			}
-
-#pragma loop count(8)
-			for (SampleBuffer::size_type nPath = 0; nPath < Mixer.nPaths(); ++nPath)
+			else
 			{
-				// Mix the input samples for this filter path into InputBufferAccumulator_
-				mix_input(Mixer.Paths()[nPath], InputBuffer_, InputBufferAccumulator_);
-
-				// get DFT of InputBufferAccumulator_
-#ifdef FFTW
-				fftwf_execute_dft_r2c(Mixer.Paths()[nPath].filter.plan(), InputBufferAccumulator_.c_ptr(),
-					reinterpret_cast<fftwf_complex*>(InputBufferAccumulator_.c_ptr()));
-#elif defined(SIMPLE_OOURA)
-				rdft(Mixer.nPartitionLength(), OouraRForward, InputBufferAccumulator_.c_ptr());
-#elif defined(OOURA)
-				// TODO: rationalize the ip, w references
-				rdft(Mixer.nPartitionLength(), OouraRForward, InputBufferAccumulator_.c_ptr(), 
-					&Mixer.Paths()[0].filter.ip[0], &Mixer.Paths()[0].filter.w[0]);
-#else
-#error "No FFT package defined"
-#endif
-
-#ifdef FFTW
-				complex_mul(reinterpret_cast<fftwf_complex*>(InputBufferAccumulator_.c_ptr()),
-					reinterpret_cast<fftwf_complex*>(c_ptr(Mixer.Paths()[nPath].filter.coeffs())),
-					reinterpret_cast<fftwf_complex*>(OutputBuffer_.c_ptr()),
-					Mixer.nPartitionLength());
-#elif defined(__ICC) || defined(__INTEL_COMPILER)
-				// vectorized
-				cmul(InputBufferAccumulator_.c_ptr(), 
-					c_ptr(Mixer.Paths()[nPath].filter.coeffs()),					// use the first partition and channel only
-					OutputBuffer_.c_ptr(), Mixer.nPartitionLength());	
-#else
-				// Non-vectorizable
-				cmult(InputBufferAccumulator_,
-					Mixer.Paths()[nPath].filter.coeffs.c_ptr(),					// use the first partition and channel only
-					OutputBuffer_, Mixer.nPartitionLength());	
-#endif
-				//get back the yi: take the Inverse DFT. Not necessary to scale here, as did so when reading filter
-#ifdef FFTW
-				fftwf_execute_dft_c2r(Mixer.Paths()[nPath].filter.reverse_plan(),
-					reinterpret_cast<fftwf_complex*>(OutputBuffer_.c_ptr()),
-					OutputBuffer_.c_ptr());
-#elif defined(SIMPLE_OOURA)
-				rdft(Mixer.nPartitionLength(), OouraRBackward, OutputBuffer_.c_ptr());
-#elif defined(OOURA)
-				rdft(Mixer.nPartitionLength(), OouraRBackward, OutputBuffer_.c_ptr()),
-					&Mixer.Paths()[0].filter.ip[0], &Mixer.Paths()[0].filter.w[0]);
-#else
-#error "No FFT package defined"
-#endif
-				// Mix the outputs (only use the last half, as the rest is junk)
-				mix_output(Mixer.Paths()[nPath], OutputBufferAccumulator_, OutputBuffer_, nInputBufferIndex_);
-			} // nPath
+				filterPartitioned();
+			}
+			STATS(nFilterCycles += readTSC() - nFilterStart);
 
 			// Save the partition to be used for output
 			nPreviousPartitionIndex_ = nPartitionIndex_;
@@ -408,310 +302,276 @@ Convolution<T>::doConvolution(const BYTE pbInputData[], BYTE pbOutputData[],
 
 			bStartWriting_ = true;
 		}
-		else
-			++nInputBufferIndex_;
-
 	} // while
 
-#if defined(DEBUG) | defined(_DEBUG)
-	cdebug << "cbInputBytesProcessed: " << cbInputBytesProcessed  << ", cbOutputBytesGenerated: " << cbOutputBytesGenerated << std::endl;
-#endif
+	STATS(Stats_.call(readTSC() - nCallStart, nFilterCycles));
+	Deadlines_.stop(nDeadlineStart, nFrames);
+}
 
-	return cbOutputBytesGenerated;
+// The DFTs of all the paths' inputs, in InputBufferAccumulator_, in place, as one batch
+template <typename T>
+void Convolution<T>::forwardFFT()
+{
+	Mixer.BatchPlan().forward(c_ptr(InputBufferAccumulator_));
 }
 
+// Get back the yi for all the paths, from the batch of spectra at Batch, in place: take the Inverse DFT.  Not
+// necessary to scale here, as did so when reading filter
 template <typename T>
-void Convolution<T>::mix_input(const ChannelPaths::ChannelPath& restrict thisPath, 
-							   const SampleBuffer& restrict InputBuffer,
-							   ChannelBuffer& restrict InputBufferAccumulator)
+void Convolution<T>::inverseFFT(T* Batch)
 {
+	Mixer.BatchPlan().inverse(Batch);
+}
 
-	const ChannelPaths::ChannelPath::size_type nChannels = thisPath.inChannel.size();
-	const DWORD nPartitionLength = Mixer.nPartitionLength();
-	const DWORD nHalfPartitionLength = Mixer.nHalfPartitionLength();
+// Partitioned convolution of the last partition-length of input, into ComputationCircularBuffer_
+template <typename T>
+void Convolution<T>::filterPartitioned()
+{
+	STATS(ULONGLONG nLap = readTSC());
 
-	assert(nPartitionLength % 2 ==0);
+	// The mixing matrices and the batched transforms serve all the paths at once, so their stages are charged
+	// to the whole engine
+	mixInput();
+	STATS(nLap = Stats_.lap(ConvolutionStats::MixInput, nLap));
 
-	assert(nInputBufferIndex_ == nHalfPartitionLength ||
-		nInputBufferIndex_ == 0);
+	forwardFFT();
+	STATS(nLap = Stats_.lap(ConvolutionStats::ForwardFFT, nLap));
 
-	// NB InputBuffer_ is circular
+	// Zero the partition from circular coeffs that we have just used, for the next cycle
+	ComputationCircularBuffer_[nPreviousPartitionIndex_] = 0;
 
-	if (nChannels == 1 && thisPath.inChannel[0].fScale == 1.0f && nInputBufferIndex_ == 0)
+#pragma loop count (8)
+	for (SampleBuffer::size_type nPath = 0; nPath < Mixer.nPaths(); ++nPath)
 	{
-		InputBufferAccumulator = InputBuffer_[thisPath.inChannel[0].nChannel];
-	}
-	else
-	{	
-		InputBufferAccumulator = 0;
-#pragma loop count(8)
-#pragma ivdep
-		for(SampleBuffer::size_type nChannel = 0; nChannel < nChannels; ++nChannel)
+#pragma loop count(4)
+		for (SampleBuffer::size_type nPartitionIndex = 0; nPartitionIndex < nPartitions_; ++nPartitionIndex)
 		{
-			const float fScale = thisPath.inChannel[nChannel].fScale;
-			const WORD thisChannel = thisPath.inChannel[nChannel].nChannel;
-			const ChannelBuffer& InputSamples = InputBuffer[thisChannel];
-
-			// Need to accumulate the whole partition, even though the input buffer contains the previous half-partition
-			// because FFTW destroys its inputs.
-
-			// untangle [Xn, Xn-1] and [Xn-1,Xn] -> [Yn-1,Yn]
-
-			ChannelBuffer::const_iterator pInputSamples = InputSamples.begin();
-			const ChannelBuffer::const_iterator pInputSamplesEnd = InputSamples.begin() + nInputBufferIndex_;
-			ChannelBuffer::iterator pInputBufferAccumulator = InputBufferAccumulator.begin() + nHalfPartitionLength;
-
-			// TODO: Do this by pointers to make it faster
-			if(fScale == 1.0f)
+			// Complex vector multiplication of InputBufferAccumulator_ and Mixer.Paths()[nPath].filter,
+			// added to ComputationCircularBuffer_
+			const Filter& filter = Mixer.Paths()[nPath].filter;
+			if (nPartitionIndex < filter.nHalfPrecisionFrom())
 			{
-				while(pInputSamples != pInputSamplesEnd)
-				{
-					*pInputBufferAccumulator++ += *pInputSamples++;
-				}
-				pInputSamples = InputSamples.begin() + nInputBufferIndex_;
-				const ChannelBuffer::const_iterator pInputSamplesEnd = InputSamples.begin() + nPartitionLength;
-				pInputBufferAccumulator = InputBufferAccumulator.begin();
-				while(pInputSamples != pInputSamplesEnd)
-				{
-					*pInputBufferAccumulator++ += *pInputSamples++;
-				}
-
-				//ChannelBuffer::size_type j = nHalfPartitionLength;
-				//for(ChannelBuffer::size_type i=0; i<nInputBufferIndex_; ++i)
-				//{
-				//	InputBufferAccumulator[j++] += InputSamples[i];
-				//}
-				//j = 0;
-				//for(ChannelBuffer::size_type i=nInputBufferIndex_; i<nPartitionLength;++i)
-				//{
-				//	InputBufferAccumulator[j++] += InputSamples[i];
-				//}
+				ComplexMulAdd_(reinterpret_cast<fftwf_complex*>(pathInput(nPath)),
+					reinterpret_cast<fftwf_complex*>(c_ptr(filter.coeffs(), nPartitionIndex)),
+					reinterpret_cast<fftwf_complex*>(pathSpectrum(nPath, nPartitionIndex_)),
+					Mixer.nPartitionLength() / 2 + 1);
 			}
 			else
 			{
-				// TODO:: performance killer
+				complex_mul_half<true>(reinterpret_cast<fftwf_complex*>(pathInput(nPath)),
+					filter.halfCoeffs(nPartitionIndex), filter.fUnscale(nPartitionIndex),
+					reinterpret_cast<fftwf_complex*>(pathSpectrum(nPath, nPartitionIndex_)),
+					Mixer.nPartitionLength() / 2 + 1);
+			}
+			nPartitionIndex_ = (nPartitionIndex_ + 1) % nPartitions_;	// circular
+		} // nPartitionIndex
+		STATS(nLap = Stats_.lap(ConvolutionStats::MultiplyAdd, nPath, nLap));
+	} // nPath
 
-				while(pInputSamples != pInputSamplesEnd)
-				{
-					*pInputBufferAccumulator++ += *pInputSamples++ * fScale;
-				}
-				pInputSamples = InputSamples.begin() + nInputBufferIndex_;
-				const ChannelBuffer::const_iterator pInputSamplesEnd = InputSamples.begin() + nPartitionLength;
-				pInputBufferAccumulator = InputBufferAccumulator.begin();
-				while(pInputSamples != pInputSamplesEnd)
-				{
-					*pInputBufferAccumulator++ += *pInputSamples++ * fScale;
-				}
+	inverseFFT(c_ptr(ComputationCircularBuffer_, nPartitionIndex_));
+	STATS(nLap = Stats_.lap(ConvolutionStats::InverseFFT, nLap));
 
-				//ChannelBuffer::size_type j = nHalfPartitionLength;
-				//for(ChannelBuffer::size_type i=0; i<nInputBufferIndex_; ++i)
-				//{
-				//	InputBufferAccumulator[j++] += InputSamples[i] * fScale;
-				//}
-				//j = 0;
-				//for(ChannelBuffer::size_type i=nInputBufferIndex_; i<nPartitionLength;++i)
-				//{
-				//	InputBufferAccumulator[j++] += InputSamples[i] * fScale;
-				//}
-
-//				const T* pInputBufferAccumulatorEnd = InputBufferAccumulator.end();
-//#pragma loop count(65536)
-//#pragma ivdep
-//#pragma vector aligned
-//#pragma prefetch pInputSamples
-//				for(T* pInputBufferAccumulator = InputBufferAccumulator.begin(), *pInputSamples = const_cast<T*>(InputSamples.begin());
-//					pInputBufferAccumulator != pInputBufferAccumulatorEnd;)
-//				{
-//					*pInputBufferAccumulator++ += *pInputSamples++ * fScale;
-//					//PreFetchCacheLine(PF_NON_TEMPORAL_LEVEL_ALL, pInputSamples+16);
-//					//PreFetchCacheLine(PF_TEMPORAL_LEVEL_1, pInputBufferAccumulator+16);
-//				}
-
-
-				//for(ChannelBuffer::iterator iterInputSamples = const_cast<ChannelBuffer::iterator>(InputSamples.begin()),
-				//	iterInputBufferAccumulator = InputBufferAccumulator_.begin();
-				//	iterInputSamples != InputSamples.end();)
-				//{
-				//	*iterInputBufferAccumulator++ += fScale * *iterInputSamples++;
-				//}
-			}
-		}
+	// Mix the outputs, from the partition just computed for each path
+#pragma loop count (8)
+	for (SampleBuffer::size_type nPath = 0; nPath < Mixer.nPaths(); ++nPath)
+	{
+		MixSources_[nPath] = pathSpectrum(nPath, nPartitionIndex_);
 	}
+	mixOutput();
+	STATS(nLap = Stats_.lap(ConvolutionStats::MixOutput, nLap));
 }
 
+// Plain overlap-save convolution of the last partition-length of input, through OutputBuffer_
 template <typename T>
-void Convolution<T>::mix_output(const ChannelPaths::ChannelPath& restrict thisPath, SampleBuffer& restrict Accumulator, 
-								const ChannelBuffer& restrict Output, const DWORD to)
+void Convolution<T>::filterOverlapSave()
 {
-	// Don't zero the Accumulator as it can accumulate from more than one output
-	const ChannelPaths::ChannelPath::size_type nChannels = thisPath.outChannel.size();
-	const DWORD nPartitionLength = Mixer.nPartitionLength();
-	const DWORD nHalfPartitionLength = Mixer.nHalfPartitionLength();
+	STATS(ULONGLONG nLap = readTSC());
 
-	assert(to == 0 || to == nHalfPartitionLength);
-
-#pragma loop count(6)
-#pragma ivdep
-	for(SampleBuffer::size_type nChannel=0; nChannel<nChannels; ++nChannel)
-	{
-		const float fScale = thisPath.outChannel[nChannel].fScale;
-		const WORD thisChannel = thisPath.outChannel[nChannel].nChannel;
-		ChannelBuffer& thisAccumulator = Accumulator[thisChannel];
+	// The mixing matrices and the batched transforms serve all the paths at once, so their stages are charged
+	// to the whole engine
+	mixInput();
+	STATS(nLap = Stats_.lap(ConvolutionStats::MixInput, nLap));
 
-		ChannelBuffer::iterator pAccumulator = thisAccumulator.begin() + to;
-		ChannelBuffer::const_iterator pOutput = Output.begin() + nHalfPartitionLength;
-		const ChannelBuffer::const_iterator pOutputEnd = Output.begin() + nPartitionLength;
+	forwardFFT();
+	STATS(nLap = Stats_.lap(ConvolutionStats::ForwardFFT, nLap));
 
-		if(fScale == 1.0f)
+#pragma loop count(8)
+	for (SampleBuffer::size_type nPath = 0; nPath < Mixer.nPaths(); ++nPath)
+	{
+		// Use the first partition only
+		const Filter& filter = Mixer.Paths()[nPath].filter;
+		if (filter.nHalfPrecisionFrom() > 0)
 		{
-			// the output is in the second half of Output; Accumulate to the specified part of thisAccumulator
-			while(pOutput != pOutputEnd)
-			{
-				*pAccumulator++ += *pOutput++;
-			}
-//		DWORD j = to;
-//#pragma loop count(65536)
-//#pragma ivdep
-//			for(ChannelBuffer::size_type i=nHalfPartitionLength; i < nPartitionLength; ++i)
-//			{
-//				thisAccumulator[j++] += Output[i];
-//			} // i
+			ComplexMul_(reinterpret_cast<fftwf_complex*>(pathInput(nPath)),
+				reinterpret_cast<fftwf_complex*>(c_ptr(filter.coeffs())),
+				reinterpret_cast<fftwf_complex*>(pathOutput(nPath)),
+				Mixer.nPartitionLength() / 2 + 1);
 		}
 		else
 		{
-			while(pOutput != pOutputEnd)
-			{
-				*pAccumulator++ += *pOutput++ * fScale;
-			}
-//			DWORD j = to;
-//#pragma loop count(65536)
-//#pragma ivdep
-//			for(ChannelBuffer::size_type i=nHalfPartitionLength; i < nPartitionLength; ++i)
-//			{
-//				thisAccumulator[j++] += Output[i] * fScale;
-//			} // i
+			complex_mul_half<false>(reinterpret_cast<fftwf_complex*>(pathInput(nPath)), filter.halfCoeffs(0),
+				filter.fUnscale(0), reinterpret_cast<fftwf_complex*>(pathOutput(nPath)), Mixer.nPartitionLength() / 2 + 1);
 		}
-	} // nChannel
-}
+		STATS(nLap = Stats_.lap(ConvolutionStats::MultiplyAdd, nPath, nLap));
+	} // nPath
 
-#ifdef FFTW
-template <typename T>
-void inline Convolution<T>::complex_mul(const fftwf_complex* restrict in1, const fftwf_complex* restrict in2,
-										fftwf_complex* restrict result, const ChannelBuffer::size_type count)
-{
-#pragma ivdep
-#pragma loop count (65536)
-#pragma vector aligned
-	for (ChannelBuffer::size_type index = 0; index < count/2+1; ++index)
-	{
-		//result[index][0] = in1[index][0] * in2[index][0] - in1[index][1] * in2[index][1];
-		//result[index][1] = in1[index][0] * in2[index][1] + in1[index][1] * in2[index][0];
+	inverseFFT(c_ptr(OutputBuffer_));
+	STATS(nLap = Stats_.lap(ConvolutionStats::InverseFFT, nLap));
 
-		const __declspec(align( 16 )) float T1 = in1[index][0] * in2[index][0];
-		const __declspec(align( 16 )) float T2 = in1[index][1] * in2[index][1];
-		result[index][0] = T1 - T2;
-		result[index][1] = ((in1[index][0] + in1[index][1]) * (in2[index][0] + in2[index][1])) - (T1 + T2);
+	// Mix the outputs
+#pragma loop count (8)
+	for (SampleBuffer::size_type nPath = 0; nPath < Mixer.nPaths(); ++nPath)
+	{
+		MixSources_[nPath] = pathOutput(nPath);
 	}
+	mixOutput();
+	STATS(nLap = Stats_.lap(ConvolutionStats::MixOutput, nLap));
 }
 
+
+// This version of the convolution routine does partitioned convolution
 template <typename T>
-void inline Convolution<T>::complex_mul_add(const fftwf_complex* restrict in1, const fftwf_complex* restrict in2,
-											fftwf_complex* restrict result, const ChannelBuffer::size_type count)
+DWORD
+Convolution<T>::doPartitionedConvolution(const BYTE pbInputData[], BYTE pbOutputData[],
+										 const ConvertSample<T>* input_sample_convertor,	// The functionoid for converting between BYTE* and T
+										 const ConvertSample<T>* output_sample_convertor,	// The functionoid for converting between T and BYTE*
+										 DWORD dwBlocksToProcess,					// A block contains a sample for each channel
+										 const T fAttenuation_db)					// Returns bytes processed
 {
-#pragma ivdep
-#pragma loop count (65536)
-#pragma vector aligned
-	for (ChannelBuffer::size_type index = 0; index < count/2+1; ++index)
-	{
-		//result[index][0] += in1[index][0] * in2[index][0] - in1[index][1] * in2[index][1];
-		//result[index][1] += in1[index][0] * in2[index][1] + in1[index][1] * in2[index][0];
+#if defined(DEBUG) | defined(_DEBUG)
+	DEBUGGING(3, cdebug << "Convolution<T>::doPartitionedConvolution" << std::endl;);
+#endif
 
-		const __declspec(align( 16 )) float T1 = in1[index][0] * in2[index][0];
-		const __declspec(align( 16 )) float T2 = in1[index][1] * in2[index][1];
-		result[index][0] += T1 - T2;
-		result[index][1] += ((in1[index][0] + in1[index][1]) * (in2[index][0] + in2[index][1])) - (T1 + T2);
-	}
+	Frames frames(pbInputData, pbOutputData, input_sample_convertor, output_sample_convertor,
+		powf(10, fAttenuation_db / 20.0f));
+
+	convolve(frames, dwBlocksToProcess, false);
+
+#if defined(DEBUG) | defined(_DEBUG)
+	cdebug << "cbInputBytesProcessed: " << frames.cbInputBytesProcessed  << ", cbOutputBytesGenerated: " << frames.cbOutputBytesGenerated << std::endl;
+#endif
+
+	return frames.cbOutputBytesGenerated;
 }
 
-#elif !(defined(__ICC) || defined(__INTEL_COMPILER))
-// Non-vectorizable versions
 
-/* Complex multiplication */
+// This version of the convolution routine is just plain overlap-save.
 template <typename T>
-void inline Convolution<T>::cmult(const ChannelBuffer& restrict A, const ChannelBuffer& restrict B, ChannelBuffer& restrict C, const ChannelBuffer::size_type N)
+DWORD
+Convolution<T>::doConvolution(const BYTE pbInputData[], BYTE pbOutputData[],
+							  const ConvertSample<T>* input_sample_convertor,		// The functionoid for converting between BYTE* and T
+							  const ConvertSample<T>* output_sample_convertor,		// The functionoid for converting between T and BYTE*
+							  DWORD dwBlocksToProcess,						// A block contains a sample for each channel
+							  const T fAttenuation_db)						// Returns bytes processed
 {
-	//__declspec(align( 16 )) float T1;
-	//__declspec(align( 16 )) float T2;
+#if defined(DEBUG) | defined(_DEBUG)
+	DEBUGGING(3, cdebug << "Convolution<T>::doConvolution" << std::endl;);
+#endif
+
+	// This convolution algorithm assumes that the filter is stored in the first, and only, partition
+	if(nPartitions_ != 1)
+	{
+		throw convolutionException("Internal error: attempted to execute plain overlap-save without using 1 partition");
+	}
+	assert(Mixer.nPartitionLength() == Mixer.nFilterLength());
 
-	// a[2*k] = R[k], 0<=k<n/2
-	// a[2*k+1] = I[k], 0<k<n/2
-	// a[1] = R[n/2]
+	Frames frames(pbInputData, pbOutputData, input_sample_convertor, output_sample_convertor,
+		powf(10, fAttenuation_db / 20.0f));
 
-	// (R[R[a] + I[a]) * (R[b]+I[b]] = R[a]R[b] - I[a]I[b]
-	// (I[R[a] + I[a]) * (R[b]+I[b]] = R[a]I[b] + I[a]R[b]
+	convolve(frames, dwBlocksToProcess, true);
 
-	// 0<k<n/2
-	//								  A[R]*B[R]      - A[I]*B[I]
-	// R[R[a] + I[a]) * (R[b]+I[b]] = a[2*k]b[2*k]   - a[2*k+1]b[2*k+1]
-	//								  A[R]*B[I]      + A{I]*B[R]
-	// I[R[a] + I[a]) * (R[b]+I[b]] = a[2*k]b[2*k+1] + a[2*k+1]b[2*k]
+#if defined(DEBUG) | defined(_DEBUG)
+	cdebug << "cbInputBytesProcessed: " << frames.cbInputBytesProcessed  << ", cbOutputBytesGenerated: " << frames.cbOutputBytesGenerated << std::endl;
+#endif
 
-	// tempt the optimizer
-	assert(N % 4 == 0);
+	return frames.cbOutputBytesGenerated;
+}
 
-	C[0] = A[0] * B[0];
-	C[1] = A[1] * B[1];
-	for(ChannelBuffer::size_type R = 2, I = 3; R < N ;R += 2, I += 2)
+// Planar version, for hosts that hold a buffer per channel.  No sample conversion
+template <typename T>
+DWORD
+Convolution<T>::process(const T* const pInput[], T* const pOutput[], DWORD nFrames, const T fAttenuation_db,
+						const bool overlapsave)
+{
+#if defined(DEBUG) | defined(_DEBUG)
+	DEBUGGING(3, cdebug << "Convolution<T>::process" << std::endl;);
+#endif
+
+	if(overlapsave && nPartitions_ != 1)
 	{
-		C[R] = A[R]*B[R] - A[I]*B[I];
-		C[I] = A[R]*B[I] + A[I]*B[R];
-		//T1 = A[R] * B[R];
-		//T2 = A[I] * B[I];
-		//C[I] = ((A[R] + A[I]) * (B[R] + B[I])) - (T1 + T2);
-		//C[R] = T1 - T2;
+		throw convolutionException("Internal error: attempted to execute plain overlap-save without using 1 partition");
 	}
-}
 
+	Frames frames(pInput, pOutput, powf(10, fAttenuation_db / 20.0f));
 
-/* Complex multiplication with addition */
+	convolve(frames, nFrames, overlapsave);
+
+	assert(frames.nInputFrames == nFrames);
+	assert(frames.nOutputFrames <= nFrames);
+
+	return frames.nOutputFrames;
+}
+
+// Mix the input channels into each path's accumulator, untangling the circular InputBuffer_ on the way:
+// [Xn, Xn-1] or [Xn-1, Xn] -> [Xn-1, Xn].  The whole partition is needed, even though the earlier half was
+// mixed last time, because the forward FFT overwrites it
 template <typename T>
-void inline Convolution<T>::cmultadd(const ChannelBuffer& restrict A, const ChannelBuffer& restrict B, ChannelBuffer& restrict C, const ChannelBuffer::size_type N)
+void Convolution<T>::mixInput()
 {
-	//__declspec(align( 16 )) float T1;
-	//__declspec(align( 16 )) float T2;
+	const DWORD nPartitionLength = Mixer.nPartitionLength();
 
-	// a[2*k] = R[k], 0<=k<n/2
-	// a[2*k+1] = I[k], 0<k<n/2
-	// a[1] = R[n/2]
+	assert(nInputBufferIndex_ == Mixer.nHalfPartitionLength() || nInputBufferIndex_ == 0);
 
-	// R[R[a] + I[a]) * (R[b]+I[b]] = R[a]R[b] - I[a]I[b]
-	// I[R[a] + I[a]) * (R[b]+I[b]] = R[a]I[b] + I[a]R[b]
+#pragma loop count(8)
+	for (SampleBuffer::size_type nPath = 0; nPath < Mixer.nPaths(); ++nPath)
+	{
+		MixDestinations_[nPath] = pathInput(nPath);
+	}
+#pragma loop count(8)
+	for (SampleBuffer::size_type nChannel = 0; nChannel < Mixer.nInputChannels(); ++nChannel)
+	{
+		MixSources_[nChannel] = c_ptr(InputBuffer_, nChannel) + nInputBufferIndex_;
+	}
+	Mixer.InputMix().apply(&MixSources_[0], &MixDestinations_[0], nPartitionLength - nInputBufferIndex_);
 
-	// 0<k<n/2
-	//								  A[R]*B[R]      - A[I]*B[I]
-	// R[R[a] + I[a]) * (R[b]+I[b]] = a[2*k]b[2*k]   - a[2*k+1]b[2*k+1]
-	//								  A[R]*B[I]      + A{I]*B[R]
-	// I[R[a] + I[a]) * (R[b]+I[b]] = a[2*k]b[2*k+1] + a[2*k+1]b[2*k]
+	if (nInputBufferIndex_ != 0)
+	{
+#pragma loop count(8)
+		for (SampleBuffer::size_type nPath = 0; nPath < Mixer.nPaths(); ++nPath)
+		{
+			MixDestinations_[nPath] += nPartitionLength - nInputBufferIndex_;
+		}
+#pragma loop count(8)
+		for (SampleBuffer::size_type nChannel = 0; nChannel < Mixer.nInputChannels(); ++nChannel)
+		{
+			MixSources_[nChannel] = c_ptr(InputBuffer_, nChannel);
+		}
+		Mixer.InputMix().apply(&MixSources_[0], &MixDestinations_[0], nInputBufferIndex_);
+	}
+}
 
-	// tempt the optimizer
-	assert(N % 4 == 0);
+// Mix the outputs of the paths, whose starts are in MixSources_, into the half of OutputBufferAccumulator_ at
+// nInputBufferIndex_.  Only the second half of each path's output is valid, as the rest is junk
+template <typename T>
+void Convolution<T>::mixOutput()
+{
+	const DWORD nHalfPartitionLength = Mixer.nHalfPartitionLength();
 
-	C[0] += A[0] * B[0];
-	C[1] += A[1] * B[1];
+	assert(nInputBufferIndex_ == nHalfPartitionLength || nInputBufferIndex_ == 0);
 
-	for (ChannelBuffer::size_type R = 2, I = 3; R < N ;R += 2, I += 2)
+#pragma loop count(8)
+	for (SampleBuffer::size_type nPath = 0; nPath < Mixer.nPaths(); ++nPath)
 	{
-		C[R] += A[R]*B[R] - A[I]*B[I];
-		C[I] += A[R]*B[I] + A[I]*B[R];
-		//T1 = A[R] * B[R];
-		//T2 = A[I] * B[I];
-		//C[I] += ((A[R] + A[I]) * (B[R] + B[I])) - (T1 + T2);
-		//C[R] += T1 - T2;
+		MixSources_[nPath] += nHalfPartitionLength;
 	}
+#pragma loop count(8)
+	for (SampleBuffer::size_type nChannel = 0; nChannel < Mixer.nOutputChannels(); ++nChannel)
+	{
+		MixDestinations_[nChannel] = c_ptr(OutputBufferAccumulator_, nChannel) + nInputBufferIndex_;
+	}
+	Mixer.OutputMix().apply(&MixSources_[0], &MixDestinations_[0], nHalfPartitionLength);
 }
 
-#endif
-
 #if defined(DEBUG) | defined(_DEBUG)
 template <typename T>
 T Convolution<T>::verify_convolution(const ChannelBuffer& X, const ChannelBuffer& H, const ChannelBuffer& Y, 
@@ -770,13 +630,23 @@ HRESULT Convolution<T>::calculateOptimumAttenuation(T& fAttenuation, const bool
 	// that is equivalent to 0.1s to process a filter
 	// which means that the filter must be less than 44100 / .1 samples in length to keep up
 	const DWORD nBlocks = nSamples * Mixer.nFilterLength();
-	const DWORD nInputBufferLength = nBlocks * Mixer.nInputChannels();	// Channels are interleaved
+	const DWORD nInputBufferLength = nBlocks * Mixer.nInputChannels();	// nBlocks for each channel, in turn
 	const DWORD nOutputBufferLength = nBlocks * Mixer.nOutputChannels();
 
 	std::vector<T>InputSamples(nInputBufferLength);
 	std::vector<T>OutputSamples(nOutputBufferLength);
 
-	Holder< ConvertSample<T> > convertor(new ConvertSample_ieeefloat<T>());
+	// Planar, so no conversion
+	std::vector<const T*>InputChannels(Mixer.nInputChannels());
+	for(WORD nChannel = 0; nChannel < Mixer.nInputChannels(); ++nChannel)
+	{
+		InputChannels[nChannel] = &InputSamples[nChannel * nBlocks];
+	}
+	std::vector<T*>OutputChannels(Mixer.nOutputChannels());
+	for(WORD nChannel = 0; nChannel < Mixer.nOutputChannels(); ++nChannel)
+	{
+		OutputChannels[nChannel] = &OutputSamples[nChannel * nBlocks];
+	}
 
 	// This is a typedef for a random number generator.
 	// Try boost:: minstd_rand or boost::ecuyer1988 instead of boost::mt19937
@@ -818,35 +688,30 @@ HRESULT Convolution<T>::calculateOptimumAttenuation(T& fAttenuation, const bool
 	cdebug << std::endl;);
 #endif
 	// nPartitions == 0 => use overlap-save version
-	DWORD nBytesGenerated = overlapsave && nPartitions_ == 1 ?
-		doConvolution(reinterpret_cast<BYTE*>(&InputSamples[0]), reinterpret_cast<BYTE*>(&OutputSamples[0]),
-		convertor.get_ptr(), convertor.get_ptr(),
-		/* dwBlocksToProcess */ nBlocks,
-		/* fAttenuation_db */ 0)
-		: doPartitionedConvolution(reinterpret_cast<BYTE*>(&InputSamples[0]), reinterpret_cast<BYTE*>(&OutputSamples[0]),
-		convertor.get_ptr(), convertor.get_ptr(),
-		/* dwBlocksToProcess */ nBlocks,
-		/* fAttenuation_db */ 0);
-
-		// The output will be missing the last half filter length, the first time around
-		assert (nBytesGenerated % sizeof(T) == 0);
-	assert (nBytesGenerated <= nOutputBufferLength * sizeof(T));
+	const DWORD nFramesGenerated = process(&InputChannels[0], &OutputChannels[0], nBlocks, /* fAttenuation_db */ 0,
+		overlapsave && nPartitions_ == 1);
+
+	// The output will be missing the last half filter length, the first time around
+	assert (nFramesGenerated <= nBlocks);
 
 #if defined(DEBUG) | defined(_DEBUG)
 	DEBUGGING(4,
-		cdebug << "OutputSamples(" << nBytesGenerated/sizeof(T) << ") " ;
-	std::copy(&OutputSamples[0], &OutputSamples[nBytesGenerated/sizeof(T)+1], std::ostream_iterator<T>(cdebug, " "));
+		cdebug << "OutputSamples(" << nFramesGenerated << " per channel) " ;
+	std::copy(OutputSamples.begin(), OutputSamples.end(), std::ostream_iterator<T>(cdebug, " "));
 	cdebug << std::endl << std::endl;);
 #endif
 
 	// Scan the output coeffs for larger output samples
 	again = FALSE;
-	for(DWORD i = 0; i  < nBytesGenerated / sizeof(T); ++i)
+	for(WORD nChannel = 0; nChannel < Mixer.nOutputChannels(); ++nChannel)
 	{
-		if (abs(OutputSamples[i]) > maxSample)
+		for(DWORD i = 0; i  < nFramesGenerated; ++i)
 		{
-			maxSample = abs(OutputSamples[i]);
-			again = TRUE; // Keep convolving until find no larger output samples
+			if (abs(OutputChannels[nChannel][i]) > maxSample)
+			{
+				maxSample = abs(OutputChannels[nChannel][i]);
+				again = TRUE; // Keep convolving until find no larger output samples
+			}
 		}
 	}
 	//} while (again);
@@ -870,24 +735,18 @@ HRESULT Convolution<T>::calculateOptimumAttenuation(T& fAttenuation, const bool
 
 	Flush(); // Reset, so that residual noise cleared
 
+	// The calculation is not real-time work, so do not count it
+	Deadlines_.reset();
+	STATS(Stats_.reset());
+
 	return hr;
 }
 
 template <typename T>
-ConvolutionList<T>::ConvolutionList(const TCHAR szConfigFileName[MAX_PATH], const DWORD& nPartitions, const unsigned int& nPlanningRigour) :
-config_(szConfigFileName),
-state_(Unselected),
-selectedConvolutionIndex_(0),
-ConvolutionList_(0),
-nConvolutionList_(0),
-nPartitions_(nPartitions),
-bNeedsUpdating(false)
+std::vector< std::basic_string<TCHAR> > ConvolutionList<T>::listConfigs(const TCHAR szConfigFileName[MAX_PATH])
 {
-	USES_CONVERSION;
-
-#if defined(DEBUG) | defined(_DEBUG)
-	DEBUGGING(3, cdebug << "ConvolutionList::ConvolutionList " << T2A(szConfigFileName) << " " << nPartitions << " " << std::endl;);
-#endif
+	std::vector< std::basic_string<TCHAR> > szConfigs;
+	configFile config(szConfigFileName);
 
 	try
 	{
@@ -908,8 +767,7 @@ bNeedsUpdating(false)
 #endif
 
 		// We have a single sound impulse file, so pick it up
-		ConvolutionList_.push_back(new Convolution<T>(szConfigFileName, nPartitions_, nPlanningRigour));
-		++nConvolutionList_;
+		szConfigs.push_back(szConfigFileName);
 	}
 	catch(const wavfileException&)
 	{
@@ -918,11 +776,10 @@ bNeedsUpdating(false)
 		{
 			// if the first character is a number, we have a config containing a list of filter paths,
 			// rather than config containing list of config files and filter sound files
-			std::basic_ifstream<TCHAR>::int_type nextchar = config_().peek();
+			std::basic_ifstream<TCHAR>::int_type nextchar = config().peek();
 			if (std::isdigit<TCHAR>(nextchar, std::locale()))
 			{
-				ConvolutionList_.push_back(new Convolution<T>(szConfigFileName, nPartitions_, nPlanningRigour));
-				++nConvolutionList_;
+				szConfigs.push_back(szConfigFileName);
 			}
 			else
 			{
@@ -930,49 +787,45 @@ bNeedsUpdating(false)
 				// TODO:: should do this by unsetting the eof exception bit
 				TCHAR szConvolutionListFilename[MAX_PATH];
 				szConvolutionListFilename[0] = 0;
-				while(!config_().eof())
+				while(!config().eof())
 				{
 					try
 					{
 						szConvolutionListFilename[0] = 0;
 						while(szConvolutionListFilename[0] == 0)
 						{
-							config_().getline(szConvolutionListFilename, MAX_PATH);
+							config().getline(szConvolutionListFilename, MAX_PATH);
 						}
 					}
 					catch(const std::ios_base::failure& error)
 					{
-						if(!config_().eof())
+						if(!config().eof())
 							throw;
 					}
-					if(!config_().eof())
+					if(!config().eof())
 					{
 #if defined(DEBUG) | defined(_DEBUG)
 						cdebug << "Reading ConvolutionList from " << szConvolutionListFilename << std::endl;
 #endif
-						ConvolutionList_.push_back(new Convolution<T>(szConvolutionListFilename, nPartitions, nPlanningRigour));
-						++nConvolutionList_;
+						szConfigs.push_back(szConvolutionListFilename);
 					}
 				}
 			}
 		}
 		catch(const std::ios_base::failure& error)
 		{
-			if(config_().eof())
+			if(config().eof())
 			{
-				if(nConvolutionList_ == 0)
+				if(szConfigs.empty())
 				{
 					throw convolutionListException("At least one filter path configuration file must be specified. Missing final blank line?", szConfigFileName);
 				}
-#if defined(DEBUG) | defined(_DEBUG)
-				Dump();
-#endif
 			}
-			else if (config_().fail())
+			else if (config().fail())
 			{
 				throw convolutionListException("Bad sound file or config file syntax is incorrect", szConfigFileName);
 			}
-			else if (config_().bad())
+			else if (config().bad())
 			{
 				throw convolutionListException("Fatal error opening/reading config file", szConfigFileName);
 			}
@@ -1012,6 +865,101 @@ bNeedsUpdating(false)
 		throw convolutionListException("Unexpected exception", szConfigFileName);
 	}
 
+	return szConfigs;
+}
+
+template <typename T>
+Footprint ConvolutionList<T>::footprint(const TCHAR szConfigFileName[MAX_PATH], const DWORD& nPartitions,
+										const unsigned int& nFFTBackend, const DWORD& nHalfPrecisionFrom)
+{
+	return footprint(listConfigs(szConfigFileName), nPartitions, nFFTBackend, nHalfPrecisionFrom);
+}
+
+template <typename T>
+Footprint ConvolutionList<T>::footprint(const std::vector< std::basic_string<TCHAR> >& szConfigs, const DWORD& nPartitions,
+										const unsigned int& nFFTBackend, const DWORD& nHalfPrecisionFrom)
+{
+	Footprint result;
+	for(std::vector< std::basic_string<TCHAR> >::size_type i = 0; i < szConfigs.size(); ++i)
+	{
+		result += ChannelPaths::footprint(szConfigs[i].c_str(), static_cast<WORD>(nPartitions), nFFTBackend, nHalfPrecisionFrom);
+	}
+	return result;
+}
+
+template <typename T>
+ConvolutionList<T>::ConvolutionList(const TCHAR szConfigFileName[MAX_PATH], const DWORD& nPartitions, const unsigned int& nPlanningRigour,
+									const unsigned int& nFFTBackend, const ULONGLONG& nMemoryBudget, const DWORD& nHalfPrecisionFrom) :
+state_(Unselected),
+selectedConvolutionIndex_(0),
+ConvolutionList_(0),
+nConvolutionList_(0),
+nPartitions_(nPartitions),
+nHalfPrecisionFrom_(nHalfPrecisionFrom),
+bNeedsUpdating(false)
+{
+	USES_CONVERSION;
+
+#if defined(DEBUG) | defined(_DEBUG)
+	DEBUGGING(3, cdebug << "ConvolutionList::ConvolutionList " << T2A(szConfigFileName) << " " << nPartitions << " " << std::endl;);
+#endif
+
+	const std::vector< std::basic_string<TCHAR> > szConfigs = listConfigs(szConfigFileName);
+
+	try
+	{
+		// Make the list fit, or refuse it, before allocating any of it
+		if (nMemoryBudget > 0)
+		{
+			Footprint Needed = footprint(szConfigs, nPartitions, nFFTBackend, nHalfPrecisionFrom_);
+			const DWORD nFullPrecision = std::min<DWORD>(nHalfPrecisionFrom_, nPartitions);
+			if (Needed.nTotal() > nMemoryBudget && nFullPrecision > 1)
+			{
+				// Each partition moved to half precision saves the same number of bytes, so work out how many
+				// need to be, from the footprint with only partition 0 kept at full precision
+				const Footprint Least = footprint(szConfigs, nPartitions, nFFTBackend, 1);
+				const ULONGLONG nSavedPerPartition = (Needed.nTotal() - Least.nTotal()) / (nFullPrecision - 1);
+				const ULONGLONG nExcess = Needed.nTotal() - nMemoryBudget;
+				const ULONGLONG nHalved = nSavedPerPartition == 0 ? nFullPrecision - 1 :
+					std::min<ULONGLONG>((nExcess + nSavedPerPartition - 1) / nSavedPerPartition, nFullPrecision - 1);
+				nHalfPrecisionFrom_ = nFullPrecision - static_cast<DWORD>(nHalved);
+				Needed = footprint(szConfigs, nPartitions, nFFTBackend, nHalfPrecisionFrom_);
+			}
+			if (Needed.nTotal() > nMemoryBudget)
+			{
+				std::ostringstream s;
+				s << "Needs " << Needed.DisplayFootprint() << ", over the memory budget of " << nMemoryBudget << " bytes";
+				if (nPartitions > 1)
+				{
+					s << ", even with half precision filter spectra from partition " << nHalfPrecisionFrom_;
+				}
+				else
+				{
+					s << ".  Use more partitions, so that the far ones can be stored at half precision";
+				}
+				throw convolutionListException(s.str(), szConfigFileName);
+			}
+		}
+
+		for(std::vector< std::basic_string<TCHAR> >::size_type i = 0; i < szConfigs.size(); ++i)
+		{
+			ConvolutionList_.push_back(Convolution<T>::load(szConfigs[i].c_str(), nPartitions_, nPlanningRigour, nFFTBackend,
+				nHalfPrecisionFrom_));
+			++nConvolutionList_;
+		}
+	}
+	catch(const convolutionListException&)
+	{
+		throw;
+	}
+	catch(const std::exception& error)
+	{
+#if defined(DEBUG) | defined(_DEBUG)
+		cdebug << "Standard exception: " << error.what() << std::endl;
+#endif
+		throw convolutionListException(error.what(), szConfigFileName);
+	}
+
 #if defined(DEBUG) | defined(_DEBUG)
 	Dump();
 #endif
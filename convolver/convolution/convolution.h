@@ -26,18 +26,14 @@
 #include "convolution\waveformat.h"
 #include "convolution\lrint.h"
 #include "convolution\ffthelp.h"
+#include "convolution\kernels.h"
+#include "convolution\stagestats.h"
+#include "convolution\deadline.h"
 
 // For random number seed
 #include <time.h>
-
-// The following routines are external to pick up multiplication routines that have been vectorized using Intel C99
-#ifndef FFTW
-#if (defined(__ICC) || defined(__ICL) || defined(__ECC) || defined(__ECL))
-// Intel compiler, for vectorization
-extern "C" void cmul(float *, float *, float *, int);
-extern "C" void cmuladd(float *, float *, float *, int);
-#endif
-#endif
+// For the ring wrap points
+#include <algorithm>
 
 // Convolution does the work
 
@@ -45,7 +41,17 @@ template <typename T>
 class Convolution
 {
 public:
-	Convolution(const TCHAR szConfigFileName[MAX_PATH], const DWORD& nPartitions, const unsigned int& nPlanningRigour);
+	// An engine that owns the filter paths loaded from szConfigFileName.  nFFTBackend selects the FFT library (see
+	// FFTBackend::Get), so that backends can be compared in one binary.  Filter partitions nHalfPrecisionFrom on are
+	// stored at half precision (see Filter)
+	static Convolution* load(const TCHAR szConfigFileName[MAX_PATH], const DWORD& nPartitions, const unsigned int& nPlanningRigour,
+		const unsigned int& nFFTBackend = 0, const DWORD& nHalfPrecisionFrom = nNoHalfPrecision);
+
+	// A worker engine: its own input/output buffers and circular spectra, but sharing the (read-only) filter
+	// spectra and FFT plans of SharedMixer, which must outlive it, and so its FFT backend.  Use for rendering
+	// several streams in parallel without reloading and re-planning the filters.  FFTPlans may be executed from
+	// several threads at once.
+	explicit Convolution(const ChannelPaths& SharedMixer);
 	//	virtual ~Convolution(void) {};
 
 	// This version of the convolution routine does partitioned convolution
@@ -64,9 +70,39 @@ public:
 		DWORD dwBlocksToProcess,
 		const T fAttenuation_db);						// Returns bytes generated
 
+	// Planar version, for hosts that already hold a buffer of nFrames samples per channel.  Reads
+	// Mixer.nInputChannels() buffers from pInput and writes Mixer.nOutputChannels() buffers to pOutput, with no sample
+	// conversion and no clipping.  Output lags input by half a partition length, as for the interleaved versions, so
+	// returns the number of frames written to the start of each output buffer.  overlapsave selects doConvolution's
+	// algorithm, which needs 1 partition
+	DWORD process(const T* const pInput[], T* const pOutput[], DWORD nFrames, const T fAttenuation_db,
+		const bool overlapsave = false);
+
 	void Flush();								// zero buffers, reset pointers
 
-	const ChannelPaths		Mixer;				// Order dependent
+	// The load of each call, against the duration of the audio that it processed
+	DeadlineMonitor& Deadlines()
+	{
+		return Deadlines_;
+	}
+
+#ifdef CONVOLUTION_STATS
+	// The cycles spent in each stage since construction or the last ResetStats.  Flush does not reset them
+	ConvolutionStats Stats() const
+	{
+		return Stats_;
+	}
+
+	void ResetStats()
+	{
+		Stats_.reset();
+	}
+#endif
+
+private:
+	Holder<const ChannelPaths> OwnedMixer_;		// NULL for a worker engine, which shares another's Mixer
+public:
+	const ChannelPaths&		Mixer;				// Order dependent
 
 	HRESULT calculateOptimumAttenuation(T& fAttenuation, const bool overlapsave = false);
 
@@ -100,49 +136,110 @@ public:
 	}
 
 private:
+	// ChannelPaths::footprint counts these buffers, before they are allocated, so keep it in step
 	SampleBuffer		InputBuffer_;				// Circular buffer holding the current and previous half partition's
 													// worth of samples
-	ChannelBuffer		InputBufferAccumulator_;
-	ChannelBuffer		OutputBuffer_;				// The output for a particular path, before mixing
+	// Batches: one array for each path, Mixer.nPathStride() floats apart, so that the FFT can transform them together
+	ChannelBuffer		InputBufferAccumulator_;	// The input for each path, after mixing
+	ChannelBuffer		OutputBuffer_;				// The output for each path, before mixing (overlap-save only)
 	SampleBuffer		OutputBufferAccumulator_;	// For collecting path outputs
-	PartitionedBuffer	ComputationCircularBuffer_;	// Used as the output buffer for partitioned convolution
+	SampleBuffer		ComputationCircularBuffer_;	// Used as the output buffer for partitioned convolution: a batch
+														// for each partition
 
 	const DWORD			nPartitions_;
 	DWORD				nInputBufferIndex_;			// placeholder
 	DWORD				nPartitionIndex_;			// for partitioned convolution
 	DWORD				nPreviousPartitionIndex_;	// lags nPartitionIndex_ by 1
 	bool				bStartWriting_;
+	std::vector<T*>		InputChannels_;				// Where getFrames puts each input channel's next run
+	std::vector<const T*> OutputChannels_;			// Where putFrames gets each output channel's next run
+	std::vector<const T*> MixSources_;				// Columns and rows for the mixing matrices
+	std::vector<T*>		MixDestinations_;
+	const std::vector<DWORD> nInputOffsets_;	// Each channel's delay, folded into the ring (see ringOffsets)
+	const std::vector<DWORD> nOutputOffsets_;
+	const std::vector<DWORD> nInputWraps_;		// Where any channel wraps, so that a run must be split (see ringWraps)
+	const std::vector<DWORD> nOutputWraps_;
+	const ComplexKernel	ComplexMul_;				// Chosen for the partition length (see select_complex_mul)
+	const ComplexKernel	ComplexMulAdd_;
+	DeadlineMonitor		Deadlines_;
+#ifdef CONVOLUTION_STATS
+	ConvolutionStats	Stats_;
+#endif
+
+	// Where the frames of a call come from, and go to: either interleaved bytes, through the sample convertors, or
+	// planar buffers of T, one per channel.  Tracks how far each has got
+	struct Frames
+	{
+		const BYTE*					pbInput;
+		BYTE*						pbOutput;
+		const ConvertSample<T>*		input_sample_convertor;
+		const ConvertSample<T>*		output_sample_convertor;
+		DWORD						cbInputBytesProcessed;
+		DWORD						cbOutputBytesGenerated;
+
+		const T* const*				pInput;			// NULL, unless planar
+		T* const*					pOutput;
+		DWORD						nInputFrames;
+		DWORD						nOutputFrames;
+
+		const float					fAttenuationFactor;
+
+		Frames(const BYTE* pbInputData, BYTE* pbOutputData, const ConvertSample<T>* input_convertor,
+			const ConvertSample<T>* output_convertor, const float fAttenuation) :
+		pbInput(pbInputData), pbOutput(pbOutputData), input_sample_convertor(input_convertor),
+			output_sample_convertor(output_convertor), cbInputBytesProcessed(0), cbOutputBytesGenerated(0),
+			pInput(NULL), pOutput(NULL), nInputFrames(0), nOutputFrames(0), fAttenuationFactor(fAttenuation)
+		{}
+
+		Frames(const T* const pInputData[], T* const pOutputData[], const float fAttenuation) :
+		pbInput(NULL), pbOutput(NULL), input_sample_convertor(NULL), output_sample_convertor(NULL),
+			cbInputBytesProcessed(0), cbOutputBytesGenerated(0),
+			pInput(pInputData), pOutput(pOutputData), nInputFrames(0), nOutputFrames(0), fAttenuationFactor(fAttenuation)
+		{}
+	};
+
+	static std::vector<DWORD> ringOffsets(const std::vector<DWORD>& nDelays, const DWORD nLength, const bool bLag);
+	static std::vector<DWORD> ringWraps(const std::vector<DWORD>& nOffsets, const DWORD nLength);
+
+	// Convert nFrames frames between frames and the delayed channels of InputBuffer_ or OutputBufferAccumulator_,
+	// starting at nInputBufferIndex_.  The frames are converted in as few blocks as the channel delays allow
+	void getFrames(Frames& frames, const DWORD nFrames);
+	void putFrames(Frames& frames, const DWORD nFrames);
+
+	// The loop shared by all the entry points.  Filters each half partition of input as it fills
+	void convolve(Frames& frames, DWORD dwBlocksToProcess, const bool bOverlapSave);
+	void filterPartitioned();
+	void filterOverlapSave();
 
-	//void mix_input(const ChannelPaths::ChannelPath& restrict thisPath);
-	void mix_input(const ChannelPaths::ChannelPath& restrict thisPath, 
-							   const SampleBuffer& restrict InputBuffer,
-							   ChannelBuffer& restrict InputBufferAccumulator);
-	void mix_output(const ChannelPaths::ChannelPath& restrict thisPath, SampleBuffer& restrict Accumulator, 
-		const ChannelBuffer& restrict Output, const DWORD to);
-
-	// The following need to be distinguished because different FFT routines use different orderings
-#ifdef FFTW
-	void inline complex_mul(const fftwf_complex* restrict in1, const fftwf_complex* restrict in2,
-		fftwf_complex* restrict result, const ChannelBuffer::size_type count);
-	void inline complex_mul_add(const fftwf_complex* restrict in1, const fftwf_complex* restrict in2,
-		fftwf_complex* restrict result, const ChannelBuffer::size_type count);
+	// Apply Mixer's input and output mixing matrices to all the paths at once
+	void mixInput();
+	void mixOutput();
+
+	// Transform all the paths at once
+	void forwardFFT();
+	void inverseFFT(T* Batch);
+
+	// A path's array in each of the batches
+	T* pathInput(const SampleBuffer::size_type nPath) const
+	{
+		return c_ptr(InputBufferAccumulator_) + nPath * Mixer.nPathStride();
+	}
+
+	T* pathOutput(const SampleBuffer::size_type nPath) const
+	{
+		return c_ptr(OutputBuffer_) + nPath * Mixer.nPathStride();
+	}
+
+	T* pathSpectrum(const SampleBuffer::size_type nPath, const DWORD nPartition) const
+	{
+		return c_ptr(ComputationCircularBuffer_, nPartition) + nPath * Mixer.nPathStride();
+	}
+
+	// The complex multiplications are in kernels.h, as all the FFT backends share a spectrum layout
 #if defined(DEBUG) | defined(_DEBUG)
 	T verify_convolution(const ChannelBuffer& X, const ChannelBuffer& H, const ChannelBuffer& Y, 
 		const ChannelBuffer::size_type from, const ChannelBuffer::size_type to) const;
 #endif
-#elif !(defined(__ICC) || defined(__INTEL_COMPILER))
-	// non-vectorized complex array multiplication -- ordering specific to the Ooura routines. C = A * B
-	void inline cmult(const ChannelBuffer& restrict A, const ChannelBuffer& restrict B, ChannelBuffer& restrict C,
-		const ChannelBuffer::size_type N);
-	void inline cmultadd(const ChannelBuffer& restrict A, const ChannelBuffer& restrict B, ChannelBuffer& restrict C,
-		const ChannelBuffer::size_type N);
-#endif
-
-	// Used to check filter / partion lengths
-	bool isPowerOf2(int i) const
-	{
-		return i > 0 && (i & (i - 1)) == 0;
-	};
 
 	Convolution(); // no implementation
 	Convolution(const Convolution& other); // no impl.
@@ -153,8 +250,17 @@ template <typename T>
 class ConvolutionList
 {
 public:
+	// nMemoryBudget > 0 => if the list's footprint would be more bytes than that, store the far partitions of its
+	// filter spectra at half precision, as few as will fit (see nHalfPrecisionFrom).  Partition 0 is always kept at full
+	// precision, so throw, rather than build the list, if even that would not fit
 	ConvolutionList(const TCHAR szConfigFileName[MAX_PATH], const DWORD& nPartitions,
-		const unsigned int& nPlanningRigour);
+		const unsigned int& nPlanningRigour, const unsigned int& nFFTBackend = 0, const ULONGLONG& nMemoryBudget = 0,
+		const DWORD& nHalfPrecisionFrom = nNoHalfPrecision);
+
+	// The memory that the list would need, with one engine for each config, worked out before building it (see
+	// ChannelPaths::footprint)
+	static Footprint footprint(const TCHAR szConfigFileName[MAX_PATH], const DWORD& nPartitions,
+		const unsigned int& nFFTBackend = 0, const DWORD& nHalfPrecisionFrom = nNoHalfPrecision);
 
 	virtual ~ConvolutionList() 
 	{
@@ -169,6 +275,11 @@ public:
 
 	// Accessor functions
 
+	DWORD nHalfPrecisionFrom() const		// the first partition stored at half precision, possibly chosen to fit the budget
+	{
+		return nHalfPrecisionFrom_;
+	}
+
 	size_type nConvolutionList() const
 	{
 		assert(nConvolutionList_ == ConvolutionList_.size());
@@ -254,14 +365,18 @@ public:
 #endif
 
 private:
-	configFile	config_;
-
-
 	SelectedState state_;
 	size_type selectedConvolutionIndex_;
 	boost::ptr_vector< Convolution<T> > ConvolutionList_;
 	size_type	nConvolutionList_;
 	DWORD	nPartitions_;
+	DWORD	nHalfPrecisionFrom_;
+
+	// The configs (or filter sound files) in the list: szConfigFileName itself, unless it lists others
+	static std::vector< std::basic_string<TCHAR> > listConfigs(const TCHAR szConfigFileName[MAX_PATH]);
+
+	static Footprint footprint(const std::vector< std::basic_string<TCHAR> >& szConfigs, const DWORD& nPartitions,
+		const unsigned int& nFFTBackend, const DWORD& nHalfPrecisionFrom);
 
 	ConvolutionList();											// No default ctor
 	ConvolutionList(const ConvolutionList&);					// No copy ctor
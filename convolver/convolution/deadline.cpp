@@ -0,0 +1,127 @@
+// Convolver: DSP plug-in for Windows Media Player that convolves an impulse respose
+// filter it with the input stream.
+//
+// Copyright (C) 2005  John Pavel
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//
+/////////////////////////////////////////////////////////////////////////////
+//
+// deadline.cpp : Real-time deadline monitoring for the convolution engine
+//
+
+#include "convolution\deadline.h"
+#include <sstream>
+#include <iomanip>
+
+DeadlineMonitor::DeadlineMonitor(const DWORD nSamplesPerSec) :
+nSamplesPerSec_(nSamplesPerSec),
+fThreshold_(1),
+pCallback_(NULL),
+pContext_(NULL),
+bOverloaded_(false)
+{
+	LARGE_INTEGER frequency;
+	::QueryPerformanceFrequency(&frequency);
+	fTicksPerSec_ = static_cast<double>(frequency.QuadPart);
+
+	reset();
+}
+
+void DeadlineMonitor::setOverloadCallback(const double fThreshold, OverloadCallback pCallback, void* pContext)
+{
+	fThreshold_ = fThreshold;
+	pCallback_ = pCallback;
+	pContext_ = pContext;
+	bOverloaded_ = false;
+}
+
+void DeadlineMonitor::stop(const LONGLONG nStart, const DWORD nFrames)
+{
+	if (nFrames == 0 || nSamplesPerSec_ == 0)
+	{
+		return;
+	}
+
+	const double fWallSeconds = (start() - nStart) / fTicksPerSec_;
+	const double fAudioSeconds = static_cast<double>(nFrames) / nSamplesPerSec_;
+	const double fLoad = fWallSeconds / fAudioSeconds;
+
+	++nCalls_;
+	fWallSeconds_ += fWallSeconds;
+	fAudioSeconds_ += fAudioSeconds;
+	if (fLoad > fMaxLoad_)
+	{
+		fMaxLoad_ = fLoad;
+	}
+	if (fLoad > 1)
+	{
+		++nOverruns_;
+	}
+
+	const DWORD nBucket = static_cast<DWORD>(fLoad * 10);
+	++Histogram_[nBucket < nBuckets ? nBucket : nBuckets - 1];
+
+	// Only report the crossing, not every call while overloaded
+	if (fLoad > fThreshold_)
+	{
+		if (!bOverloaded_ && pCallback_ != NULL)
+		{
+			pCallback_(fLoad, nFrames, pContext_);
+		}
+		bOverloaded_ = true;
+	}
+	else
+	{
+		bOverloaded_ = false;
+	}
+}
+
+void DeadlineMonitor::reset()
+{
+	nCalls_ = 0;
+	nOverruns_ = 0;
+	fMaxLoad_ = 0;
+	fWallSeconds_ = 0;
+	fAudioSeconds_ = 0;
+	::ZeroMemory(Histogram_, sizeof(Histogram_));
+	bOverloaded_ = false;
+}
+
+const std::string DeadlineMonitor::DisplayDeadlines() const
+{
+	std::ostringstream s;
+
+	s << nCalls_ << " calls, " << nOverruns_ << " overrun(s), mean load " << std::fixed << std::setprecision(3)
+		<< fMeanLoad() << ", max load " << fMaxLoad_ << std::endl;
+	for (DWORD nBucket = 0; nBucket < nBuckets; ++nBucket)
+	{
+		if (Histogram_[nBucket] != 0)
+		{
+			s << "  load " << std::setprecision(1) << nBucket / 10.0;
+			if (nBucket < nBuckets - 1)
+			{
+				s << "-" << (nBucket + 1) / 10.0;
+			}
+			else
+			{
+				s << "+";
+			}
+			s << ": " << Histogram_[nBucket] << std::endl;
+		}
+	}
+
+	return s.str();
+}
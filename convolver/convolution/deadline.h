@@ -0,0 +1,103 @@
+#pragma once
+// Convolver: DSP plug-in for Windows Media Player that convolves an impulse respose
+// filter it with the input stream.
+//
+// Copyright (C) 2005  John Pavel
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//
+/////////////////////////////////////////////////////////////////////////////
+//
+// deadline.h : Real-time deadline monitoring for the convolution engine
+//
+/////////////////////////////////////////////////////////////////////////////
+
+#include "convolution\config.h"
+#include <string>
+
+// Compares the wall time taken by each call of the engine with the duration of the audio that the call
+// processed.  The ratio is the load: above 1, the call overran its real-time deadline.
+class DeadlineMonitor
+{
+public:
+	// Called, on the audio thread, when the load of a call rises above the threshold.  Keep it short
+	typedef void (*OverloadCallback)(const double fLoad, const DWORD nFrames, void* pContext);
+
+	static const DWORD nBuckets = 20;	// Bucket b counts calls with loads of b/10 to (b+1)/10; the last takes the rest
+
+	explicit DeadlineMonitor(const DWORD nSamplesPerSec);
+
+	// pCallback == NULL => no callback
+	void setOverloadCallback(const double fThreshold, OverloadCallback pCallback, void* pContext = NULL);
+
+	// Bracket a call that processes nFrames frames
+	LONGLONG start() const
+	{
+		LARGE_INTEGER now;
+		::QueryPerformanceCounter(&now);
+		return now.QuadPart;
+	}
+
+	void stop(const LONGLONG nStart, const DWORD nFrames);
+
+	void reset();
+
+	// Accessor functions
+
+	DWORD nCalls() const
+	{
+		return nCalls_;
+	}
+
+	DWORD nOverruns() const
+	{
+		return nOverruns_;
+	}
+
+	double fMaxLoad() const
+	{
+		return fMaxLoad_;
+	}
+
+	// Total wall time / total audio time
+	double fMeanLoad() const
+	{
+		return fAudioSeconds_ > 0 ? fWallSeconds_ / fAudioSeconds_ : 0;
+	}
+
+	DWORD Histogram(const DWORD nBucket) const
+	{
+		assert(nBucket < nBuckets);
+		return Histogram_[nBucket];
+	}
+
+	const std::string DisplayDeadlines() const;
+
+private:
+	DWORD			nSamplesPerSec_;
+	double			fTicksPerSec_;			// of the performance counter
+
+	double			fThreshold_;
+	OverloadCallback	pCallback_;
+	void*			pContext_;
+	bool			bOverloaded_;			// The last call was above the threshold
+
+	DWORD			nCalls_;
+	DWORD			nOverruns_;
+	double			fMaxLoad_;
+	double			fWallSeconds_;
+	double			fAudioSeconds_;
+	DWORD			Histogram_[nBuckets];
+};
@@ -113,6 +113,8 @@
 #include <ksmedia.h>
 #include <mediaerr.h>
 #include <time.h>
+#include <vector>
+#include <algorithm>
 #include <boost\random.hpp>
 //#include <boost\numeric\conversion\conversion_traits.hpp>
 #include <boost\numeric\conversion\converter.hpp>
@@ -181,6 +183,18 @@ public:
 	// Generate the dither
 	virtual T dither(const WORD nChannel) = 0;
 
+	// Generate the dither for nFrames frames of nChannels channels, interleaved.  The default draws a sample at a time
+	virtual void ditherframes(T* dst, const WORD nChannels, const DWORD nFrames)
+	{
+		for (DWORD nFrame = 0; nFrame < nFrames; ++nFrame)
+		{
+			for (WORD nChannel = 0; nChannel < nChannels; ++nChannel)
+			{
+				*dst++ = dither(nChannel);
+			}
+		}
+	}
+
 	virtual ~Dither(void) = 0;
 };
 
@@ -200,25 +214,118 @@ public:
 		return 0;
 	}
 
+	void ditherframes(T* dst, const WORD nChannels, const DWORD nFrames)
+	{
+		std::fill(dst, dst + nFrames * nChannels, T(0));
+	}
+
 	~NoDither(void) {};
 };
 
-//  
+// Marsaglia's xorshift128, run as four independent streams, so that SSE2 can step them together.  Fast, and
+// random enough for dither (it is not for cryptography).  The scalar build gives the same sequence
+class XorShift128
+{
+public:
+	explicit XorShift128(const unsigned int nSeed)
+	{
+		// Expand the seed with a linear congruential generator; no stream may be all zero
+		UINT32 nState = nSeed;
+		for (int nLane = 0; nLane < 4; ++nLane)
+		{
+			for (int nWord = 0; nWord < 4; ++nWord)
+			{
+				nState = nState * 1664525 + 1013904223;
+				state_[nWord][nLane] = nState | (nWord == 3 ? 1 : 0);
+			}
+		}
+	}
+
+	// The next n (a multiple of 4) 32-bit values
+	void generate(INT32* dst, const DWORD n)
+	{
+		assert(n % 4 == 0);
+#ifdef SSE2_CONVERSION
+		__m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(state_[0]));
+		__m128i y = _mm_loadu_si128(reinterpret_cast<const __m128i*>(state_[1]));
+		__m128i z = _mm_loadu_si128(reinterpret_cast<const __m128i*>(state_[2]));
+		__m128i w = _mm_loadu_si128(reinterpret_cast<const __m128i*>(state_[3]));
+		for (DWORD i = 0; i < n; i += 4)
+		{
+			const __m128i t = _mm_xor_si128(x, _mm_slli_epi32(x, 11));
+			x = y;
+			y = z;
+			z = w;
+			w = _mm_xor_si128(_mm_xor_si128(w, _mm_srli_epi32(w, 19)), _mm_xor_si128(t, _mm_srli_epi32(t, 8)));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), w);
+		}
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(state_[0]), x);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(state_[1]), y);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(state_[2]), z);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(state_[3]), w);
+#else
+		for (DWORD i = 0; i < n; i += 4)
+		{
+			for (int nLane = 0; nLane < 4; ++nLane)
+			{
+				const UINT32 t = state_[0][nLane] ^ (state_[0][nLane] << 11);
+				state_[0][nLane] = state_[1][nLane];
+				state_[1][nLane] = state_[2][nLane];
+				state_[2][nLane] = state_[3][nLane];
+				state_[3][nLane] = state_[3][nLane] ^ (state_[3][nLane] >> 19) ^ (t ^ (t >> 8));
+				dst[i + nLane] = static_cast<INT32>(state_[3][nLane]);
+			}
+		}
+#endif
+	}
+
+private:
+	UINT32 state_[4][4];		// [x, y, z, w][stream]
+};
 
-template <typename T, unsigned short validBits, 
-typename distribution_type = boost::uniform_real<T>, 
-typename base_generator_type = boost::random::lagged_fibonacci_01<T, 48, 607, 273> >
+// Draws rectangular dither, uniform over +/- half the least significant bit, a block of frames at a time for all
+// the channels, and hands it out a sample or a block at a time.  Either way, the dither comes in the same order
+template <typename T, unsigned short validBits>
 class SimpleDither : public virtual Dither<T>
 {
 public:
 
 	// Dithering may vary or be optimizable by the number of channels or sample rate
-	SimpleDither(const WORD nChannels) : nChannels_(nChannels),
-	  generator_(unsigned int(std::time(NULL))), gen_dither_(generator_, distribution_type(-Qover2, Qover2))
+	// nSeed == 0 => seed from the clock
+	SimpleDither(const WORD nChannels, const unsigned int nSeed = 0) : nChannels_(nChannels),
+		block_(nBlockFrames * nChannels), generator_(nSeed == 0 ? unsigned int(std::time(NULL)) : nSeed),
+		raw_(nBlockFrames * nChannels), nNext_(nBlockFrames * nChannels)
 	{}
 
 	// Generate the dither
-	virtual T dither(const WORD nChannel) = 0;
+	T dither(const WORD nChannel)
+	{
+		assert(nChannel < nChannels_);
+		assert(nNext_ % nChannels_ == nChannel || nNext_ == block_.size());	// channels are taken in order
+		if (nNext_ == block_.size())
+		{
+			refill();
+		}
+		return block_[nNext_++];
+	}
+
+	void ditherframes(T* dst, const WORD nChannels, const DWORD nFrames)
+	{
+		assert(nChannels == nChannels_);
+		DWORD nSamples = nFrames * nChannels;
+		while (nSamples > 0)
+		{
+			if (nNext_ == block_.size())
+			{
+				refill();
+			}
+			const DWORD nCopy = std::min<DWORD>(nSamples, static_cast<DWORD>(block_.size() - nNext_));
+			std::copy(&block_[nNext_], &block_[nNext_] + nCopy, dst);
+			dst += nCopy;
+			nNext_ += nCopy;
+			nSamples -= nCopy;
+		}
+	}
 
 	virtual ~SimpleDither(void) {};
 
@@ -226,34 +333,52 @@ protected:
 	static const T Q;				// Least significant bit
 	static const T Qover2;
 
-	typedef boost::variate_generator<base_generator_type&, distribution_type> gen_type;
-	gen_type gen_dither_;
-	base_generator_type generator_;
+	enum { nBlockFrames = 64 };		// keeps the block a multiple of 4 samples, for the generator
 
 	const WORD nChannels_;
+	std::vector<T> block_;			// nBlockFrames frames of dither
+
+	// Transform the rectangular dither of a freshly-drawn block_ (eg, to triangular)
+	virtual void shape() {}
+
+	// Draw nSamples (at most a block) of rectangular dither straight from the generator
+	void draw(T* dst, const DWORD nSamples)
+	{
+		assert(nSamples <= raw_.size());
+		generator_.generate(&raw_[0], (nSamples + 3) & ~3);
+		const T scale = Qover2 / T(2147483648.0);	// INT32 => +/- Qover2
+#pragma ivdep
+		for (DWORD i = 0; i < nSamples; ++i)
+		{
+			dst[i] = static_cast<T>(raw_[i]) * scale;
+		}
+	}
+
+private:
+	XorShift128 generator_;
+	std::vector<INT32> raw_;
+	typename std::vector<T>::size_type nNext_;	// in block_
+
+	void refill()
+	{
+		draw(&block_[0], static_cast<DWORD>(block_.size()));
+		shape();
+		nNext_ = 0;
+	}
 };
 
-template <typename T, unsigned short validBits,
-typename distribution_type, typename base_generator_type >
-const T  SimpleDither<T, validBits, distribution_type, base_generator_type>::Q = 2.0 / ((1 << (validBits-2)) - 1 + (1 << (validBits-2)));
+template <typename T, unsigned short validBits>
+const T  SimpleDither<T, validBits>::Q = 2.0 / ((1 << (validBits-2)) - 1 + (1 << (validBits-2)));
 
-template <typename T, unsigned short validBits,
-typename distribution_type, typename base_generator_type >
-const T  SimpleDither<T, validBits, distribution_type, base_generator_type>::Qover2 = 1.0 / ((1 << (validBits-2)) - 1 + (1 << (validBits-2)));
+template <typename T, unsigned short validBits>
+const T  SimpleDither<T, validBits>::Qover2 = 1.0 / ((1 << (validBits-2)) - 1 + (1 << (validBits-2)));
 
 template <typename T, unsigned short validBits> 
 class RectangularDither : public SimpleDither<T, validBits>
 {
 public:
-	RectangularDither(WORD nChannels) : SimpleDither<T, validBits>(nChannels)
+	RectangularDither(WORD nChannels, const unsigned int nSeed = 0) : SimpleDither<T, validBits>(nChannels, nSeed)
 	{};
-
-	// Generate the dither
-	T dither(const WORD nChannel)
-	{
-		assert(nChannel < nChannels_);
-		return gen_dither_();
-	}
 };
 
 
@@ -261,53 +386,30 @@ template <typename T, unsigned short validBits>
 class TriangularDither : public SimpleDither<T, validBits>
 {
 public:
-	TriangularDither(WORD nChannels) : SimpleDither<T, validBits>(nChannels), prev_dither_(nChannels, gen_dither_())
-	{};
-
-	// Generate the triangular dither by differencing successive rectangular dither values
-	T dither(const WORD nChannel)
+	TriangularDither(WORD nChannels, const unsigned int nSeed = 0) : SimpleDither<T, validBits>(nChannels, nSeed),
+		prev_dither_(nChannels)
 	{
-		assert(nChannel < nChannels_);
-		const T dither = gen_dither_();
-		const T result = dither - prev_dither_[nChannel];
-		prev_dither_[nChannel] = dither;
-		return result;
-	}
+		// Start from a draw, as if a frame had gone before, so that the first frame is triangular too
+		this->draw(&prev_dither_[0], nChannels);
+	};
 
 private:
 	std::vector<T> prev_dither_;
-};
-
-// Optimization for 2 channels; requires only 1 extra random number per channel cycle
-template <typename T, unsigned short validBits>
-class StereoTriangularDither : public SimpleDither<T, validBits>
-{
-public:
-	StereoTriangularDither() : SimpleDither<T, validBits>(2), prev_dither_(gen_dither_()), right_dither_(gen_dither_())
-	{};
 
-	// Generate the triangular dither by summing and differencing successive rectangular dither values
-	T dither(const WORD nChannel)
+	// Triangular dither, by differencing successive rectangular dither values of each channel
+	void shape()
 	{
-		assert(nChannels_ == 2);
-		assert(nChannel < nChannels_);
-		if(nChannel == 0)
+		for (typename std::vector<T>::size_type i = 0; i < block_.size(); i += nChannels_)
 		{
-			const T dither = gen_dither_();
-			const T left_dither = dither - prev_dither_;
-			right_dither_ = dither + prev_dither_;
-			prev_dither_ = dither;
-			return left_dither;
-		}
-		else
-		{
-			return right_dither_;
+#pragma loop count (8)
+			for (WORD nChannel = 0; nChannel < nChannels_; ++nChannel)
+			{
+				const T dither = block_[i + nChannel];
+				block_[i + nChannel] = dither - prev_dither_[nChannel];
+				prev_dither_[nChannel] = dither;
+			}
 		}
 	}
-
-private:
-	T prev_dither_;
-	T right_dither_;
 };
 
 
@@ -351,6 +453,21 @@ struct NoiseShape
 	// Generate the dither
 	virtual IntType shapenoise(const T sample, Dither<T> * dither, const WORD nChannel) = 0;
 
+	// Shape frames nFirstFrame to nFirstFrame + nFrames - 1 of the channels srcChannels, clipped to [-1, 1], into
+	// the interleaved dst.  The default shapes a sample at a time
+	virtual void shapeframes(IntType* dst, const T* const srcChannels[], const WORD nChannels,
+		const DWORD nFirstFrame, const DWORD nFrames, Dither<T> * dither)
+	{
+		for (DWORD nFrame = nFirstFrame; nFrame < nFirstFrame + nFrames; ++nFrame)
+		{
+			for (WORD nChannel = 0; nChannel < nChannels; ++nChannel)
+			{
+				const T sample = srcChannels[nChannel][nFrame];
+				*dst++ = shapenoise(sample < T(-1.0) ? T(-1.0) : (sample > T(1.0) ? T(1.0) : sample), dither, nChannel);
+			}
+		}
+	}
+
 	virtual ~NoiseShape(void) = 0;
 };
 template <typename T, typename IntType>
@@ -627,3 +744,240 @@ const TCHAR NoiseShaper<T>::Description[NoiseShaper<T>::nNoiseShapers][NoiseShap
 		TEXT("9th order shaping"),
 		TEXT("Pseudo Sony SBM")
 };
+
+
+// The error feedback filters of the noise shapers above, indexed by NoiseShaper<T>::NoiseShapingType.
+// Coefficient k weights the error of k + 1 samples ago
+template <int nNoiseShaper>
+struct ShapingFilter;
+
+template <>
+struct ShapingFilter<0>	// None: dither only
+{
+	enum { nOrder = 0 };
+	template <typename T> static const T* coefficients()
+	{
+		return NULL;
+	}
+};
+
+template <>
+struct ShapingFilter<1>	// Simple
+{
+	enum { nOrder = 1 };
+	template <typename T> static const T* coefficients()
+	{
+		static const T c[nOrder] = { T(1) };
+		return c;
+	}
+};
+
+template <>
+struct ShapingFilter<2>	// SecondOrder
+{
+	enum { nOrder = 2 };
+	template <typename T> static const T* coefficients()
+	{
+		static const T c[nOrder] = { T(1.287), T(-0.651) };
+		return c;
+	}
+};
+
+template <>
+struct ShapingFilter<3>	// ThirdOrder
+{
+	enum { nOrder = 3 };
+	template <typename T> static const T* coefficients()
+	{
+		static const T c[nOrder] = { T(1.329), T(-0.735), T(0.0646) };
+		return c;
+	}
+};
+
+template <>
+struct ShapingFilter<4>	// NinthOrder
+{
+	enum { nOrder = 9 };
+	template <typename T> static const T* coefficients()
+	{
+		static const T c[nOrder] = { T(2.203), T(-3.210), T(3.970), T(-4.404), T(3.668), T(-2.656),
+			T(1.644), T(-0.767), T(0.118) };
+		return c;
+	}
+};
+
+template <>
+struct ShapingFilter<5>	// SonySBM
+{
+	enum { nOrder = 12 };
+	template <typename T> static const T* coefficients()
+	{
+		static const T c[nOrder] = { T(1.47933), T(-1.59032), T(1.64436), T(-1.36613), T(0.926704), T(-0.557931),
+			T(-0.267859), T(-0.106726), T(-0.0285161), T(0.00123066), T(-0.00616555), T(0.003067) };
+		return c;
+	}
+};
+
+// Any of the noise shapers above, with the filter order fixed at compile time.  The error feedback is serial
+// in time, but independent across channels, so the channels of a frame are shaped together, four to an SSE2
+// vector.  The arithmetic is that of the scalar shapers, in the same order, and the dither is drawn in the
+// same order, so, for the same dither seed, the output is identical.  (T must be float for SSE2.)
+template <typename T, typename IntType, int validBits, int nNoiseShaper>
+class VectorNoiseShape : public NoNoiseShape<T, IntType, validBits>
+{
+	typedef ShapingFilter<nNoiseShaper> Filter;
+
+public:
+	VectorNoiseShape(const WORD nChannels) : NoNoiseShape<T, IntType, validBits>(nChannels),
+		nPaddedChannels_((nChannels + 3) & ~3), e_(Filter::nOrder * nPaddedChannels_ + 1, 0),
+		sample_(nPaddedChannels_, 0), dither_(nPaddedChannels_, 0), yint_(nPaddedChannels_, 0)
+	{}
+
+	// Generate shaped sample
+	virtual IntType shapenoise(const T sample, Dither<T> * dither, const WORD nChannel)
+	{
+		assert(nChannel < nChannels_);
+		return shape(sample, dither->dither(nChannel), nChannel);
+	}
+
+	virtual void shapeframes(IntType* dst, const T* const srcChannels[], const WORD nChannels,
+		const DWORD nFirstFrame, const DWORD nFrames, Dither<T> * dither)
+	{
+		assert(nChannels == nChannels_);
+		for (DWORD nFrame = nFirstFrame; nFrame < nFirstFrame + nFrames; ++nFrame)
+		{
+			// The ditherers have state, so draw the dither in the scalar order
+			dither->ditherframes(&dither_[0], nChannels, 1);
+			for (WORD nChannel = 0; nChannel < nChannels; ++nChannel)
+			{
+				const T sample = srcChannels[nChannel][nFrame];
+				sample_[nChannel] = sample < T(-1.0) ? T(-1.0) : (sample > T(1.0) ? T(1.0) : sample);
+			}
+#ifdef SSE2_CONVERSION
+			shapeframe();
+#pragma loop count (8)
+			for (WORD nChannel = 0; nChannel < nChannels; ++nChannel)
+			{
+				*dst++ = static_cast<IntType>(yint_[nChannel]);
+			}
+#else
+#pragma loop count (8)
+			for (WORD nChannel = 0; nChannel < nChannels; ++nChannel)
+			{
+				*dst++ = shape(sample_[nChannel], dither_[nChannel], nChannel);
+			}
+#endif
+		}
+	}
+
+	virtual ~VectorNoiseShape(void) {}
+
+private:
+	const WORD nPaddedChannels_;			// a whole number of vectors
+	std::vector<T> e_;						// error feedback: row k (of nPaddedChannels_) is the error of k + 1 samples ago
+	std::vector<T> sample_;					// the current frame
+	std::vector<T> dither_;
+	std::vector<INT32> yint_;
+
+	// One channel
+	IntType shape(const T sample, const T d, const WORD nChannel)
+	{
+		const T* c = Filter::template coefficients<T>();
+		T H = 0;
+		if (Filter::nOrder > 0)
+		{
+			H = e_[nChannel] * c[0];
+			for (int k = 1; k < Filter::nOrder; ++k)
+			{
+				H = H + e_[k * nPaddedChannels_ + nChannel] * c[k];
+			}
+		}
+		const T y = sample + d - H;
+
+		const IntType yint = Floor<IntType,T>(y * q_);		// just scale (eg from float to IntType)
+
+		if (Filter::nOrder > 0)
+		{
+			for (int k = Filter::nOrder - 1; k > 0; --k)
+			{
+				e_[k * nPaddedChannels_ + nChannel] = e_[(k - 1) * nPaddedChannels_ + nChannel];
+			}
+			e_[nChannel] = Q_ * (yint + T(0.5)) - (sample - H);
+		}
+		return yint;
+	}
+
+#ifdef SSE2_CONVERSION
+	// Every channel of the frame in sample_ and dither_, into yint_
+	void shapeframe()
+	{
+		const T* c = Filter::template coefficients<T>();
+		const __m128 q = _mm_set1_ps(q_);
+		const __m128 Q = _mm_set1_ps(Q_);
+		const __m128 one = _mm_set1_ps(1.0f);
+		const __m128 half = _mm_set1_ps(0.5f);
+		for (WORD nChannel = 0; nChannel < nPaddedChannels_; nChannel += 4)
+		{
+			const __m128 sample = _mm_loadu_ps(&sample_[nChannel]);
+			__m128 H = _mm_setzero_ps();
+			if (Filter::nOrder > 0)
+			{
+				H = _mm_mul_ps(_mm_loadu_ps(&e_[nChannel]), _mm_set1_ps(c[0]));
+				for (int k = 1; k < Filter::nOrder; ++k)
+				{
+					H = _mm_add_ps(H, _mm_mul_ps(_mm_loadu_ps(&e_[k * nPaddedChannels_ + nChannel]), _mm_set1_ps(c[k])));
+				}
+			}
+			const __m128 y = _mm_mul_ps(_mm_sub_ps(_mm_add_ps(sample, _mm_loadu_ps(&dither_[nChannel])), H), q);
+
+			// floor, from truncation: less one, where truncation rounded a negative value up
+			const __m128 truncated = _mm_cvtepi32_ps(_mm_cvttps_epi32(y));
+			__m128i yint = _mm_cvttps_epi32(_mm_sub_ps(truncated, _mm_and_ps(_mm_cmpgt_ps(truncated, y), one)));
+			if (sizeof(IntType) == 2)
+			{
+				// As the scalar conversion to INT16, which keeps the low 16 bits of any overflow
+				yint = _mm_srai_epi32(_mm_slli_epi32(yint, 16), 16);
+			}
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(&yint_[nChannel]), yint);
+
+			if (Filter::nOrder > 0)
+			{
+				for (int k = Filter::nOrder - 1; k > 0; --k)
+				{
+					_mm_storeu_ps(&e_[k * nPaddedChannels_ + nChannel], _mm_loadu_ps(&e_[(k - 1) * nPaddedChannels_ + nChannel]));
+				}
+				_mm_storeu_ps(&e_[nChannel],
+					_mm_sub_ps(_mm_mul_ps(Q, _mm_add_ps(_mm_cvtepi32_ps(yint), half)), _mm_sub_ps(sample, H)));
+			}
+		}
+	}
+#endif
+};
+
+// The VectorNoiseShape equivalent of nNoiseShaper.  NULL => use the scalar shaper: without SSE2, there are no
+// vectors to gain
+template <typename T, typename IntType, int validBits>
+NoiseShape<T, IntType>* makeVectorNoiseShape(const typename NoiseShaper<T>::NoiseShapingType nNoiseShaper, const WORD nChannels)
+{
+#ifdef SSE2_CONVERSION
+	switch(nNoiseShaper)
+	{
+	case NoiseShaper<T>::None:
+		return new VectorNoiseShape<T, IntType, validBits, NoiseShaper<T>::None>(nChannels);
+	case NoiseShaper<T>::Simple:
+		return new VectorNoiseShape<T, IntType, validBits, NoiseShaper<T>::Simple>(nChannels);
+	case NoiseShaper<T>::SecondOrder:
+		return new VectorNoiseShape<T, IntType, validBits, NoiseShaper<T>::SecondOrder>(nChannels);
+	case NoiseShaper<T>::ThirdOrder:
+		return new VectorNoiseShape<T, IntType, validBits, NoiseShaper<T>::ThirdOrder>(nChannels);
+	case NoiseShaper<T>::NinthOrder:
+		return new VectorNoiseShape<T, IntType, validBits, NoiseShaper<T>::NinthOrder>(nChannels);
+	case NoiseShaper<T>::SonySBM:
+		return new VectorNoiseShape<T, IntType, validBits, NoiseShaper<T>::SonySBM>(nChannels);
+	default:
+		return NULL;	// the convertor reports it
+	}
+#else
+	return NULL;
+#endif
+}
@@ -0,0 +1,314 @@
+// Convolver: DSP plug-in for Windows Media Player that convolves an impulse respose
+// filter it with the input stream.
+//
+// Copyright (C) 2005  John Pavel
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//
+/////////////////////////////////////////////////////////////////////////////
+//
+// fftbackend.cpp : The FFT libraries that the engines can transform with, chosen at runtime
+//
+
+#include "convolution\fftbackend.h"
+#include "convolution\realfft.h"
+#include "convolution\samplebuffer.h"
+
+namespace
+{
+#ifdef FFTW
+	class FFTWPlan : public FFTPlan
+	{
+	public:
+		FFTWPlan(const DWORD nLength, const DWORD nBatch, const DWORD nStride, const unsigned int nPlanningRigour) :
+		  forward_plan_(NULL), reverse_plan_(NULL)
+		{
+			// PATIENT will disable multithreading, if it's not faster
+			if(nPlanningRigour > PlanningRigour::Measure)
+				fftwf_plan_with_nthreads(2);
+
+			if(nPlanningRigour == PlanningRigour::TimeLimited)
+				fftwf_set_timelimit(PlanningRigour::nTimeLimit);
+
+			// The planner may overwrite the batch, so plan on a scratch one
+			ChannelBuffer Batch(nBatch * nStride);
+			const int n = nLength;
+			forward_plan_ = fftwf_plan_many_dft_r2c(1, &n, nBatch,
+				c_ptr(Batch), NULL, 1, nStride,
+				reinterpret_cast<fftwf_complex*>(c_ptr(Batch)), NULL, 1, nStride / 2,
+				PlanningRigour::Flag[nPlanningRigour]);
+			reverse_plan_ = fftwf_plan_many_dft_c2r(1, &n, nBatch,
+				reinterpret_cast<fftwf_complex*>(c_ptr(Batch)), NULL, 1, nStride / 2,
+				c_ptr(Batch), NULL, 1, nStride,
+				PlanningRigour::Flag[nPlanningRigour]);
+			if (forward_plan_ == NULL || reverse_plan_ == NULL)
+			{
+				destroy();
+				throw convolutionException("Failed to plan FFTW transforms");
+			}
+		}
+
+		virtual ~FFTWPlan()
+		{
+			destroy();
+		}
+
+		// The new-array execute routines may be called from several threads at once
+		virtual void forward(float* pBatch) const
+		{
+			fftwf_execute_dft_r2c(forward_plan_, pBatch, reinterpret_cast<fftwf_complex*>(pBatch));
+		}
+
+		virtual void inverse(float* pBatch) const
+		{
+			fftwf_execute_dft_c2r(reverse_plan_, reinterpret_cast<fftwf_complex*>(pBatch), pBatch);
+		}
+
+	private:
+		fftwf_plan	forward_plan_;
+		fftwf_plan	reverse_plan_;
+
+		void destroy()
+		{
+			if (forward_plan_ != NULL)
+				fftwf_destroy_plan(forward_plan_);
+			if (reverse_plan_ != NULL)
+				fftwf_destroy_plan(reverse_plan_);
+		}
+
+		FFTWPlan(const FFTWPlan&);						// No copying
+		const FFTWPlan& operator=(const FFTWPlan&);
+	};
+
+	class FFTWBackend : public FFTBackend
+	{
+	public:
+		virtual const TCHAR* szName() const
+		{
+			return TEXT("FFTW");
+		}
+
+		virtual DWORD nOptimalLength(const DWORD nLength) const
+		{
+			OptimalDFT oDFT;
+			return oDFT.GetOptimalDFTSize(nLength);
+		}
+
+		virtual float fRoundTripGain(const DWORD nLength) const
+		{
+			return static_cast<float>(nLength);
+		}
+
+		virtual FFTPlan* plan(const DWORD nLength, const DWORD nBatch, const DWORD nStride,
+			const unsigned int nPlanningRigour) const
+		{
+			return new FFTWPlan(nLength, nBatch, nStride, nPlanningRigour);
+		}
+
+		// FFTW shares its twiddles between plans.  Take them to be a complex value for each point
+		virtual ULONGLONG nPlanBytes(const DWORD nLength, const DWORD nPlans) const
+		{
+			return static_cast<ULONGLONG>(nLength) * 2 * sizeof(float);
+		}
+	};
+#endif
+
+	// The built-in transform (see realfft.h), which needs powers of 2
+	class BuiltinPlan : public FFTPlan
+	{
+	public:
+		BuiltinPlan(const DWORD nLength, const DWORD nBatch, const DWORD nStride) :
+		  fft_(nLength), nBatch_(nBatch), nStride_(nStride)
+		{
+		}
+
+		virtual void forward(float* pBatch) const
+		{
+#pragma loop count (8)
+			for(DWORD nArray = 0; nArray < nBatch_; ++nArray)
+				fft_.forward(pBatch + nArray * nStride_);
+		}
+
+		virtual void inverse(float* pBatch) const
+		{
+#pragma loop count (8)
+			for(DWORD nArray = 0; nArray < nBatch_; ++nArray)
+				fft_.inverse(pBatch + nArray * nStride_);
+		}
+
+	private:
+		const RealFFT	fft_;
+		const DWORD		nBatch_;
+		const DWORD		nStride_;
+	};
+
+	class BuiltinBackend : public FFTBackend
+	{
+	public:
+		virtual const TCHAR* szName() const
+		{
+			return TEXT("Builtin");
+		}
+
+		virtual DWORD nOptimalLength(const DWORD nLength) const
+		{
+			OptimalDFT oDFT;
+			return oDFT.GetPowerOf2DFTSize(nLength);
+		}
+
+		virtual float fRoundTripGain(const DWORD nLength) const
+		{
+			return static_cast<float>(nLength);
+		}
+
+		virtual FFTPlan* plan(const DWORD nLength, const DWORD nBatch, const DWORD nStride,
+			const unsigned int nPlanningRigour) const
+		{
+			return new BuiltinPlan(nLength, nBatch, nStride);
+		}
+
+		virtual ULONGLONG nPlanBytes(const DWORD nLength, const DWORD nPlans) const
+		{
+			return RealFFT::nTableBytes(nLength);
+		}
+	};
+
+	// The bundled Ooura split-radix routines (fftsg), which need powers of 2.  rdft packs R[n/2] into a[1], so it is
+	// moved to the end of the spectrum after the forward transform, and back before the inverse
+	class OouraPlan : public FFTPlan
+	{
+	public:
+		OouraPlan(const DWORD nLength, const DWORD nBatch, const DWORD nStride) :
+		  nLength_(nLength), nBatch_(nBatch), nStride_(nStride),
+			  ip_(static_cast<int>(sqrt(static_cast<float>(nLength))) + 2, 0),	// ip_[0] = 0 signals the need to initialize
+			  w_(nLength / 2)
+		{
+			if (nLength < 4 || (nLength & (nLength - 1)) != 0)
+			{
+				throw convolutionException("Ooura's FFT only handles powers of 2");
+			}
+
+			// rdft makes its tables on first use.  Do so now, so that executing the plan only reads them
+			ChannelBuffer Scratch(nSpectrumLength());
+			rdft(nLength_, OouraRForward, c_ptr(Scratch), &ip_[0], &w_[0]);
+		}
+
+		virtual void forward(float* pBatch) const
+		{
+#pragma loop count (8)
+			for(DWORD nArray = 0; nArray < nBatch_; ++nArray)
+			{
+				float* const a = pBatch + nArray * nStride_;
+				rdft(nLength_, OouraRForward, a, &ip_[0], &w_[0]);
+				a[nLength_] = a[1];
+				a[1] = 0;
+				a[nLength_ + 1] = 0;
+			}
+		}
+
+		virtual void inverse(float* pBatch) const
+		{
+#pragma loop count (8)
+			for(DWORD nArray = 0; nArray < nBatch_; ++nArray)
+			{
+				float* const a = pBatch + nArray * nStride_;
+				a[1] = a[nLength_];
+				rdft(nLength_, OouraRBackward, a, &ip_[0], &w_[0]);
+			}
+		}
+
+	private:
+		const int				nLength_;
+		const DWORD				nBatch_;
+		const DWORD				nStride_;
+		// Workspace for the non-simple Ooura routines, which only read it once initialized
+		mutable std::vector<int>	ip_;		// work area for bit reversal; length of ip >= 2+sqrt(n)
+		mutable std::vector<DLReal>	w_;			// w[0...n/2-1]   :cos/sin table
+
+		DWORD nSpectrumLength() const
+		{
+			return FFTBackend::nSpectrumLength(nLength_);
+		}
+	};
+
+	class OouraBackend : public FFTBackend
+	{
+	public:
+		virtual const TCHAR* szName() const
+		{
+			return TEXT("Ooura");
+		}
+
+		virtual DWORD nOptimalLength(const DWORD nLength) const
+		{
+			OptimalDFT oDFT;
+			return oDFT.GetPowerOf2DFTSize(nLength);
+		}
+
+		// rdft's inverse is only scaled by n/2
+		virtual float fRoundTripGain(const DWORD nLength) const
+		{
+			return static_cast<float>(nLength / 2);
+		}
+
+		virtual FFTPlan* plan(const DWORD nLength, const DWORD nBatch, const DWORD nStride,
+			const unsigned int nPlanningRigour) const
+		{
+			return new OouraPlan(nLength, nBatch, nStride);
+		}
+
+		// Each plan has its own ip and w
+		virtual ULONGLONG nPlanBytes(const DWORD nLength, const DWORD nPlans) const
+		{
+			return static_cast<ULONGLONG>(nPlans) * ((static_cast<int>(sqrt(static_cast<float>(nLength))) + 2) * sizeof(int) +
+				nLength / 2 * sizeof(DLReal));
+		}
+	};
+
+#ifdef FFTW
+	const FFTWBackend FFTWInstance;
+#endif
+	const BuiltinBackend BuiltinInstance;
+	const OouraBackend OouraInstance;
+
+	const FFTBackend* const Backends[] =
+	{
+#ifdef FFTW
+		&FFTWInstance,
+#endif
+		&BuiltinInstance,
+		&OouraInstance
+	};
+}
+
+const unsigned int FFTBackend::nBackends = sizeof(Backends) / sizeof(Backends[0]);
+
+const FFTBackend& FFTBackend::Get(const unsigned int nBackend)
+{
+	if (nBackend >= nBackends)
+		throw std::range_error("Invalid FFT backend");
+
+	return *Backends[nBackend];
+}
+
+unsigned int FFTBackend::Lookup(const TCHAR* szName)
+{
+	for(unsigned int i=0; i<nBackends; ++i)
+	{
+		if(_tcsicmp(szName, Backends[i]->szName()) == 0)
+			return i;
+	}
+	throw std::range_error("Invalid FFT backend");
+}
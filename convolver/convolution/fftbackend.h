@@ -0,0 +1,78 @@
+#pragma once
+// Convolver: DSP plug-in for Windows Media Player that convolves an impulse respose
+// filter it with the input stream.
+//
+// Copyright (C) 2005  John Pavel
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//
+/////////////////////////////////////////////////////////////////////////////
+//
+// fftbackend.h : The FFT libraries that the engines can transform with, chosen at runtime
+//
+/////////////////////////////////////////////////////////////////////////////
+
+#include "convolution\config.h"
+#include "convolution\ffthelp.h"
+
+// A plan for transforming a batch of arrays in place.  The arrays are nStride floats apart, and each holds
+// nLength reals or, after the forward transform, the nLength / 2 + 1 interleaved complex values of their spectrum.
+// A plan is not changed by executing it, so several threads can execute one at once, on different batches.
+class FFTPlan
+{
+public:
+	virtual ~FFTPlan() {}
+
+	virtual void forward(float* pBatch) const = 0;
+	virtual void inverse(float* pBatch) const = 0;
+};
+
+// An FFT library.  All the backends use the spectrum layout above (FFTW's), so that the complex kernels serve
+// them all, but a spectrum should only be inverted by the backend that made it, as the sign of the imaginary
+// parts is the backend's own (Ooura's is the opposite of FFTW's).  Products of spectra from the same backend
+// invert correctly.  Neither direction is normalised: a forward and an inverse transform multiply by
+// fRoundTripGain(nLength)
+class FFTBackend
+{
+public:
+	virtual ~FFTBackend() {}
+
+	virtual const TCHAR* szName() const = 0;
+
+	// The smallest length, at least nLength, that the backend can transform efficiently
+	virtual DWORD nOptimalLength(const DWORD nLength) const = 0;
+
+	virtual float fRoundTripGain(const DWORD nLength) const = 0;
+
+	// Plan nBatch transforms of nLength reals.  nStride must be at least nSpectrumLength(nLength), and keep each
+	// array of a batch 16-byte aligned.  The caller owns the plan.  Throws, if the backend can't plan it
+	virtual FFTPlan* plan(const DWORD nLength, const DWORD nBatch, const DWORD nStride,
+		const unsigned int nPlanningRigour) const = 0;
+
+	// The bytes of the tables that nPlans plans of nLength hold between them, whatever their batches.  An estimate,
+	// for a library whose plans are opaque
+	virtual ULONGLONG nPlanBytes(const DWORD nLength, const DWORD nPlans) const = 0;
+
+	// The floats needed to hold the spectrum of nLength reals
+	static DWORD nSpectrumLength(const DWORD nLength)
+	{
+		return 2 * (nLength / 2 + 1);
+	}
+
+	// The backends built in, most preferred first.  Get and Lookup throw std::range_error for an unknown backend
+	static const unsigned int nBackends;
+	static const FFTBackend& Get(const unsigned int nBackend);
+	static unsigned int Lookup(const TCHAR* szName);
+};
@@ -296,7 +296,7 @@ DWORD OptimalDFT::GetOptimalDFTSize( DWORD size0 )
 {
 	if(size0 >= HalfLargestDFTSize)
 		throw convolutionException("Convolution too big to handle");
-#ifdef FFTW
+
 	DWORD a = 0;
 	DWORD b = sizeof(OptimalDFTSize)/sizeof(OptimalDFTSize[0]) - 1;
 	assert( (unsigned)size0 < (unsigned)OptimalDFTSize[b] );
@@ -312,7 +312,14 @@ DWORD OptimalDFT::GetOptimalDFTSize( DWORD size0 )
 	}
 
 	return OptimalDFTSize[b];
-#else
+}
+
+// For the FFTs that only handle powers of 2
+DWORD OptimalDFT::GetPowerOf2DFTSize( DWORD size0 )
+{
+	if(size0 >= HalfLargestDFTSize)
+		throw convolutionException("Convolution too big to handle");
+
 	// highest power of two greater than size0
 	DWORD d = 2;
 	while(d < size0)
@@ -320,5 +327,4 @@ DWORD OptimalDFT::GetOptimalDFTSize( DWORD size0 )
 		d*=2;
 	}
 	return d;
-#endif
 }
@@ -29,6 +29,7 @@ struct OptimalDFT
 	static const DWORD OptimalDFTSize[];
 
 	DWORD GetOptimalDFTSize( DWORD size0 );
+	DWORD GetPowerOf2DFTSize( DWORD size0 );
 
 };
 
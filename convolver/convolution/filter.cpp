@@ -19,40 +19,141 @@
 
 #include "convolution\ffthelp.h"
 #include "convolution\filter.h"
+#include "convolution\kernels.h"
+#include <algorithm>
+#include <limits>
+
+namespace
+{
+	// The number of samples (of all the channels) read at a time
+	const DWORD nChunkSamples = 65536;
+
+#ifndef LIBSNDFILE
+	// Converts one sample of a PCM or IEEE float wave file
+	float decodeSample(const BYTE* bSample, const WORD wFormatTag, const WORD wBitsPerSample, const WORD wValidBitsPerSample,
+		const TCHAR szFilterFileName[MAX_PATH])
+	{
+		switch (wFormatTag)
+		{
+		case WAVE_FORMAT_PCM:
+			switch (wBitsPerSample)	// container size
+			{
+			case 8:
+				return static_cast<float>(bSample[0] - 128);
+			case 16:
+				return *reinterpret_cast<const INT16*>(bSample);
+			case 24:
+				{
+					// Get the input sample
+					int i = bSample[2];
+					i = (i << 8) | bSample[1];
+
+					switch (wValidBitsPerSample)
+					{
+					case 16:
+						break;
+					case 20:
+						i = (i << 4) | (bSample[0] >> 4);
+						break;
+					case 24:
+						i = (i << 8) | bSample[0];
+						break;
+					default:
+						throw filterException("Bit depth for 24-bit container must be 16, 20 or 24", szFilterFileName);
+					}
+					return static_cast<float>(i);
+				}
+			case 32:
+				{
+					INT32 i = *reinterpret_cast<const INT32*>(bSample);
+
+					switch (wValidBitsPerSample)
+					{
+					case 16:
+						i >>= 16;
+						break;
+					case 20:
+						i >>= 12;
+						break;
+					case 24:
+						i >>= 8;
+						break;
+					case 32:
+						break;
+					default:
+						throw filterException("Bit depth for 32-bit container must be 16, 20, 24 or 32", szFilterFileName);
+					}
+					return static_cast<float>(i);
+				}
+			default:
+				throw filterException("Unsupported PCM sample size", szFilterFileName);
+			}
+
+		case WAVE_FORMAT_IEEE_FLOAT:
+			switch (wBitsPerSample)
+			{
+			case 16:
+				throw filterException("16-bit IEEE float sample size not implemented", szFilterFileName);
+			case 24:
+				throw filterException("24-bit IEEE float sample size not implemented", szFilterFileName);
+			case 32:
+				return *reinterpret_cast<const float*>(bSample);
+			case 64:
+				return static_cast<float>(*reinterpret_cast<const double*>(bSample));
+			default:
+				throw filterException("Invalid IEEE float sample size", szFilterFileName);
+			}
+
+		default:
+			throw filterException("Only PCM and IEEE Float file formats supported", szFilterFileName);
+		}
+	}
+#endif
+}
 
 // nSamplesPerSec is a default, for raw pcm files,.  nSamplesPerSec_ will be reset to the actual rate of the sound file for other formats
-Filter::Filter(const TCHAR szFilterFileName[MAX_PATH], const DWORD nPartitions, const DWORD nFilterChannel, const DWORD nSamplesPerSec,
-			   const unsigned int nPlanningRigour) : 
-nPartitions (nPartitions),
-nSamplesPerSec_(nSamplesPerSec)
+FilterFile::FilterFile(const TCHAR szFilterFileName[MAX_PATH], const DWORD nPartitions, const std::vector<DWORD>& nFilterChannels,
+					   const DWORD nSamplesPerSec, const unsigned int nPlanningRigour, const FFTBackend& Backend,
+					   const DWORD nHalfPrecisionFrom) :
+nPartitions(nPartitions),
+nSamplesPerSec_(nSamplesPerSec),
+Backend_(Backend),
+nPlanningRigour_(nPlanningRigour),
+nHalfPrecisionFrom_(nHalfPrecisionFrom)
 {
 #if defined(DEBUG) | defined(_DEBUG)
-	DEBUGGING(3, cdebug << "Filter::Filter " << nPartitions << " " << nSamplesPerSec << std::endl;);
+	DEBUGGING(3, cdebug << "FilterFile::FilterFile " << nPartitions << " " << nSamplesPerSec << std::endl;);
 #endif
 #ifndef LIBSNDFILE
 	HRESULT hr = S_OK;
 #endif
 
-#ifdef UNDEFINED
-	// TODO:: unclear whether this has any effect other than breaking Athlon
-	SIMDFlushToZero();	// Set flush to zero processor mode for speed, with a loss of accuracy
-#endif
-
 	if (nPartitions == 0)
 	{
 		throw filterException("Number of partitions must be at least one", szFilterFileName);
 	}
 
+	// Each channel is extracted once, however many filters are taken from it
+	for(std::vector<DWORD>::size_type i = 0; i < nFilterChannels.size(); ++i)
+	{
+		const std::vector<DWORD>::iterator it = std::find(nFilterChannels_.begin(), nFilterChannels_.end(), nFilterChannels[i]);
+		if (it == nFilterChannels_.end())
+		{
+			nFilterChannels_.push_back(nFilterChannels[i]);
+			nTakes_.push_back(1);
+		}
+		else
+		{
+			++nTakes_[it - nFilterChannels_.begin()];
+		}
+	}
+
 	// Load the sound file
 #ifdef LIBSNDFILE
 	::ZeroMemory(&sf_FilterFormat_, sizeof(SF_INFO));
 	CWaveFileHandle pFilterWave(szFilterFileName, SFM_READ, &sf_FilterFormat_, nSamplesPerSec); // Throws, if file invalid
 
-	if(sf_FilterFormat_.channels < nFilterChannel + 1)
-	{
-		throw filterException("Filter channel number too big", szFilterFileName);
-	}
-
+	const DWORD nChannels = sf_FilterFormat_.channels;
 	nSamplesPerSec_ = sf_FilterFormat_.samplerate;
 	nFilterLength_ = sf_FilterFormat_.frames;
 
@@ -68,12 +169,8 @@ nSamplesPerSec_(nSamplesPerSec)
 	::ZeroMemory(&wfexFilterFormat_, sizeof(wfexFilterFormat_));
 	wfexFilterFormat_.Format = *pFilterWave->GetFormat();
 
-	if(wfexFilterFormat_.Format.nChannels < nFilterChannel + 1)
-	{
-		throw filterException("Filter channel number too big");
-	}
-
-	nSamplesPerSec_ = wfexFilterFormat_.Format.nSampleRate;
+	const DWORD nChannels = wfexFilterFormat_.Format.nChannels;
+	nSamplesPerSec_ = wfexFilterFormat_.Format.nSamplesPerSec;
 
 	WORD wValidBitsPerSample = wfexFilterFormat_.Format.wBitsPerSample;
 	WORD wFormatTag = wfexFilterFormat_.Format.wFormatTag;
@@ -108,8 +205,20 @@ nSamplesPerSec_(nSamplesPerSec)
 			}
 		}
 	}
+
+	assert(wfexFilterFormat_.Format.wBitsPerSample >= wValidBitsPerSample);
+	const DWORD dwSampleSize = wfexFilterFormat_.Format.wBitsPerSample / 8;  // container size, in bytes
+	assert (dwSampleSize <= 8);	// 8 is the biggest sample size (64-bit)
 #endif
 
+	for(std::vector<DWORD>::size_type i = 0; i < nFilterChannels_.size(); ++i)
+	{
+		if(nChannels < nFilterChannels_[i] + 1)
+		{
+			throw filterException("Filter channel number too big", szFilterFileName);
+		}
+	}
+
 	// Setup the filter
 	// A partition will contain half real data, and half zero padding.  Taking the DFT will, of course, overwrite that padding
 	nHalfPartitionLength_ = (nFilterLength_ + nPartitions - 1) / nPartitions;
@@ -132,57 +241,28 @@ nSamplesPerSec_(nSamplesPerSec)
 
 	nPartitionLength_ = nHalfPartitionLength_ * 2;
 
-	DWORD nHalfPaddedPartitionLength = oDFT.GetOptimalDFTSize(nHalfPartitionLength_);
-	DWORD nPaddedPartitionLength = nHalfPaddedPartitionLength * 2;
+	const DWORD nPaddedPartitionLength = nPaddedLength(nFilterLength_, nPartitions, Backend);
+	const DWORD nHalfPaddedPartitionLength = nPaddedPartitionLength / 2;
 
-#ifdef OOURA
-	// Initialize the Oooura workspace;
-	ip_.resize(static_cast<int>(sqrt(static_cast<float>(nPaddedPartitionLength)) + 2));
-	ip_[0]=0; // signal the need to initialize
-	w_.resize(nHalfPaddedPartitionLength);	// w_[0..nPaddedPartitionLength/2 - 1]
-#endif
-
-	// Initialise the Filter
-#ifdef FFTW
-	nFFTWPartitionLength_ = 2*(nPaddedPartitionLength/2+1);
-#ifdef ARRAY
-	coeffs_ = SampleBuffer(nPartitions, nFFTWPartitionLength_);
-#else
-	coeffs_ = SampleBuffer(nPartitions, ChannelBuffer(nFFTWPartitionLength_));
-#endif
-	// PATIENT will disable multithreading, if it's not faster
-	if(nPlanningRigour > PlanningRigour::Measure)
-		fftwf_plan_with_nthreads(2);
-
-	if(nPlanningRigour == PlanningRigour::TimeLimited)
-		fftwf_set_timelimit(PlanningRigour::nTimeLimit);
-
-	plan_ =  fftwf_plan_dft_r2c_1d(nPaddedPartitionLength,
-		c_ptr(coeffs_), reinterpret_cast<fftwf_complex*>(c_ptr(coeffs_)),
-		PlanningRigour::Flag[nPlanningRigour]);
-	reverse_plan_ =  fftwf_plan_dft_c2r_1d(nPaddedPartitionLength, 
-		reinterpret_cast<fftwf_complex*>(c_ptr(coeffs_)), c_ptr(coeffs_),
-		PlanningRigour::Flag[nPlanningRigour]);
-#else
+	// Initialise the spectra
+	nFFTWPartitionLength_ = FFTBackend::nSpectrumLength(nPaddedPartitionLength);
 #ifdef ARRAY
-	coeffs_ = SampleBuffer(nPartitions, nPaddedPartitionLength);
+	coeffs_ = PartitionedBuffer(nFilterChannels_.size(), SampleBuffer(nPartitions, nFFTWPartitionLength_));
 #else
-	coeffs_ = SampleBuffer(nPartitions, ChannelBuffer(nPaddedPartitionLength));
-#endif
+	coeffs_ = PartitionedBuffer(nFilterChannels_.size(), SampleBuffer(nPartitions, ChannelBuffer(nFFTWPartitionLength_)));
 #endif
+	Holder<FFTPlan> plan;
+	plan.set_ptr(Backend.plan(nPaddedPartitionLength, 1, nFFTWPartitionLength_, nPlanningRigour));
 
-#ifdef LIBSNDFILE
-	std::vector<float> item(sf_FilterFormat_.channels);
-#else
-	assert(wfexFilterFormat_.Format.wBitsPerSample >= wValidBitsPerSample);
-	const DWORD dwSizeToRead = wfexFilterFormat_.Format.wBitsPerSample / 8;  // container size, in bytes
+	// Scale the spectra, so that we don't need to do so when convolving
+	const float fScale = 1.0f / Backend.fRoundTripGain(nPaddedPartitionLength);
 
-	assert (dwSizeToRead <= 8);
-	std::vector<BYTE> bSample(8,0); // 8 is the biggest sample size (64-bit)
-
-	DWORD dwSizeRead = 0;
-
-	float sample = 0;
+	// Read the filter file, a chunk of whole frames at a time.  Each partition takes the padded half length of the
+	// filter, as the engines delay each partition by that, so the last partitions may take less, or none
+	const DWORD nChunkFrames = std::max<DWORD>(1, nChunkSamples / nChannels);
+	std::vector<float> Chunk(nChunkFrames * nChannels);		// interleaved, as in the file
+#ifndef LIBSNDFILE
+	std::vector<BYTE> bChunk(nChunkFrames * nChannels * dwSampleSize);
 #endif
 
 #if defined(DEBUG) | defined(_DEBUG)
@@ -190,248 +270,197 @@ nSamplesPerSec_(nSamplesPerSec)
 	float maxSample = 0;
 #endif
 
-	// Read the filter file
 	DWORD nPartition = 0;
+	DWORD nOffset = 0;					// The samples so far in the current partition
 	DWORD nFrame = 0;					// LibSndFile refers to blocks as frames
 	while (nFrame < nFilterLength_)
 	{
+		const DWORD nFrames = std::min<DWORD>(nChunkFrames, nFilterLength_ - nFrame);
 #ifdef LIBSNDFILE
-		if (1 == pFilterWave.readf_float(&item[0], 1))		// 1 = 1 frame = nChannel items
-		{
-			// Got a frame / block (ie, the items / samples for each channel)
-			// Pick the sample corresponding to the selected channel
-			coeffs_[nPartition][nFrame % nHalfPartitionLength_] = item[nFilterChannel];
-#if defined(DEBUG) | defined(_DEBUG)
-			if (item[nFilterChannel] > maxSample)
-				maxSample = item[nFilterChannel];
-			if (item[nFilterChannel] < minSample)
-				minSample = item[nFilterChannel];
-#endif
-		}
-		else
+		if (nFrames != pFilterWave.readf_float(&Chunk[0], nFrames))
 		{
 			throw filterException("Failed to read a frame", szFilterFileName);
-		};
+		}
 #else
-		for(WORD nChannel = 0; nChannel <= nFilterChannel; ++nChannel)
+		DWORD dwSizeRead = 0;
+		const DWORD dwSizeToRead = nFrames * nChannels * dwSampleSize;
+		hr = pFilterWave->Read(&bChunk[0], dwSizeToRead, &dwSizeRead);
+
+		if (FAILED(hr))
 		{
-			hr = pFilterWave->Read(&bSample[nChannel], dwSizeToRead, &dwSizeRead);
+			throw filterException("Failed to read a block", szFilterFileName);
+		}
 
-			if (FAILED(hr))
-			{
-				throw filterException("Failed to read a block", szFilterFileName);
-			}
+		if (dwSizeRead != dwSizeToRead) // file corrupt, non-existent, etc
+		{
+			throw filterException("Failed to read a complete block", szFilterFileName);
+		}
 
-			if (dwSizeRead != dwSizeToRead) // file corrupt, non-existent, etc
+		// Only decode the channels selected
+		for(DWORD nChunkFrame = 0; nChunkFrame < nFrames; ++nChunkFrame)
+		{
+			for(std::vector<DWORD>::size_type i = 0; i < nFilterChannels_.size(); ++i)
 			{
-				throw filterException("Failed to read a complete block", szFilterFileName);
+				const DWORD nSample = nChunkFrame * nChannels + nFilterChannels_[i];
+				Chunk[nSample] = decodeSample(&bChunk[nSample * dwSampleSize], wFormatTag,
+					wfexFilterFormat_.Format.wBitsPerSample, wValidBitsPerSample, szFilterFileName);
 			}
 		}
-		// Now convert bSample to the float sample
-		switch (wFormatTag)
+#endif
+
+		// Copy the selected channels into their partitions, transforming each partition when it is full
+		for(DWORD nChunkFrame = 0; nChunkFrame < nFrames;)
 		{
-		case WAVE_FORMAT_PCM:
-			switch (wfexFilterFormat_.Format.wBitsPerSample)	// container size
+			const DWORD nRun = std::min<DWORD>(nFrames - nChunkFrame, nHalfPaddedPartitionLength - nOffset);
+			for(std::vector<DWORD>::size_type i = 0; i < nFilterChannels_.size(); ++i)
 			{
-			case 8:
-				{
-					assert(dwSizeToRead == sizeof(BYTE));
-					sample = static_cast<float>(bSample[0] - 128);
-				}
-				break;
-			case 16:
-				{
-					assert(dwSizeToRead == sizeof(INT16));
-					sample = *reinterpret_cast<INT16*>(&bSample[0]);
-				}
-				break;
-			case 24:
-				{
-					assert(dwSizeToRead == 3);  // 3 bytes
-					// Get the input sample
-					int i = bSample[2];
-					i = (i << 8) | bSample[1];
-
-					switch (wValidBitsPerSample)
-					{
-					case 16:
-						break;
-					case 20:
-						i = (i << 4) | (bSample[0] >> 4);
-						break;
-					case 24:
-						i = (i << 8) | bSample[0];
-						break;
-					default:
-						throw filterException("Bit depth for 24-bit container must be 16, 20 or 24", szFilterFileName);
-					}
-					sample = static_cast<float>(i);
-				}
-				break;
-			case 32:
+				const float* restrict in = &Chunk[nChunkFrame * nChannels + nFilterChannels_[i]];
+				float* restrict out = c_ptr(coeffs_[i], nPartition) + nOffset;
+				for(DWORD n = 0; n < nRun; ++n)
 				{
-					assert(dwSizeToRead == sizeof(INT32));
-
-					//// Get the input sample
-					INT32 i = *reinterpret_cast<INT32 *>(&bSample[0]);
-
-					////sample = (bSample[3] << 24) + (bSample[2] << 16) + (bSample[1] << 8) + bSample[0]; // little-endian. (RIFF)
-					////sample = (bSample[0] << 24) + (bSample[1] << 16) + (bSample[2] << 8) + bSample[3]; // big-endian. (RIFX)
-
-					switch (wValidBitsPerSample)
-					{
-					case 16:
-						i >>= 16;
-						break;
-					case 20:
-						i >>= 12;
-						break;
-					case 24:
-						i >>= 8;
-						break;
-					case 32:
-						break;
-					default:
-						throw filterException("Bit depth for 32-bit container must be 16, 20, 24 or 32", szFilterFileName);
-					}
-					sample = static_cast<float>(i);
+					out[n] = in[n * nChannels];
+#if defined(DEBUG) | defined(_DEBUG)
+					if (out[n] > maxSample)
+						maxSample = out[n];
+					if (out[n] < minSample)
+						minSample = out[n];
+#endif
 				}
-				break;
-			default:
-				throw filterException("Unsupported PCM sample size", szFilterFileName); // Unsupported it sample size
 			}
-			break;
+			nChunkFrame += nRun;
+			nOffset += nRun;
 
-		case WAVE_FORMAT_IEEE_FLOAT:
-			switch (wfexFilterFormat_.Format.wBitsPerSample)
+			if (nOffset == nHalfPaddedPartitionLength)
 			{
-			case 16:
-				throw filterException("16-bit IEEE float sample size not implemented", szFilterFileName);
-			case 24:
-				throw filterException("24-bit IEEE float sample size not implemented", szFilterFileName);
-			case 32:
+				for(std::vector<DWORD>::size_type i = 0; i < nFilterChannels_.size(); ++i)
 				{
-					assert(dwSizeToRead == sizeof(float));
-					sample = *reinterpret_cast<float*>(&bSample[0]);
-				}  // case
-				break;
-			case 64:
-				{
-					assert(dwSizeToRead == sizeof(double));
-					sample = *reinterpret_cast<double*>(&bSample[0]);
-				}  // case
-				break;
-			default:
-				throw filterException("Invalid IEEE float sample size", szFilterFileName); // Unsupported it sample size
+					// Pad partition, and take the DFT
+					coeffs_[i][nPartition].Zero(nHalfPaddedPartitionLength, nPaddedPartitionLength - nHalfPaddedPartitionLength);
+					plan->forward(c_ptr(coeffs_[i], nPartition));
+					coeffs_[i][nPartition] *= fScale;
+				}
+				++nPartition;
+				nOffset = 0;
 			}
-			break;
-
-		default:
-			throw filterException("Only PCM and IEEE Float file formats supported", szFilterFileName););	// Filter file format is not supported
 		}
 
-		coeffs_[nPartition][nFrame % nHalfPartitionLength_] = sample;
-
-#if defined(DEBUG) | defined(_DEBUG)
-		if (sample > maxSample)
-			maxSample = sample;
-		if (sample < minSample)
-			minSample = sample;
-#endif
+		nFrame += nFrames;
+	} // while
 
-		// skip the rest of the block
-		for(;nChannel < wfexFilterFormat_.Format.nChannels ; ++ nChannel)
+	// Pad the current partition (if necessary)
+	if (nOffset != 0)
+	{
+		for(std::vector<DWORD>::size_type i = 0; i < nFilterChannels_.size(); ++i)
 		{
-			hr = pFilterWave->Read(&bSample[0], dwSizeToRead, &dwSizeRead);
-
-			if (FAILED(hr))
-			{
-				throw filterException("Failed to read a block", szFilterFileName);
-			}
-
-			if (dwSizeRead != dwSizeToRead) // file corrupt, non-existent, etc
-			{
-				throw filterException("Failed to read a complete block", szFilterFileName);
-			}
+			coeffs_[i][nPartition].Zero(nOffset, nPaddedPartitionLength - nOffset);
+			plan->forward(c_ptr(coeffs_[i], nPartition));
+			coeffs_[i][nPartition] *= fScale;
 		}
+		++nPartition;
+	}
 
-#endif
-
-		++nFrame;
-		if (nFrame % nHalfPartitionLength_ == 0)
+	// Zero any further partitions;
+	for (;nPartition < nPartitions; ++nPartition)
+	{
+		for(std::vector<DWORD>::size_type i = 0; i < nFilterChannels_.size(); ++i)
 		{
-			// Pad partition
-			for (ChannelBuffer::size_type nPadding = nHalfPartitionLength_; nPadding < nPaddedPartitionLength; ++nPadding)
-			{
-				coeffs_[nPartition][nPadding] = 0;
-			}
+			coeffs_[i][nPartition] = 0;
+		}
+	}
 
-			// Take the DFT
-#ifdef FFTW
-			fftwf_execute_dft_r2c(plan_, 
-				c_ptr(coeffs_, nPartition), 
-				reinterpret_cast<fftwf_complex*>(c_ptr(coeffs_, nPartition)));
-#elif defined(OOURA_SIMPLE)
-			rdft(nPaddedPartitionLength, OouraRForward, c_ptr(coeffs_, nPartition));
-#elif defined(OOURA)
-			rdft(nPaddedPartitionLength, OouraRForward, c_ptr(coeffs_, nPartition), &ip_[0], &w_[0]);
+	// The padded lengths become the actual lengths that we are going to work with
+	nPartitionLength_ = nPaddedPartitionLength;
+	nHalfPartitionLength_ = nHalfPaddedPartitionLength;
+	nFilterLength_ = nPartitions * nPartitionLength_;
+
+#if defined(DEBUG) | defined(_DEBUG)
+#ifdef LIBSNDFILE
+	cdebug << waveFormatDescription(sf_FilterFormat(), "FFT Filter: ") << std::endl;
 #else
-#error "No FFT package defined"
+	cdebug << waveFormatDescription(&wfexFilterFormat_, nFilterLength_, "FFT Filter:") << std::endl;
 #endif
 
-			// Scale here, so that we don't need to do so when convolving
-#ifdef FFTW
-			coeffs_[nPartition] *= static_cast<float>(1.0L / nPaddedPartitionLength);
-#elif defined(OOURA) || defined(SIMPLE_OOURA)
-			coeffs_[nPartition] *= static_cast<float>(2.0L / nPaddedPartitionLength);
-#else
-#error "No FFT package defined"
+	cdebug << "minSample " << minSample << ", maxSample " << maxSample << std::endl;
 #endif
-			++nPartition;
-		}
-	} // while
+}
 
-	// Pad the current partition (if necessary)
-	if (nFrame % nHalfPartitionLength_ != 0)
+void FilterFile::take(const DWORD nFilterChannel, SampleBuffer& coeffs)
+{
+	const std::vector<DWORD>::iterator it = std::find(nFilterChannels_.begin(), nFilterChannels_.end(), nFilterChannel);
+	if (it == nFilterChannels_.end())
 	{
-		for (ChannelBuffer::size_type nSample = nFrame % nHalfPartitionLength_; nSample < nPaddedPartitionLength; ++nSample)
-		{
-			coeffs_[nPartition][nSample] = 0;
-		}
+		throw convolutionException("Internal error: filter channel not read");
+	}
+
+	const std::vector<DWORD>::size_type i = it - nFilterChannels_.begin();
+	if (nTakes_[i] == 0)
+	{
+		throw convolutionException("Internal error: filter channel already taken");
+	}
+
+	// The last filter to take a channel gets its spectra, rather than a copy
+	if (--nTakes_[i] == 0)
+		coeffs.swap(coeffs_[i]);
+	else
+		coeffs = coeffs_[i];
+}
+
+void FilterFile::probe(const TCHAR szFilterFileName[MAX_PATH], const DWORD nSamplesPerSec, DWORD& nFrames, DWORD& nChannels)
+{
+#ifdef LIBSNDFILE
+	SF_INFO sf_info; ::ZeroMemory(&sf_info, sizeof(SF_INFO));
+	CWaveFileHandle pFilterWave(szFilterFileName, SFM_READ, &sf_info, nSamplesPerSec); // Throws, if file invalid
 
-		// Take the DFT
-#ifdef FFTW
-		fftwf_execute_dft_r2c(plan_, c_ptr(coeffs_, nPartition), reinterpret_cast<fftwf_complex*>(c_ptr(coeffs_, nPartition)));
-#elif defined(OOURA_SIMPLE)
-		rdft(nPaddedPartitionLength, OouraRForward, c_ptr(coeffs_, nPartition));
-#elif defined(OOURA)
-		rdft(nPaddedPartitionLength, OouraRForward, c_ptr(coeffs_, nPartition), &ip_[0], &w_[0]);
+	nFrames = static_cast<DWORD>(sf_info.frames);
+	nChannels = sf_info.channels;
 #else
-#error "No FFT package defined"
+	CWaveFileHandle pFilterWave;
+	HRESULT hr = pFilterWave->Open( szFilterFileName, NULL, WAVEFILE_READ );
+	if( FAILED(hr) )
+	{
+		throw filterException(hr);
+	}
+
+	nChannels = pFilterWave->GetFormat()->nChannels;
+	nFrames = pFilterWave->GetSize() / pFilterWave->GetFormat()->nBlockAlign;
 #endif
+}
 
-		// Scale here, so that we don't need to do so when convolving
-#ifdef FFTW
-		coeffs_[nPartition] *= static_cast<float>(1.0L / nPaddedPartitionLength);
-#elif defined(OOURA) || defined(SIMPLE_OOURA)
-		coeffs_[nPartition] *= static_cast<float>(1.0L / nPaddedPartitionLength);
+// A partition holds half real data, and half zero padding, and the padded length depends on the lengths that the
+// backend handles well
+DWORD FilterFile::nPaddedLength(const DWORD nFrames, const DWORD nPartitions, const FFTBackend& Backend)
+{
+	const DWORD nHalfPartitionLength = std::max<DWORD>(2, (nFrames + nPartitions - 1) / nPartitions);
+	return 2 * Backend.nOptimalLength(nHalfPartitionLength);
+}
+
+Filter::Filter(FilterFile& File, const DWORD nFilterChannel) :
+nPartitions(File.nPartitions),
+nSamplesPerSec_(File.nSamplesPerSec()),
+#ifdef LIBSNDFILE
+sf_FilterFormat_(File.sf_FilterFormat()),
 #else
-#error "No FFT package defined"
+wfexFilterFormat_(File.wfexFilterFormat()),
+#endif
+nPartitionLength_(File.nPartitionLength()),
+nHalfPartitionLength_(File.nHalfPartitionLength()),
+nFilterLength_(File.nFilterLength()),
+nFFTWPartitionLength_(File.nFFTWPartitionLength()),
+nHalfPrecisionFrom_(std::min<DWORD>(File.nHalfPrecisionFrom(), File.nPartitions)),
+fHalfPrecisionSNR_(std::numeric_limits<double>::infinity())
+{
+#if defined(DEBUG) | defined(_DEBUG)
+	DEBUGGING(3, cdebug << "Filter::Filter " << nPartitions << " " << nFilterChannel << std::endl;);
 #endif
-		++nPartition;
-	}
 
-	// Zero any further partitions;
-	for (;nPartition < nPartitions; ++nPartition)
+	File.take(nFilterChannel, coeffs_);
+	plan_.set_ptr(File.Backend().plan(nPartitionLength_, 1, nFFTWPartitionLength_, File.nPlanningRigour()));
+
+	if (nHalfPrecisionFrom_ < nPartitions)
 	{
-		coeffs_[nPartition] = 0;
+		storeHalfPrecision();
 	}
 
-	// The padded lengths become the actual lengths that we are going to work with
-	nPartitionLength_ = nPaddedPartitionLength;
-	nHalfPartitionLength_ = nHalfPaddedPartitionLength;
-	nFilterLength_ = nPartitions * nPartitionLength_;
-
 #ifdef UNDEFINED
 	// Only works for float. Seems to have no performance benefit
 	for(WORD nPartition=0; nPartition<nPartitions; ++ nPartition)
@@ -451,19 +480,67 @@ nSamplesPerSec_(nSamplesPerSec)
 #endif
 
 #if defined(DEBUG) | defined(_DEBUG)
-
 	cdebug << "FFT Filter: ";
 	DumpSampleBuffer(coeffs_);
 	cdebug << std::endl;
+#endif
+}
 
+// Rounds the partitions from nHalfPrecisionFrom_ on to half precision, each scaled by a power of 2 so that its
+// largest value is in [2^14, 2^15), and frees their single precision spectra.  The rounding errors are measured
+// against the energy of the whole filter.  Each complex bin, other than DC and Nyquist, stands for two, as the
+// spectrum of a real signal is symmetric
+void Filter::storeHalfPrecision()
+{
+	halfCoeffs_.resize(nPartitions);
+	fUnscale_.resize(nPartitions, 1.0f);
 
-#ifdef LIBSNDFILE
-	cdebug << waveFormatDescription(sf_FilterFormat(), "FFT Filter: ") << std::endl;
-#else
-	cdebug << waveFormatDescription(&wfexFilterFormat_, nFilterLength_, "FFT Filter:") << std::endl;
-#endif
+	double fSignal = 0;
+	double fNoise = 0;
+	for(DWORD nPartition = 0; nPartition < nPartitions; ++nPartition)
+	{
+		const float* restrict spectrum = c_ptr(coeffs_, nPartition);
+		double fPeak = 0;
+		for(DWORD n = 0; n < nFFTWPartitionLength_; ++n)
+		{
+			const double fWeight = (n < 2 || n >= nFFTWPartitionLength_ - 2) ? 1 : 2;
+			fSignal += fWeight * spectrum[n] * spectrum[n];
+			fPeak = std::max<double>(fPeak, ::fabs(spectrum[n]));
+		}
+		if (nPartition < nHalfPrecisionFrom_)
+		{
+			continue;
+		}
 
-	cdebug << "minSample " << minSample << ", maxSample " << maxSample << std::endl;
-#endif
+		int nExponent = 0;
+		::frexp(fPeak, &nExponent);					// fPeak = [0.5, 1) * 2^nExponent
+		if (fPeak == 0)
+		{
+			nExponent = 15;							// a silent partition needs no scaling
+		}
+		if (97 + nExponent > std::numeric_limits<float>::max_exponent - 1)
+		{
+			throw convolutionException("Filter spectrum too large to store at half precision");
+		}
+		const double fScale = ::ldexp(1.0, 15 - nExponent);
+		fUnscale_[nPartition] = static_cast<float>(::ldexp(1.0, 97 + nExponent));	// 2^112 / fScale
+
+		FastArray<WORD> half(nFFTWPartitionLength_);
+		for(DWORD n = 0; n < nFFTWPartitionLength_; ++n)
+		{
+			half[n] = half_from_float(static_cast<float>(spectrum[n] * fScale));
+			const double fError = float_from_half(half[n], fUnscale_[nPartition]) - static_cast<double>(spectrum[n]);
+			const double fWeight = (n < 2 || n >= nFFTWPartitionLength_ - 2) ? 1 : 2;
+			fNoise += fWeight * fError * fError;
+		}
+		halfCoeffs_[nPartition].swap(half);
 
+		ChannelBuffer none;
+		coeffs_[nPartition].swap(none);
+	}
+
+	if (fNoise > 0)
+	{
+		fHalfPrecisionSNR_ = 10 * ::log10(fSignal / fNoise);
+	}
 }
@@ -25,6 +25,111 @@
 #include "convolution\wavefile.h"
 #include "convolution\waveformat.h"
 #include "convolution\ffthelp.h"
+#include "convolution\fftbackend.h"
+#include "convolution\holder.h"
+
+// As the first partition of a filter to store at half precision (see Filter): none of them
+const DWORD nNoHalfPrecision = 0xFFFFFFFF;
+
+// A filter sound file, read in a single pass of large chunks.  Only the channels that filters are taken from are
+// extracted, and each partition of each of them is transformed as soon as it is filled, so that several filters
+// taken from the channels of one file cost one read of it
+class FilterFile
+{
+public:
+	const DWORD	nPartitions;
+
+	// nFilterChannels are the channels that filters will be taken from (repeats allowed).  nSamplesPerSec is a
+	// default, for raw pcm files.  The filters store partitions nHalfPrecisionFrom on at half precision
+	FilterFile(const TCHAR szFilterFileName[MAX_PATH], const DWORD nPartitions, const std::vector<DWORD>& nFilterChannels,
+		const DWORD nSamplesPerSec, const unsigned int nPlanningRigour, const FFTBackend& Backend,
+		const DWORD nHalfPrecisionFrom = nNoHalfPrecision);
+
+	// Accessor functions
+
+	DWORD nSamplesPerSec() const
+	{
+		return nSamplesPerSec_;
+	}
+
+#ifdef LIBSNDFILE
+	const SF_INFO& sf_FilterFormat() const
+	{
+		return sf_FilterFormat_;
+	}
+#else
+	const WAVEFORMATEXTENSIBLE&	wfexFilterFormat() const
+	{
+		return wfexFilterFormat_;
+	}
+#endif
+
+	// The padded lengths, as for Filter
+	DWORD nPartitionLength() const
+	{
+		return nPartitionLength_;
+	}
+
+	DWORD nHalfPartitionLength() const
+	{
+		return nHalfPartitionLength_;
+	}
+
+	DWORD nFilterLength() const
+	{
+		return nFilterLength_;
+	}
+
+	DWORD nFFTWPartitionLength() const
+	{
+		return nFFTWPartitionLength_;
+	}
+
+	const FFTBackend& Backend() const
+	{
+		return Backend_;
+	}
+
+	unsigned int nPlanningRigour() const
+	{
+		return nPlanningRigour_;
+	}
+
+	DWORD nHalfPrecisionFrom() const
+	{
+		return nHalfPrecisionFrom_;
+	}
+
+	// Hands over the spectra of nFilterChannel, once for each time that it was asked for
+	void take(const DWORD nFilterChannel, SampleBuffer& coeffs);
+
+	// The frames and channels of szFilterFileName, from its header alone
+	static void probe(const TCHAR szFilterFileName[MAX_PATH], const DWORD nSamplesPerSec, DWORD& nFrames, DWORD& nChannels);
+
+	// The padded partition length of a filter of nFrames, cut into nPartitions
+	static DWORD nPaddedLength(const DWORD nFrames, const DWORD nPartitions, const FFTBackend& Backend);
+
+private:
+	DWORD					nSamplesPerSec_;
+#ifdef LIBSNDFILE
+	SF_INFO					sf_FilterFormat_;
+#else
+	WAVEFORMATEXTENSIBLE	wfexFilterFormat_;
+#endif
+	DWORD					nPartitionLength_;
+	DWORD					nHalfPartitionLength_;
+	DWORD					nFilterLength_;
+	DWORD					nFFTWPartitionLength_;
+	const FFTBackend&		Backend_;
+	const unsigned int		nPlanningRigour_;
+	const DWORD				nHalfPrecisionFrom_;
+	std::vector<DWORD>		nFilterChannels_;		// The channels extracted, once each
+	std::vector<DWORD>		nTakes_;				// The number of filters still to take each of them
+	PartitionedBuffer		coeffs_;				// The spectra of each of them
+
+	FilterFile(const FilterFile&);					// No copying
+	const FilterFile& operator =(const FilterFile&);
+};
 
 class Filter
 {
@@ -38,11 +143,41 @@ public:
 		return nSamplesPerSec_;
 	}
 
+	// The spectra of the partitions stored at single precision.  Those from nHalfPrecisionFrom() on are empty
 	const SampleBuffer& coeffs() const
 	{
 		return coeffs_;
 	}
 
+	// The partitions from this on are stored at half precision, to halve the memory that the multiply-add streams
+	// through for them.  nPartitions => none are
+	DWORD nHalfPrecisionFrom() const
+	{
+		return nHalfPrecisionFrom_;
+	}
+
+	// The spectrum of nPartition (>= nHalfPrecisionFrom()), as halves, and the factor that restores its scale as they
+	// are widened (see complex_mul_half)
+	const WORD* halfCoeffs(const DWORD nPartition) const
+	{
+		assert(nPartition >= nHalfPrecisionFrom_ && nPartition < nPartitions);
+		return halfCoeffs_[nPartition].c_ptr();
+	}
+
+	float fUnscale(const DWORD nPartition) const
+	{
+		assert(nPartition >= nHalfPrecisionFrom_ && nPartition < nPartitions);
+		return fUnscale_[nPartition];
+	}
+
+	// The energy of the whole spectrum / the energy of the errors of rounding partitions to half precision, in dB:
+	// for white noise, the ratio of the output to the error that the rounding adds to it.  Infinite, if no
+	// partitions are at half precision
+	double fHalfPrecisionSNR() const
+	{
+		return fHalfPrecisionSNR_;
+	}
+
 #ifdef LIBSNDFILE
 	const SF_INFO& sf_FilterFormat() const		// The format of the filter file
 	{
@@ -73,50 +208,26 @@ public:
 		return nFilterLength_;
 	}
 
-#if defined(FFTW)
+	// The length of each partition of coeffs, which holds its spectrum in the layout of the FFT backends
 	DWORD nFFTWPartitionLength() const
 	{
 		assert(nFFTWPartitionLength_ == 2*(nPartitionLength()/2+1));
 		return nFFTWPartitionLength_;
 	}
 
-	const fftwf_plan& plan() const
+	// Transforms a single partition, with the backend that made coeffs
+	const FFTPlan& plan() const
 	{
-		return plan_;
+		return *plan_;
 	}
 
-	const fftwf_plan& reverse_plan() const
-	{
-		return reverse_plan_;
-	}
-
-#elif defined(OOURA)
-	// Workspace for the non-simple Ooura routines.  
-	const std::vector<DLReal>& w()						// w[0...n/2-1]   :cos/sin table
-	{
-		return w_;
-	}
-	const std::vector<int> ip()					// work area for bit reversal
-	{
-		return ip_;
-	}
-	// length of ip >= 2+sqrt(n)
-	// strictly, length of ip >= 
-	//    2+(1<<(int)(log(n+0.5)/log(2))/2).
-#endif
-
-	// Constructor
-	Filter(const TCHAR szFilterFileName[MAX_PATH], const DWORD nPartitions, const DWORD nFilterChannel, const DWORD nSamplesPerSec,
-			   const unsigned int nPlanningRigour);
+	// Constructor.  Takes the spectra of nFilterChannel from File
+	Filter(FilterFile& File, const DWORD nFilterChannel);
 
 	virtual ~Filter()
 	{
 #if defined(DEBUG) | defined(_DEBUG)
 		DEBUGGING(3, cdebug << "Filter::~Filter " << std::endl;);
-#endif
-#ifdef FFTW
-		fftwf_destroy_plan(plan_);
-		fftwf_destroy_plan(reverse_plan_);
 #endif
 	}
 
@@ -132,20 +243,16 @@ private:
 	DWORD					nPartitionLength_;		// in blocks (a block contains the samples for each channel)
 	DWORD					nHalfPartitionLength_;	// in blocks
 	DWORD					nFilterLength_;			// nFilterLength = nPartitions * nPartitionLength
-#if defined(FFTW)
 	DWORD					nFFTWPartitionLength_;	// 2*(nPaddedPartitionLength/2+1);
-	fftwf_plan				plan_;
-	fftwf_plan				reverse_plan_;
-#elif defined(OOURA)
-	// Workspace for the non-simple Ooura routines.  
-	std::vector<DLReal>		w_;						// w[0...n/2-1]   :cos/sin table
-	std::vector<int>		ip_;					// work area for bit reversal
-	// length of ip >= 2+sqrt(n)
-	// strictly, length of ip >= 
-	//    2+(1<<(int)(log(n+0.5)/log(2))/2).
-#endif
+	DWORD					nHalfPrecisionFrom_;
+	std::vector< FastArray<WORD> >	halfCoeffs_;	// empty for the partitions at single precision
+	std::vector<float>		fUnscale_;
+	double					fHalfPrecisionSNR_;
+	Holder<FFTPlan>			plan_;
+
+	void storeHalfPrecision();
 
-	// Disable default copy construction and assignment, as it FFTW plans cannot be copied
+	// Disable default copy construction and assignment, as FFT plans cannot be copied
 	Filter();									// prevent construction
 	Filter(const Filter&);						// prevent copying
 	const Filter& operator =(const Filter&);	// prevent copying
@@ -0,0 +1,59 @@
+// Convolver: DSP plug-in for Windows Media Player that convolves an impulse respose
+// filter it with the input stream.
+//
+// Copyright (C) 2005  John Pavel
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//
+/////////////////////////////////////////////////////////////////////////////
+//
+// footprint.cpp : The memory that an engine needs, worked out before it is built
+//
+
+#include "convolution\footprint.h"
+#include <sstream>
+#include <iomanip>
+#include <climits>
+
+namespace
+{
+	std::string megabytes(const ULONGLONG nBytes)
+	{
+		std::ostringstream s;
+		s << std::fixed << std::setprecision(1) << nBytes / 1048576.0 << " MB";
+		return s.str();
+	}
+}
+
+unsigned int Footprint::nEnginesWithin(const ULONGLONG nBudget) const
+{
+	if (nTotal() > nBudget)
+		return 0;
+	if (nWorking == 0)
+		return UINT_MAX;
+
+	const ULONGLONG nEngines = (nBudget - nCoefficients - nPlans) / nWorking;
+	return nEngines > UINT_MAX ? UINT_MAX : static_cast<unsigned int>(nEngines);
+}
+
+const std::string Footprint::DisplayFootprint(const unsigned int nEngines) const
+{
+	std::ostringstream s;
+	s << megabytes(nTotal(nEngines)) << ": coefficients " << megabytes(nCoefficients) << ", plans " << megabytes(nPlans)
+		<< ", working buffers " << megabytes(nWorking);
+	if (nEngines != 1)
+		s << " x " << nEngines << " engines";
+	return s.str();
+}
@@ -0,0 +1,57 @@
+#pragma once
+// Convolver: DSP plug-in for Windows Media Player that convolves an impulse respose
+// filter it with the input stream.
+//
+// Copyright (C) 2005  John Pavel
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//
+/////////////////////////////////////////////////////////////////////////////
+//
+// footprint.h : The memory that an engine needs, worked out before it is built
+//
+/////////////////////////////////////////////////////////////////////////////
+
+#include "convolution\config.h"
+#include <string>
+
+// The bytes that the engines of a config allocate, by purpose.  The filter spectra and the plans are shared by the
+// worker engines (see Convolution), each of which has its own working buffers
+struct Footprint
+{
+	ULONGLONG	nCoefficients;		// the filter spectra
+	ULONGLONG	nPlans;				// the tables of the FFT plans (see FFTBackend::nPlanBytes)
+	ULONGLONG	nWorking;			// the buffers of one engine
+
+	Footprint() : nCoefficients(0), nPlans(0), nWorking(0) {}
+
+	Footprint& operator+=(const Footprint& other)
+	{
+		nCoefficients += other.nCoefficients;
+		nPlans += other.nPlans;
+		nWorking += other.nWorking;
+		return *this;
+	}
+
+	ULONGLONG nTotal(const unsigned int nEngines = 1) const
+	{
+		return nCoefficients + nPlans + nEngines * nWorking;
+	}
+
+	// The most engines that fit in nBudget bytes (0, if not even one does)
+	unsigned int nEnginesWithin(const ULONGLONG nBudget) const;
+
+	const std::string DisplayFootprint(const unsigned int nEngines = 1) const;
+};
@@ -0,0 +1,588 @@
+#pragma once
+// Convolver: DSP plug-in for Windows Media Player that convolves an impulse respose
+// filter it with the input stream.
+//
+// Copyright (C) 2005  John Pavel
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//
+/////////////////////////////////////////////////////////////////////////////
+//
+// kernels.h : The inner loops of the convolution engines
+//
+// Kept apart from the engines, so that kernelbench can time them in isolation
+//
+/////////////////////////////////////////////////////////////////////////////
+
+#include "convolution\config.h"
+#include <limits>
+
+// result = in1 * in2, for nComplex complex values, in the spectrum layout shared by all the FFT backends
+inline void complex_mul(const fftwf_complex* restrict in1, const fftwf_complex* restrict in2,
+						fftwf_complex* restrict result, const DWORD nComplex)
+{
+#pragma ivdep
+#pragma loop count (65536)
+#pragma vector aligned
+	for (DWORD index = 0; index < nComplex; ++index)
+	{
+		//result[index][0] = in1[index][0] * in2[index][0] - in1[index][1] * in2[index][1];
+		//result[index][1] = in1[index][0] * in2[index][1] + in1[index][1] * in2[index][0];
+
+		const __declspec(align( 16 )) float T1 = in1[index][0] * in2[index][0];
+		const __declspec(align( 16 )) float T2 = in1[index][1] * in2[index][1];
+		result[index][0] = T1 - T2;
+		result[index][1] = ((in1[index][0] + in1[index][1]) * (in2[index][0] + in2[index][1])) - (T1 + T2);
+	}
+}
+
+// result += in1 * in2, for nComplex complex values
+inline void complex_mul_add(const fftwf_complex* restrict in1, const fftwf_complex* restrict in2,
+							fftwf_complex* restrict result, const DWORD nComplex)
+{
+#pragma ivdep
+#pragma loop count (65536)
+#pragma vector aligned
+	for (DWORD index = 0; index < nComplex; ++index)
+	{
+		const __declspec(align( 16 )) float T1 = in1[index][0] * in2[index][0];
+		const __declspec(align( 16 )) float T2 = in1[index][1] * in2[index][1];
+		result[index][0] += T1 - T2;
+		result[index][1] += ((in1[index][0] + in1[index][1]) * (in2[index][0] + in2[index][1])) - (T1 + T2);
+	}
+}
+
+#ifdef SSE2_CONVERSION
+// The complex product of in1[0..1] and in2[0..1], four floats each
+inline __m128 complex_mul2(const __m128 in1, const __m128 in2)
+{
+	const __m128 re = _mm_shuffle_ps(in1, in1, _MM_SHUFFLE(2, 2, 0, 0));
+	const __m128 im = _mm_shuffle_ps(in1, in1, _MM_SHUFFLE(3, 3, 1, 1));
+	const __m128 swapped = _mm_shuffle_ps(in2, in2, _MM_SHUFFLE(2, 3, 0, 1));
+	const __m128 negate_real = _mm_castsi128_ps(_mm_set_epi32(0, 0x80000000, 0, 0x80000000));
+	return _mm_add_ps(_mm_mul_ps(re, in2), _mm_xor_ps(_mm_mul_ps(im, swapped), negate_real));
+}
+#endif
+
+// The same, with the constant trip counts of a common partition length, nPartitionLength: the nPartitionLength / 2
+// complex values below Nyquist eight at a time (four vectors of two), then Nyquist on its own.  nComplex is ignored
+template <DWORD nPartitionLength, bool bAdd>
+inline void complex_mul_unrolled(const fftwf_complex* restrict in1, const fftwf_complex* restrict in2,
+								 fftwf_complex* restrict result, const DWORD nComplex)
+{
+	assert(nComplex == nPartitionLength / 2 + 1);
+#ifdef SSE2_CONVERSION
+	const float* restrict a = reinterpret_cast<const float*>(in1);
+	const float* restrict b = reinterpret_cast<const float*>(in2);
+	float* restrict r = reinterpret_cast<float*>(result);
+	for (DWORD index = 0; index < nPartitionLength; index += 16)
+	{
+		const __m128 r0 = complex_mul2(_mm_load_ps(a + index), _mm_load_ps(b + index));
+		const __m128 r1 = complex_mul2(_mm_load_ps(a + index + 4), _mm_load_ps(b + index + 4));
+		const __m128 r2 = complex_mul2(_mm_load_ps(a + index + 8), _mm_load_ps(b + index + 8));
+		const __m128 r3 = complex_mul2(_mm_load_ps(a + index + 12), _mm_load_ps(b + index + 12));
+		if (bAdd)
+		{
+			_mm_store_ps(r + index, _mm_add_ps(_mm_load_ps(r + index), r0));
+			_mm_store_ps(r + index + 4, _mm_add_ps(_mm_load_ps(r + index + 4), r1));
+			_mm_store_ps(r + index + 8, _mm_add_ps(_mm_load_ps(r + index + 8), r2));
+			_mm_store_ps(r + index + 12, _mm_add_ps(_mm_load_ps(r + index + 12), r3));
+		}
+		else
+		{
+			_mm_store_ps(r + index, r0);
+			_mm_store_ps(r + index + 4, r1);
+			_mm_store_ps(r + index + 8, r2);
+			_mm_store_ps(r + index + 12, r3);
+		}
+	}
+	const DWORD nNyquist = nPartitionLength / 2;
+	const float T1 = in1[nNyquist][0] * in2[nNyquist][0];
+	const float T2 = in1[nNyquist][1] * in2[nNyquist][1];
+	const float T3 = ((in1[nNyquist][0] + in1[nNyquist][1]) * (in2[nNyquist][0] + in2[nNyquist][1])) - (T1 + T2);
+	if (bAdd)
+	{
+		result[nNyquist][0] += T1 - T2;
+		result[nNyquist][1] += T3;
+	}
+	else
+	{
+		result[nNyquist][0] = T1 - T2;
+		result[nNyquist][1] = T3;
+	}
+#else
+	if (bAdd)
+	{
+		complex_mul_add(in1, in2, result, nPartitionLength / 2 + 1);
+	}
+	else
+	{
+		complex_mul(in1, in2, result, nPartitionLength / 2 + 1);
+	}
+#endif
+}
+
+template <DWORD nPartitionLength>
+inline void complex_mul_fixed(const fftwf_complex* restrict in1, const fftwf_complex* restrict in2,
+							  fftwf_complex* restrict result, const DWORD nComplex)
+{
+	complex_mul_unrolled<nPartitionLength, false>(in1, in2, result, nComplex);
+}
+
+template <DWORD nPartitionLength>
+inline void complex_mul_add_fixed(const fftwf_complex* restrict in1, const fftwf_complex* restrict in2,
+								  fftwf_complex* restrict result, const DWORD nComplex)
+{
+	complex_mul_unrolled<nPartitionLength, true>(in1, in2, result, nComplex);
+}
+
+typedef void (*ComplexKernel)(const fftwf_complex* restrict in1, const fftwf_complex* restrict in2,
+							  fftwf_complex* restrict result, const DWORD nComplex);
+
+// Chosen once, when an engine is constructed: the fixed kernel for partition lengths of 256 to 8192,
+// otherwise the general one
+inline ComplexKernel select_complex_mul(const DWORD nPartitionLength)
+{
+	switch (nPartitionLength)
+	{
+	case 256:	return complex_mul_fixed<256>;
+	case 512:	return complex_mul_fixed<512>;
+	case 1024:	return complex_mul_fixed<1024>;
+	case 2048:	return complex_mul_fixed<2048>;
+	case 4096:	return complex_mul_fixed<4096>;
+	case 8192:	return complex_mul_fixed<8192>;
+	default:	return complex_mul;
+	}
+}
+
+inline ComplexKernel select_complex_mul_add(const DWORD nPartitionLength)
+{
+	switch (nPartitionLength)
+	{
+	case 256:	return complex_mul_add_fixed<256>;
+	case 512:	return complex_mul_add_fixed<512>;
+	case 1024:	return complex_mul_add_fixed<1024>;
+	case 2048:	return complex_mul_add_fixed<2048>;
+	case 4096:	return complex_mul_add_fixed<4096>;
+	case 8192:	return complex_mul_add_fixed<8192>;
+	default:	return complex_mul_add;
+	}
+}
+
+// Filter spectra can be stored at half precision (IEEE 754 binary16), which halves the memory, and the bandwidth, of
+// the partitions that need it least (see Filter).  Each partition is scaled by a power of 2 before it is rounded, so
+// that it uses the range of a half, and the kernels undo the scaling as they widen the halves, for the cost of the
+// multiply that the widening needs anyway
+
+// Rounds f (which should be less than 65520 in magnitude, or it saturates) to the nearest half, ties to even
+inline WORD half_from_float(const float f)
+{
+	const DWORD x = *reinterpret_cast<const DWORD*>(&f);
+	const WORD sign = static_cast<WORD>((x >> 16) & 0x8000);
+	const DWORD abs = x & 0x7FFFFFFF;
+
+	if (abs >= 0x477FF000)				// 65520, or more, would round to infinity
+	{
+		return sign | 0x7BFF;			// 65504
+	}
+	if (abs < 0x38800000)				// below 2^-14, so a subnormal half
+	{
+		if (abs < 0x33000000)			// up to 2^-25 rounds to 0
+		{
+			return sign;
+		}
+		const DWORD nShift = 126 - (abs >> 23);
+		const DWORD nSignificand = (abs & 0x007FFFFF) | 0x00800000;
+		DWORD h = nSignificand >> nShift;
+		const DWORD nRemainder = nSignificand & ((1 << nShift) - 1);
+		const DWORD nHalfway = 1 << (nShift - 1);
+		if (nRemainder > nHalfway || (nRemainder == nHalfway && (h & 1)))
+		{
+			++h;
+		}
+		return static_cast<WORD>(sign | h);
+	}
+	// Rebias the exponent, and round off 13 bits of the mantissa; a carry rolls into the exponent
+	DWORD h = (abs - 0x38000000) >> 13;
+	const DWORD nRemainder = abs & 0x1FFF;
+	if (nRemainder > 0x1000 || (nRemainder == 0x1000 && (h & 1)))
+	{
+		++h;
+	}
+	return static_cast<WORD>(sign | h);
+}
+
+// The bits of a half, moved into place in a float, are the half's value / 2^112.  So fUnscale is 2^112 / the scale
+// applied before rounding.  (Subnormal halves become denormal floats, which are lost if denormals are flushed, but
+// they are at least 2^-29 below the largest value of their partition)
+inline float float_from_half(const WORD h, const float fUnscale)
+{
+	const DWORD x = (static_cast<DWORD>(h & 0x8000) << 16) | (static_cast<DWORD>(h & 0x7FFF) << 13);
+	return *reinterpret_cast<const float*>(&x) * fUnscale;
+}
+
+#ifdef SSE2_CONVERSION
+// The same, for four halves, zero-extended to 32 bits
+inline __m128 widen4(const __m128i h, const __m128 unscale)
+{
+	const __m128i sign = _mm_slli_epi32(_mm_and_si128(h, _mm_set1_epi32(0x8000)), 16);
+	const __m128i magnitude = _mm_slli_epi32(_mm_and_si128(h, _mm_set1_epi32(0x7FFF)), 13);
+	return _mm_mul_ps(_mm_castsi128_ps(_mm_or_si128(sign, magnitude)), unscale);
+}
+#endif
+
+// result = in1 * in2 (or += for bAdd), where in2 is nComplex complex halves, interleaved as are the floats of a
+// spectrum, and aligned in the same way
+template <bool bAdd>
+inline void complex_mul_half(const fftwf_complex* restrict in1, const WORD* restrict in2, const float fUnscale,
+							 fftwf_complex* restrict result, const DWORD nComplex)
+{
+	DWORD index = 0;
+#ifdef SSE2_CONVERSION
+	const __m128 unscale = _mm_set1_ps(fUnscale);
+	const __m128i zero = _mm_setzero_si128();
+	const float* restrict a = reinterpret_cast<const float*>(in1);
+	float* restrict r = reinterpret_cast<float*>(result);
+#pragma loop count (16384)
+	for (; index + 4 <= nComplex; index += 4)
+	{
+		// Four complex halves, widened to two pairs of complex floats
+		const __m128i h = _mm_load_si128(reinterpret_cast<const __m128i*>(in2 + 2 * index));
+		const __m128 lo = complex_mul2(_mm_load_ps(a + 2 * index), widen4(_mm_unpacklo_epi16(h, zero), unscale));
+		const __m128 hi = complex_mul2(_mm_load_ps(a + 2 * index + 4), widen4(_mm_unpackhi_epi16(h, zero), unscale));
+		if (bAdd)
+		{
+			_mm_store_ps(r + 2 * index, _mm_add_ps(_mm_load_ps(r + 2 * index), lo));
+			_mm_store_ps(r + 2 * index + 4, _mm_add_ps(_mm_load_ps(r + 2 * index + 4), hi));
+		}
+		else
+		{
+			_mm_store_ps(r + 2 * index, lo);
+			_mm_store_ps(r + 2 * index + 4, hi);
+		}
+	}
+#endif
+	for (; index < nComplex; ++index)
+	{
+		const float re = float_from_half(in2[2 * index], fUnscale);
+		const float im = float_from_half(in2[2 * index + 1], fUnscale);
+		const float T1 = in1[index][0] * re;
+		const float T2 = in1[index][1] * im;
+		const float T3 = ((in1[index][0] + in1[index][1]) * (re + im)) - (T1 + T2);
+		if (bAdd)
+		{
+			result[index][0] += T1 - T2;
+			result[index][1] += T3;
+		}
+		else
+		{
+			result[index][0] = T1 - T2;
+			result[index][1] = T3;
+		}
+	}
+}
+
+typedef void (*HalfComplexKernel)(const fftwf_complex* restrict in1, const WORD* restrict in2, const float fUnscale,
+								  fftwf_complex* restrict result, const DWORD nComplex);
+
+// result += scale * in, for count floats.  Used to mix channels into, and out of, the filter paths.
+// Not necessarily aligned, as the engines mix into the middle of their buffers
+inline void scale_add(const float* restrict in, const float scale, float* restrict result, const DWORD count)
+{
+	if (scale == 1.0f)
+	{
+#pragma ivdep
+#pragma loop count (65536)
+		for (DWORD index = 0; index < count; ++index)
+		{
+			result[index] += in[index];
+		}
+	}
+	else
+	{
+#pragma ivdep
+#pragma loop count (65536)
+		for (DWORD index = 0; index < count; ++index)
+		{
+			result[index] += scale * in[index];
+		}
+	}
+}
+
+// result = scale * in, for count floats.  Used to take planar input into the engines' buffers
+inline void scale_copy(const float* restrict in, const float scale, float* restrict result, const DWORD count)
+{
+#pragma ivdep
+#pragma loop count (65536)
+	for (DWORD index = 0; index < count; ++index)
+	{
+		result[index] = scale * in[index];
+	}
+}
+
+// Sample format conversion, between a host's interleaved frames and the engines' buffers, one per channel
+
+#ifdef SSE2_CONVERSION
+// Four successive samples of a channel, nStride samples apart, as floats
+inline __m128 load4(const float* p, const DWORD nStride)
+{
+	return nStride == 1 ? _mm_loadu_ps(p) : _mm_set_ps(p[3 * nStride], p[2 * nStride], p[nStride], p[0]);
+}
+
+inline __m128 load4(const INT32* p, const DWORD nStride)
+{
+	return _mm_cvtepi32_ps(nStride == 1 ? _mm_loadu_si128(reinterpret_cast<const __m128i*>(p)) :
+		_mm_set_epi32(p[3 * nStride], p[2 * nStride], p[nStride], p[0]));
+}
+
+inline __m128 load4(const INT16* p, const DWORD nStride)
+{
+	return _mm_cvtepi32_ps(_mm_set_epi32(p[3 * nStride], p[2 * nStride], p[nStride], p[0]));
+}
+
+inline __m128 load4(const BYTE* p, const DWORD nStride)
+{
+	return _mm_cvtepi32_ps(_mm_set_epi32(p[3 * nStride], p[2 * nStride], p[nStride], p[0]));
+}
+
+// Store four integers to successive samples of a channel, nStride samples apart
+inline void store4(const __m128i x, INT32* p, const DWORD nStride)
+{
+	if (nStride == 1)
+	{
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(p), x);
+	}
+	else
+	{
+		__declspec(align(16)) INT32 i[4];
+		_mm_store_si128(reinterpret_cast<__m128i*>(i), x);
+		p[0] = i[0];
+		p[nStride] = i[1];
+		p[2 * nStride] = i[2];
+		p[3 * nStride] = i[3];
+	}
+}
+
+inline void store4(const __m128i x, INT16* p, const DWORD nStride)
+{
+	__declspec(align(16)) INT32 i[4];
+	_mm_store_si128(reinterpret_cast<__m128i*>(i), x);
+	p[0] = static_cast<INT16>(i[0]);
+	p[nStride] = static_cast<INT16>(i[1]);
+	p[2 * nStride] = static_cast<INT16>(i[2]);
+	p[3 * nStride] = static_cast<INT16>(i[3]);
+}
+#endif
+
+// dst[nChannel][nFrame] = (src[nFrame * nChannels + nChannel] + fOffset) * fScale * fAttenuation, evaluated in the
+// same order as the per-sample ConvertSample::GetSample, so that the results are the same.  Sample is float,
+// INT32, INT16 or BYTE
+template <typename Sample>
+inline void deinterleave_any(const Sample* restrict src, float* const dst[], const WORD nChannels, const DWORD nFrames,
+							 const float fOffset, const float fScale, const float fAttenuation)
+{
+#pragma loop count (8)
+	for (WORD nChannel = 0; nChannel < nChannels; ++nChannel)
+	{
+		const Sample* restrict in = src + nChannel;
+		float* restrict out = dst[nChannel];
+		DWORD nFrame = 0;
+#ifdef SSE2_CONVERSION
+		const __m128 offset = _mm_set1_ps(fOffset);
+		const __m128 scale = _mm_set1_ps(fScale);
+		const __m128 attenuation = _mm_set1_ps(fAttenuation);
+		for (; nFrame + 4 <= nFrames; nFrame += 4, in += 4 * nChannels)
+		{
+			_mm_storeu_ps(out + nFrame, _mm_mul_ps(_mm_mul_ps(_mm_add_ps(load4(in, nChannels), offset), scale), attenuation));
+		}
+#endif
+#pragma loop count (65536)
+		for (; nFrame < nFrames; ++nFrame, in += nChannels)
+		{
+			out[nFrame] = (*in + fOffset) * fScale * fAttenuation;
+		}
+	}
+}
+
+// dst[nFrame * nChannels + nChannel] = floor(src[nChannel][nFrame] * fScale), after clipping src to [-1, 1].
+// Sample is INT32 or INT16
+template <typename Sample>
+inline void interleave_floor_any(const float* const src[], Sample* restrict dst, const WORD nChannels, const DWORD nFrames,
+								 const float fScale)
+{
+#pragma loop count (8)
+	for (WORD nChannel = 0; nChannel < nChannels; ++nChannel)
+	{
+		const float* restrict in = src[nChannel];
+		Sample* restrict out = dst + nChannel;
+		DWORD nFrame = 0;
+#ifdef SSE2_CONVERSION
+		const __m128 minus_one = _mm_set1_ps(-1.0f);
+		const __m128 one = _mm_set1_ps(1.0f);
+		const __m128 scale = _mm_set1_ps(fScale);
+		for (; nFrame + 4 <= nFrames; nFrame += 4, out += 4 * nChannels)
+		{
+			const __m128 x = _mm_mul_ps(_mm_min_ps(_mm_max_ps(_mm_loadu_ps(in + nFrame), minus_one), one), scale);
+			// floor, from truncation: less one, where truncation rounded a negative value up
+			const __m128 truncated = _mm_cvtepi32_ps(_mm_cvttps_epi32(x));
+			const __m128 floored = _mm_sub_ps(truncated, _mm_and_ps(_mm_cmpgt_ps(truncated, x), one));
+			// cvttps2dq gives 0x80000000 for +2^31 (full scale INT32); flip that to 0x7fffffff
+			const __m128i overflowed = _mm_castps_si128(_mm_cmpge_ps(x, _mm_set1_ps(2147483648.0f)));
+			store4(_mm_xor_si128(_mm_cvttps_epi32(floored), overflowed), out, nChannels);
+		}
+#endif
+#pragma loop count (65536)
+		for (; nFrame < nFrames; ++nFrame, out += nChannels)
+		{
+			const float x = in[nFrame] < -1.0f ? -1.0f : (in[nFrame] > 1.0f ? 1.0f : in[nFrame]);
+			const float y = floor(x * fScale);
+			*out = y >= static_cast<float>((std::numeric_limits<Sample>::max)()) ?
+				(std::numeric_limits<Sample>::max)() : static_cast<Sample>(y);
+		}
+	}
+}
+
+// dst[nFrame * nChannels + nChannel] = src[nChannel][nFrame].  Float output is not clipped
+inline void interleave_any(const float* const src[], float* restrict dst, const WORD nChannels, const DWORD nFrames)
+{
+#pragma loop count (8)
+	for (WORD nChannel = 0; nChannel < nChannels; ++nChannel)
+	{
+		const float* restrict in = src[nChannel];
+		float* restrict out = dst + nChannel;
+#pragma loop count (65536)
+		for (DWORD nFrame = 0; nFrame < nFrames; ++nFrame, out += nChannels)
+		{
+			*out = in[nFrame];
+		}
+	}
+}
+
+// The same, for the common channel counts (mono, stereo, 5.1 and 7.1).  With nChannels constant, the channel loops
+// have constant trip counts, and the interleaved frames are taken in order, a frame at a time
+template <WORD nChannels, typename Sample>
+inline void deinterleave_fixed(const Sample* restrict src, float* const dst[], const DWORD nFrames,
+							   const float fOffset, const float fScale, const float fAttenuation)
+{
+	DWORD nFrame = 0;
+#ifdef SSE2_CONVERSION
+	const __m128 offset = _mm_set1_ps(fOffset);
+	const __m128 scale = _mm_set1_ps(fScale);
+	const __m128 attenuation = _mm_set1_ps(fAttenuation);
+	for (; nFrame + 4 <= nFrames; nFrame += 4, src += 4 * nChannels)
+	{
+		for (WORD nChannel = 0; nChannel < nChannels; ++nChannel)
+		{
+			_mm_storeu_ps(dst[nChannel] + nFrame,
+				_mm_mul_ps(_mm_mul_ps(_mm_add_ps(load4(src + nChannel, nChannels), offset), scale), attenuation));
+		}
+	}
+#endif
+	for (; nFrame < nFrames; ++nFrame, src += nChannels)
+	{
+		for (WORD nChannel = 0; nChannel < nChannels; ++nChannel)
+		{
+			dst[nChannel][nFrame] = (src[nChannel] + fOffset) * fScale * fAttenuation;
+		}
+	}
+}
+
+template <WORD nChannels, typename Sample>
+inline void interleave_floor_fixed(const float* const src[], Sample* restrict dst, const DWORD nFrames, const float fScale)
+{
+	DWORD nFrame = 0;
+#ifdef SSE2_CONVERSION
+	const __m128 minus_one = _mm_set1_ps(-1.0f);
+	const __m128 one = _mm_set1_ps(1.0f);
+	const __m128 scale = _mm_set1_ps(fScale);
+	const __m128 full_scale = _mm_set1_ps(2147483648.0f);
+	for (; nFrame + 4 <= nFrames; nFrame += 4, dst += 4 * nChannels)
+	{
+		for (WORD nChannel = 0; nChannel < nChannels; ++nChannel)
+		{
+			const __m128 x = _mm_mul_ps(_mm_min_ps(_mm_max_ps(_mm_loadu_ps(src[nChannel] + nFrame), minus_one), one), scale);
+			const __m128 truncated = _mm_cvtepi32_ps(_mm_cvttps_epi32(x));
+			const __m128 floored = _mm_sub_ps(truncated, _mm_and_ps(_mm_cmpgt_ps(truncated, x), one));
+			const __m128i overflowed = _mm_castps_si128(_mm_cmpge_ps(x, full_scale));
+			store4(_mm_xor_si128(_mm_cvttps_epi32(floored), overflowed), dst + nChannel, nChannels);
+		}
+	}
+#endif
+	for (; nFrame < nFrames; ++nFrame, dst += nChannels)
+	{
+		for (WORD nChannel = 0; nChannel < nChannels; ++nChannel)
+		{
+			const float in = src[nChannel][nFrame];
+			const float x = in < -1.0f ? -1.0f : (in > 1.0f ? 1.0f : in);
+			const float y = floor(x * fScale);
+			dst[nChannel] = y >= static_cast<float>((std::numeric_limits<Sample>::max)()) ?
+				(std::numeric_limits<Sample>::max)() : static_cast<Sample>(y);
+		}
+	}
+}
+
+template <WORD nChannels>
+inline void interleave_fixed(const float* const src[], float* restrict dst, const DWORD nFrames)
+{
+	for (DWORD nFrame = 0; nFrame < nFrames; ++nFrame, dst += nChannels)
+	{
+		for (WORD nChannel = 0; nChannel < nChannels; ++nChannel)
+		{
+			dst[nChannel] = src[nChannel][nFrame];
+		}
+	}
+}
+
+// The conversion kernels used by ConvertSample: the fixed versions for the common channel counts, otherwise the
+// general ones.  The convertors serve any number of channels, so the choice is made for each block
+template <typename Sample>
+inline void deinterleave(const Sample* restrict src, float* const dst[], const WORD nChannels, const DWORD nFrames,
+						 const float fOffset, const float fScale, const float fAttenuation)
+{
+	switch (nChannels)
+	{
+	case 1:		deinterleave_fixed<1>(src, dst, nFrames, fOffset, fScale, fAttenuation); break;
+	case 2:		deinterleave_fixed<2>(src, dst, nFrames, fOffset, fScale, fAttenuation); break;
+	case 6:		deinterleave_fixed<6>(src, dst, nFrames, fOffset, fScale, fAttenuation); break;
+	case 8:		deinterleave_fixed<8>(src, dst, nFrames, fOffset, fScale, fAttenuation); break;
+	default:	deinterleave_any(src, dst, nChannels, nFrames, fOffset, fScale, fAttenuation);
+	}
+}
+
+template <typename Sample>
+inline void interleave_floor(const float* const src[], Sample* restrict dst, const WORD nChannels, const DWORD nFrames,
+							 const float fScale)
+{
+	switch (nChannels)
+	{
+	case 1:		interleave_floor_fixed<1>(src, dst, nFrames, fScale); break;
+	case 2:		interleave_floor_fixed<2>(src, dst, nFrames, fScale); break;
+	case 6:		interleave_floor_fixed<6>(src, dst, nFrames, fScale); break;
+	case 8:		interleave_floor_fixed<8>(src, dst, nFrames, fScale); break;
+	default:	interleave_floor_any(src, dst, nChannels, nFrames, fScale);
+	}
+}
+
+inline void interleave(const float* const src[], float* restrict dst, const WORD nChannels, const DWORD nFrames)
+{
+	switch (nChannels)
+	{
+	case 1:		interleave_fixed<1>(src, dst, nFrames); break;
+	case 2:		interleave_fixed<2>(src, dst, nFrames); break;
+	case 6:		interleave_fixed<6>(src, dst, nFrames); break;
+	case 8:		interleave_fixed<8>(src, dst, nFrames); break;
+	default:	interleave_any(src, dst, nChannels, nFrames);
+	}
+}
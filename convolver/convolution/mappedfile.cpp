@@ -0,0 +1,323 @@
+// Convolver: DSP plug-in for Windows Media Player that convolves an impulse respose
+// filter it with the input stream.
+//
+// Copyright (C) 2005  John Pavel
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//
+/////////////////////////////////////////////////////////////////////////////
+//
+// mappedfile.cpp : 32-bit float sound files, accessed in place through a file mapping
+//
+
+#include "convolution\mappedfile.h"
+#include <algorithm>
+
+namespace
+{
+	// Little-endian fields of a RIFF header
+	inline WORD getWord(const BYTE* p)
+	{
+		return static_cast<WORD>(p[0] | (p[1] << 8));
+	}
+
+	inline DWORD getDword(const BYTE* p)
+	{
+		return p[0] | (p[1] << 8) | (p[2] << 16) | (static_cast<DWORD>(p[3]) << 24);
+	}
+
+	inline BYTE* putWord(BYTE* p, const WORD w)
+	{
+		p[0] = static_cast<BYTE>(w);
+		p[1] = static_cast<BYTE>(w >> 8);
+		return p + 2;
+	}
+
+	inline BYTE* putDword(BYTE* p, const DWORD dw)
+	{
+		putWord(p, static_cast<WORD>(dw));
+		putWord(p + 2, static_cast<WORD>(dw >> 16));
+		return p + 4;
+	}
+
+	inline BYTE* putTag(BYTE* p, const char* tag)
+	{
+		std::copy(tag, tag + 4, p);
+		return p + 4;
+	}
+
+	// The rest of KSDATAFORMAT_SUBTYPE_IEEE_FLOAT, after its first WORD (WAVE_FORMAT_IEEE_FLOAT)
+	const BYTE SubFormatGuidTail[14] = { 0x00, 0x00, 0x00, 0x00, 0x10, 0x00, 0x80, 0x00, 0x00, 0xAA, 0x00, 0x38, 0x9B, 0x71 };
+
+	// RIFF + WAVE_FORMAT_EXTENSIBLE fmt + fact + data headers.  A multiple of 16 bytes, so that the samples are aligned
+	const DWORD WAVE_HEADER_BYTES = 12 + 8 + 40 + 8 + 4 + 8;
+
+	bool isHeaderlessFile(const TCHAR szPath[MAX_PATH])
+	{
+		const TCHAR* szExtension = _tcsrchr(szPath, TEXT('.'));
+		return szExtension != NULL && (_tcsicmp(szExtension + 1, TEXT("pcm")) == 0 || _tcsicmp(szExtension + 1, TEXT("raw")) == 0);
+	}
+
+	bool readAt(HANDLE hFile, const ULONGLONG nOffset, BYTE* pBuffer, const DWORD nBytes)
+	{
+		LARGE_INTEGER liOffset;
+		liOffset.QuadPart = static_cast<LONGLONG>(nOffset);
+		DWORD nBytesRead = 0;
+		return ::SetFilePointerEx(hFile, liOffset, NULL, FILE_BEGIN) &&
+			::ReadFile(hFile, pBuffer, nBytes, &nBytesRead, NULL) && nBytesRead == nBytes;
+	}
+
+	// Find the format and the samples of a 32-bit float WAV file.  false => not such a file
+	bool readWaveHeader(HANDLE hFile, const ULONGLONG nFileBytes, WORD& nChannels, DWORD& nSamplesPerSec,
+		ULONGLONG& nDataOffset, ULONGLONG& nDataBytes)
+	{
+		BYTE riff[12];
+		if (!readAt(hFile, 0, riff, sizeof(riff)) || memcmp(riff, "RIFF", 4) != 0 || memcmp(riff + 8, "WAVE", 4) != 0)
+			return false;
+
+		bool bFormat = false;
+		ULONGLONG nOffset = sizeof(riff);
+		BYTE chunk[8];
+		while (readAt(hFile, nOffset, chunk, sizeof(chunk)))
+		{
+			const DWORD nChunkBytes = getDword(chunk + 4);
+			if (memcmp(chunk, "fmt ", 4) == 0)
+			{
+				BYTE fmt[40];
+				if (nChunkBytes < 16 || !readAt(hFile, nOffset + 8, fmt, std::min<DWORD>(nChunkBytes, sizeof(fmt))))
+					return false;
+
+				WORD wFormatTag = getWord(fmt);
+				if (wFormatTag == WAVE_FORMAT_EXTENSIBLE)
+				{
+					if (nChunkBytes < sizeof(fmt) || memcmp(fmt + 26, SubFormatGuidTail, sizeof(SubFormatGuidTail)) != 0)
+						return false;
+					wFormatTag = getWord(fmt + 24);
+				}
+				if (wFormatTag != WAVE_FORMAT_IEEE_FLOAT || getWord(fmt + 14) != 32)
+					return false;
+
+				nChannels = getWord(fmt + 2);
+				nSamplesPerSec = getDword(fmt + 4);
+				bFormat = nChannels > 0;
+			}
+			else if (memcmp(chunk, "data", 4) == 0)
+			{
+				nDataOffset = nOffset + sizeof(chunk);
+				// Streaming writers may leave the size unset
+				nDataBytes = std::min<ULONGLONG>(nChunkBytes, nFileBytes - nDataOffset);
+				return bFormat;
+			}
+			nOffset += sizeof(chunk) + nChunkBytes + (nChunkBytes & 1);	// chunks are word aligned
+		}
+		return false;
+	}
+}
+
+MappedSoundFile::MappedSoundFile(const TCHAR szPath[MAX_PATH], const WORD nChannels, const DWORD nSamplesPerSec) :
+szPath_(szPath),
+bWritable_(false),
+bHeaderless_(isHeaderlessFile(szPath)),
+nChannels_(nChannels),
+nSamplesPerSec_(nSamplesPerSec),
+nFrames_(0),
+nDataOffset_(0),
+nFileBytes_(0),
+hFile_(INVALID_HANDLE_VALUE),
+hMapping_(NULL),
+pView_(NULL),
+nViewOffset_(0),
+nViewBytes_(0),
+nGranularity_(0)
+{
+#if defined(DEBUG) | defined(_DEBUG)
+	DEBUGGING(3, cdebug << "MappedSoundFile (read)" << std::endl;)
+#endif
+
+	hFile_ = ::CreateFile(szPath, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (hFile_ == INVALID_HANDLE_VALUE)
+		throw wavfileException("Failed to open for mapping", szPath, "");
+
+	LARGE_INTEGER liFileBytes;
+	if (!::GetFileSizeEx(hFile_, &liFileBytes))
+	{
+		::CloseHandle(hFile_);
+		throw wavfileException("Failed to get size", szPath, "");
+	}
+	nFileBytes_ = liFileBytes.QuadPart;
+
+	ULONGLONG nDataBytes = nFileBytes_;
+	if (!bHeaderless_ && !readWaveHeader(hFile_, nFileBytes_, nChannels_, nSamplesPerSec_, nDataOffset_, nDataBytes))
+	{
+		::CloseHandle(hFile_);
+		throw wavfileException("Not a 32-bit float WAV file", szPath, "");
+	}
+	nFrames_ = nDataBytes / (nChannels_ * sizeof(float));
+
+	createMapping(PAGE_READONLY);
+}
+
+MappedSoundFile::MappedSoundFile(const TCHAR szPath[MAX_PATH], const bool bHeaderless, const WORD nChannels,
+								 const DWORD nSamplesPerSec, const ULONGLONG nFrames) :
+szPath_(szPath),
+bWritable_(true),
+bHeaderless_(bHeaderless),
+nChannels_(nChannels),
+nSamplesPerSec_(nSamplesPerSec),
+nFrames_(nFrames),
+nDataOffset_(bHeaderless ? 0 : WAVE_HEADER_BYTES),
+nFileBytes_(0),
+hFile_(INVALID_HANDLE_VALUE),
+hMapping_(NULL),
+pView_(NULL),
+nViewOffset_(0),
+nViewBytes_(0),
+nGranularity_(0)
+{
+#if defined(DEBUG) | defined(_DEBUG)
+	DEBUGGING(3, cdebug << "MappedSoundFile (write)" << std::endl;)
+#endif
+
+	const ULONGLONG nDataBytes = nFrames * nChannels * sizeof(float);
+	nFileBytes_ = nDataOffset_ + nDataBytes;
+	if (!bHeaderless && nFileBytes_ - 8 > ULONG_MAX)
+		throw wavfileException("Too long for a WAV file", szPath, "");
+
+	hFile_ = ::CreateFile(szPath, GENERIC_READ | GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (hFile_ == INVALID_HANDLE_VALUE)
+		throw wavfileException("Failed to create for mapping", szPath, "");
+
+	if (!bHeaderless)
+	{
+		BYTE header[WAVE_HEADER_BYTES];
+		BYTE* p = putTag(header, "RIFF");
+		p = putDword(p, static_cast<DWORD>(nFileBytes_ - 8));
+		p = putTag(p, "WAVE");
+
+		p = putTag(p, "fmt ");
+		p = putDword(p, 40);
+		p = putWord(p, WAVE_FORMAT_EXTENSIBLE);
+		p = putWord(p, nChannels);
+		p = putDword(p, nSamplesPerSec);
+		p = putDword(p, static_cast<DWORD>(nSamplesPerSec * nChannels * sizeof(float)));	// nAvgBytesPerSec
+		p = putWord(p, static_cast<WORD>(nChannels * sizeof(float)));	// nBlockAlign
+		p = putWord(p, 32);												// wBitsPerSample
+		p = putWord(p, 22);												// cbSize
+		p = putWord(p, 32);												// wValidBitsPerSample
+		p = putDword(p, 0);												// dwChannelMask: unassigned
+		p = putWord(p, WAVE_FORMAT_IEEE_FLOAT);
+		p = std::copy(SubFormatGuidTail, SubFormatGuidTail + sizeof(SubFormatGuidTail), p);
+
+		p = putTag(p, "fact");
+		p = putDword(p, 4);
+		p = putDword(p, static_cast<DWORD>(std::min<ULONGLONG>(nFrames, ULONG_MAX)));
+
+		p = putTag(p, "data");
+		p = putDword(p, static_cast<DWORD>(nDataBytes));
+		assert(p == header + sizeof(header));
+
+		DWORD nBytesWritten = 0;
+		if (!::WriteFile(hFile_, header, sizeof(header), &nBytesWritten, NULL) || nBytesWritten != sizeof(header))
+		{
+			::CloseHandle(hFile_);
+			throw wavfileException("Failed to write header", szPath, "");
+		}
+	}
+
+	// Mapping extends the file to its full length
+	createMapping(PAGE_READWRITE);
+}
+
+void MappedSoundFile::createMapping(const DWORD flProtect)
+{
+	SYSTEM_INFO si;
+	::GetSystemInfo(&si);
+	nGranularity_ = si.dwAllocationGranularity;
+
+	if (nFileBytes_ == 0)
+		return;		// Nothing to map (and a zero-length mapping is an error)
+
+	hMapping_ = ::CreateFileMapping(hFile_, NULL, flProtect,
+		static_cast<DWORD>(nFileBytes_ >> 32), static_cast<DWORD>(nFileBytes_), NULL);
+	if (hMapping_ == NULL)
+	{
+		::CloseHandle(hFile_);
+		throw wavfileException("Failed to map", szPath_.c_str(), "");
+	}
+}
+
+MappedSoundFile::~MappedSoundFile()
+{
+#if defined(DEBUG) | defined(_DEBUG)
+	DEBUGGING(3, cdebug << "MappedSoundFile::~MappedSoundFile" << std::endl;)
+#endif
+	if (pView_ != NULL)
+		::UnmapViewOfFile(pView_);
+	if (hMapping_ != NULL)
+		::CloseHandle(hMapping_);
+	if (hFile_ != INVALID_HANDLE_VALUE)
+		::CloseHandle(hFile_);
+}
+
+bool MappedSoundFile::isMappable(const TCHAR szPath[MAX_PATH])
+{
+	if (isHeaderlessFile(szPath))
+		return true;
+
+	HANDLE hFile = ::CreateFile(szPath, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (hFile == INVALID_HANDLE_VALUE)
+		return false;
+
+	bool bMappable = false;
+	LARGE_INTEGER liFileBytes;
+	if (::GetFileSizeEx(hFile, &liFileBytes))
+	{
+		WORD nChannels = 0;
+		DWORD nSamplesPerSec = 0;
+		ULONGLONG nDataOffset = 0;
+		ULONGLONG nDataBytes = 0;
+		bMappable = readWaveHeader(hFile, liFileBytes.QuadPart, nChannels, nSamplesPerSec, nDataOffset, nDataBytes);
+	}
+	::CloseHandle(hFile);
+	return bMappable;
+}
+
+float* MappedSoundFile::view(const ULONGLONG nFrame, const DWORD nFrames)
+{
+	const ULONGLONG nFrameBytes = nChannels_ * sizeof(float);
+	const ULONGLONG nFrom = nDataOffset_ + nFrame * nFrameBytes;
+	const ULONGLONG nTo = nFrom + nFrames * nFrameBytes;
+	if (nFrame + nFrames > nFrames_)
+		throw wavfileException("Internal error: view beyond the end of the mapped file", szPath_.c_str(), "");
+
+	if (pView_ == NULL || nFrom < nViewOffset_ || nTo > nViewOffset_ + nViewBytes_)
+	{
+		if (pView_ != NULL)
+		{
+			::UnmapViewOfFile(pView_);
+			pView_ = NULL;
+		}
+
+		// Map at least nMinViewBytes, so that sequential access seldom remaps
+		nViewOffset_ = nFrom - nFrom % nGranularity_;
+		nViewBytes_ = std::min(std::max<ULONGLONG>(nTo - nViewOffset_, nMinViewBytes), nFileBytes_ - nViewOffset_);
+		pView_ = ::MapViewOfFile(hMapping_, bWritable_ ? FILE_MAP_WRITE : FILE_MAP_READ,
+			static_cast<DWORD>(nViewOffset_ >> 32), static_cast<DWORD>(nViewOffset_), static_cast<SIZE_T>(nViewBytes_));
+		if (pView_ == NULL)
+			throw wavfileException("Failed to map view", szPath_.c_str(), "");
+	}
+
+	return reinterpret_cast<float*>(static_cast<BYTE*>(pView_) + (nFrom - nViewOffset_));
+}
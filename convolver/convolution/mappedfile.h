@@ -0,0 +1,98 @@
+#pragma once
+// Convolver: DSP plug-in for Windows Media Player that convolves an impulse respose
+// filter it with the input stream.
+//
+// Copyright (C) 2005  John Pavel
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//
+/////////////////////////////////////////////////////////////////////////////
+//
+// mappedfile.h : 32-bit float sound files, accessed in place through a file mapping
+//
+/////////////////////////////////////////////////////////////////////////////
+
+#include "convolution\config.h"
+#include <string>
+
+// A 32-bit IEEE float WAV file (WAVE_FORMAT_IEEE_FLOAT, or WAVE_FORMAT_EXTENSIBLE with that subformat), or a
+// headerless .pcm/.raw file, whose samples are read or written through a view of a file mapping, rather than
+// being copied through libsndfile.  Only a window of the file is mapped at a time, so that files much larger than
+// the address space can be used.  The file is opened for sequential scan, so that the cache manager reads ahead.
+class MappedSoundFile
+{
+public:
+	// Open an existing file for reading.  A headerless file is taken to have nChannels interleaved channels
+	MappedSoundFile(const TCHAR szPath[MAX_PATH], const WORD nChannels, const DWORD nSamplesPerSec);
+
+	// Create a file for writing, pre-sized to hold nFrames frames
+	MappedSoundFile(const TCHAR szPath[MAX_PATH], const bool bHeaderless, const WORD nChannels, const DWORD nSamplesPerSec,
+		const ULONGLONG nFrames);
+
+	~MappedSoundFile();
+
+	// Is szPath a 32-bit float file that can be mapped?
+	static bool isMappable(const TCHAR szPath[MAX_PATH]);
+
+	// Frames [nFrame, nFrame + nFrames).  Only valid until the next call
+	float* view(const ULONGLONG nFrame, const DWORD nFrames);
+
+	// Accessor functions
+
+	bool bHeaderless() const
+	{
+		return bHeaderless_;
+	}
+
+	WORD nChannels() const
+	{
+		return nChannels_;
+	}
+
+	DWORD nSamplesPerSec() const
+	{
+		return nSamplesPerSec_;
+	}
+
+	ULONGLONG nFrames() const
+	{
+		return nFrames_;
+	}
+
+private:
+	void createMapping(const DWORD flProtect);
+
+	std::basic_string<TCHAR> szPath_;
+	bool		bWritable_;
+	bool		bHeaderless_;
+	WORD		nChannels_;
+	DWORD		nSamplesPerSec_;
+	ULONGLONG	nFrames_;
+	ULONGLONG	nDataOffset_;			// bytes from the start of the file to the first sample
+	ULONGLONG	nFileBytes_;
+
+	HANDLE		hFile_;
+	HANDLE		hMapping_;
+	LPVOID		pView_;
+	ULONGLONG	nViewOffset_;			// a multiple of the allocation granularity
+	ULONGLONG	nViewBytes_;
+	DWORD		nGranularity_;
+
+	static const DWORD nMinViewBytes = 1 << 25;	// 32MB: remap rarely, but leave address space to spare
+
+	MappedSoundFile(); // no implementation
+	MappedSoundFile(const MappedSoundFile& other); // no impl.
+	const MappedSoundFile& operator=(const MappedSoundFile& other); // no impl.
+};
@@ -0,0 +1,348 @@
+// Convolver: DSP plug-in for Windows Media Player that convolves an impulse respose
+// filter it with the input stream.
+//
+// Copyright (C) 2005  John Pavel
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//
+/////////////////////////////////////////////////////////////////////////////
+//
+// mixingmatrix.cpp : The routing of channels into, and out of, the filter paths
+//
+
+#include "convolution\mixingmatrix.h"
+#include <algorithm>
+#include <sstream>
+
+namespace
+{
+	// The ways of applying one gain to a source, to start a row or to add to it.  Gains of 1 and -1 need no multiply
+	struct Copy
+	{
+		static float apply(const float x, const float) { return x; }
+#ifdef SSE2_CONVERSION
+		static __m128 apply(const __m128 x, const __m128) { return x; }
+#endif
+	};
+
+	struct Negate
+	{
+		static float apply(const float x, const float) { return -x; }
+#ifdef SSE2_CONVERSION
+		static __m128 apply(const __m128 x, const __m128) { return _mm_sub_ps(_mm_setzero_ps(), x); }
+#endif
+	};
+
+	struct Scale
+	{
+		static float apply(const float x, const float fGain) { return fGain * x; }
+#ifdef SSE2_CONVERSION
+		static __m128 apply(const __m128 x, const __m128 gain) { return _mm_mul_ps(gain, x); }
+#endif
+	};
+
+	// result = Op(in)
+	template <class Op>
+	inline void assignTerm(const float* restrict in, const float fGain, float* restrict result, const DWORD nFrames)
+	{
+		DWORD nFrame = 0;
+#ifdef SSE2_CONVERSION
+		const __m128 gain = _mm_set1_ps(fGain);
+		for (; nFrame + 4 <= nFrames; nFrame += 4)
+		{
+			_mm_storeu_ps(result + nFrame, Op::apply(_mm_loadu_ps(in + nFrame), gain));
+		}
+#endif
+#pragma loop count (256)
+		for (; nFrame < nFrames; ++nFrame)
+		{
+			result[nFrame] = Op::apply(in[nFrame], fGain);
+		}
+	}
+
+	// result += Op(in)
+	template <class Op>
+	inline void addTerm(const float* restrict in, const float fGain, float* restrict result, const DWORD nFrames)
+	{
+		DWORD nFrame = 0;
+#ifdef SSE2_CONVERSION
+		const __m128 gain = _mm_set1_ps(fGain);
+		for (; nFrame + 4 <= nFrames; nFrame += 4)
+		{
+			_mm_storeu_ps(result + nFrame,
+				_mm_add_ps(_mm_loadu_ps(result + nFrame), Op::apply(_mm_loadu_ps(in + nFrame), gain)));
+		}
+#endif
+#pragma loop count (256)
+		for (; nFrame < nFrames; ++nFrame)
+		{
+			result[nFrame] += Op::apply(in[nFrame], fGain);
+		}
+	}
+
+	inline void term(const float* restrict in, const float fGain, float* restrict result, const DWORD nFrames,
+		const bool bFirst)
+	{
+		if (fGain == 1.0f)
+		{
+			bFirst ? assignTerm<Copy>(in, fGain, result, nFrames) : addTerm<Copy>(in, fGain, result, nFrames);
+		}
+		else if (fGain == -1.0f)
+		{
+			bFirst ? assignTerm<Negate>(in, fGain, result, nFrames) : addTerm<Negate>(in, fGain, result, nFrames);
+		}
+		else
+		{
+			bFirst ? assignTerm<Scale>(in, fGain, result, nFrames) : addTerm<Scale>(in, fGain, result, nFrames);
+		}
+	}
+
+	// Each block of a row is formed from all the columns in registers, and stored once.  nFixedColumns != 0 =>
+	// there are that many columns, so that the column loops have constant trip counts
+	template <WORD nFixedColumns>
+	void mixDense(const float* fDense, const WORD nRows, const WORD nAnyColumns, const float* const src[],
+		float* const dst[], const DWORD nFrames, const DWORD nBlock)
+	{
+		const WORD nColumns = nFixedColumns != 0 ? nFixedColumns : nAnyColumns;
+		for (DWORD nFrom = 0; nFrom < nFrames; nFrom += nBlock)
+		{
+			const DWORD nTo = std::min<DWORD>(nFrames, nFrom + nBlock);
+#pragma loop count (8)
+			for (WORD nRow = 0; nRow < nRows; ++nRow)
+			{
+				const float* gain = fDense + nRow * nColumns;
+				float* restrict out = dst[nRow];
+				DWORD nFrame = nFrom;
+#ifdef SSE2_CONVERSION
+				for (; nFrame + 4 <= nTo; nFrame += 4)
+				{
+					__m128 sum = _mm_mul_ps(_mm_set1_ps(gain[0]), _mm_loadu_ps(src[0] + nFrame));
+					for (WORD nColumn = 1; nColumn < nColumns; ++nColumn)
+					{
+						sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(gain[nColumn]), _mm_loadu_ps(src[nColumn] + nFrame)));
+					}
+					_mm_storeu_ps(out + nFrame, sum);
+				}
+#endif
+				for (; nFrame < nTo; ++nFrame)
+				{
+					float sum = gain[0] * src[0][nFrame];
+					for (WORD nColumn = 1; nColumn < nColumns; ++nColumn)
+					{
+						sum += gain[nColumn] * src[nColumn][nFrame];
+					}
+					out[nFrame] = sum;
+				}
+			}
+		}
+	}
+
+	struct ByRow
+	{
+		bool operator()(const MixingMatrix::Entry& a, const MixingMatrix::Entry& b) const
+		{
+			return a.nRow < b.nRow;
+		}
+	};
+}
+
+MixingMatrix::MixingMatrix() :
+nRows_(0),
+nColumns_(0),
+storage_(Sparse),
+bIdentity_(false),
+bCopy_(true),
+nRowStart_(1, 0),
+pDense_(NULL)
+{
+}
+
+MixingMatrix::MixingMatrix(const WORD nRows, const WORD nColumns, const std::vector<Entry>& Entries) :
+nRows_(nRows),
+nColumns_(nColumns),
+storage_(Sparse),
+bIdentity_(nRows == nColumns),
+bCopy_(true),
+nRowStart_(nRows + 1, 0),
+pDense_(NULL)
+{
+	// Keep each row's gains in the order given, so that the sums are formed in the same order as before
+	std::vector<Entry> Sorted(Entries);
+	std::stable_sort(Sorted.begin(), Sorted.end(), ByRow());
+
+	nColumn_.reserve(Sorted.size());
+	fGain_.reserve(Sorted.size());
+	DWORD nRowFirst = 0;
+	for (std::vector<Entry>::size_type i = 0; i < Sorted.size(); ++i)
+	{
+		const Entry& entry = Sorted[i];
+		if (entry.nRow >= nRows || entry.nColumn >= nColumns)
+		{
+			throw convolutionException("Internal error: mixing matrix entry out of range");
+		}
+		if (i == 0 || entry.nRow != Sorted[i - 1].nRow)
+		{
+			nRowFirst = static_cast<DWORD>(fGain_.size());
+		}
+
+		// Sum repeated gains
+		DWORD nGain = nRowFirst;
+		while (nGain < fGain_.size() && nColumn_[nGain] != entry.nColumn)
+		{
+			++nGain;
+		}
+		if (nGain < fGain_.size())
+		{
+			fGain_[nGain] += entry.fGain;
+		}
+		else
+		{
+			nColumn_.push_back(entry.nColumn);
+			fGain_.push_back(entry.fGain);
+		}
+		nRowStart_[entry.nRow + 1] = static_cast<DWORD>(fGain_.size());
+	}
+
+	// Drop zero gains, and fill in the starts of rows without any
+	DWORD nKept = 0;
+	DWORD nStart = 0;
+	for (WORD nRow = 0; nRow < nRows; ++nRow)
+	{
+		const DWORD nEnd = std::max<DWORD>(nStart, nRowStart_[nRow + 1]);
+		nRowStart_[nRow] = nKept;
+		for (DWORD nGain = nStart; nGain < nEnd; ++nGain)
+		{
+			if (fGain_[nGain] != 0.0f)
+			{
+				nColumn_[nKept] = nColumn_[nGain];
+				fGain_[nKept] = fGain_[nGain];
+				++nKept;
+			}
+		}
+		nStart = nEnd;
+	}
+	nRowStart_[nRows] = nKept;
+	nColumn_.resize(nKept);
+	fGain_.resize(nKept);
+
+	bool bColumnOrder = true;
+	for (WORD nRow = 0; nRow < nRows; ++nRow)
+	{
+		const DWORD nRowGains = nRowStart_[nRow + 1] - nRowStart_[nRow];
+		const bool bUnit = nRowGains == 1 && fGain_[nRowStart_[nRow]] == 1.0f;
+		bCopy_ = bCopy_ && (nRowGains == 0 || bUnit);
+		bIdentity_ = bIdentity_ && bUnit && nColumn_[nRowStart_[nRow]] == nRow;
+		for (DWORD nGain = nRowStart_[nRow] + 1; nGain < nRowStart_[nRow + 1]; ++nGain)
+		{
+			bColumnOrder = bColumnOrder && nColumn_[nGain - 1] < nColumn_[nGain];
+		}
+	}
+
+	// Dense, when more than half the gains are non-zero, so that each frame of a row is stored just once.  mixDense
+	// sums in column order, so only if each row's gains were given in column order: then the sums are formed in
+	// the same order as before, and the zero gains in between add exact zeros
+	if (!bCopy_ && bColumnOrder && 2 * nKept > static_cast<DWORD>(nRows) * nColumns)
+	{
+		storage_ = Dense;
+		fDense_.assign(static_cast<DWORD>(nRows) * nColumns, 0.0f);
+		for (WORD nRow = 0; nRow < nRows; ++nRow)
+		{
+			for (DWORD nGain = nRowStart_[nRow]; nGain < nRowStart_[nRow + 1]; ++nGain)
+			{
+				fDense_[nRow * nColumns + nColumn_[nGain]] = fGain_[nGain];
+			}
+		}
+
+		// Mono, stereo, 5.1 and 7.1 inputs, or as many paths, have their own kernels
+		switch (nColumns)
+		{
+		case 1:		pDense_ = mixDense<1>; break;
+		case 2:		pDense_ = mixDense<2>; break;
+		case 6:		pDense_ = mixDense<6>; break;
+		case 8:		pDense_ = mixDense<8>; break;
+		default:	pDense_ = mixDense<0>;
+		}
+	}
+}
+
+void MixingMatrix::apply(const float* const src[], float* const dst[], const DWORD nFrames) const
+{
+	if (bCopy_)
+	{
+#pragma loop count (8)
+		for (WORD nRow = 0; nRow < nRows_; ++nRow)
+		{
+			if (nRowStart_[nRow] == nRowStart_[nRow + 1])
+			{
+				std::fill(dst[nRow], dst[nRow] + nFrames, 0.0f);
+			}
+			else
+			{
+				const float* in = src[nColumn_[nRowStart_[nRow]]];
+				std::copy(in, in + nFrames, dst[nRow]);
+			}
+		}
+	}
+	else if (storage_ == Dense)
+	{
+		pDense_(&fDense_[0], nRows_, nColumns_, src, dst, nFrames, nBlock);
+	}
+	else
+	{
+		applySparse(src, dst, nFrames);
+	}
+}
+
+// Each block of a row is formed one gain at a time, with the block in cache
+void MixingMatrix::applySparse(const float* const src[], float* const dst[], const DWORD nFrames) const
+{
+	for (DWORD nFrom = 0; nFrom < nFrames; nFrom += nBlock)
+	{
+		const DWORD nCount = std::min<DWORD>(nFrames - nFrom, nBlock);
+#pragma loop count (8)
+		for (WORD nRow = 0; nRow < nRows_; ++nRow)
+		{
+			float* restrict out = dst[nRow] + nFrom;
+			if (nRowStart_[nRow] == nRowStart_[nRow + 1])
+			{
+				std::fill(out, out + nCount, 0.0f);
+				continue;
+			}
+			for (DWORD nGain = nRowStart_[nRow]; nGain < nRowStart_[nRow + 1]; ++nGain)
+			{
+				term(src[nColumn_[nGain]] + nFrom, fGain_[nGain], out, nCount, nGain == nRowStart_[nRow]);
+			}
+		}
+	}
+}
+
+const std::string MixingMatrix::DisplayMixingMatrix() const
+{
+	std::ostringstream s;
+	s << nRows_ << "x" << nColumns_;
+	if (bIdentity_)
+	{
+		s << " identity";
+	}
+	else if (bCopy_)
+	{
+		s << " copy";
+	}
+	else
+	{
+		s << (storage_ == Dense ? " dense, " : " sparse, ") << nGains() << (nGains() == 1 ? " gain" : " gains");
+	}
+	return s.str();
+}
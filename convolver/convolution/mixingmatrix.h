@@ -0,0 +1,115 @@
+#pragma once
+// Convolver: DSP plug-in for Windows Media Player that convolves an impulse respose
+// filter it with the input stream.
+//
+// Copyright (C) 2005  John Pavel
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//
+/////////////////////////////////////////////////////////////////////////////
+//
+// mixingmatrix.h : The routing of channels into, and out of, the filter paths
+//
+/////////////////////////////////////////////////////////////////////////////
+
+#include "convolution\config.h"
+#include <vector>
+#include <string>
+
+// Each of nRows destinations is a weighted sum of nColumns sources.  The config file's routing is compiled
+// into two of these: the paths from the input channels, and the output channels from the paths.
+// Stored densely when most gains are non-zero, otherwise by row (compressed sparse row).  Routings that
+// are only copies need no arithmetic at all.
+class MixingMatrix
+{
+public:
+	// One gain.  Gains for the same row and column are summed
+	struct Entry
+	{
+		WORD	nRow;
+		WORD	nColumn;
+		float	fGain;
+
+		Entry(const WORD nRow, const WORD nColumn, const float fGain) : nRow(nRow), nColumn(nColumn), fGain(fGain)
+		{}
+	};
+
+	enum Storage {Dense, Sparse};
+
+	MixingMatrix();
+	MixingMatrix(const WORD nRows, const WORD nColumns, const std::vector<Entry>& Entries);
+
+	// dst[nRow][0..nFrames) = sum of fGain * src[nColumn][0..nFrames), overwriting dst.  A row without any
+	// gains is zeroed.  Works through the frames a block at a time, so that the sources stay in cache
+	// while each row is formed.  src and dst must not overlap
+	void apply(const float* const src[], float* const dst[], const DWORD nFrames) const;
+
+	// Accessor functions
+
+	WORD nRows() const
+	{
+		return nRows_;
+	}
+
+	WORD nColumns() const
+	{
+		return nColumns_;
+	}
+
+	Storage storage() const
+	{
+		return storage_;
+	}
+
+	DWORD nGains() const	// number of non-zero gains
+	{
+		return static_cast<DWORD>(fGain_.size());
+	}
+
+	bool bIdentity() const	// square, with row n a copy of column n
+	{
+		return bIdentity_;
+	}
+
+	bool bCopy() const		// each row a copy of one column, or zero
+	{
+		return bCopy_;
+	}
+
+	const std::string DisplayMixingMatrix() const;
+
+private:
+	static const DWORD nBlock = 256;	// frames
+
+	void applySparse(const float* const src[], float* const dst[], const DWORD nFrames) const;
+
+	WORD				nRows_;
+	WORD				nColumns_;
+	Storage				storage_;
+	bool				bIdentity_;
+	bool				bCopy_;
+
+	// Compressed sparse row: the gains of row r are at nRowStart_[r] .. nRowStart_[r+1]-1
+	std::vector<DWORD>	nRowStart_;
+	std::vector<WORD>	nColumn_;
+	std::vector<float>	fGain_;
+
+	std::vector<float>	fDense_;		// nRows_ x nColumns_, row by row, if Dense
+
+	// The dense kernel, chosen on construction: one with a fixed number of columns, if there is one
+	typedef void (*DenseKernel)(const float* fDense, const WORD nRows, const WORD nColumns, const float* const src[],
+		float* const dst[], const DWORD nFrames, const DWORD nBlock);
+	DenseKernel			pDense_;
+};
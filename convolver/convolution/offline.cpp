@@ -0,0 +1,360 @@
+// Convolver: DSP plug-in for Windows Media Player that convolves an impulse respose
+// filter it with the input stream.
+//
+// Copyright (C) 2005  John Pavel
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//
+
+#include "convolution\offline.h"
+#include <sstream>
+#include <cmath>
+#include <algorithm>
+
+// For random number seed
+#include <time.h>
+#include <boost\random.hpp>
+
+template class OfflineConvolution<float>;
+
+template <typename T>
+OfflineConvolution<T>::OfflineConvolution(const TCHAR szConfigFileName[MAX_PATH], const unsigned int& nPlanningRigour,
+										  const unsigned int& nFFTBackend, const ULONGLONG& nMemoryBudget) :
+nInputChannels_(0),
+nOutputChannels_(0),
+nSamplesPerSec_(0),
+nFilterLength_(0),
+nPaths_(0),
+nMaxInputSamplesDelay_(0),
+nMaxOutputSamplesDelay_(0),
+nBlockLength_(0),
+nFFTLength_(0),
+nSlotLength_(0),
+nPartitions_(0),
+nTailLength_(0),
+ComplexMulAdd_(complex_mul_add),
+nFDLIndex_(0)
+{
+#if defined(DEBUG) | defined(_DEBUG)
+	DEBUGGING(3, cdebug << "OfflineConvolution" << std::endl;)
+#endif
+
+	// Size up the paths and filters from the config and the filter header, without reading the filters
+	DWORD nMaxSamplesDelay = 0;
+	ChannelPaths::probe(szConfigFileName, nFilterLength_, nPaths_, nInputChannels_, nOutputChannels_, nMaxSamplesDelay);
+
+	// Choose the partitioning that minimises the cost per output frame.  A block is half a partition, padded
+	// to a length that the backend transforms well, and must be longer than the delays.  Once the whole filter
+	// fits in one partition, longer blocks only make the FFTs more expensive.
+	const FFTBackend& Backend = FFTBackend::Get(nFFTBackend);
+	double fMinCost = 0;
+	for(DWORD nBlockLength = nMinBlockLength; nBlockLength <= OptimalDFT::HalfLargestDFTSize; nBlockLength *= 2)
+	{
+		const DWORD nPartitions = (nFilterLength_ + nBlockLength - 1) / nBlockLength;
+		const DWORD nPaddedBlockLength = FilterFile::nPaddedLength(nFilterLength_, nPartitions, Backend) / 2;
+		if (static_cast<WORD>(nPartitions) == nPartitions && nPaddedBlockLength > nMaxSamplesDelay)
+		{
+			const double fCost = cost(nPaddedBlockLength);
+			if (nPartitions_ == 0 || fCost < fMinCost)
+			{
+				fMinCost = fCost;
+				nPartitions_ = nPartitions;
+			}
+		}
+		if (nBlockLength >= nFilterLength_)
+			break;
+	}
+	if (nPartitions_ == 0)
+	{
+		nPartitions_ = 1;		// so that ChannelPaths reports what is wrong
+	}
+
+	// The filters and their plans, as for the real-time engines, the inverse plan, and the buffers allocated below
+	{
+		const DWORD nFFTLength = FilterFile::nPaddedLength(nFilterLength_, nPartitions_, Backend);
+		const ULONGLONG nSlotLength = (FFTBackend::nSpectrumLength(nFFTLength) + 3) & ~3;
+		Footprint_ = ChannelPaths::footprint(szConfigFileName, static_cast<WORD>(nPartitions_), nFFTBackend);
+		Footprint_.nPlans += Backend.nPlanBytes(nFFTLength, 1);
+		Footprint_.nWorking = (static_cast<ULONGLONG>(nInputChannels_) * (nMaxSamplesDelay + nFFTLength) +
+			static_cast<ULONGLONG>(nOutputChannels_) * (nMaxSamplesDelay + nFFTLength / 2) +
+			(static_cast<ULONGLONG>(nPartitions_) * nPaths_ + 1 + nOutputChannels_) * nSlotLength) * sizeof(float);
+	}
+	if (nMemoryBudget > 0 && Footprint_.nTotal() > nMemoryBudget)
+	{
+		std::ostringstream s;
+		s << "Needs " << Footprint_.DisplayFootprint() << ", over the memory budget of " << nMemoryBudget << " bytes";
+		throw convolutionException(s.str());
+	}
+
+	// Read the filters, and take their spectra, for that partitioning
+	Filters_.set_ptr(new ChannelPaths(szConfigFileName, static_cast<WORD>(nPartitions_), nPlanningRigour, nFFTBackend));
+
+	nInputChannels_ = Filters_->nInputChannels();
+	nSamplesPerSec_ = Filters_->nSamplesPerSec();
+	nInputSamplesDelay_ = Filters_->nInputSamplesDelay();
+	nOutputSamplesDelay_ = Filters_->nOutputSamplesDelay();
+	nMaxInputSamplesDelay_ = *std::max_element(nInputSamplesDelay_.begin(), nInputSamplesDelay_.end());
+	nMaxOutputSamplesDelay_ = *std::max_element(nOutputSamplesDelay_.begin(), nOutputSamplesDelay_.end());
+
+	nBlockLength_ = Filters_->nHalfPartitionLength();
+	nFFTLength_ = Filters_->nPartitionLength();
+	nSlotLength_ = Filters_->nPathStride();
+	nTailLength_ = nFilterLength_ - 1 + nMaxInputSamplesDelay_ + nMaxOutputSamplesDelay_;
+	ComplexMulAdd_ = select_complex_mul_add(nFFTLength_);
+
+	// Working storage
+	InputHistory_.assign(nInputChannels_, ChannelBuffer(nMaxInputSamplesDelay_ + 2 * nBlockLength_));
+	OutputHistory_.assign(nOutputChannels_, ChannelBuffer(nMaxOutputSamplesDelay_ + nBlockLength_));
+	InputSpectra_.assign(nPartitions_, ChannelBuffer(nPaths_ * nSlotLength_));
+	ChannelBuffer PathSpectrum(nSlotLength_);
+	PathSpectrum_.swap(PathSpectrum);
+	ChannelBuffer OutputSpectra(nOutputChannels_ * nSlotLength_);
+	OutputSpectra_.swap(OutputSpectra);
+
+	// Each row of the delay line is a batch for Filters_->BatchPlan(), as are the output channels' slots for the
+	// inverse plan
+	InversePlan_.set_ptr(Filters_->Backend().plan(nFFTLength_, nOutputChannels_, nSlotLength_, nPlanningRigour));
+
+	// Planning may have scribbled on the buffers
+	Flush();
+}
+
+template <typename T>
+OfflineConvolution<T>::~OfflineConvolution()
+{
+#if defined(DEBUG) | defined(_DEBUG)
+	DEBUGGING(3, cdebug << "OfflineConvolution::~OfflineConvolution" << std::endl;)
+#endif
+}
+
+template <typename T>
+double OfflineConvolution<T>::cost(const DWORD nBlockLength) const
+{
+	const double nFFTLength = 2.0 * nBlockLength;
+	const double nPartitions = (nFilterLength_ + nBlockLength - 1) / nBlockLength;
+
+	const double fFFT = 2.5 * nFFTLength * log(nFFTLength) / log(2.0);	// a real DFT
+	const double fMAC = 8.0 * (nBlockLength + 1);						// a partition's complex multiply-add
+
+	// The delay line and the filter spectra are each nPartitions x nPaths spectra
+	const double nWorkingSetBytes = 2.0 * nPaths_ * nPartitions * (nFFTLength + 2) * sizeof(float);
+	const double fMACPenalty = nWorkingSetBytes > nCacheBytes ? nCacheMissPenalty : 1;
+
+	return ((nPaths_ + nOutputChannels_) * fFFT + nPaths_ * nPartitions * fMAC * fMACPenalty) / nBlockLength;
+}
+
+// Reset various buffers and pointers
+template <typename T>
+void OfflineConvolution<T>::Flush()
+{
+#if defined(DEBUG) | defined(_DEBUG)
+	DEBUGGING(3, cdebug << "OfflineConvolution<T>::Flush" << std::endl;)
+#endif
+	Zero(InputHistory_);
+	Zero(OutputHistory_);
+	Zero(InputSpectra_);
+	Zero(PathSpectrum_);
+	Zero(OutputSpectra_);
+	nFDLIndex_ = 0;
+}
+
+template <typename T>
+DWORD OfflineConvolution<T>::Process(const T* pfInput, T* pfOutput, const DWORD nFrames, const T fAttenuation_db)
+{
+	if (nFrames % nBlockLength_ != 0)
+	{
+		throw convolutionException("Internal error: offline convolution must be given whole blocks");
+	}
+
+	const float fAttenuationFactor = powf(10, fAttenuation_db / 20.0f);
+
+	for (DWORD nBlock = 0; nBlock < nFrames / nBlockLength_; ++nBlock)
+	{
+		// De-interleave the block, after the previous block (and delay) in the history
+		for (WORD nChannel = 0; nChannel < nInputChannels_; ++nChannel)
+		{
+			float* restrict pHistory = InputHistory_[nChannel].c_ptr() + nMaxInputSamplesDelay_ + nBlockLength_;
+			if (pfInput == NULL)
+			{
+				std::fill_n(pHistory, nBlockLength_, 0.0f);
+			}
+			else
+			{
+				const T* restrict pInput = pfInput + nChannel;
+				for (DWORD nFrame = 0; nFrame < nBlockLength_; ++nFrame, pInput += nInputChannels_)
+					pHistory[nFrame] = *pInput * fAttenuationFactor;
+			}
+		}
+		if (pfInput != NULL)
+			pfInput += nBlockLength_ * nInputChannels_;
+
+		processBlock();
+
+		// Interleave the output, applying the output delays
+		for (WORD nChannel = 0; nChannel < nOutputChannels_; ++nChannel)
+		{
+			const float* restrict pHistory = OutputHistory_[nChannel].c_ptr() + nMaxOutputSamplesDelay_ - nOutputSamplesDelay_[nChannel];
+			T* restrict pOutput = pfOutput + nChannel;
+			for (DWORD nFrame = 0; nFrame < nBlockLength_; ++nFrame, pOutput += nOutputChannels_)
+				*pOutput = pHistory[nFrame];
+		}
+		pfOutput += nBlockLength_ * nOutputChannels_;
+
+		// Slide the histories along by a block
+		for (WORD nChannel = 0; nChannel < nInputChannels_; ++nChannel)
+		{
+			ChannelBuffer& History = InputHistory_[nChannel];
+			std::copy(History.begin() + nBlockLength_, History.end(), History.begin());
+		}
+		for (WORD nChannel = 0; nChannel < nOutputChannels_; ++nChannel)
+		{
+			ChannelBuffer& History = OutputHistory_[nChannel];
+			std::copy(History.begin() + nBlockLength_, History.end(), History.begin());
+		}
+	}
+
+	return nFrames;
+}
+
+// Uniformly-partitioned overlap-save on the block at the end of InputHistory_, leaving the result
+// at the end of OutputHistory_
+template <typename T>
+void OfflineConvolution<T>::processBlock()
+{
+	const DWORD nComplex = nFFTLength_ / 2 + 1;
+	float* restrict pRow = c_ptr(InputSpectra_, nFDLIndex_);
+
+	// Mix the (delayed) previous and current blocks into a slot for each path ...
+	for (DWORD nPath = 0; nPath < nPaths_; ++nPath)
+	{
+		const ChannelPaths::ChannelPath& thisPath = Filters_->Paths()[nPath];
+		float* restrict pSlot = pRow + nPath * nSlotLength_;
+		std::fill_n(pSlot, nFFTLength_, 0.0f);
+		for (std::vector<ChannelPaths::ChannelPath::ScaledChannel>::size_type i = 0; i < thisPath.inChannel.size(); ++i)
+		{
+			const WORD nChannel = thisPath.inChannel[i].nChannel;
+			scale_add(InputHistory_[nChannel].c_ptr() + nMaxInputSamplesDelay_ - nInputSamplesDelay_[nChannel],
+				thisPath.inChannel[i].fScale, pSlot, nFFTLength_);
+		}
+	}
+
+	// ... and take their DFTs together
+	Filters_->BatchPlan().forward(pRow);
+
+	// Multiply by each partition of the filter, summing over the delay line, and mix into the output channels
+	Zero(OutputSpectra_);
+	for (DWORD nPath = 0; nPath < nPaths_; ++nPath)
+	{
+		const ChannelPaths::ChannelPath& thisPath = Filters_->Paths()[nPath];
+		Zero(PathSpectrum_);
+
+		DWORD nRow = nFDLIndex_;
+		for (DWORD nPartition = 0; nPartition < nPartitions_; ++nPartition)
+		{
+			ComplexMulAdd_(reinterpret_cast<const fftwf_complex*>(c_ptr(InputSpectra_, nRow) + nPath * nSlotLength_),
+				reinterpret_cast<const fftwf_complex*>(c_ptr(thisPath.filter.coeffs(), nPartition)),
+				reinterpret_cast<fftwf_complex*>(PathSpectrum_.c_ptr()), nComplex);
+			nRow = nRow == 0 ? nPartitions_ - 1 : nRow - 1;		// the previous block
+		}
+
+		for (std::vector<ChannelPaths::ChannelPath::ScaledChannel>::size_type i = 0; i < thisPath.outChannel.size(); ++i)
+		{
+			scale_add(PathSpectrum_.c_ptr(), thisPath.outChannel[i].fScale,
+				OutputSpectra_.c_ptr() + thisPath.outChannel[i].nChannel * nSlotLength_, 2 * nComplex);
+		}
+	}
+
+	// Get back the outputs.  Only the last half is valid (overlap-save)
+	InversePlan_->inverse(OutputSpectra_.c_ptr());
+	for (WORD nChannel = 0; nChannel < nOutputChannels_; ++nChannel)
+	{
+		const float* pSlot = OutputSpectra_.c_ptr() + nChannel * nSlotLength_;
+		std::copy(pSlot + nBlockLength_, pSlot + nFFTLength_, OutputHistory_[nChannel].begin() + nMaxOutputSamplesDelay_);
+	}
+
+	if (++nFDLIndex_ == nPartitions_)
+	{
+		nFDLIndex_ = 0;
+	}
+}
+
+template <typename T>
+HRESULT OfflineConvolution<T>::calculateOptimumAttenuation(T& fAttenuation)
+{
+#if defined(DEBUG) | defined(_DEBUG)
+	DEBUGGING(3, cdebug << "OfflineConvolution::calculateOptimumAttenuation" << std::endl;)
+#endif
+	Flush();	// Start from a known point
+
+	// As for Convolution<T>::calculateOptimumAttenuation, NSAMPLES filter lengths of white noise (in whole blocks)
+	const DWORD nBlocks = ((NSAMPLES * nFilterLength_ + nBlockLength_ - 1) / nBlockLength_) * nBlockLength_;
+
+	std::vector<T> InputSamples(nBlocks * nInputChannels_);
+	std::vector<T> OutputSamples(nBlocks * nOutputChannels_);
+
+	typedef boost::lagged_fibonacci607 base_generator_type;
+	base_generator_type generator(static_cast<unsigned int>(std::time(NULL)));
+	typedef boost::uniform_real<float> distribution_type;
+	typedef boost::variate_generator<base_generator_type&, distribution_type> gen_type;
+	distribution_type uni_dist(-1, 1);
+	gen_type uni(generator, uni_dist);
+
+	std::generate(InputSamples.begin(), InputSamples.end(), uni);
+
+	Process(&InputSamples[0], &OutputSamples[0], nBlocks, 0);
+
+	float maxSample = 0;
+	for (typename std::vector<T>::size_type i = 0; i < OutputSamples.size(); ++i)
+	{
+		if (fabs(OutputSamples[i]) > maxSample)
+		{
+			maxSample = fabs(OutputSamples[i]);
+		}
+	}
+
+	// maxSample * 10 ^ (fAttenuation_db / 20) = 1
+	// Limit fAttenuation to +/-MAX_ATTENUATION dB
+	fAttenuation = -20.0f * log10(maxSample);
+
+	if (fAttenuation > MAX_ATTENUATION)
+	{
+		fAttenuation = MAX_ATTENUATION;
+	}
+	else if (-fAttenuation > MAX_ATTENUATION)
+	{
+		fAttenuation = -1.0L * MAX_ATTENUATION;
+	}
+
+#if defined(DEBUG) | defined(_DEBUG)
+	cdebug << "fAttenuation:" << fAttenuation << " maxSample: " << maxSample << std::endl;
+#endif
+
+	Flush(); // Reset, so that residual noise cleared
+
+	return S_OK;
+}
+
+template <typename T>
+const std::string OfflineConvolution<T>::DisplayOfflineConvolution() const
+{
+	std::ostringstream result;
+
+	result << nPaths_ << (nPaths_ == 1 ? " path, " : " paths, ") << nInputChannels_ << " to " << nOutputChannels_
+		<< " channels, filter length " << nFilterLength_ << ": " << nPartitions_
+		<< (nPartitions_ == 1 ? " partition" : " partitions") << " of " << nBlockLength_ << " frames (DFT length "
+		<< nFFTLength_ << ", " << CT2CA(Filters_->Backend().szName()) << ")";
+
+	return result.str();
+}
@@ -0,0 +1,147 @@
+#pragma once
+// Convolver: DSP plug-in for Windows Media Player that convolves an impulse respose
+// filter it with the input stream.
+//
+// Copyright (C) 2005  John Pavel
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//
+
+#include "convolution\config.h"
+#include "convolution\holder.h"
+#include "convolution\samplebuffer.h"
+#include "convolution\channelpaths.h"
+#include "convolution\fftbackend.h"
+#include "convolution\kernels.h"
+#include <vector>
+
+// OfflineConvolution renders whole files, where latency is irrelevant.  Rather than the real-time
+// engine's frame-by-frame state machine, it works a block at a time on planar buffers, with the number
+// of partitions chosen to minimise the cost per output frame for the filter length and channel layout.
+// The filters are read, and transformed, for that partitioning, as for the real-time engines, so each block
+// is half a (padded) partition.  The forward FFTs of all the filter paths, and the inverse FFTs of all the
+// output channels, are each done by a single batched plan of the FFT backend.  The output is not delayed:
+// output frame t corresponds to input frame t, and the response continues for nTailLength() frames after
+// the input ends.
+
+template <typename T>
+class OfflineConvolution
+{
+public:
+	// nFFTBackend indexes FFTBackend::Get.  nMemoryBudget > 0 => throw, rather than read the filters, if the engine
+	// would need more bytes than that
+	OfflineConvolution(const TCHAR szConfigFileName[MAX_PATH], const unsigned int& nPlanningRigour,
+		const unsigned int& nFFTBackend = 0, const ULONGLONG& nMemoryBudget = 0);
+	virtual ~OfflineConvolution();
+
+	// Convolve nFrames interleaved frames, which must be a multiple of nBlockLength().
+	// pfInput == NULL => silence (eg, to flush out the tail).  Returns the number of frames generated (== nFrames)
+	DWORD Process(const T* pfInput, T* pfOutput, const DWORD nFrames, const T fAttenuation_db);
+
+	void Flush();								// zero buffers, reset pointers
+
+	HRESULT calculateOptimumAttenuation(T& fAttenuation);
+
+	// Accessor functions
+
+	WORD nInputChannels() const
+	{
+		return nInputChannels_;
+	}
+
+	WORD nOutputChannels() const
+	{
+		return nOutputChannels_;
+	}
+
+	DWORD nSamplesPerSec() const
+	{
+		return nSamplesPerSec_;
+	}
+
+	DWORD nFilterLength() const				// in frames, as read (unpadded)
+	{
+		return nFilterLength_;
+	}
+
+	DWORD nBlockLength() const				// frames consumed and generated for each block
+	{
+		return nBlockLength_;
+	}
+
+	DWORD nPartitions() const				// the number of partitions into which each filter has been cut
+	{
+		return nPartitions_;
+	}
+
+	DWORD nTailLength() const				// frames of output following the last input frame
+	{
+		return nTailLength_;
+	}
+
+	// The memory that the engine needs, as worked out for its partitioning before the filters were read (taking
+	// the longest delay for every channel)
+	const Footprint& footprint() const
+	{
+		return Footprint_;
+	}
+
+	const std::string DisplayOfflineConvolution() const;
+
+private:
+	// Estimated cost, in flops per output frame, of convolving with blocks of nBlockLength frames
+	double cost(const DWORD nBlockLength) const;
+
+	void processBlock();
+
+	WORD		nInputChannels_;
+	WORD		nOutputChannels_;
+	DWORD		nSamplesPerSec_;
+	DWORD		nFilterLength_;
+	DWORD		nPaths_;
+	std::vector<DWORD> nInputSamplesDelay_;
+	std::vector<DWORD> nOutputSamplesDelay_;
+	DWORD		nMaxInputSamplesDelay_;
+	DWORD		nMaxOutputSamplesDelay_;
+
+	DWORD		nBlockLength_;				// B
+	DWORD		nFFTLength_;				// 2B
+	DWORD		nSlotLength_;				// floats per spectrum: 2*(B+1), rounded up to keep each slot 16-byte aligned
+	DWORD		nPartitions_;				// ceil(nFilterLength_ / B)
+	DWORD		nTailLength_;
+	Footprint	Footprint_;
+
+	Holder<ChannelPaths> Filters_;			// the paths, with their filters partitioned nPartitions_ ways
+	ComplexKernel	ComplexMulAdd_;			// chosen for nFFTLength_ (see select_complex_mul_add)
+
+	SampleBuffer	InputHistory_;			// per input channel: the previous block, the current block, and the delay
+	SampleBuffer	OutputHistory_;			// per output channel: the delay, and the current block
+	SampleBuffer	InputSpectra_;			// frequency-domain delay line: nPartitions_ rows of nPaths_ slots
+	ChannelBuffer	PathSpectrum_;			// a path's output spectrum
+	ChannelBuffer	OutputSpectra_;			// nOutputChannels_ slots
+	DWORD			nFDLIndex_;				// the newest row of InputSpectra_
+
+	Holder<FFTPlan>	InversePlan_;			// nOutputChannels_ transforms, in place.  The forward transforms of the
+											// nPaths_ slots of a row use Filters_->BatchPlan()
+
+	// Used to tune the choice of block length
+	static const DWORD nMinBlockLength = 64;
+	static const DWORD nCacheBytes = 1 << 21;		// beyond which the delay line and filter spectra spill out of cache
+	static const int nCacheMissPenalty = 2;			// the factor by which the multiply-adds then slow
+
+	OfflineConvolution(); // no implementation
+	OfflineConvolution(const OfflineConvolution& other); // no impl.
+	const OfflineConvolution& operator=(const OfflineConvolution& other); // no impl.
+};
@@ -0,0 +1,319 @@
+// Convolver: DSP plug-in for Windows Media Player that convolves an impulse respose
+// filter it with the input stream.
+//
+// Copyright (C) 2005  John Pavel
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//
+/////////////////////////////////////////////////////////////////////////////
+//
+// realfft.cpp : The built-in FFT of reals, for powers of 2
+//
+
+#include "convolution\realfft.h"
+#include <map>
+
+struct RealFFT::Tables
+{
+	explicit Tables(const DWORD nLength);
+
+	DWORD				nRefs;
+	// The twiddles of the butterflies of span h are w^j = e^(-2pi i j / 2h), j < h.  They are stored from float 2h
+	// on, as (wr, wr) and (-wi, wi) pairs, so that SSE can multiply by them without shuffling them
+	ChannelBuffer		StageCos;
+	ChannelBuffer		StageSin;
+	// The pairs of complex values to exchange, to undo the bit reversal of decimation in frequency
+	std::vector<DWORD>	nSwaps;
+	// The twiddles that split the complex spectrum into the real one, e^(-2pi i k / n), k <= n / 4
+	std::vector<float>	fCos;
+	std::vector<float>	fSin;
+};
+
+RealFFT::Tables::Tables(const DWORD nLength) : nRefs(0), StageCos(nLength), StageSin(nLength),
+	fCos(nLength / 4 + 1), fSin(nLength / 4 + 1)
+{
+	const double TwoPi = 6.283185307179586476925286766559;
+	const DWORD M = nLength / 2;
+
+	for(DWORD h = 1; h < M; h *= 2)
+	{
+		for(DWORD j = 0; j < h; ++j)
+		{
+			const double theta = TwoPi * j / (2 * h);
+			StageCos[2 * (h + j)] = StageCos[2 * (h + j) + 1] = static_cast<float>(cos(theta));
+			StageSin[2 * (h + j)] = static_cast<float>(sin(theta));
+			StageSin[2 * (h + j) + 1] = static_cast<float>(-sin(theta));
+		}
+	}
+
+	DWORD nBits = 0;
+	while((1UL << nBits) < M)
+		++nBits;
+	for(DWORD i = 0; i < M; ++i)
+	{
+		DWORD r = 0;
+		for(DWORD nBit = 0; nBit < nBits; ++nBit)
+			r |= ((i >> nBit) & 1) << (nBits - 1 - nBit);
+		if(i < r)
+		{
+			nSwaps.push_back(i);
+			nSwaps.push_back(r);
+		}
+	}
+
+	for(DWORD k = 0; k <= M / 2; ++k)
+	{
+		const double theta = TwoPi * k / nLength;
+		fCos[k] = static_cast<float>(cos(theta));
+		fSin[k] = static_cast<float>(-sin(theta));
+	}
+}
+
+namespace
+{
+	// The tables in use, by length
+	class TableCache
+	{
+	public:
+		TableCache()
+		{
+			InitializeCriticalSection(&cs_);
+		}
+
+		~TableCache()
+		{
+			for(std::map<DWORD, RealFFT::Tables*>::iterator it = tables_.begin(); it != tables_.end(); ++it)
+				delete it->second;
+			DeleteCriticalSection(&cs_);
+		}
+
+		const RealFFT::Tables* acquire(const DWORD nLength)
+		{
+			Lock lock(cs_);
+			RealFFT::Tables*& tables = tables_[nLength];
+			if(tables == NULL)
+			{
+				try
+				{
+					tables = new RealFFT::Tables(nLength);
+				}
+				catch(...)
+				{
+					tables_.erase(nLength);
+					throw;
+				}
+			}
+			++tables->nRefs;
+			return tables;
+		}
+
+		void release(const DWORD nLength)
+		{
+			Lock lock(cs_);
+			std::map<DWORD, RealFFT::Tables*>::iterator it = tables_.find(nLength);
+			assert(it != tables_.end());
+			if(--it->second->nRefs == 0)
+			{
+				delete it->second;
+				tables_.erase(it);
+			}
+		}
+
+	private:
+		struct Lock
+		{
+			explicit Lock(CRITICAL_SECTION& cs) : cs_(cs) { EnterCriticalSection(&cs_); }
+			~Lock() { LeaveCriticalSection(&cs_); }
+			CRITICAL_SECTION& cs_;
+		};
+
+		CRITICAL_SECTION					cs_;
+		std::map<DWORD, RealFFT::Tables*>	tables_;
+	} Cache;
+
+	// The butterflies of span h >= 2 over the M complex values in z: a, b <- a + b, (a - b) w^j
+	inline void stage(float* restrict z, const DWORD M, const DWORD h, const float* restrict wr, const float* restrict wi)
+	{
+		for(DWORD nBlock = 0; nBlock < M; nBlock += 2 * h)
+		{
+			float* restrict a = z + 2 * nBlock;
+			float* restrict b = a + 2 * h;
+#ifdef SSE2_CONVERSION
+			for(DWORD j = 0; j < 2 * h; j += 4)
+			{
+				const __m128 va = _mm_load_ps(a + j);
+				const __m128 vb = _mm_load_ps(b + j);
+				const __m128 d = _mm_sub_ps(va, vb);
+				_mm_store_ps(a + j, _mm_add_ps(va, vb));
+				// (dr, di) * (wr, wi) = (dr wr - di wi, di wr + dr wi)
+				_mm_store_ps(b + j, _mm_add_ps(_mm_mul_ps(d, _mm_load_ps(wr + j)),
+					_mm_mul_ps(_mm_shuffle_ps(d, d, _MM_SHUFFLE(2, 3, 0, 1)), _mm_load_ps(wi + j))));
+			}
+#else
+			for(DWORD j = 0; j < 2 * h; j += 2)
+			{
+				const float dr = a[j] - b[j];
+				const float di = a[j + 1] - b[j + 1];
+				a[j] += b[j];
+				a[j + 1] += b[j + 1];
+				b[j] = dr * wr[j] + di * wi[j];
+				b[j + 1] = di * wr[j + 1] + dr * wi[j + 1];
+			}
+#endif
+		}
+	}
+
+	// The last butterflies, of span 1, which need no twiddles
+	inline void pairs(float* z, const DWORD M)
+	{
+#ifdef SSE2_CONVERSION
+		const __m128 sign = _mm_set_ps(-1.0f, -1.0f, 1.0f, 1.0f);
+		for(DWORD i = 0; i < 2 * M; i += 4)
+		{
+			const __m128 v = _mm_load_ps(z + i);
+			_mm_store_ps(z + i, _mm_add_ps(_mm_movelh_ps(v, v), _mm_mul_ps(_mm_movehl_ps(v, v), sign)));
+		}
+#else
+		for(DWORD i = 0; i < 2 * M; i += 4)
+		{
+			const float ar = z[i], ai = z[i + 1];
+			z[i] = ar + z[i + 2];
+			z[i + 1] = ai + z[i + 3];
+			z[i + 2] = ar - z[i + 2];
+			z[i + 3] = ai - z[i + 3];
+		}
+#endif
+	}
+}
+
+RealFFT::RealFFT(const DWORD nLength) : nLength_(nLength), tables_(NULL)
+{
+	if (nLength < 4 || (nLength & (nLength - 1)) != 0)
+	{
+		throw convolutionException("The built-in FFT only handles powers of 2");
+	}
+	tables_ = Cache.acquire(nLength);
+}
+
+RealFFT::~RealFFT()
+{
+	Cache.release(nLength_);
+}
+
+// The stage twiddles, the swaps (all but the 2^ceil(k/2) of the M = 2^k values that are their own bit reversal),
+// and the split twiddles
+ULONGLONG RealFFT::nTableBytes(const DWORD nLength)
+{
+	const DWORD M = nLength / 2;
+	DWORD nBits = 0;
+	while((1UL << nBits) < M)
+		++nBits;
+
+	return 2 * static_cast<ULONGLONG>(nLength) * sizeof(float) + (M - (1UL << ((nBits + 1) / 2))) * sizeof(DWORD) +
+		2 * (nLength / 4 + 1) * sizeof(float);
+}
+
+void RealFFT::transform(float* z) const
+{
+	const DWORD M = nLength_ / 2;
+
+	for(DWORD h = M / 2; h >= 2; h /= 2)
+		stage(z, M, h, c_ptr(tables_->StageCos) + 2 * h, c_ptr(tables_->StageSin) + 2 * h);
+	pairs(z, M);
+
+	for(std::vector<DWORD>::const_iterator it = tables_->nSwaps.begin(); it != tables_->nSwaps.end(); it += 2)
+	{
+		float* const p = z + 2 * *it;
+		float* const q = z + 2 * *(it + 1);
+		std::swap(p[0], q[0]);
+		std::swap(p[1], q[1]);
+	}
+}
+
+// z = x[2j] + i x[2j+1] has the transform Z.  X[k] = E[k] + e^(-2pi i k / n) O[k], where E and O are the
+// transforms of the even and odd samples: E[k] = (Z[k] + Z*[M-k]) / 2 and O[k] = -i (Z[k] - Z*[M-k]) / 2
+void RealFFT::forward(float* a) const
+{
+	transform(a);
+
+	const DWORD M = nLength_ / 2;
+	const float* const wr = &tables_->fCos[0];
+	const float* const wi = &tables_->fSin[0];
+
+	const float r0 = a[0];
+	const float i0 = a[1];
+	a[0] = r0 + i0;
+	a[1] = 0;
+	a[nLength_] = r0 - i0;
+	a[nLength_ + 1] = 0;
+	a[M + 1] = -a[M + 1];
+
+	for(DWORD k = 1; k < M / 2; ++k)
+	{
+		const DWORD m = M - k;
+		const float er = 0.5f * (a[2 * k] + a[2 * m]);
+		const float ei = 0.5f * (a[2 * k + 1] - a[2 * m + 1]);
+		const float br = 0.5f * (a[2 * k + 1] + a[2 * m + 1]);
+		const float bi = 0.5f * (a[2 * m] - a[2 * k]);
+		const float tr = wr[k] * br - wi[k] * bi;
+		const float ti = wr[k] * bi + wi[k] * br;
+		a[2 * k] = er + tr;
+		a[2 * k + 1] = ei + ti;
+		a[2 * m] = er - tr;
+		a[2 * m + 1] = ti - ei;
+	}
+}
+
+// Undoes forward, to 2Z, and then inverts that through the forward transform, as conj(transform(conj(2Z))).
+// The result is scaled by 2M = n
+void RealFFT::inverse(float* a) const
+{
+	const DWORD M = nLength_ / 2;
+	const float* const wr = &tables_->fCos[0];
+	const float* const wi = &tables_->fSin[0];
+
+	const float x0 = a[0];
+	const float xm = a[nLength_];
+	a[0] = x0 + xm;
+	a[1] = xm - x0;
+	a[M] *= 2;
+	a[M + 1] *= 2;
+
+	for(DWORD k = 1; k < M / 2; ++k)
+	{
+		const DWORD m = M - k;
+		const float er = a[2 * k] + a[2 * m];
+		const float ei = a[2 * k + 1] - a[2 * m + 1];
+		const float dr = a[2 * k] - a[2 * m];
+		const float di = a[2 * k + 1] + a[2 * m + 1];
+		const float br = dr * wr[k] + di * wi[k];
+		const float bi = di * wr[k] - dr * wi[k];
+		a[2 * k] = er - bi;
+		a[2 * k + 1] = -(ei + br);
+		a[2 * m] = er + bi;
+		a[2 * m + 1] = ei - br;
+	}
+
+	transform(a);
+
+#ifdef SSE2_CONVERSION
+	const __m128 sign = _mm_castsi128_ps(_mm_set_epi32(0x80000000, 0, 0x80000000, 0));
+	for(DWORD i = 0; i < nLength_; i += 4)
+		_mm_store_ps(a + i, _mm_xor_ps(_mm_load_ps(a + i), sign));
+#else
+	for(DWORD i = 1; i < nLength_; i += 2)
+		a[i] = -a[i];
+#endif
+}
@@ -0,0 +1,60 @@
+#pragma once
+// Convolver: DSP plug-in for Windows Media Player that convolves an impulse respose
+// filter it with the input stream.
+//
+// Copyright (C) 2005  John Pavel
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//
+/////////////////////////////////////////////////////////////////////////////
+//
+// realfft.h : The built-in FFT of reals, for powers of 2
+//
+/////////////////////////////////////////////////////////////////////////////
+
+#include "convolution\config.h"
+#include "convolution\samplebuffer.h"
+
+// Transforms n = 2^k reals in place, as the complex transform of the n / 2 values made of the interleaved even
+// and odd samples, by radix-2 decimation in frequency.  The spectrum has FFTW's layout, sign and scaling (see
+// fftbackend.h).  The butterflies use SSE, when it is available.  The twiddle tables for each length are shared
+// by all the transforms of that length, process-wide, and released with the last of them.
+// forward and inverse only read the tables, so several threads can use one RealFFT at once
+class RealFFT
+{
+public:
+	// Throws, unless nLength is a power of 2, and at least 4
+	explicit RealFFT(const DWORD nLength);
+	~RealFFT();
+
+	// a is 16-byte aligned, and holds nLength + 2 floats
+	void forward(float* a) const;
+	void inverse(float* a) const;
+
+	// The bytes of the tables for nLength, which all the transforms of that length share
+	static ULONGLONG nTableBytes(const DWORD nLength);
+
+	struct Tables;
+
+private:
+	const DWORD		nLength_;
+	const Tables*	tables_;
+
+	// The unscaled forward complex transform of the nLength / 2 interleaved values in z, in natural order
+	void transform(float* z) const;
+
+	RealFFT(const RealFFT&);						// No copying
+	const RealFFT& operator=(const RealFFT&);
+};
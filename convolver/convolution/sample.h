@@ -24,6 +24,7 @@
 #include <mediaerr.h>
 #include "convolution\factory.h"
 #include "convolution\dither.h"
+#include "convolution\kernels.h"
 
 //Floating-point samples use the range -1.0...1.0, inclusive.
 //Integer formats use the full signed range of their data type,
@@ -56,13 +57,39 @@ struct __declspec(novtable) __single_inheritance ConvertSample
 	ConvertSample() {}
 
 	ConvertSample(const typename NoiseShaper<T>::NoiseShapingType nNoiseShaper, const typename Ditherer<T>::DitherType nDither,
-		const WORD nChannels, const DWORD nSamplesPerSec)
+		const WORD nChannels, const DWORD nSamplesPerSec, const bool bVectorized, const unsigned int nSeed)
 	{}
 
 	virtual void GetSample(T& dstSample, const BYTE* & srcContainer, const float fAttenuationFactor, DWORD& nBytesProcessed) const = 0;	// converts sample into a T (eg, float), [-1..1]
 
 	virtual void PutSample(BYTE*& dstContainer, T srcSample, const WORD nChannel, DWORD& nBytesGenerated) const = 0;
 
+	// Convert nFrames interleaved frames into a buffer for each of nChannels channels, and back.  The defaults
+	// convert a sample at a time; the formats override them with block conversions
+	virtual void GetSamples(T* const dstChannels[], const BYTE* & srcContainer, const WORD nChannels, const DWORD nFrames,
+		const float fAttenuationFactor, DWORD& nBytesProcessed) const
+	{
+		for (DWORD nFrame = 0; nFrame < nFrames; ++nFrame)
+		{
+			for (WORD nChannel = 0; nChannel < nChannels; ++nChannel)
+			{
+				GetSample(dstChannels[nChannel][nFrame], srcContainer, fAttenuationFactor, nBytesProcessed);
+			}
+		}
+	}
+
+	virtual void PutSamples(BYTE*& dstContainer, const T* const srcChannels[], const WORD nChannels, const DWORD nFrames,
+		DWORD& nBytesGenerated) const
+	{
+		for (DWORD nFrame = 0; nFrame < nFrames; ++nFrame)
+		{
+			for (WORD nChannel = 0; nChannel < nChannels; ++nChannel)
+			{
+				PutSample(dstContainer, srcChannels[nChannel][nFrame], nChannel, nBytesGenerated);
+			}
+		}
+	}
+
 	virtual WORD nContainerSize() const = 0;
 
 	virtual ~ConvertSample(void) = 0;
@@ -82,7 +109,7 @@ struct ConvertSample_ieeefloat : public virtual ConvertSample<T>
 	{}
 
 	ConvertSample_ieeefloat(const typename NoiseShaper<T>::NoiseShapingType nNoiseShaper, const typename Ditherer<T>::DitherType nDither,
-		const WORD nChannels, const DWORD nSamplesPerSec)
+		const WORD nChannels, const DWORD nSamplesPerSec, const bool bVectorized, const unsigned int nSeed)
 	{}
 
 	void GetSample(T& dstSample, const BYTE* & srcContainer, const float fAttenuationFactor, DWORD& nBytesProcessed) const
@@ -100,6 +127,22 @@ struct ConvertSample_ieeefloat : public virtual ConvertSample<T>
 		nBytesGenerated += sizeof(float);
 	}
 
+	void GetSamples(T* const dstChannels[], const BYTE* & srcContainer, const WORD nChannels, const DWORD nFrames,
+		const float fAttenuationFactor, DWORD& nBytesProcessed) const
+	{
+		deinterleave(reinterpret_cast<const float *>(srcContainer), dstChannels, nChannels, nFrames, 0.0f, 1.0f, fAttenuationFactor);
+		srcContainer += nFrames * nChannels * sizeof(float);
+		nBytesProcessed += nFrames * nChannels * sizeof(float);
+	}
+
+	void PutSamples(BYTE*& dstContainer, const T* const srcChannels[], const WORD nChannels, const DWORD nFrames,
+		DWORD& nBytesGenerated) const
+	{
+		interleave(srcChannels, reinterpret_cast<float *>(dstContainer), nChannels, nFrames);
+		dstContainer += nFrames * nChannels * sizeof(float);
+		nBytesGenerated += nFrames * nChannels * sizeof(float);
+	}
+
 	WORD nContainerSize() const
 	{
 		return sizeof(float);
@@ -113,7 +156,7 @@ struct ConvertSample_ieeedouble : public virtual ConvertSample<T>
 	{}
 
 	ConvertSample_ieeedouble(const typename NoiseShaper<T>::NoiseShapingType nNoiseShaper, const typename Ditherer<T>::DitherType nDither,
-		const WORD nChannels, const DWORD nSamplesPerSec)
+		const WORD nChannels, const DWORD nSamplesPerSec, const bool bVectorized, const unsigned int nSeed)
 	{}
 
 	void GetSample(T& dstSample, const BYTE* & srcContainer, const float fAttenuationFactor, DWORD& nBytesProcessed) const
@@ -131,6 +174,40 @@ struct ConvertSample_ieeedouble : public virtual ConvertSample<T>
 		nBytesGenerated += sizeof(double);
 	}
 
+	void GetSamples(T* const dstChannels[], const BYTE* & srcContainer, const WORD nChannels, const DWORD nFrames,
+		const float fAttenuationFactor, DWORD& nBytesProcessed) const
+	{
+#pragma loop count (8)
+		for (WORD nChannel = 0; nChannel < nChannels; ++nChannel)
+		{
+			const double* src = reinterpret_cast<const double *>(srcContainer) + nChannel;
+			T* dst = dstChannels[nChannel];
+			for (DWORD nFrame = 0; nFrame < nFrames; ++nFrame, src += nChannels)
+			{
+				dst[nFrame] = *src * fAttenuationFactor;
+			}
+		}
+		srcContainer += nFrames * nChannels * sizeof(double);
+		nBytesProcessed += nFrames * nChannels * sizeof(double);
+	}
+
+	void PutSamples(BYTE*& dstContainer, const T* const srcChannels[], const WORD nChannels, const DWORD nFrames,
+		DWORD& nBytesGenerated) const
+	{
+#pragma loop count (8)
+		for (WORD nChannel = 0; nChannel < nChannels; ++nChannel)
+		{
+			const T* src = srcChannels[nChannel];
+			double* dst = reinterpret_cast<double *>(dstContainer) + nChannel;
+			for (DWORD nFrame = 0; nFrame < nFrames; ++nFrame, dst += nChannels)
+			{
+				*dst = src[nFrame];
+			}
+		}
+		dstContainer += nFrames * nChannels * sizeof(double);
+		nBytesGenerated += nFrames * nChannels * sizeof(double);
+	}
+
 	WORD nContainerSize() const
 	{
 		return sizeof(double);
@@ -142,11 +219,13 @@ template <typename T>
 struct ConvertSample_pcm8 : public virtual ConvertSample<T>
 {
 
-	ConvertSample_pcm8() : dither_(new NoDither<T>()), noiseshape_(new NoNoiseShape<T,INT16,8>(1))
+	ConvertSample_pcm8() : dither_(new NoDither<T>()), noiseshape_(new NoNoiseShape<T,INT16,8>(1)), bShaped_(false),
+		shaped_(nShapedFrames)
 	{}
 
 	ConvertSample_pcm8(const typename NoiseShaper<T>::NoiseShapingType nNoiseShaper, const typename Ditherer<T>::DitherType nDither,
-		const WORD nChannels, const DWORD nSamplesPerSec)
+		const WORD nChannels, const DWORD nSamplesPerSec, const bool bVectorized, const unsigned int nSeed) :
+	bShaped_(nDither != Ditherer<T>::None || nNoiseShaper != NoiseShaper<T>::None), shaped_(nShapedFrames * nChannels)
 	{
 		switch(nDither)
 		{
@@ -157,59 +236,61 @@ struct ConvertSample_pcm8 : public virtual ConvertSample<T>
 			break;
 		case Ditherer<T>::Triangular:
 			{
-				if(nChannels == 2)
-				{
-					dither_.set_ptr(new StereoTriangularDither<T, 8>());
-				}
-				else
-				{
-					dither_.set_ptr(new TriangularDither<T, 8>(nChannels));
-				}
+				dither_.set_ptr(new TriangularDither<T, 8>(nChannels, nSeed));
 			}
 			break;
 		case Ditherer<T>::Rectangular:
 			{
-				dither_.set_ptr(new RectangularDither<T, 8>(nChannels));
+				dither_.set_ptr(new RectangularDither<T, 8>(nChannels, nSeed));
 			}
 			break;
 		default:
 			throw std::runtime_error("Invalid Dither for pcm8");
 		}
 
-		switch(nNoiseShaper)
+		if(bVectorized)
 		{
-		case NoiseShaper<T>::None:
-			{
-				noiseshape_.set_ptr(new NoNoiseShape<T,INT16,8>(nChannels));
-			}
-			break;
-		case NoiseShaper<T>::Simple:
-			{
-				noiseshape_.set_ptr(new SimpleNoiseShape<T,INT16,8>(nChannels));
-			}
-			break;
-		case NoiseShaper<T>::SecondOrder:
-			{
-				noiseshape_.set_ptr(new SecondOrderNoiseShape<T,INT16,8>(nChannels));
-			}
-			break;
-		case NoiseShaper<T>::ThirdOrder:
-			{
-				noiseshape_.set_ptr(new ThirdOrderNoiseShape<T,INT16,8>(nChannels));
-			}
-			break;
-		case NoiseShaper<T>::NinthOrder:
-			{
-				noiseshape_.set_ptr(new NinthOrderNoiseShape<T,INT16,8>(nChannels));
-			}
-			break;
-		case NoiseShaper<T>::SonySBM:
+			// Shape all the channels of a frame at once, where that gains anything
+			noiseshape_.set_ptr(makeVectorNoiseShape<T,INT16,8>(nNoiseShaper, nChannels));
+		}
+
+		if(noiseshape_.get_ptr() == NULL)
+		{
+			switch(nNoiseShaper)
 			{
-				noiseshape_.set_ptr(new SonySBM<T,INT16,8>(nChannels));
+			case NoiseShaper<T>::None:
+				{
+					noiseshape_.set_ptr(new NoNoiseShape<T,INT16,8>(nChannels));
+				}
+				break;
+			case NoiseShaper<T>::Simple:
+				{
+					noiseshape_.set_ptr(new SimpleNoiseShape<T,INT16,8>(nChannels));
+				}
+				break;
+			case NoiseShaper<T>::SecondOrder:
+				{
+					noiseshape_.set_ptr(new SecondOrderNoiseShape<T,INT16,8>(nChannels));
+				}
+				break;
+			case NoiseShaper<T>::ThirdOrder:
+				{
+					noiseshape_.set_ptr(new ThirdOrderNoiseShape<T,INT16,8>(nChannels));
+				}
+				break;
+			case NoiseShaper<T>::NinthOrder:
+				{
+					noiseshape_.set_ptr(new NinthOrderNoiseShape<T,INT16,8>(nChannels));
+				}
+				break;
+			case NoiseShaper<T>::SonySBM:
+				{
+					noiseshape_.set_ptr(new SonySBM<T,INT16,8>(nChannels));
+				}
+				break;
+			default:
+				throw std::runtime_error("Invalid NoiseShaper for pcm8");
 			}
-			break;
-		default:
-			throw std::runtime_error("Invalid NoiseShaper for pcm8");
 		}
 	}
 
@@ -232,6 +313,48 @@ struct ConvertSample_pcm8 : public virtual ConvertSample<T>
 		++nBytesGenerated;
 	}
 
+	void GetSamples(T* const dstChannels[], const BYTE* & srcContainer, const WORD nChannels, const DWORD nFrames,
+		const float fAttenuationFactor, DWORD& nBytesProcessed) const
+	{
+		const T Q = 1.0 / ((1 << (8-1)) - 0.5); // 1/127.5
+		deinterleave(srcContainer, dstChannels, nChannels, nFrames, T(-127.5), Q, fAttenuationFactor);
+		srcContainer += nFrames * nChannels;
+		nBytesProcessed += nFrames * nChannels;
+	}
+
+	// 8-bit output is rare enough not to be vectorized.  shaped_ is only sized for the channels of a shaping convertor
+	void PutSamples(BYTE*& dstContainer, const T* const srcChannels[], const WORD nChannels, const DWORD nFrames,
+		DWORD& nBytesGenerated) const
+	{
+		if (bShaped_)
+		{
+			assert(shaped_.size() >= nShapedFrames * nChannels);
+			for (DWORD nFrame = 0; nFrame < nFrames; nFrame += nShapedFrames)
+			{
+				const DWORD nChunk = std::min<DWORD>(nFrames - nFrame, nShapedFrames);
+				noiseshape_->shapeframes(&shaped_[0], srcChannels, nChannels, nFrame, nChunk, dither_.get_ptr());
+				for (DWORD nSample = 0; nSample < nChunk * nChannels; ++nSample)
+				{
+					*dstContainer++ = static_cast<BYTE>(shaped_[nSample] + 128);
+				}
+			}
+		}
+		else
+		{
+			// As NoNoiseShape
+			for (DWORD nFrame = 0; nFrame < nFrames; ++nFrame)
+			{
+				for (WORD nChannel = 0; nChannel < nChannels; ++nChannel)
+				{
+					const T srcSample = srcChannels[nChannel][nFrame];
+					*dstContainer++ = static_cast<BYTE>(Floor<INT16,T>((srcSample < T(-1.0) ? T(-1.0) :
+						(srcSample > T(1.0) ? T(1.0) : srcSample)) * T((1 << (8-2)) - 0.5 + (1 << (8-2)))) + 128);
+				}
+			}
+		}
+		nBytesGenerated += nFrames * nChannels;
+	}
+
 	WORD nContainerSize() const
 	{
 		return 1;
@@ -240,17 +363,21 @@ struct ConvertSample_pcm8 : public virtual ConvertSample<T>
 private:
 	Holder<Dither<T> > dither_;
 	Holder<NoiseShape<T, INT16> > noiseshape_;
+	const bool bShaped_;		// false => neither dithered nor noise shaped, so that blocks can be converted directly
+	enum { nShapedFrames = 64 };
+	mutable std::vector<INT16> shaped_;	// nShapedFrames frames, as shaped but not yet offset into BYTEs (if bShaped_)
 };
 
 // 16-bit sound is -32768..32767 with 0 == silence
 template <typename T>
 struct ConvertSample_pcm16 : public virtual ConvertSample<T>
 {
-	ConvertSample_pcm16() : dither_(new NoDither<T>()), noiseshape_(new NoNoiseShape<T,INT16,16>(1))
+	ConvertSample_pcm16() : dither_(new NoDither<T>()), noiseshape_(new NoNoiseShape<T,INT16,16>(1)), bShaped_(false)
 	{}
 
 	ConvertSample_pcm16(const typename NoiseShaper<T>::NoiseShapingType nNoiseShaper, const typename Ditherer<T>::DitherType nDither,
-		const WORD nChannels, const DWORD nSamplesPerSec)
+		const WORD nChannels, const DWORD nSamplesPerSec, const bool bVectorized, const unsigned int nSeed) :
+	bShaped_(nDither != Ditherer<T>::None || nNoiseShaper != NoiseShaper<T>::None)
 	{
 		switch(nDither)
 		{
@@ -261,59 +388,61 @@ struct ConvertSample_pcm16 : public virtual ConvertSample<T>
 			break;
 		case Ditherer<T>::Triangular:
 			{
-				if(nChannels == 2)
-				{
-					dither_.set_ptr(new StereoTriangularDither<T, 16>());
-				}
-				else
-				{
-					dither_.set_ptr(new TriangularDither<T, 16>(nChannels));
-				}
+				dither_.set_ptr(new TriangularDither<T, 16>(nChannels, nSeed));
 			}
 			break;
 		case Ditherer<T>::Rectangular:
 			{
-				dither_.set_ptr(new RectangularDither<T, 16>(nChannels));
+				dither_.set_ptr(new RectangularDither<T, 16>(nChannels, nSeed));
 			}
 			break;
 		default:
 			throw std::runtime_error("Invalid Dither for pcm16");
 		}
 
-		switch(nNoiseShaper)
+		if(bVectorized)
 		{
-		case NoiseShaper<T>::None:
-			{
-				noiseshape_.set_ptr(new NoNoiseShape<T,INT16,16>(nChannels));
-			}
-			break;
-		case NoiseShaper<T>::Simple:
-			{
-				noiseshape_.set_ptr(new SimpleNoiseShape<T,INT16,16>(nChannels));
-			}
-			break;
-		case NoiseShaper<T>::SecondOrder:
-			{
-				noiseshape_.set_ptr(new SecondOrderNoiseShape<T,INT16,16>(nChannels));
-			}
-			break;
-		case NoiseShaper<T>::ThirdOrder:
-			{
-				noiseshape_.set_ptr(new ThirdOrderNoiseShape<T,INT16,16>(nChannels));
-			}
-			break;
-		case NoiseShaper<T>::NinthOrder:
-			{
-				noiseshape_.set_ptr(new NinthOrderNoiseShape<T,INT16,16>(nChannels));
-			}
-			break;
-		case NoiseShaper<T>::SonySBM:
+			// Shape all the channels of a frame at once, where that gains anything
+			noiseshape_.set_ptr(makeVectorNoiseShape<T,INT16,16>(nNoiseShaper, nChannels));
+		}
+
+		if(noiseshape_.get_ptr() == NULL)
+		{
+			switch(nNoiseShaper)
 			{
-				noiseshape_.set_ptr(new SonySBM<T,INT16,16>(nChannels));
+			case NoiseShaper<T>::None:
+				{
+					noiseshape_.set_ptr(new NoNoiseShape<T,INT16,16>(nChannels));
+				}
+				break;
+			case NoiseShaper<T>::Simple:
+				{
+					noiseshape_.set_ptr(new SimpleNoiseShape<T,INT16,16>(nChannels));
+				}
+				break;
+			case NoiseShaper<T>::SecondOrder:
+				{
+					noiseshape_.set_ptr(new SecondOrderNoiseShape<T,INT16,16>(nChannels));
+				}
+				break;
+			case NoiseShaper<T>::ThirdOrder:
+				{
+					noiseshape_.set_ptr(new ThirdOrderNoiseShape<T,INT16,16>(nChannels));
+				}
+				break;
+			case NoiseShaper<T>::NinthOrder:
+				{
+					noiseshape_.set_ptr(new NinthOrderNoiseShape<T,INT16,16>(nChannels));
+				}
+				break;
+			case NoiseShaper<T>::SonySBM:
+				{
+					noiseshape_.set_ptr(new SonySBM<T,INT16,16>(nChannels));
+				}
+				break;
+			default:
+				throw std::runtime_error("Invalid NoiseShaper for pcm16");
 			}
-			break;
-		default:
-			throw std::runtime_error("Invalid NoiseShaper for pcm16");
 		}
 	}
 
@@ -335,6 +464,32 @@ struct ConvertSample_pcm16 : public virtual ConvertSample<T>
 		nBytesGenerated += 2;
 	}
 
+	void GetSamples(T* const dstChannels[], const BYTE* & srcContainer, const WORD nChannels, const DWORD nFrames,
+		const float fAttenuationFactor, DWORD& nBytesProcessed) const
+	{
+		const T Q = 2.0 / ((1 << 16) - 1.0); // 2/65535 
+		deinterleave(reinterpret_cast<const INT16*>(srcContainer), dstChannels, nChannels, nFrames, T(0.5), Q, fAttenuationFactor);
+		srcContainer += nFrames * nChannels * 2;
+		nBytesProcessed += nFrames * nChannels * 2;
+	}
+
+	void PutSamples(BYTE*& dstContainer, const T* const srcChannels[], const WORD nChannels, const DWORD nFrames,
+		DWORD& nBytesGenerated) const
+	{
+		INT16* dst = reinterpret_cast<INT16*>(dstContainer);
+		if (bShaped_)
+		{
+			noiseshape_->shapeframes(dst, srcChannels, nChannels, 0, nFrames, dither_.get_ptr());
+		}
+		else
+		{
+			// As NoNoiseShape
+			interleave_floor(srcChannels, dst, nChannels, nFrames, T((1 << (16-2)) - 0.5 + (1 << (16-2))));
+		}
+		dstContainer += nFrames * nChannels * 2;
+		nBytesGenerated += nFrames * nChannels * 2;
+	}
+
 	WORD nContainerSize() const
 	{
 		return 2;
@@ -343,17 +498,20 @@ struct ConvertSample_pcm16 : public virtual ConvertSample<T>
 private:
 	Holder<Dither<T> > dither_;
 	Holder<NoiseShape<T, INT16> > noiseshape_;
+	const bool bShaped_;		// false => neither dithered nor noise shaped, so that blocks can be converted directly
 };
 
 // 24-bit sound
 template <typename T, int validBits>
 struct ConvertSample_pcm24 : public virtual ConvertSample<T>
 {
-	ConvertSample_pcm24() : dither_(new NoDither<T>()), noiseshape_(new NoNoiseShape<T,INT32,validBits>(1))
+	ConvertSample_pcm24() : dither_(new NoDither<T>()), noiseshape_(new NoNoiseShape<T,INT32,validBits>(1)), bShaped_(false),
+		shaped_(nShapedFrames)
 	{}
 
 	ConvertSample_pcm24(const typename NoiseShaper<T>::NoiseShapingType nNoiseShaper, const typename Ditherer<T>::DitherType nDither,
-		const WORD nChannels, const DWORD nSamplesPerSec)
+		const WORD nChannels, const DWORD nSamplesPerSec, const bool bVectorized, const unsigned int nSeed) :
+	bShaped_(nDither != Ditherer<T>::None || nNoiseShaper != NoiseShaper<T>::None), shaped_(nShapedFrames * nChannels)
 	{
 		switch(nDither)
 		{
@@ -364,66 +522,68 @@ struct ConvertSample_pcm24 : public virtual ConvertSample<T>
 			break;
 		case Ditherer<T>::Triangular:
 			{
-				if(nChannels == 2)
-				{
-					dither_.set_ptr(new StereoTriangularDither<T, validBits>());
-				}
-				else
-				{
-					dither_.set_ptr(new TriangularDither<T, validBits>(nChannels));
-				}
+				dither_.set_ptr(new TriangularDither<T, validBits>(nChannels, nSeed));
 			}
 			break;
 		case Ditherer<T>::Rectangular:
 			{
-				dither_.set_ptr(new RectangularDither<T, validBits>(nChannels));
+				dither_.set_ptr(new RectangularDither<T, validBits>(nChannels, nSeed));
 			}
 			break;
 		default:
 			throw std::runtime_error("Invalid Dither for pcm24");
 		}
 
-		switch(nNoiseShaper)
+		if(bVectorized)
 		{
-		case NoiseShaper<T>::None:
-			{
-				noiseshape_.set_ptr(new NoNoiseShape<T,INT32,validBits>(nChannels));
-			}
-			break;
-		case NoiseShaper<T>::Simple:
-			{
-				noiseshape_.set_ptr(new SimpleNoiseShape<T,INT32,validBits>(nChannels));
-			}
-			break;
-		case NoiseShaper<T>::SecondOrder:
-			{
-				noiseshape_.set_ptr(new SecondOrderNoiseShape<T,INT32,validBits>(nChannels));
-			}
-			break;
-		case NoiseShaper<T>::ThirdOrder:
-			{
-				noiseshape_.set_ptr(new ThirdOrderNoiseShape<T,INT32,validBits>(nChannels));
-			}
-			break;
-		case NoiseShaper<T>::NinthOrder:
-			{
-				noiseshape_.set_ptr(new NinthOrderNoiseShape<T,INT32,validBits>(nChannels));
-			}
-			break;
-		case NoiseShaper<T>::SonySBM:
+			// Shape all the channels of a frame at once, where that gains anything
+			noiseshape_.set_ptr(makeVectorNoiseShape<T,INT32,validBits>(nNoiseShaper, nChannels));
+		}
+
+		if(noiseshape_.get_ptr() == NULL)
+		{
+			switch(nNoiseShaper)
 			{
-				noiseshape_.set_ptr(new SonySBM<T,INT32,validBits>(nChannels));
+			case NoiseShaper<T>::None:
+				{
+					noiseshape_.set_ptr(new NoNoiseShape<T,INT32,validBits>(nChannels));
+				}
+				break;
+			case NoiseShaper<T>::Simple:
+				{
+					noiseshape_.set_ptr(new SimpleNoiseShape<T,INT32,validBits>(nChannels));
+				}
+				break;
+			case NoiseShaper<T>::SecondOrder:
+				{
+					noiseshape_.set_ptr(new SecondOrderNoiseShape<T,INT32,validBits>(nChannels));
+				}
+				break;
+			case NoiseShaper<T>::ThirdOrder:
+				{
+					noiseshape_.set_ptr(new ThirdOrderNoiseShape<T,INT32,validBits>(nChannels));
+				}
+				break;
+			case NoiseShaper<T>::NinthOrder:
+				{
+					noiseshape_.set_ptr(new NinthOrderNoiseShape<T,INT32,validBits>(nChannels));
+				}
+				break;
+			case NoiseShaper<T>::SonySBM:
+				{
+					noiseshape_.set_ptr(new SonySBM<T,INT32,validBits>(nChannels));
+				}
+				break;
+			default:
+				throw std::runtime_error("Invalid NoiseShaper for pcm24");
 			}
-			break;
-		default:
-			throw std::runtime_error("Invalid NoiseShaper for pcm24");
 		}
 	}
 
-	void GetSample(T& dstSample, const BYTE* & srcContainer, const float fAttenuationFactor, DWORD& nBytesProcessed) const
+	// The sample in the container, in units of the valid bits
+	static INT32 unpack(const BYTE* srcContainer)
 	{
-
-		INT32 i = srcContainer[2];
+		INT32 i = static_cast<signed char>(srcContainer[2]);	// sign extend
 		i = ( i << 8 ) | srcContainer[1];
 
 		switch (validBits)
@@ -432,20 +592,46 @@ struct ConvertSample_pcm24 : public virtual ConvertSample<T>
 			break;
 		case 20:
 			i = (i << 4) | (srcContainer[0] >> 4);
+			break;
 		case 24:
 			i = (i << 8) | srcContainer[0];
+			break;
 		default:
 			assert(false);
 		};
 
+		return i;
+	}
+
+	void GetSample(T& dstSample, const BYTE* & srcContainer, const float fAttenuationFactor, DWORD& nBytesProcessed) const
+	{
 		const T Q = 2.0 / ((1 << validBits) - 1);
 
-		dstSample =  (i + T(0.5)) * Q * fAttenuationFactor;
+		dstSample =  (unpack(srcContainer) + T(0.5)) * Q * fAttenuationFactor;
 
 		srcContainer += 3;
 		nBytesProcessed += 3;
 	}
 
+	// 3-byte containers do not suit SIMD, but converting a channel at a time still avoids the virtual calls
+	void GetSamples(T* const dstChannels[], const BYTE* & srcContainer, const WORD nChannels, const DWORD nFrames,
+		const float fAttenuationFactor, DWORD& nBytesProcessed) const
+	{
+		const T Q = 2.0 / ((1 << validBits) - 1);
+#pragma loop count (8)
+		for (WORD nChannel = 0; nChannel < nChannels; ++nChannel)
+		{
+			const BYTE* src = srcContainer + 3 * nChannel;
+			T* dst = dstChannels[nChannel];
+			for (DWORD nFrame = 0; nFrame < nFrames; ++nFrame, src += 3 * nChannels)
+			{
+				dst[nFrame] = (unpack(src) + T(0.5)) * Q * fAttenuationFactor;
+			}
+		}
+		srcContainer += nFrames * nChannels * 3;
+		nBytesProcessed += nFrames * nChannels * 3;
+	}
+
 	void PutSample(BYTE*& dstContainer, T srcSample, const WORD nChannel, DWORD& nBytesGenerated) const 
 	{   
 		// Clip if exceeded full scale.
@@ -460,6 +646,48 @@ struct ConvertSample_pcm24 : public virtual ConvertSample<T>
 		nBytesGenerated += 3;
 	}
 
+	void PutSamples(BYTE*& dstContainer, const T* const srcChannels[], const WORD nChannels, const DWORD nFrames,
+		DWORD& nBytesGenerated) const
+	{
+		if (bShaped_)
+		{
+			BYTE* dst = dstContainer;
+			for (DWORD nFrame = 0; nFrame < nFrames; nFrame += nShapedFrames)
+			{
+				const DWORD nChunk = std::min<DWORD>(nFrames - nFrame, nShapedFrames);
+				noiseshape_->shapeframes(&shaped_[0], srcChannels, nChannels, nFrame, nChunk, dither_.get_ptr());
+				for (DWORD nSample = 0; nSample < nChunk * nChannels; ++nSample, dst += 3)
+				{
+					const INT32 i = shaped_[nSample];
+					dst[0] = static_cast<BYTE>(i & 0xff);
+					dst[1] = static_cast<BYTE>((i >>  8) & 0xff);
+					dst[2] = static_cast<BYTE>((i >> 16) & 0xff);
+				}
+			}
+		}
+		else
+		{
+			// As NoNoiseShape
+			const T q = (1 << (validBits-2)) - 0.5 + (1 << (validBits-2));
+#pragma loop count (8)
+			for (WORD nChannel = 0; nChannel < nChannels; ++nChannel)
+			{
+				const T* src = srcChannels[nChannel];
+				BYTE* dst = dstContainer + 3 * nChannel;
+				for (DWORD nFrame = 0; nFrame < nFrames; ++nFrame, dst += 3 * nChannels)
+				{
+					const T srcSample = src[nFrame];
+					const INT32 i = Floor<INT32,T>((srcSample < T(-1.0) ? T(-1.0) : (srcSample > T(1.0) ? T(1.0) : srcSample)) * q);
+					dst[0] = static_cast<BYTE>(i & 0xff);
+					dst[1] = static_cast<BYTE>((i >>  8) & 0xff);
+					dst[2] = static_cast<BYTE>((i >> 16) & 0xff);
+				}
+			}
+		}
+		dstContainer += nFrames * nChannels * 3;
+		nBytesGenerated += nFrames * nChannels * 3;
+	}
+
 	WORD nContainerSize() const
 	{
 		return 3;
@@ -468,17 +696,21 @@ struct ConvertSample_pcm24 : public virtual ConvertSample<T>
 private:
 	Holder<Dither<T> > dither_;
 	Holder<NoiseShape<T, INT32> > noiseshape_;
+	const bool bShaped_;		// false => neither dithered nor noise shaped, so that blocks can be converted directly
+	enum { nShapedFrames = 64 };
+	mutable std::vector<INT32> shaped_;	// nShapedFrames frames, as shaped but not yet packed into 3 bytes
 };
 
 // 32-bit sound
 template <typename T, int validBits = 32>
 struct ConvertSample_pcm32 : public virtual ConvertSample<T>
 {
-	ConvertSample_pcm32() : dither_(new NoDither<T>()), noiseshape_(new NoNoiseShape<T,INT32,validBits>(1))
+	ConvertSample_pcm32() : dither_(new NoDither<T>()), noiseshape_(new NoNoiseShape<T,INT32,validBits>(1)), bShaped_(false)
 	{}
 
 	ConvertSample_pcm32(const typename NoiseShaper<T>::NoiseShapingType nNoiseShaper, const typename Ditherer<T>::DitherType nDither,
-		const WORD nChannels, const DWORD nSamplesPerSec)
+		const WORD nChannels, const DWORD nSamplesPerSec, const bool bVectorized, const unsigned int nSeed) :
+	bShaped_(nDither != Ditherer<T>::None || nNoiseShaper != NoiseShaper<T>::None)
 	{
 		switch(nDither)
 		{
@@ -489,59 +721,61 @@ struct ConvertSample_pcm32 : public virtual ConvertSample<T>
 			break;
 		case Ditherer<T>::Triangular:
 			{
-				if(nChannels == 2)
-				{
-					dither_.set_ptr(new StereoTriangularDither<T, validBits>());
-				}
-				else
-				{
-					dither_.set_ptr(new TriangularDither<T, validBits>(nChannels));
-				}
+				dither_.set_ptr(new TriangularDither<T, validBits>(nChannels, nSeed));
 			}
 			break;
 		case Ditherer<T>::Rectangular:
 			{
-				dither_.set_ptr(new RectangularDither<T, validBits>(nChannels));
+				dither_.set_ptr(new RectangularDither<T, validBits>(nChannels, nSeed));
 			}
 			break;
 		default:
 			throw std::runtime_error("Invalid Dither for pcm32");
 		}
 
-		switch(nNoiseShaper)
+		if(bVectorized)
 		{
-		case NoiseShaper<T>::None:
-			{
-				noiseshape_.set_ptr(new NoNoiseShape<T,INT32,validBits>(nChannels));
-			}
-			break;
-		case NoiseShaper<T>::Simple:
-			{
-				noiseshape_.set_ptr(new SimpleNoiseShape<T,INT32,validBits>(nChannels));
-			}
-			break;
-		case NoiseShaper<T>::SecondOrder:
-			{
-				noiseshape_.set_ptr(new SecondOrderNoiseShape<T,INT32,validBits>(nChannels));
-			}
-			break;
-		case NoiseShaper<T>::ThirdOrder:
-			{
-				noiseshape_.set_ptr(new ThirdOrderNoiseShape<T,INT32,validBits>(nChannels));
-			}
-			break;
-		case NoiseShaper<T>::NinthOrder:
-			{
-				noiseshape_.set_ptr(new NinthOrderNoiseShape<T,INT32,validBits>(nChannels));
-			}
-			break;
-		case NoiseShaper<T>::SonySBM:
+			// Shape all the channels of a frame at once, where that gains anything
+			noiseshape_.set_ptr(makeVectorNoiseShape<T,INT32,validBits>(nNoiseShaper, nChannels));
+		}
+
+		if(noiseshape_.get_ptr() == NULL)
+		{
+			switch(nNoiseShaper)
 			{
-				noiseshape_.set_ptr(new SonySBM<T,INT32,validBits>(nChannels));
+			case NoiseShaper<T>::None:
+				{
+					noiseshape_.set_ptr(new NoNoiseShape<T,INT32,validBits>(nChannels));
+				}
+				break;
+			case NoiseShaper<T>::Simple:
+				{
+					noiseshape_.set_ptr(new SimpleNoiseShape<T,INT32,validBits>(nChannels));
+				}
+				break;
+			case NoiseShaper<T>::SecondOrder:
+				{
+					noiseshape_.set_ptr(new SecondOrderNoiseShape<T,INT32,validBits>(nChannels));
+				}
+				break;
+			case NoiseShaper<T>::ThirdOrder:
+				{
+					noiseshape_.set_ptr(new ThirdOrderNoiseShape<T,INT32,validBits>(nChannels));
+				}
+				break;
+			case NoiseShaper<T>::NinthOrder:
+				{
+					noiseshape_.set_ptr(new NinthOrderNoiseShape<T,INT32,validBits>(nChannels));
+				}
+				break;
+			case NoiseShaper<T>::SonySBM:
+				{
+					noiseshape_.set_ptr(new SonySBM<T,INT32,validBits>(nChannels));
+				}
+				break;
+			default:
+				throw std::runtime_error("Invalid NoiseShaper for pcm32");
 			}
-			break;
-		default:
-			throw std::runtime_error("Invalid NoiseShaper for pcm32");
 		}
 	}
 
@@ -565,6 +799,32 @@ struct ConvertSample_pcm32 : public virtual ConvertSample<T>
 		nBytesGenerated += 4;
 	}
 
+	void GetSamples(T* const dstChannels[], const BYTE* & srcContainer, const WORD nChannels, const DWORD nFrames,
+		const float fAttenuationFactor, DWORD& nBytesProcessed) const
+	{
+		const T Q = 1.0 / ( (1 << (validBits-2)) - 0.5 + (1 << (validBits-2)) );
+		deinterleave(reinterpret_cast<const INT32*>(srcContainer), dstChannels, nChannels, nFrames, T(0.5), Q, fAttenuationFactor);
+		srcContainer += nFrames * nChannels * 4;
+		nBytesProcessed += nFrames * nChannels * 4;
+	}
+
+	void PutSamples(BYTE*& dstContainer, const T* const srcChannels[], const WORD nChannels, const DWORD nFrames,
+		DWORD& nBytesGenerated) const
+	{
+		INT32* dst = reinterpret_cast<INT32*>(dstContainer);
+		if (bShaped_)
+		{
+			noiseshape_->shapeframes(dst, srcChannels, nChannels, 0, nFrames, dither_.get_ptr());
+		}
+		else
+		{
+			// As NoNoiseShape
+			interleave_floor(srcChannels, dst, nChannels, nFrames, T((1 << (validBits-2)) - 0.5 + (1 << (validBits-2))));
+		}
+		dstContainer += nFrames * nChannels * 4;
+		nBytesGenerated += nFrames * nChannels * 4;
+	}
+
 	WORD nContainerSize() const
 	{
 		return 4;
@@ -573,6 +833,7 @@ struct ConvertSample_pcm32 : public virtual ConvertSample<T>
 private:
 	Holder<Dither<T> > dither_;
 	Holder<NoiseShape<T, INT32> > noiseshape_;
+	const bool bShaped_;		// false => neither dithered nor noise shaped, so that blocks can be converted directly
 };
 
 // 32-bit sound. No dithering or shaping
@@ -583,7 +844,7 @@ struct ConvertSample_pcm32<T,32> : public virtual ConvertSample<T>
 	{}
 
 	ConvertSample_pcm32(const typename NoiseShaper<T>::NoiseShapingType nNoiseShaper, const typename Ditherer<T>::DitherType nDither,
-		const WORD nChannels, const DWORD nSamplesPerSec)
+		const WORD nChannels, const DWORD nSamplesPerSec, const bool bVectorized, const unsigned int nSeed)
 	{}
 
 	void GetSample(T& dstSample, const BYTE* & srcContainer, const float fAttenuationFactor, DWORD& nBytesProcessed) const
@@ -608,6 +869,24 @@ struct ConvertSample_pcm32<T,32> : public virtual ConvertSample<T>
 		nBytesGenerated += 4;
 	}
 
+	void GetSamples(T* const dstChannels[], const BYTE* & srcContainer, const WORD nChannels, const DWORD nFrames,
+		const float fAttenuationFactor, DWORD& nBytesProcessed) const
+	{
+		const T Q = 1.0 / ( (1 << (32-2)) - 0.5 + (1 << (32-2)) );
+		deinterleave(reinterpret_cast<const INT32*>(srcContainer), dstChannels, nChannels, nFrames, T(0.5), Q, fAttenuationFactor);
+		srcContainer += nFrames * nChannels * 4;
+		nBytesProcessed += nFrames * nChannels * 4;
+	}
+
+	void PutSamples(BYTE*& dstContainer, const T* const srcChannels[], const WORD nChannels, const DWORD nFrames,
+		DWORD& nBytesGenerated) const
+	{
+		const T q = ( (1 << (32-2)) - 0.5 + (1 << (32-2)) ); // (2^31 - 0.5)
+		interleave_floor(srcChannels, reinterpret_cast<INT32*>(dstContainer), nChannels, nFrames, q);
+		dstContainer += nFrames * nChannels * 4;
+		nBytesGenerated += nFrames * nChannels * 4;
+	}
+
 	WORD nContainerSize() const
 	{
 		return 4;
@@ -640,7 +919,7 @@ class ConvertSampleMaker
 {
 private:
 	typedef typename ObjectFactory<ConvertSample<T> *(typename NoiseShaper<T>::NoiseShapingType, typename Ditherer<T>::DitherType,
-		WORD, DWORD), SampleFormatId> FactoryType;
+		WORD, DWORD, bool, unsigned int), SampleFormatId> FactoryType;
 
 public:
 	ConvertSampleMaker()
@@ -720,10 +999,13 @@ public:
 		}
 	}
 
-	// Same as CheckSampleFormat, but sets sample_convertor
+	// Same as CheckSampleFormat, but sets sample_convertor.  bVectorized shapes all the channels of a frame at once,
+	// with VectorNoiseShape, where SSE2 is available; the output is the same either way.  nSeed seeds the ditherer;
+	// 0 => from the clock.  Fix it to make dithered output repeatable
 	HRESULT SelectSampleConvertor(const WAVEFORMATEX* pWave, Holder<ConvertSample<T> > & sample_convertor, 
 		typename NoiseShaper<T>::NoiseShapingType nNoiseShaper = NoiseShaper<T>::None,
-		typename Ditherer<T>::DitherType nDither = Ditherer<T>::None) const
+		typename Ditherer<T>::DitherType nDither = Ditherer<T>::None, const bool bVectorized = true,
+		const unsigned int nSeed = 0) const
 	{
 		if(pWave == NULL)
 		{
@@ -750,7 +1032,7 @@ public:
 
 			sample_convertor.set_ptr(sample_factory_.Create(SampleFormatId(pWaveXT->SubFormat, WAVE_FORMAT_EXTENSIBLE,
 				pWaveXT->Format.wBitsPerSample, pWaveXT->Samples.wValidBitsPerSample), nNoiseShaper, nDither,
-				pWaveXT->Format.nChannels, pWaveXT->Format.nSamplesPerSec));
+				pWaveXT->Format.nChannels, pWaveXT->Format.nSamplesPerSec, bVectorized, nSeed));
 
 			return sample_convertor.get_ptr() == NULL ? DMO_E_TYPE_NOT_ACCEPTED : S_OK;
 
@@ -767,7 +1049,7 @@ public:
 			sample_convertor.set_ptr(sample_factory_.Create(SampleFormatId(pWave->wFormatTag == WAVE_FORMAT_PCM 
 				? KSDATAFORMAT_SUBTYPE_PCM : KSDATAFORMAT_SUBTYPE_IEEE_FLOAT,
 				pWave->wFormatTag, pWave->wBitsPerSample, pWave->wBitsPerSample), nNoiseShaper, nDither,
-				pWave->nChannels, pWave->nSamplesPerSec));
+				pWave->nChannels, pWave->nSamplesPerSec, bVectorized, nSeed));
 
 			return sample_convertor.get_ptr() == NULL ? DMO_E_TYPE_NOT_ACCEPTED : S_OK;
 		}
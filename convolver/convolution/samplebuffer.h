@@ -247,8 +247,8 @@ struct FastArray : AlignedArray<T>
 	//	std::swap_ranges(begin(),end(),y.begin());
 	//}
 
-	// Helper for =
-	void swap(reference x)
+	// Helper for =.  Also the way to size an array after construction
+	void swap(FastArray<T>& x)
 	{
 		std::swap(first_, x.first_);
 		std::swap(size_, x.size_);
@@ -271,12 +271,8 @@ struct FastArray : AlignedArray<T>
 	// arrays will be assigned correctly
 	FastArray<T>& operator=(const FastArray<T>& other)
 	{
-#ifdef FFTW
-		// Don't demand equality as arrays for FFTW are a bit longer to hold complex transforms
+		// Don't demand equality as arrays for the FFTs are a bit longer to hold complex transforms
 		assert(size() == other.size() || size() == 2*(other.size()/2+1));
-#else
-		assert(size_ == other.size_);
-#endif
 		//if (this != &other)
 		//{
 		//	FastArray<T> temp(other);
@@ -304,11 +300,7 @@ struct FastArray : AlignedArray<T>
 	template <typename T2>
 	FastArray<T>& operator= (const FastArray<T2>& rhs)
 	{
-#ifdef FFTW
 		assert(size() == rhs.size() || size() == 2*(rhs.size()/2+1));
-#else
-		assert(size() == rhs.size());
-#endif
 		std::uninitialized_copy(rhs.begin(), rhs.end(), begin());
 		return *this;
 	}
@@ -378,11 +370,7 @@ struct FastArray : AlignedArray<T>
 	template <typename T2>
 		FastArray<T>& operator+= (const FastArray<T2>& rhs)
 	{
-#ifdef FFTW
 		assert(size() == rhs.size() || size() == 2*(rhs.size()/2+1));
-#else
-		assert(size() == rhs.size());
-#endif
 		// Optimization
 //		const size_type rhs_size = rhs.size();
 //#pragma loop count(65536)
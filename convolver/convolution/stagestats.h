@@ -0,0 +1,280 @@
+#pragma once
+// Convolver: DSP plug-in for Windows Media Player that convolves an impulse respose
+// filter it with the input stream.
+//
+// Copyright (C) 2005  John Pavel
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//
+/////////////////////////////////////////////////////////////////////////////
+//
+// stagestats.h : Per-stage cycle counters for the convolution engine
+//
+// Define CONVOLUTION_STATS to compile them in.  Otherwise STATS(x) expands to
+// nothing, and the engine is unchanged.
+//
+/////////////////////////////////////////////////////////////////////////////
+
+#include "convolution\config.h"
+
+#ifdef CONVOLUTION_STATS
+#define STATS(x) x
+#else
+#define STATS(x)
+#endif
+
+#ifdef CONVOLUTION_STATS
+
+#include <string>
+#include <sstream>
+#include <vector>
+#include <iomanip>
+
+#if defined(_MSC_VER) && _MSC_VER >= 1400
+#include <intrin.h>
+#pragma intrinsic(__rdtsc)
+#endif
+
+// The processor's time stamp counter
+inline ULONGLONG readTSC()
+{
+#if defined(_MSC_VER) && _MSC_VER >= 1400
+	return __rdtsc();
+#else
+	ULARGE_INTEGER tsc;
+	__asm
+	{
+		rdtsc
+		mov tsc.LowPart, eax
+		mov tsc.HighPart, edx
+	}
+	return tsc.QuadPart;
+#endif
+}
+
+// The cycles spent in one stage: a total, a maximum and a histogram with power of 2 buckets
+struct StageCounter
+{
+	static const DWORD nBuckets = 32;	// Bucket b counts events of 2^b to 2^(b+1)-1 cycles; the last takes the rest
+
+	ULONGLONG	nCycles;
+	ULONGLONG	nMaxCycles;
+	DWORD		nEvents;
+	DWORD		Histogram[nBuckets];
+
+	StageCounter()
+	{
+		reset();
+	}
+
+	void reset()
+	{
+		nCycles = 0;
+		nMaxCycles = 0;
+		nEvents = 0;
+		::ZeroMemory(Histogram, sizeof(Histogram));
+	}
+
+	void add(const ULONGLONG nEventCycles)
+	{
+		nCycles += nEventCycles;
+		if (nEventCycles > nMaxCycles)
+		{
+			nMaxCycles = nEventCycles;
+		}
+		++nEvents;
+
+		DWORD nBucket = 0;
+		for (ULONGLONG n = nEventCycles >> 1; n != 0 && nBucket < nBuckets - 1; n >>= 1)
+		{
+			++nBucket;
+		}
+		++Histogram[nBucket];
+	}
+
+	void add(const StageCounter& other)
+	{
+		nCycles += other.nCycles;
+		if (other.nMaxCycles > nMaxCycles)
+		{
+			nMaxCycles = other.nMaxCycles;
+		}
+		nEvents += other.nEvents;
+		for (DWORD nBucket = 0; nBucket < nBuckets; ++nBucket)
+		{
+			Histogram[nBucket] += other.Histogram[nBucket];
+		}
+	}
+
+	double fMeanCycles() const
+	{
+		return nEvents == 0 ? 0 : static_cast<double>(static_cast<LONGLONG>(nCycles)) / nEvents;
+	}
+};
+
+// Counters for each stage of each filter path, for the stages that serve all the paths at once (the mixing
+// matrices and the batched transforms), and for each call of the engine.  Each stage is timed with one read of
+// the time stamp counter: lap charges the cycles since the previous read to a stage, and returns the time now,
+// for the next stage to start from.
+class ConvolutionStats
+{
+public:
+	enum Stage {MixInput, ForwardFFT, MultiplyAdd, InverseFFT, MixOutput, nStages};
+
+	static const char* StageName(const Stage stage)
+	{
+		static const char* const Names[nStages] = {"mix_input", "forward_fft", "multiply_add", "inverse_fft", "mix_output"};
+		return Names[stage];
+	}
+
+	explicit ConvolutionStats(const DWORD nPaths) : Engine_(nStages), Paths_(nPaths * nStages)
+	{}
+
+	void reset()
+	{
+		Calls_.reset();
+		Convert_.reset();
+		for (std::vector<StageCounter>::size_type i = 0; i < Engine_.size(); ++i)
+		{
+			Engine_[i].reset();
+		}
+		for (std::vector<StageCounter>::size_type i = 0; i < Paths_.size(); ++i)
+		{
+			Paths_[i].reset();
+		}
+	}
+
+	ULONGLONG lap(const Stage stage, const DWORD nPath, const ULONGLONG nStart)
+	{
+		const ULONGLONG nNow = readTSC();
+		Paths_[nPath * nStages + stage].add(nNow - nStart);
+		return nNow;
+	}
+
+	// A stage done once for all the paths
+	ULONGLONG lap(const Stage stage, const ULONGLONG nStart)
+	{
+		const ULONGLONG nNow = readTSC();
+		Engine_[stage].add(nNow - nStart);
+		return nNow;
+	}
+
+	// A whole call took nCallCycles, of which nFilterCycles were spent in the filter paths.  The rest is
+	// sample conversion, delays and bookkeeping
+	void call(const ULONGLONG nCallCycles, const ULONGLONG nFilterCycles)
+	{
+		Calls_.add(nCallCycles);
+		Convert_.add(nCallCycles - nFilterCycles);
+	}
+
+	DWORD nPaths() const
+	{
+		return static_cast<DWORD>(Paths_.size() / nStages);
+	}
+
+	const StageCounter& Calls() const
+	{
+		return Calls_;
+	}
+
+	const StageCounter& Convert() const
+	{
+		return Convert_;
+	}
+
+	const StageCounter& EngineStage(const Stage stage) const
+	{
+		return Engine_[stage];
+	}
+
+	const StageCounter& PathStage(const DWORD nPath, const Stage stage) const
+	{
+		return Paths_[nPath * nStages + stage];
+	}
+
+	// The stage done once for all the paths, plus the stage summed over all the filter paths
+	StageCounter TotalStage(const Stage stage) const
+	{
+		StageCounter total(EngineStage(stage));
+		for (DWORD nPath = 0; nPath < nPaths(); ++nPath)
+		{
+			total.add(PathStage(nPath, stage));
+		}
+		return total;
+	}
+
+	const std::string DisplayStats() const
+	{
+		std::ostringstream s;
+		const double fCallCycles = static_cast<double>(static_cast<LONGLONG>(Calls_.nCycles));
+
+		s << "stage                events       cycles     mean        max  share" << std::endl;
+		displayCounter(s, "call", Calls_, fCallCycles);
+		displayCounter(s, "convert", Convert_, fCallCycles);
+		for (int stage = 0; stage < nStages; ++stage)
+		{
+			displayCounter(s, StageName(static_cast<Stage>(stage)), TotalStage(static_cast<Stage>(stage)), fCallCycles);
+		}
+
+		if (nPaths() > 1)
+		{
+			for (DWORD nPath = 0; nPath < nPaths(); ++nPath)
+			{
+				for (int stage = 0; stage < nStages; ++stage)
+				{
+					if (PathStage(nPath, static_cast<Stage>(stage)).nEvents == 0)
+					{
+						continue;	// done once for all the paths
+					}
+					std::ostringstream name;
+					name << "path" << nPath << "." << StageName(static_cast<Stage>(stage));
+					displayCounter(s, name.str(), PathStage(nPath, static_cast<Stage>(stage)), fCallCycles);
+				}
+			}
+		}
+
+		s << "call histogram (cycles: calls)" << std::endl;
+		for (DWORD nBucket = 0; nBucket < StageCounter::nBuckets; ++nBucket)
+		{
+			if (Calls_.Histogram[nBucket] != 0)
+			{
+				s << "  >= 2^" << nBucket << ": " << Calls_.Histogram[nBucket] << std::endl;
+			}
+		}
+
+		return s.str();
+	}
+
+private:
+	static void displayCounter(std::ostream& s, const std::string& name, const StageCounter& counter,
+		const double fCallCycles)
+	{
+		s << std::left << std::setw(20) << name << std::right
+			<< std::setw(7) << counter.nEvents
+			<< std::setw(13) << counter.nCycles
+			<< std::setw(9) << static_cast<ULONGLONG>(counter.fMeanCycles())
+			<< std::setw(11) << counter.nMaxCycles
+			<< std::setw(6) << std::fixed << std::setprecision(1)
+			<< (fCallCycles > 0 ? 100 * static_cast<double>(static_cast<LONGLONG>(counter.nCycles)) / fCallCycles : 0)
+			<< "%" << std::endl;
+	}
+
+	StageCounter				Calls_;
+	StageCounter				Convert_;
+	std::vector<StageCounter>	Engine_;	// nStages counters for the stages done once for all the paths
+	std::vector<StageCounter>	Paths_;		// nStages counters for each path
+};
+
+#endif
@@ -118,6 +118,28 @@ public:
 		return sf_readf_float(sndfile_, ptr, frames);
 	};
 
+	// Read frames of nChannels samples until there are as many as asked for, or the file ends.  A read from a pipe
+	// or a network share can return fewer frames than were asked for, short of the end of the file, so only a read
+	// of nothing ends it.  If it returns short, check error()
+	sf_count_t fillf_float(float *ptr, sf_count_t frames, const int nChannels) const
+	{
+		sf_count_t nFramesRead = 0;
+		while (nFramesRead < frames)
+		{
+			const sf_count_t nRead = sf_readf_float(sndfile_, ptr + nFramesRead * nChannels, frames - nFramesRead);
+			if (nRead <= 0)
+				break;
+			nFramesRead += nRead;
+		}
+		return nFramesRead;
+	};
+
+	// SF_ERR_NO_ERROR, unless the last operation failed (rather than, say, reading nothing at the end of the file)
+	int error() const
+	{
+		return sf_error(sndfile_);
+	};
+
 	sf_count_t  write_float(float *ptr, sf_count_t items) const
 	{
 		return sf_write_float(sndfile_, ptr, items);
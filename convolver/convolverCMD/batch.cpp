@@ -0,0 +1,203 @@
+// Convolver: DSP plug-in for Windows Media Player that convolves an impulse respose
+// filter it with the input stream.
+//
+// Copyright (C) 2005  John Pavel
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//
+//
+/////////////////////////////////////////////////////////////////////////////
+//
+// batch.cpp : Render many sound files through one set of filter paths
+//
+
+#include "stdafx.h"
+#include "batch.h"
+#include "render.h"
+#include "convolution\wavefile.h"
+#include "debugging\fasttiming.h"
+#include <windows.h>
+#include <process.h>
+#include <fstream>
+
+void listBatchJobs(const TCHAR szInput[MAX_PATH], const TCHAR szOutputDirectory[MAX_PATH], std::vector<BatchJob>& jobs)
+{
+	const std::basic_string< _TCHAR > input(szInput);
+	std::basic_string< _TCHAR > outputDirectory(szOutputDirectory);
+	if (!outputDirectory.empty() && outputDirectory[outputDirectory.length() - 1] != TEXT('\\'))
+		outputDirectory += TEXT('\\');
+
+	const DWORD dwInputAttributes = ::GetFileAttributes(szInput);
+	if (dwInputAttributes == INVALID_FILE_ATTRIBUTES)
+		throw wavfileException("Batch input not found", szInput, "");
+
+	if (dwInputAttributes & FILE_ATTRIBUTE_DIRECTORY)
+	{
+		std::basic_string< _TCHAR > inputDirectory(input);
+		if (inputDirectory[inputDirectory.length() - 1] != TEXT('\\'))
+			inputDirectory += TEXT('\\');
+
+		WIN32_FIND_DATA fd;
+		HANDLE hFind = ::FindFirstFile((inputDirectory + TEXT("*")).c_str(), &fd);
+		if (hFind != INVALID_HANDLE_VALUE)
+		{
+			do
+			{
+				if ((fd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) == 0)
+					jobs.push_back(BatchJob(inputDirectory + fd.cFileName, outputDirectory + fd.cFileName));
+			}
+			while (::FindNextFile(hFind, &fd));
+			::FindClose(hFind);
+		}
+	}
+	else
+	{
+		std::basic_ifstream< _TCHAR > list(szInput);
+		if (!list)
+			throw wavfileException("Failed to open batch list", szInput, "");
+
+		std::basic_string< _TCHAR > line;
+		while (std::getline(list, line))
+		{
+			// Trim trailing white space (including any CR)
+			const std::basic_string< _TCHAR >::size_type end = line.find_last_not_of(TEXT(" \t\r"));
+			if (end == std::basic_string< _TCHAR >::npos)
+				continue;	// Blank line
+			line.erase(end + 1);
+
+			const std::basic_string< _TCHAR >::size_type idx = line.find_last_of(TEXT("\\/:"));
+			const std::basic_string< _TCHAR > filename = idx == std::basic_string< _TCHAR >::npos ? line : line.substr(idx + 1);
+			jobs.push_back(BatchJob(line, outputDirectory + filename));
+		}
+	}
+
+	if (jobs.empty())
+		throw wavfileException("No files to convolve", szInput, "");
+
+	if (!::CreateDirectory(szOutputDirectory, NULL) && ::GetLastError() != ERROR_ALREADY_EXISTS)
+		throw wavfileException("Failed to create output directory", szOutputDirectory, "");
+}
+
+#ifdef LIBSNDFILE
+
+namespace
+{
+	// The state handed to each worker thread
+	struct BatchWorker
+	{
+		Holder< Convolution<float> >	conv;		// this worker's engine
+		std::vector<BatchJob>*			jobs;
+		volatile LONG*					nNextJob;	// shared by all the workers
+		DWORD							nPartitions;
+		float							fAttenuation;
+
+		BatchWorker(const ChannelPaths& Mixer, std::vector<BatchJob>* jobs, volatile LONG* nNextJob,
+			const DWORD nPartitions, const float fAttenuation) :
+		conv(new Convolution<float>(Mixer)), jobs(jobs), nNextJob(nNextJob),
+			nPartitions(nPartitions), fAttenuation(fAttenuation) {}
+	};
+
+	unsigned __stdcall batchWorkerThread(void* pWorker)
+	{
+		BatchWorker& worker = *static_cast<BatchWorker*>(pWorker);
+
+		for(;;)
+		{
+			const LONG nJob = ::InterlockedIncrement(worker.nNextJob) - 1;
+			if (nJob >= static_cast<LONG>(worker.jobs->size()))
+				break;
+
+			BatchJob& job = (*worker.jobs)[nJob];
+			try
+			{
+				job.nFrames = renderFile(*worker.conv, job.szInputFile.c_str(), job.szOutputFile.c_str(),
+					worker.nPartitions, worker.fAttenuation);
+			}
+			catch(const std::exception& error)
+			{
+				job.szError = error.what();
+			}
+			catch(...)
+			{
+				job.szError = "Failed";
+			}
+		}
+
+		return 0;
+	}
+}
+
+unsigned int doBatch(const ChannelPaths& Mixer, std::vector<BatchJob>& jobs,
+					 const DWORD nPartitions, const float fAttenuation, const unsigned int nThreads)
+{
+	assert(nThreads > 0);
+
+	// Build the worker engines up front, in this thread.  The filters (and their FFTW plans) are shared,
+	// so nothing is planned here, but the allocations are better made before the clock starts.
+	volatile LONG nNextJob = 0;
+	boost::ptr_vector<BatchWorker> workers;
+	for(unsigned int i = 0; i < nThreads; ++i)
+		workers.push_back(new BatchWorker(Mixer, &jobs, &nNextJob, nPartitions, fAttenuation));
+
+	std::vector<HANDLE> hThreads;
+	apHiResElapsedTime t;
+	for(unsigned int i = 0; i < nThreads; ++i)
+	{
+		const uintptr_t hThread = ::_beginthreadex(NULL, 0, batchWorkerThread, &workers[i], 0, NULL);
+		if (hThread == 0)
+			break;
+		hThreads.push_back(reinterpret_cast<HANDLE>(hThread));
+	}
+	if (hThreads.empty())
+		throw convolutionException("Failed to start batch worker threads");
+
+	// WaitForMultipleObjects can only wait on MAXIMUM_WAIT_OBJECTS at a time
+	for(std::vector<HANDLE>::size_type i = 0; i < hThreads.size(); i += MAXIMUM_WAIT_OBJECTS)
+	{
+		::WaitForMultipleObjects(static_cast<DWORD>(std::min<std::vector<HANDLE>::size_type>(MAXIMUM_WAIT_OBJECTS, hThreads.size() - i)),
+			&hThreads[i], TRUE, INFINITE);
+	}
+	const double fElapsed = t.msec();
+
+	for(std::vector<HANDLE>::size_type i = 0; i < hThreads.size(); ++i)
+		::CloseHandle(hThreads[i]);
+
+	unsigned int nFailed = 0;
+	double nTotalFrames = 0;
+	for(std::vector<BatchJob>::size_type i = 0; i < jobs.size(); ++i)
+	{
+		if (jobs[i].szError.empty())
+		{
+			nTotalFrames += jobs[i].nFrames;
+		}
+		else
+		{
+			++nFailed;
+			std::wcerr << "Failed to convolve " << jobs[i].szInputFile << ": " << jobs[i].szError.c_str() << std::endl;
+		}
+	}
+
+	std::wcerr << "Convolved " << jobs.size() - nFailed << " of " << jobs.size() << " files (" << nTotalFrames
+		<< " frames) using " << hThreads.size() << " thread(s) in " << fElapsed << " milliseconds" << std::endl;
+	if (fElapsed > 0)
+	{
+		std::wcerr << "Aggregate throughput: " << nTotalFrames * 1000.0 / fElapsed << " frames/second ("
+			<< nTotalFrames * 1000.0 / (fElapsed * Mixer.nSamplesPerSec()) << " x realtime)" << std::endl;
+	}
+
+	return nFailed;
+}
+
+#endif
@@ -0,0 +1,55 @@
+#pragma once
+// Convolver: DSP plug-in for Windows Media Player that convolves an impulse respose
+// filter it with the input stream.
+//
+// Copyright (C) 2005  John Pavel
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//
+//
+/////////////////////////////////////////////////////////////////////////////
+//
+// batch.h : Render many sound files through one set of filter paths
+//
+// The filter spectra and FFTW plans are built (and the optimum attenuation
+// calculated) once.  Each worker thread then owns a lightweight worker
+// Convolution engine that shares them, and takes the next file from the list
+// until none are left.
+//
+/////////////////////////////////////////////////////////////////////////////
+
+#include "convolution\config.h"
+#include "convolution\convolution.h"
+#include <string>
+#include <vector>
+
+struct BatchJob
+{
+	std::basic_string< _TCHAR >	szInputFile;
+	std::basic_string< _TCHAR >	szOutputFile;
+	DWORD						nFrames;		// frames written
+	std::string					szError;		// empty if rendered successfully
+
+	BatchJob(const std::basic_string< _TCHAR >& input, const std::basic_string< _TCHAR >& output) :
+	szInputFile(input), szOutputFile(output), nFrames(0) {}
+};
+
+// szInput is either a directory, all of whose files are rendered, or a text file listing one sound file per line.
+// Outputs are written to szOutputDirectory (created if need be) under the same file names.
+void listBatchJobs(const TCHAR szInput[MAX_PATH], const TCHAR szOutputDirectory[MAX_PATH], std::vector<BatchJob>& jobs);
+
+// Render all the jobs using nThreads worker engines sharing Mixer.  Returns the number of jobs that failed.
+unsigned int doBatch(const ChannelPaths& Mixer, std::vector<BatchJob>& jobs,
+					 const DWORD nPartitions, const float fAttenuation, const unsigned int nThreads);
@@ -36,6 +36,9 @@
 #endif
 #include "debugging\fasttiming.h"
 #include "convolution\wavefile.h"
+#include "render.h"
+#include "batch.h"
+#include "segment.h"
 
 int _tmain(int argc, _TCHAR* argv[])
 {
@@ -55,7 +58,6 @@ int _tmain(int argc, _TCHAR* argv[])
 	const DWORD SAMPLES = 1; // how many filter lengths to convolve at a time
 
 	HRESULT hr = S_OK;
-	Holder< ConvertSample<float> > convertor(new ConvertSample_ieeefloat<float>());
 
 	PlanningRigour pr;
 
@@ -63,12 +65,87 @@ int _tmain(int argc, _TCHAR* argv[])
 	debugstream.sink (apDebugSinkConsole::sOnly);
 #endif
 
-	if (argc != 6)
+	// Options precede the positional arguments
+	int nArg = 1;
+	unsigned int nBatchThreads = 0;	// 0 => convolve a single file
+	unsigned int nSegmentThreads = 0;	// 0 => convolve sequentially
+	bool bSweep = false;
+	bool bRealtime = false;		// use the real-time engine, rather than the offline one
+	bool bMapFiles = true;		// read and write float files through file mappings
+	bool bStats = false;		// report the load and the stage cycles of the real-time engine
+	ULONGLONG nMemoryBudget = 0;	// bytes.  0 => unlimited
+	DWORD nHalfPrecisionFrom = nNoHalfPrecision;	// the first filter partition to store at half precision
+	bool bUsage = false;
+	while (nArg < argc && _tcsncmp(argv[nArg], TEXT("--"), 2) == 0)
+	{
+		if (_tcscmp(argv[nArg], TEXT("--batch")) == 0 && nArg + 1 < argc)
+		{
+			std::wistringstream szThreads(argv[nArg + 1]);
+			szThreads >> nBatchThreads;
+			bUsage = bUsage || nBatchThreads == 0;
+			nArg += 2;
+		}
+		else if (_tcscmp(argv[nArg], TEXT("--segment")) == 0 && nArg + 1 < argc)
+		{
+			std::wistringstream szThreads(argv[nArg + 1]);
+			szThreads >> nSegmentThreads;
+			bUsage = bUsage || nSegmentThreads == 0;
+			nArg += 2;
+		}
+		else if (_tcscmp(argv[nArg], TEXT("--budget")) == 0 && nArg + 1 < argc)
+		{
+			std::wistringstream szBudget(argv[nArg + 1]);
+			double fMegabytes = 0;
+			szBudget >> fMegabytes;
+			bUsage = bUsage || fMegabytes <= 0;
+			nMemoryBudget = static_cast<ULONGLONG>(fMegabytes * 1048576);
+			nArg += 2;
+		}
+		else if (_tcscmp(argv[nArg], TEXT("--half")) == 0 && nArg + 1 < argc)
+		{
+			std::wistringstream szHalfPrecisionFrom(argv[nArg + 1]);
+			szHalfPrecisionFrom >> nHalfPrecisionFrom;
+			bUsage = bUsage || szHalfPrecisionFrom.fail();
+			bRealtime = true;
+			nArg += 2;
+		}
+		else if (_tcscmp(argv[nArg], TEXT("--realtime")) == 0)
+		{
+			bRealtime = true;
+			++nArg;
+		}
+		else if (_tcscmp(argv[nArg], TEXT("--stats")) == 0)
+		{
+			bStats = true;
+			bRealtime = true;
+			++nArg;
+		}
+		else if (_tcscmp(argv[nArg], TEXT("--no-mmap")) == 0)
+		{
+			bMapFiles = false;
+			++nArg;
+		}
+		else if (_tcscmp(argv[nArg], TEXT("--sweep")) == 0)
+		{
+			bSweep = true;
+			++nArg;
+		}
+		else
+		{
+			bUsage = true;
+			break;
+		}
+	}
+	bUsage = bUsage || (nBatchThreads > 0 && nSegmentThreads > 0) || (bSweep && nSegmentThreads == 0) ||
+		(bStats && (nBatchThreads > 0 || nSegmentThreads > 0));
+
+	if (bUsage || argc - nArg != 5)
 	{
 		USES_CONVERSION;
 
-		std::wcerr << "Usage: convolverCMD nPartitions nTuningRigour config.txt|IR.wav infile outfile" << std::endl;
-		std::wcerr << "       nPartitions = 0 for overlap-save, or the number of partitions to be used" << std::endl;
+		std::wcerr << "Usage: convolverCMD [--realtime [--stats]] [--no-mmap] [--budget MB] [--half nPartition] [--batch nThreads | --segment nThreads [--sweep]] nPartitions nTuningRigour config.txt|IR.wav infile outfile" << std::endl;
+		std::wcerr << "       nPartitions = 0 for overlap-save, or the number of partitions to be used by the" << std::endl;
+		std::wcerr << "                     real-time engine.  (The offline engine chooses its own partitioning)" << std::endl;
 		std::wcerr << "       nTuningRigour = 0-" << pr.nDegrees-1 << " (";
 		for(int i = 0; i < pr.nDegrees - 1; ++i)
 			std::wcerr << pr.Rigour[i] << "|";
@@ -76,13 +153,32 @@ int _tmain(int argc, _TCHAR* argv[])
 		std::wcerr << "       config.txt|IR.wav = a config text file specifying a single filter path" << std::endl;
 		std::wcerr << "                           or a sound file to be used as a filter" << std::endl;
 		std::wcerr << "       input and output sound files are, typically, .wav" << std::endl;
+		std::wcerr << "       --realtime = use the real-time engine, whose output lags by half a partition, rather than" << std::endl;
+		std::wcerr << "                    the offline engine.  --batch and --segment always use the real-time engine" << std::endl;
+		std::wcerr << "       --stats = report the load of each call of the real-time engine, against the duration of" << std::endl;
+		std::wcerr << "                 the audio, and the cycles spent in each stage of each filter path (implies --realtime)" << std::endl;
+		std::wcerr << "       --no-mmap = always read and write through libsndfile.  Otherwise the offline engine" << std::endl;
+		std::wcerr << "                   maps 32-bit float .wav and headerless .pcm/.raw files, rather than copying them" << std::endl;
+		std::wcerr << "       --budget MB = refuse to build an engine that would need more memory than that.  The" << std::endl;
+		std::wcerr << "                     real-time engine first stores the far partitions of its filter spectra at" << std::endl;
+		std::wcerr << "                     half precision, as --half does, and reports the SNR; the worker threads of" << std::endl;
+		std::wcerr << "                     --batch and --segment are cut back to fit, if need be" << std::endl;
+		std::wcerr << "       --half nPartition = store the filter spectra at half precision from this partition on (0 for all)," << std::endl;
+		std::wcerr << "                           halving their memory and bandwidth, and report the SNR that that costs" << std::endl;
+		std::wcerr << "                           (implies --realtime)" << std::endl;
+		std::wcerr << "       --batch nThreads = convolve many files, using nThreads worker threads.  infile is then" << std::endl;
+		std::wcerr << "                          a directory, or a text file listing one sound file per line, and" << std::endl;
+		std::wcerr << "                          outfile is the directory to which the results are written" << std::endl;
+		std::wcerr << "       --segment nThreads = convolve one long file as segments rendered in parallel" << std::endl;
+		std::wcerr << "       --sweep = also render sequentially, then segmented with 1..nThreads threads, reporting" << std::endl;
+		std::wcerr << "                 the speedup and the difference from the sequential output" << std::endl;
 		return 1;
 	}
-#define PARTITIONS argv[1]
-#define PLANNINGRIGOUR argv[2]
-#define CONFIG argv[3]
-#define INPUTFILE argv[4]
-#define OUTPUTFILE argv[5]
+#define PARTITIONS argv[nArg]
+#define PLANNINGRIGOUR argv[nArg + 1]
+#define CONFIG argv[nArg + 2]
+#define INPUTFILE argv[nArg + 3]
+#define OUTPUTFILE argv[nArg + 4]
 
 	try
 	{
@@ -90,6 +186,42 @@ int _tmain(int argc, _TCHAR* argv[])
 		DWORD nPartitions;
 		szPartitions >> nPartitions;
 
+		std::wistringstream szPlanningRigour(PLANNINGRIGOUR);
+		DWORD nPlanningRigour;
+		szPlanningRigour >> nPlanningRigour;
+
+#ifdef LIBSNDFILE
+		if (!bRealtime && nBatchThreads == 0 && nSegmentThreads == 0)
+		{
+			// Latency is irrelevant when rendering a file, so use the offline engine, which chooses its own partitioning
+			OfflineConvolution<float> offline(CONFIG, nPlanningRigour, 0, nMemoryBudget);
+			std::wcerr << "Using offline convolution: " << offline.DisplayOfflineConvolution().c_str() << std::endl;
+			std::wcerr << "Memory footprint: " << offline.footprint().DisplayFootprint().c_str() << std::endl;
+
+			float fAttenuation = 0;
+			apHiResElapsedTime t;
+			hr = offline.calculateOptimumAttenuation(fAttenuation);
+			if (FAILED(hr))
+			{
+				std::wcerr << "Failed to calculate optimum attenuation" << std::endl;
+				throw (hr);
+			}
+			std::wcerr << "Optimum attenuation: " << fAttenuation << " calculated in " << t.msec() << " milliseconds" << std::endl;
+
+			t.reset();
+			PipelineStats stats;
+			const DWORD nFramesWritten = renderOffline(offline, INPUTFILE, OUTPUTFILE, fAttenuation, bMapFiles, stats);
+			const double fElapsed = t.msec();
+			std::wcerr << "Convolved and wrote " << nFramesWritten << " frames to " << std::basic_string< _TCHAR >(OUTPUTFILE, _tcslen(OUTPUTFILE))
+				<< " in " << fElapsed << " milliseconds" << std::endl;
+			if (stats.nChunks > 0)
+			{
+				std::wcerr << "Pipeline: " << stats.DisplayPipelineStats().c_str() << std::endl;
+			}
+			return 0;
+		}
+#endif
+
 		if (nPartitions == 0)
 		{
 			std::wcerr << "Using overlap-save convolution" << std::endl;
@@ -99,73 +231,52 @@ int _tmain(int argc, _TCHAR* argv[])
 			std::wcerr << "Using partitioned convolution with " << nPartitions << " partition(s)" << std::endl;
 		}
 
-		std::wistringstream szPlanningRigour(PLANNINGRIGOUR);
-		DWORD nPlanningRigour;
-		szPlanningRigour >> nPlanningRigour;
+		// Each worker thread has its own engine, sharing the filters and plans of conv.  Their working buffers come
+		// out of the budget first, and conv fits its filters into the rest (see ConvolutionList), storing their far
+		// partitions at half precision if need be.  So the workers are only cut back if even the narrowest filters
+		// would leave no room for them
+		const unsigned int nWorkerThreads = std::max(nBatchThreads, nSegmentThreads);
+		ULONGLONG nListBudget = nMemoryBudget;
+		if (nMemoryBudget > 0 && nWorkerThreads > 0)
+		{
+			const Footprint Least = ConvolutionList<float>::footprint(CONFIG, nPartitions == 0 ? 1 : nPartitions, 0,
+				std::min<DWORD>(nHalfPrecisionFrom, 1));
+			const unsigned int nEngines = Least.nEnginesWithin(nMemoryBudget);
+			if (nEngines < 2)
+			{
+				throw convolutionException("Over the memory budget: needs " + Least.DisplayFootprint(2));
+			}
+			if (nEngines - 1 < nWorkerThreads)
+			{
+				std::wcerr << "Only " << nEngines - 1 << " worker thread(s) fit within the memory budget" << std::endl;
+				nBatchThreads = std::min(nBatchThreads, nEngines - 1);
+				nSegmentThreads = std::min(nSegmentThreads, nEngines - 1);
+			}
+			nListBudget = nMemoryBudget - std::max(nBatchThreads, nSegmentThreads) * Least.nWorking;
+		}
 
 		ConvolutionList<float> conv(CONFIG, nPartitions == 0 ? 1 : nPartitions, 
-			nPlanningRigour); // Sets conv. nPartitions==0 => use overlap-save
+			nPlanningRigour, 0, nListBudget, nHalfPrecisionFrom); // Sets conv. nPartitions==0 => use overlap-save
 
 		// TODO:: allow SF_INFO as well as WAVEFILEEX to select convolutions
 		if(conv.nConvolutionList() != 1)
 			throw convolutionException("Only single filter path specification acceptable");
 
-#ifdef LIBSNDFILE
-		SF_INFO sf_info; ::ZeroMemory(&sf_info, sizeof(sf_info));
-		// TODO: The following uses the sample rate of the first filter path for .PCM files
+		// The filters are loaded and planned, and the attenuation calculated, once: worker engines share them
 		conv.selectConvolutionIndex(0);  // Select the one and only filter path
-		CWaveFileHandle WavIn(INPUTFILE, SFM_READ, &sf_info, conv.SelectedConvolution().Mixer.nSamplesPerSec());
-		std::cerr << waveFormatDescription(sf_info, "Input file format: ") << std::endl;
-
-		const DWORD cBufferLength = conv.SelectedConvolution().Mixer.nFilterLength() * SAMPLES;  // frames
-#else
-		CWaveFileHandle WavIn;
-		if( FAILED( hr = WavIn->Open(INPUTFILE, NULL, WAVEFILE_READ ) ) )
-		{
-			std::wcerr << "Failed to open " << std::basic_string< _TCHAR >(INPUTFILE, _tcslen(INPUTFILE)) << " for reading" << std::endl;
-			throw(hr);
-		}
-
-		WAVEFORMATEXTENSIBLE wfexFilterFormat;
-		::ZeroMemory(&wfexFilterFormat, sizeof(wfexFilterFormat));
-		wfexFilterFormat = *(WAVEFORMATEXTENSIBLE*) WavIn->GetFormat();
-		std::cerr << waveFormatDescription(&wfexFilterFormat, WavIn->GetSize() / WavIn->GetFormat()->nBlockAlign, "Input file format: ") << std::endl;
 
-		WAVEFORMATEX* pWave = WavIn->GetFormat();
+		const Footprint Needed = ConvolutionList<float>::footprint(CONFIG, nPartitions == 0 ? 1 : nPartitions, 0,
+			conv.nHalfPrecisionFrom());
+		std::wcerr << "Memory footprint: "
+			<< Needed.DisplayFootprint(std::max(nBatchThreads, nSegmentThreads) + 1).c_str() << std::endl;
 
-		std::cerr << waveFormatDescription(&(conv->FIR.wfexFilterFormat), conv->FIR.nFilterLength, "Filter format: ") << std::endl;
-
-		if (conv->FIR.wfexFilterFormat.Format.nChannels < WavIn->GetFormat()->nChannels)
-		{
-			std::wcerr << "Filter format has fewer channels than the Input file" << std::endl;
-			throw(hr);
-		}
-
-		if (conv->FIR.wfexFilterFormat.Format.nSamplesPerSec!= WavIn->GetFormat()->nSamplesPerSec)
+		if (conv.nHalfPrecisionFrom() < conv.SelectedConvolution().Mixer.nPartitions)
 		{
-			std::wcerr << "Warning: Filter format and Input file have different sample rates" << std::endl;
+			std::wcerr << "Half precision filter spectra from partition " << conv.nHalfPrecisionFrom()
+				<< (conv.nHalfPrecisionFrom() < nHalfPrecisionFrom ? ", to fit the memory budget" : "") << ": "
+				<< conv.SelectedConvolution().Mixer.fHalfPrecisionSNR() << " dB SNR, for white noise" << std::endl;
 		}
 
-		const DWORD cBufferLength = conv->FIR.nFilterLength * conv->FIR.wfexFilterFormat.Format.nBlockAlign * SAMPLES;  // bytes
-#endif		
-
-#if defined(DEBUG) | defined(_DEBUG)
-		//cdebug << "cBufferLength=" << cBufferLength << std::endl ;
-#endif
-
-		UINT dwSizeWrote = 0;
-		DWORD dwSizeRead = 0;
-		DWORD dwTotalSizeRead = 0;
-		DWORD dwTotalSizeWritten = 0;
-#ifdef LIBSNDFILE
-		const DWORD dwTotalSizeToRead = sf_info.frames;
-#else
-		const DWORD dwTotalSizeToRead = WavIn->GetSize(); // bytes
-#endif
-#if defined(DEBUG) | defined(_DEBUG)
-		cdebug << "dwTotalSizeToRead=" << dwTotalSizeToRead << std::endl;
-#endif
-
 		float fAttenuation = 0;
 		double fElapsed = 0;
 		apHiResElapsedTime t;
@@ -180,131 +291,54 @@ int _tmain(int argc, _TCHAR* argv[])
 		//fAttenuation = 0;
 		std::wcerr << "Using attenuation of " << fAttenuation << std::endl;
 
-		const int nInputChannels = conv.SelectedConvolution().Mixer.nInputChannels();
-
 #ifdef LIBSNDFILE
-		std::vector<float> pfInputSamples(cBufferLength * nInputChannels);
-		std::vector<float> pfOutputSamples(cBufferLength * nInputChannels);
-#else
-		std::vector<BYTE> pbInputSamples(cBufferLength,0);
-		std::vector<BYTE> pbOutputSamples(cBufferLength,0);
-#endif
-
-#ifdef	LIBSNDFILE
-		// Write out in the same format as the input file, but with the right number of output channels
-		sf_info.channels = conv.SelectedConvolution().Mixer.nOutputChannels();	// select the first filter path
-		CWaveFileHandle WavOut(OUTPUTFILE, SFM_WRITE, &sf_info, sf_info.samplerate);
-#else
-		CWaveFileHandle WavOut;
-		if( FAILED( hr = WavOut->Open(OUTPUTFILE, WavIn->GetFormat(), WAVEFILE_WRITE ) ) )  // TODO:: fix for when different no of i/o channels
+		if (nBatchThreads > 0)
 		{
-			std::wcerr << "Failed to open " << std::basic_string< _TCHAR >(OUTPUTFILE, _tcslen(OUTPUTFILE)) << " for writing" << std::endl;
-			throw(hr);
+			std::vector<BatchJob> jobs;
+			listBatchJobs(INPUTFILE, OUTPUTFILE, jobs);
+
+			return doBatch(conv.SelectedConvolution().Mixer, jobs, nPartitions, fAttenuation, nBatchThreads) == 0 ? 0 : 1;
 		}
-#endif
 
-		t.reset(); // Start timing
-		while (dwTotalSizeRead != dwTotalSizeToRead)
+		if (nSegmentThreads > 0)
 		{
-#ifdef LIBSNDFILE
-			dwSizeRead = WavIn.readf_float(&pfInputSamples[0], cBufferLength);
-			if (dwSizeRead == 0)
-			{
-				throw std::length_error("Failed to read input buffer");
-			}
-#else
-			hr = WavIn->Read(&pbInputSamples[0], cBufferLength, &dwSizeRead);
-			if (FAILED(hr))
-			{
-				std::wcerr << "Failed to read " << cBufferLength << "bytes." << std::endl;
-				throw(std::length_error("Failed to read"));
-			}
-#endif
-			dwTotalSizeRead += dwSizeRead;
-
-#ifdef LIBSNDFILE
-			// Pad with zeros, to flush.  TODO: Won't work with 8-bit samples
-			for(unsigned int i = dwSizeRead * nInputChannels; i < cBufferLength * nInputChannels; ++i)
-				pfInputSamples[i]=0;
-
-			DWORD dwBlocksToProcess = cBufferLength;
-#else
-			if (dwSizeRead % conv.Mixer.wfexFilterFormat.Format.nBlockAlign != 0)
-			{
-				std::wcerr << "Failed to read a whole number of blocks. Read " << dwSizeRead << " bytes." << std::endl;
-				throw(std::length_error("Failed to read a whole number of blocks"));
-			}
-
-			// Pad with zeros, to flush
-			for(int i = dwSizeRead; i < cBufferLength; ++i)
-				pfInputSamples[i]=0;
-
-			DWORD dwBlocksToProcess = cBufferLength / conv.Mixer.wfexFilterFormat.Format.nBlockAlign;
-
-#endif
-
-			// nPartitions == 0 => use overlap-save version
-			DWORD dwBufferSizeGenerated = nPartitions == 0 ?
-#ifdef LIBSNDFILE
-				conv.SelectedConvolution().doConvolution(reinterpret_cast<BYTE*>(&pfInputSamples[0]),
-				reinterpret_cast<BYTE*>(&pfOutputSamples[0]),
-#else
-				conv.SelectedConvolution().doConvolution(&pbInputSamples[0], &pbOutputSamples[0],
-#endif
-				convertor.get_ptr(), convertor.get_ptr(),
-				/* dwBlocksToProcess */ dwBlocksToProcess,
-				/* fAttenuation_db */ fAttenuation)
-				:
-#ifdef LIBSNDFILE
-			conv.SelectedConvolution().doPartitionedConvolution(reinterpret_cast<BYTE*>(&pfInputSamples[0]),
-				reinterpret_cast<BYTE*>(&pfOutputSamples[0]),
-#else
-			conv.SelectedConvolution().doPartitionedConvolution(&pbInputSamples[0], &pbOutputSamples[0],
-#endif
-				convertor.get_ptr(), convertor.get_ptr(),
-				/* dwBlocksToProcess */ dwBlocksToProcess,
-				/* fAttenuation_db */ fAttenuation);
-
-#if defined(DEBUG) | defined(_DEBUG)
-				cdebug << "dwBufferSizeGenerated=" << dwBufferSizeGenerated << std::endl;
-#endif
-
-
-#ifdef LIBSNDFILE
-			dwSizeWrote = WavOut.writef_float(&pfOutputSamples[0], dwBufferSizeGenerated / (sizeof(float) * sf_info.channels)); // dwSizeWrote is in frames
-			if (dwSizeWrote != dwBufferSizeGenerated / (sizeof(float) * sf_info.channels))
-#else
-			hr = WavOut->Write(dwBufferSizeGenerated, &pbOutputSamples[0], &dwSizeWrote);
-			if (FAILED(hr))
+			if (bSweep)
 			{
-				std::wcerr << "Failed to write " << dwBufferSizeGenerated << " bytes." << std::endl;
-				throw(std::length_error("Failed to write"));
+				sweepSegmented(conv.SelectedConvolution(), INPUTFILE, OUTPUTFILE, nPartitions, fAttenuation, nSegmentThreads);
 			}
-			if (dwSizeWrote != dwBufferSizeGenerated)
-#endif
+			else
 			{
-				std::wcerr << "Failed to write " << dwBufferSizeGenerated << " bytes. Only wrote " 
-					<< dwSizeWrote << std::endl;
-				throw(std::length_error("Failed to write"));
+				t.reset();
+				const DWORD nFramesWritten = renderSegmented(conv.SelectedConvolution().Mixer, INPUTFILE, OUTPUTFILE,
+					nPartitions, fAttenuation, nSegmentThreads);
+				fElapsed = t.msec();
+				std::wcerr << "Convolved and wrote " << nFramesWritten << " frames to " << std::basic_string< _TCHAR >(OUTPUTFILE, _tcslen(OUTPUTFILE))
+					<< " using " << nSegmentThreads << " thread(s) in " << fElapsed << " milliseconds" << std::endl;
 			}
+			return 0;
+		}
 
-			dwTotalSizeWritten += dwSizeWrote;
-		} 
+		// The real-time engine takes a filter length at a time, as it would in the convolver
+		const DWORD nChunkLength = conv.SelectedConvolution().Mixer.nFilterLength() * SAMPLES;  // frames
 
+		t.reset(); // Start timing
+		PipelineStats stats;
+		const DWORD nFramesWritten = renderPipelined(conv.SelectedConvolution(), INPUTFILE, OUTPUTFILE, nPartitions,
+			fAttenuation, nChunkLength, stats);
 		fElapsed = t.msec();
+		std::wcerr << "Convolved and wrote " << nFramesWritten << " frames to " << std::basic_string< _TCHAR >(OUTPUTFILE, _tcslen(OUTPUTFILE))
+			<< " in " << fElapsed << " milliseconds" << std::endl;
 
-		std::wcerr << "Convolved and wrote " << dwTotalSizeWritten <<
-#ifdef LIBSNDFILE
-			" frames to "
+		if (bStats)
+		{
+			std::wcerr << "Pipeline: " << stats.DisplayPipelineStats().c_str() << std::endl;
+			std::wcerr << "Deadlines: " << conv.SelectedConvolution().Deadlines().DisplayDeadlines().c_str();
+#ifdef CONVOLUTION_STATS
+			std::wcerr << "Stage cycles:" << std::endl << conv.SelectedConvolution().Stats().DisplayStats().c_str();
 #else
-			" bytes to " 
+			std::wcerr << "Stage statistics are not compiled in: rebuild with CONVOLUTION_STATS defined" << std::endl;
 #endif
-			<< std::basic_string< _TCHAR >(OUTPUTFILE, _tcslen(OUTPUTFILE))
-			<< " in " << fElapsed << " milliseconds" << std::endl;
-
-#ifndef LIBSNDFILE
-		WavIn->Close();
-		WavOut->Close();
+		}
 #endif
 
 		return 0;
@@ -0,0 +1,445 @@
+// Convolver: DSP plug-in for Windows Media Player that convolves an impulse respose
+// filter it with the input stream.
+//
+// Copyright (C) 2005  John Pavel
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//
+/////////////////////////////////////////////////////////////////////////////
+//
+// pipeline.cpp : Overlap reading, convolving and writing a sound file
+//
+
+#include "stdafx.h"
+#include "pipeline.h"
+#include "convolution\wavefile.h"
+#include "debugging\fasttiming.h"
+#include <windows.h>
+#include <process.h>
+#include <algorithm>
+#include <sstream>
+
+const std::string PipelineStats::DisplayPipelineStats() const
+{
+	std::ostringstream s;
+	s << nChunks << " chunks.  Busy (waiting) milliseconds: read " << fReadBusy << " (" << fReadWait << "), convolve "
+		<< fConvolveBusy << " (" << fConvolveWait << "), write " << fWriteBusy << " (" << fWriteWait << ").  ";
+	s << "Mean queue depths: " << fInputDepth << " chunk(s) read ahead, " << fOutputDepth << " chunk(s) awaiting write.  ";
+
+	const double fMaxBusy = std::max(fReadBusy, std::max(fConvolveBusy, fWriteBusy));
+	s << "Bottleneck: " << (fMaxBusy == fConvolveBusy ? "convolve" : fMaxBusy == fReadBusy ? "read" : "write");
+	return s.str();
+}
+
+#ifdef LIBSNDFILE
+
+namespace
+{
+	// Chunks in flight on each side of the engine
+	const DWORD PIPELINE_DEPTH = 4;
+
+	struct Chunk
+	{
+		std::vector<float>	samples;
+		DWORD				nFrames;	// valid
+		bool				bLast;		// the input, or the output, ends with this chunk
+
+		Chunk(const std::vector<float>::size_type nSamples) : samples(nSamples), nFrames(0), bLast(false) {}
+	};
+
+	// The state shared by the stages
+	struct Pipeline
+	{
+		const TCHAR*		szInputFile;
+		const TCHAR*		szOutputFile;
+		CWaveFileHandle&	WavIn;
+		CWaveFileHandle&	WavOut;
+		const sf_count_t	nInputFrames;
+		const sf_count_t	nOutputFrames;
+		const DWORD			nChunkLength;
+		const int			nInputChannels;
+
+		SPSCQueue<Chunk>	InputFree;		// engine -> reader
+		SPSCQueue<Chunk>	InputFull;		// reader -> engine
+		SPSCQueue<Chunk>	OutputFull;		// engine -> writer
+		SPSCQueue<Chunk>	OutputFree;		// writer -> engine
+
+		volatile LONG		bAbort;			// set by any stage that fails
+		std::string			szError;		// from the reader or writer
+		double				fReadWait;
+		double				fReadBusy;
+		double				fWriteWait;
+		double				fWriteBusy;
+
+		Pipeline(const TCHAR* szInputFile, const TCHAR* szOutputFile, CWaveFileHandle& WavIn, CWaveFileHandle& WavOut,
+			const sf_count_t nInputFrames, const sf_count_t nOutputFrames, const DWORD nChunkLength, const int nInputChannels) :
+		szInputFile(szInputFile), szOutputFile(szOutputFile), WavIn(WavIn), WavOut(WavOut),
+			nInputFrames(nInputFrames), nOutputFrames(nOutputFrames), nChunkLength(nChunkLength), nInputChannels(nInputChannels),
+			InputFree(PIPELINE_DEPTH), InputFull(PIPELINE_DEPTH), OutputFull(PIPELINE_DEPTH), OutputFree(PIPELINE_DEPTH),
+			bAbort(FALSE), fReadWait(0), fReadBusy(0), fWriteWait(0), fWriteBusy(0) {}
+
+		void abort(const std::string& szWhat)
+		{
+			if (::InterlockedExchange(&bAbort, TRUE) == FALSE)
+				szError = szWhat;
+		}
+
+	private:
+		Pipeline(const Pipeline& other); // no impl.
+		const Pipeline& operator=(const Pipeline& other); // no impl.
+	};
+
+	// Take a chunk, yielding while the queue is empty and adding the time to fWait.  NULL => aborted
+	Chunk* take(SPSCQueue<Chunk>& queue, volatile LONG& bAbort, double& fWait)
+	{
+		Chunk* chunk = queue.pop();
+		if (chunk != NULL)
+			return chunk;
+
+		apHiResElapsedTime t;
+		while ((chunk = queue.pop()) == NULL && !bAbort)
+			::SwitchToThread();
+		fWait += t.msec();
+		return chunk;
+	}
+
+	// Each queue can hold every chunk on its side of the engine, so should never fill
+	void give(SPSCQueue<Chunk>& queue, Chunk* chunk)
+	{
+		if (!queue.push(chunk))
+			throw convolutionException("Internal error: pipeline queue full");
+	}
+
+	unsigned __stdcall readerThread(void* pPipeline)
+	{
+		Pipeline& pipeline = *static_cast<Pipeline*>(pPipeline);
+		apHiResElapsedTime t;
+
+		try
+		{
+			sf_count_t nTotalFramesRead = 0;
+			while (nTotalFramesRead < pipeline.nInputFrames)
+			{
+				Chunk* chunk = take(pipeline.InputFree, pipeline.bAbort, pipeline.fReadWait);
+				if (chunk == NULL)
+					break;
+
+				const sf_count_t nWanted = std::min<sf_count_t>(pipeline.nChunkLength, pipeline.nInputFrames - nTotalFramesRead);
+				const sf_count_t nFramesRead = pipeline.WavIn.fillf_float(&chunk->samples[0], nWanted, pipeline.nInputChannels);
+				if (nFramesRead < nWanted && pipeline.WavIn.error() != SF_ERR_NO_ERROR)
+					throw wavfileException("Failed to read input buffer", pipeline.szInputFile, "");
+				nTotalFramesRead += nFramesRead;
+
+				// The input ends with this chunk if it has all the frames in the header, or the file ended short
+				// of them.  Only that chunk can be short, and it is padded with zeros, to make whole blocks
+				std::fill(chunk->samples.begin() + static_cast<std::vector<float>::size_type>(nFramesRead * pipeline.nInputChannels),
+					chunk->samples.end(), 0.0f);
+				chunk->nFrames = static_cast<DWORD>(nFramesRead);
+				chunk->bLast = nFramesRead < nWanted || nTotalFramesRead == pipeline.nInputFrames;
+
+				const bool bLast = chunk->bLast;
+				give(pipeline.InputFull, chunk);
+				if (bLast)
+					break;
+			}
+		}
+		catch(const std::exception& error)
+		{
+			pipeline.abort(error.what());
+		}
+		catch(...)
+		{
+			pipeline.abort("Failed to read");
+		}
+
+		pipeline.fReadBusy = t.msec() - pipeline.fReadWait;
+		return 0;
+	}
+
+	unsigned __stdcall writerThread(void* pPipeline)
+	{
+		Pipeline& pipeline = *static_cast<Pipeline*>(pPipeline);
+		apHiResElapsedTime t;
+
+		try
+		{
+			sf_count_t nTotalFramesWritten = 0;
+			while (nTotalFramesWritten < pipeline.nOutputFrames)
+			{
+				Chunk* chunk = take(pipeline.OutputFull, pipeline.bAbort, pipeline.fWriteWait);
+				if (chunk == NULL)
+					break;
+
+				if (pipeline.WavOut.writef_float(&chunk->samples[0], chunk->nFrames) != chunk->nFrames)
+					throw wavfileException("Failed to write output buffer", pipeline.szOutputFile, "");
+				nTotalFramesWritten += chunk->nFrames;
+
+				// The output ends early, if the input did
+				const bool bLast = chunk->bLast;
+				give(pipeline.OutputFree, chunk);
+				if (bLast)
+					break;
+			}
+		}
+		catch(const std::exception& error)
+		{
+			pipeline.abort(error.what());
+		}
+		catch(...)
+		{
+			pipeline.abort("Failed to write");
+		}
+
+		pipeline.fWriteBusy = t.msec() - pipeline.fWriteWait;
+		return 0;
+	}
+
+	// The offline engine writes a whole chunk for each chunk it takes, so its output is not delayed.  The filter
+	// tail is flushed out with silence
+	class OfflineStage
+	{
+	public:
+		OfflineStage(OfflineConvolution<float>& conv, const float fAttenuation) : conv_(conv), fAttenuation_(fAttenuation) {}
+
+		DWORD nSamplesPerSec() const
+		{
+			return conv_.nSamplesPerSec();
+		}
+
+		int nInputChannels() const
+		{
+			return conv_.nInputChannels();
+		}
+
+		int nOutputChannels() const
+		{
+			return conv_.nOutputChannels();
+		}
+
+		DWORD nTailLength() const
+		{
+			return conv_.nTailLength();
+		}
+
+		// pfInput == NULL => silence.  Returns the number of frames written to pfOutput
+		DWORD convolve(const float* pfInput, float* pfOutput, const DWORD nFrames)
+		{
+			conv_.Process(pfInput, pfOutput, nFrames, fAttenuation_);
+			return nFrames;
+		}
+
+	private:
+		OfflineConvolution<float>&	conv_;
+		const float					fAttenuation_;
+
+		OfflineStage(const OfflineStage& other); // no impl.
+		const OfflineStage& operator=(const OfflineStage& other); // no impl.
+	};
+
+	// The real-time engine's output lags its input by half a partition, so it writes fewer frames than it takes at
+	// first, and the lag is flushed out with silence.  It has no tail, so the output is as long as the input
+	class RealtimeStage
+	{
+	public:
+		RealtimeStage(Convolution<float>& conv, const DWORD nPartitions, const float fAttenuation, const DWORD nChunkLength) :
+		  conv_(conv), nPartitions_(nPartitions), fAttenuation_(fAttenuation), Silence_(nChunkLength * conv.Mixer.nInputChannels()) {}
+
+		DWORD nSamplesPerSec() const
+		{
+			return conv_.Mixer.nSamplesPerSec();
+		}
+
+		int nInputChannels() const
+		{
+			return conv_.Mixer.nInputChannels();
+		}
+
+		int nOutputChannels() const
+		{
+			return conv_.Mixer.nOutputChannels();
+		}
+
+		DWORD nTailLength() const
+		{
+			return 0;
+		}
+
+		// pfInput == NULL => silence.  Returns the number of frames written to pfOutput
+		DWORD convolve(const float* pfInput, float* pfOutput, const DWORD nFrames)
+		{
+			assert(nFrames * conv_.Mixer.nInputChannels() <= Silence_.size());
+			const BYTE* pbInput = reinterpret_cast<const BYTE*>(pfInput == NULL ? &Silence_[0] : pfInput);
+
+			// nPartitions == 0 => use overlap-save version
+			const DWORD cbGenerated = nPartitions_ == 0 ?
+				conv_.doConvolution(pbInput, reinterpret_cast<BYTE*>(pfOutput), &convertor_, &convertor_, nFrames, fAttenuation_)
+				:
+				conv_.doPartitionedConvolution(pbInput, reinterpret_cast<BYTE*>(pfOutput), &convertor_, &convertor_, nFrames, fAttenuation_);
+			return cbGenerated / (sizeof(float) * conv_.Mixer.nOutputChannels());
+		}
+
+	private:
+		Convolution<float>&						conv_;
+		const DWORD								nPartitions_;
+		const float								fAttenuation_;
+		const std::vector<float>				Silence_;
+		const ConvertSample_ieeefloat<float>	convertor_;
+
+		RealtimeStage(const RealtimeStage& other); // no impl.
+		const RealtimeStage& operator=(const RealtimeStage& other); // no impl.
+	};
+
+	// Run the reader and writer threads around the engine stage, which convolves on this thread.  Stage is
+	// OfflineStage or RealtimeStage
+	template <typename Stage>
+	DWORD renderThrough(Stage& stage, const TCHAR szInputFile[MAX_PATH], const TCHAR szOutputFile[MAX_PATH],
+						const DWORD nChunkLength, PipelineStats& stats)
+	{
+		stats = PipelineStats();
+
+		SF_INFO sf_info; ::ZeroMemory(&sf_info, sizeof(sf_info));
+		CWaveFileHandle WavIn(szInputFile, SFM_READ, &sf_info, stage.nSamplesPerSec());
+
+		const int nInputChannels = stage.nInputChannels();
+		const int nOutputChannels = stage.nOutputChannels();
+		if(sf_info.channels != nInputChannels)
+			throw wavfileException("Number of channels does not match the filter paths", szInputFile, "");
+
+		const sf_count_t nInputFrames = sf_info.frames;
+		const sf_count_t nOutputFrames = nInputFrames == 0 ? 0 : nInputFrames + stage.nTailLength();
+
+		// Write out in the same format as the input file, but with the right number of output channels
+		sf_info.channels = nOutputChannels;
+		CWaveFileHandle WavOut(szOutputFile, SFM_WRITE, &sf_info, sf_info.samplerate);
+
+		Pipeline pipeline(szInputFile, szOutputFile, WavIn, WavOut, nInputFrames, nOutputFrames, nChunkLength, nInputChannels);
+
+		// The chunks are allocated once, and circulate
+		boost::ptr_vector<Chunk> chunks;
+		for (DWORD i = 0; i < PIPELINE_DEPTH; ++i)
+		{
+			chunks.push_back(new Chunk(nChunkLength * nInputChannels));
+			give(pipeline.InputFree, &chunks.back());
+			chunks.push_back(new Chunk(nChunkLength * nOutputChannels));
+			give(pipeline.OutputFree, &chunks.back());
+		}
+
+		HANDLE hThreads[2] = { NULL, NULL };
+		hThreads[0] = reinterpret_cast<HANDLE>(::_beginthreadex(NULL, 0, readerThread, &pipeline, 0, NULL));
+		if (hThreads[0] == NULL)
+			throw convolutionException("Failed to start the reader thread");
+		hThreads[1] = reinterpret_cast<HANDLE>(::_beginthreadex(NULL, 0, writerThread, &pipeline, 0, NULL));
+		if (hThreads[1] == NULL)
+		{
+			pipeline.abort("Failed to start the writer thread");
+			::WaitForSingleObject(hThreads[0], INFINITE);
+			::CloseHandle(hThreads[0]);
+			throw convolutionException(pipeline.szError);
+		}
+
+		// The engine stage.  If the input ends short of the frames in its header, so does the output
+		sf_count_t nFramesToConvolve = nOutputFrames;
+		apHiResElapsedTime t;
+		try
+		{
+			sf_count_t nTotalFramesRead = 0;
+			sf_count_t nTotalFramesConvolved = 0;
+			DWORD nInputChunks = 0;
+			bool bInputEnded = nInputFrames == 0;
+			while (nTotalFramesConvolved < nFramesToConvolve)
+			{
+				// Once the input is exhausted, flush out the tail
+				Chunk* input = NULL;
+				if (!bInputEnded)
+				{
+					input = take(pipeline.InputFull, pipeline.bAbort, stats.fConvolveWait);
+					if (input == NULL)
+						break;
+					stats.fInputDepth += pipeline.InputFull.depth();
+					++nInputChunks;
+					nTotalFramesRead += input->nFrames;
+					if (input->bLast)
+					{
+						bInputEnded = true;
+						nFramesToConvolve = nTotalFramesRead == 0 ? 0 : nTotalFramesRead + stage.nTailLength();
+					}
+				}
+
+				Chunk* output = take(pipeline.OutputFree, pipeline.bAbort, stats.fConvolveWait);
+				if (output == NULL)
+					break;
+				stats.fOutputDepth += pipeline.OutputFull.depth();
+
+				const DWORD nFramesGenerated = stage.convolve(input == NULL ? NULL : &input->samples[0], &output->samples[0], nChunkLength);
+				output->nFrames = static_cast<DWORD>(std::min<sf_count_t>(nFramesGenerated, nFramesToConvolve - nTotalFramesConvolved));
+				nTotalFramesConvolved += output->nFrames;
+				output->bLast = nTotalFramesConvolved == nFramesToConvolve;
+				++stats.nChunks;
+
+				if (input != NULL)
+					give(pipeline.InputFree, input);
+				give(pipeline.OutputFull, output);
+			}
+
+			if (nInputChunks > 0)
+				stats.fInputDepth /= nInputChunks;
+			if (stats.nChunks > 0)
+				stats.fOutputDepth /= stats.nChunks;
+		}
+		catch(const std::exception& error)
+		{
+			pipeline.abort(error.what());
+		}
+		catch(...)
+		{
+			pipeline.abort("Failed to convolve");
+		}
+		stats.fConvolveBusy = t.msec() - stats.fConvolveWait;
+
+		::WaitForMultipleObjects(2, hThreads, TRUE, INFINITE);
+		::CloseHandle(hThreads[0]);
+		::CloseHandle(hThreads[1]);
+
+		if (pipeline.bAbort)
+			throw convolutionException(pipeline.szError);
+
+		stats.fReadBusy = pipeline.fReadBusy;
+		stats.fReadWait = pipeline.fReadWait;
+		stats.fWriteBusy = pipeline.fWriteBusy;
+		stats.fWriteWait = pipeline.fWriteWait;
+
+		return static_cast<DWORD>(nFramesToConvolve);
+	}
+}
+
+DWORD renderPipelined(OfflineConvolution<float>& conv, const TCHAR szInputFile[MAX_PATH], const TCHAR szOutputFile[MAX_PATH],
+					  const float fAttenuation, const DWORD nChunkLength, PipelineStats& stats)
+{
+	assert(nChunkLength % conv.nBlockLength() == 0);
+
+	conv.Flush();
+	OfflineStage stage(conv, fAttenuation);
+	return renderThrough(stage, szInputFile, szOutputFile, nChunkLength, stats);
+}
+
+DWORD renderPipelined(Convolution<float>& conv, const TCHAR szInputFile[MAX_PATH], const TCHAR szOutputFile[MAX_PATH],
+					  const DWORD nPartitions, const float fAttenuation, const DWORD nChunkLength, PipelineStats& stats)
+{
+	conv.Flush();
+	RealtimeStage stage(conv, nPartitions, fAttenuation, nChunkLength);
+	return renderThrough(stage, szInputFile, szOutputFile, nChunkLength, stats);
+}
+
+#endif
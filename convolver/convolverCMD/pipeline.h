@@ -0,0 +1,120 @@
+#pragma once
+// Convolver: DSP plug-in for Windows Media Player that convolves an impulse respose
+// filter it with the input stream.
+//
+// Copyright (C) 2005  John Pavel
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//
+/////////////////////////////////////////////////////////////////////////////
+//
+// pipeline.h : Overlap reading, convolving and writing a sound file
+//
+// A reader thread decodes the input through libsndfile, the engine convolves
+// on the calling thread, and a writer thread encodes the output.  The stages
+// pass fixed chunks to each other through bounded lock-free queues, and the
+// chunks are recycled, so nothing is allocated once the pipeline is running.
+//
+/////////////////////////////////////////////////////////////////////////////
+
+#include "convolution\config.h"
+#include "convolution\convolution.h"
+#include "convolution\offline.h"
+#include <string>
+#include <vector>
+
+// A bounded, lock-free queue between exactly one producer thread and one consumer thread
+template <typename T>
+class SPSCQueue
+{
+public:
+	explicit SPSCQueue(const DWORD nCapacity) : ring_(nCapacity + 1), head_(0), tail_(0) {}
+
+	// false => full
+	bool push(T* p)
+	{
+		const LONG tail = tail_;
+		const LONG next = next_index(tail);
+		if (next == head_)
+			return false;
+		ring_[tail] = p;
+		::InterlockedExchange(&tail_, next);	// publish p
+		return true;
+	}
+
+	// NULL => empty
+	T* pop()
+	{
+		const LONG head = head_;
+		if (head == tail_)
+			return NULL;
+		T* p = ring_[head];
+		::InterlockedExchange(&head_, next_index(head));	// release the slot
+		return p;
+	}
+
+	// Only a snapshot, as the other thread may be changing it
+	DWORD depth() const
+	{
+		const LONG nSize = static_cast<LONG>(ring_.size());
+		return static_cast<DWORD>((tail_ - head_ + nSize) % nSize);
+	}
+
+private:
+	LONG next_index(const LONG index) const
+	{
+		return index + 1 == static_cast<LONG>(ring_.size()) ? 0 : index + 1;
+	}
+
+	std::vector<T*>	ring_;
+	volatile LONG	head_;		// next to pop (owned by the consumer)
+	volatile LONG	tail_;		// next to push (owned by the producer)
+
+	SPSCQueue(const SPSCQueue& other); // no impl.
+	const SPSCQueue& operator=(const SPSCQueue& other); // no impl.
+};
+
+// Where the time went.  Each stage is either busy or waiting on one of its queues; the stage
+// that is busiest is the bottleneck.
+struct PipelineStats
+{
+	DWORD	nChunks;			// convolved
+	double	fReadBusy;			// milliseconds
+	double	fReadWait;
+	double	fConvolveBusy;
+	double	fConvolveWait;
+	double	fWriteBusy;
+	double	fWriteWait;
+	double	fInputDepth;		// mean chunks read ahead of the engine, as it takes each one
+	double	fOutputDepth;		// mean chunks convolved ahead of the writer, as it takes each one
+
+	PipelineStats() : nChunks(0), fReadBusy(0), fReadWait(0), fConvolveBusy(0), fConvolveWait(0),
+		fWriteBusy(0), fWriteWait(0), fInputDepth(0), fOutputDepth(0) {}
+
+	const std::string DisplayPipelineStats() const;
+};
+
+#ifdef LIBSNDFILE
+// Convolve one sound file into another through the pipeline, using the offline engine (which is flushed first)
+// on this thread.  Otherwise as renderOffline.  Returns the number of frames written.
+DWORD renderPipelined(OfflineConvolution<float>& conv, const TCHAR szInputFile[MAX_PATH], const TCHAR szOutputFile[MAX_PATH],
+					  const float fAttenuation, const DWORD nChunkLength, PipelineStats& stats);
+
+// Likewise, using the real-time engine conv (which is flushed first), as the convolver does.  nPartitions == 0 =>
+// overlap-save.  The output is as long as the input, and lags it by half a partition.  Returns the number of
+// frames written.
+DWORD renderPipelined(Convolution<float>& conv, const TCHAR szInputFile[MAX_PATH], const TCHAR szOutputFile[MAX_PATH],
+					  const DWORD nPartitions, const float fAttenuation, const DWORD nChunkLength, PipelineStats& stats);
+#endif
@@ -0,0 +1,179 @@
+// Convolver: DSP plug-in for Windows Media Player that convolves an impulse respose
+// filter it with the input stream.
+//
+// Copyright (C) 2005  John Pavel
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//
+//
+/////////////////////////////////////////////////////////////////////////////
+//
+// render.cpp : Convolve one sound file into another
+//
+
+#include "stdafx.h"
+#include "render.h"
+#include "convolution\wavefile.h"
+#include "convolution\mappedfile.h"
+#include <algorithm>
+
+#ifdef LIBSNDFILE
+
+DWORD renderFile(Convolution<float>& conv, const TCHAR szInputFile[MAX_PATH], const TCHAR szOutputFile[MAX_PATH],
+				 const DWORD nPartitions, const float fAttenuation)
+{
+	const ConvertSample_ieeefloat<float> convertor;
+
+	conv.Flush();
+
+	SF_INFO sf_info; ::ZeroMemory(&sf_info, sizeof(sf_info));
+	CWaveFileHandle WavIn(szInputFile, SFM_READ, &sf_info, conv.Mixer.nSamplesPerSec());
+
+	const int nInputChannels = conv.Mixer.nInputChannels();
+	const int nOutputChannels = conv.Mixer.nOutputChannels();
+	if(sf_info.channels != nInputChannels)
+		throw wavfileException("Number of channels does not match the filter paths", szInputFile, "");
+
+	const DWORD cBufferLength = conv.Mixer.nFilterLength();  // frames
+	const sf_count_t nTotalFramesToRead = sf_info.frames;
+
+	std::vector<float> pfInputSamples(cBufferLength * nInputChannels);
+	std::vector<float> pfOutputSamples(cBufferLength * nOutputChannels);
+
+	// Write out in the same format as the input file, but with the right number of output channels
+	sf_info.channels = nOutputChannels;
+	CWaveFileHandle WavOut(szOutputFile, SFM_WRITE, &sf_info, sf_info.samplerate);
+
+	sf_count_t nTotalFramesRead = 0;
+	DWORD nTotalFramesWritten = 0;
+	bool bInputEnded = nTotalFramesToRead == 0;
+	while (!bInputEnded)
+	{
+		const sf_count_t nWanted = std::min<sf_count_t>(cBufferLength, nTotalFramesToRead - nTotalFramesRead);
+		const sf_count_t nFramesRead = WavIn.fillf_float(&pfInputSamples[0], nWanted, nInputChannels);
+		if (nFramesRead < nWanted && WavIn.error() != SF_ERR_NO_ERROR)
+			throw wavfileException("Failed to read input buffer", szInputFile, "");
+		nTotalFramesRead += nFramesRead;
+		bInputEnded = nFramesRead < nWanted || nTotalFramesRead == nTotalFramesToRead;
+		if (nFramesRead == 0)
+			break;
+
+		// Only the last buffer can be short.  Pad it with zeros, to flush
+		std::fill(pfInputSamples.begin() + static_cast<std::vector<float>::size_type>(nFramesRead * nInputChannels),
+			pfInputSamples.end(), 0.0f);
+
+		// nPartitions == 0 => use overlap-save version
+		const DWORD dwBufferSizeGenerated = nPartitions == 0 ?
+			conv.doConvolution(reinterpret_cast<BYTE*>(&pfInputSamples[0]),
+			reinterpret_cast<BYTE*>(&pfOutputSamples[0]), &convertor, &convertor, cBufferLength, fAttenuation)
+			:
+			conv.doPartitionedConvolution(reinterpret_cast<BYTE*>(&pfInputSamples[0]),
+			reinterpret_cast<BYTE*>(&pfOutputSamples[0]), &convertor, &convertor, cBufferLength, fAttenuation);
+
+		const sf_count_t nFramesGenerated = dwBufferSizeGenerated / (sizeof(float) * nOutputChannels);
+		if (WavOut.writef_float(&pfOutputSamples[0], nFramesGenerated) != nFramesGenerated)
+			throw wavfileException("Failed to write output buffer", szOutputFile, "");
+
+		nTotalFramesWritten += static_cast<DWORD>(nFramesGenerated);
+	}
+
+	return nTotalFramesWritten;
+}
+
+#endif
+
+#ifdef LIBSNDFILE
+
+// Frames read at a time by the offline engine (rounded up to whole blocks)
+const DWORD OFFLINE_CHUNK_LENGTH = 65536;
+
+namespace
+{
+	// The engine works directly on the mapped samples, except for the partial chunks at the end of the input and
+	// of the output, which go through small buffers
+	DWORD renderOfflineMapped(OfflineConvolution<float>& conv, const TCHAR szInputFile[MAX_PATH], const TCHAR szOutputFile[MAX_PATH],
+								  const float fAttenuation)
+	{
+		conv.Flush();
+
+		MappedSoundFile In(szInputFile, conv.nInputChannels(), conv.nSamplesPerSec());
+
+		const WORD nInputChannels = conv.nInputChannels();
+		const WORD nOutputChannels = conv.nOutputChannels();
+		if(In.nChannels() != nInputChannels)
+			throw wavfileException("Number of channels does not match the filter paths", szInputFile, "");
+
+		const ULONGLONG nInputFrames = In.nFrames();
+		const ULONGLONG nOutputFrames = nInputFrames == 0 ? 0 : nInputFrames + conv.nTailLength();
+
+		const DWORD nChunkLength = ((OFFLINE_CHUNK_LENGTH + conv.nBlockLength() - 1) / conv.nBlockLength()) * conv.nBlockLength();
+		std::vector<float> pfInputSamples(nChunkLength * nInputChannels);
+		std::vector<float> pfOutputSamples(nChunkLength * nOutputChannels);
+
+		// Write out in the same format as the input file, but with the right number of output channels
+		MappedSoundFile Out(szOutputFile, In.bHeaderless(), nOutputChannels, In.nSamplesPerSec(), nOutputFrames);
+
+		ULONGLONG nTotalFramesRead = 0;
+		ULONGLONG nTotalFramesWritten = 0;
+		while (nTotalFramesWritten < nOutputFrames)
+		{
+			// Once the input is exhausted, flush out the tail
+			const float* pfInput = NULL;
+			if (nTotalFramesRead < nInputFrames)
+			{
+				const DWORD nFramesRead = static_cast<DWORD>(std::min<ULONGLONG>(nChunkLength, nInputFrames - nTotalFramesRead));
+				pfInput = In.view(nTotalFramesRead, nFramesRead);
+				if (nFramesRead < nChunkLength)
+				{
+					// Pad with zeros, to make whole blocks
+					std::copy(pfInput, pfInput + nFramesRead * nInputChannels, pfInputSamples.begin());
+					std::fill(pfInputSamples.begin() + nFramesRead * nInputChannels, pfInputSamples.end(), 0.0f);
+					pfInput = &pfInputSamples[0];
+				}
+				nTotalFramesRead += nFramesRead;
+			}
+
+			const DWORD nToWrite = static_cast<DWORD>(std::min<ULONGLONG>(nChunkLength, nOutputFrames - nTotalFramesWritten));
+			float* pfOutput = Out.view(nTotalFramesWritten, nToWrite);
+			if (nToWrite == nChunkLength)
+			{
+				conv.Process(pfInput, pfOutput, nChunkLength, fAttenuation);
+			}
+			else
+			{
+				conv.Process(pfInput, &pfOutputSamples[0], nChunkLength, fAttenuation);
+				std::copy(pfOutputSamples.begin(), pfOutputSamples.begin() + nToWrite * nOutputChannels, pfOutput);
+			}
+
+			nTotalFramesWritten += nToWrite;
+		}
+
+		return static_cast<DWORD>(nTotalFramesWritten);
+	}
+}
+
+DWORD renderOffline(OfflineConvolution<float>& conv, const TCHAR szInputFile[MAX_PATH], const TCHAR szOutputFile[MAX_PATH],
+					const float fAttenuation, const bool bMapFiles, PipelineStats& stats)
+{
+	stats = PipelineStats();
+	if (bMapFiles && MappedSoundFile::isMappable(szInputFile))
+		return renderOfflineMapped(conv, szInputFile, szOutputFile, fAttenuation);
+
+	// Otherwise overlap decoding and encoding with convolution
+	const DWORD nChunkLength = ((OFFLINE_CHUNK_LENGTH + conv.nBlockLength() - 1) / conv.nBlockLength()) * conv.nBlockLength();
+	return renderPipelined(conv, szInputFile, szOutputFile, fAttenuation, nChunkLength, stats);
+}
+
+#endif
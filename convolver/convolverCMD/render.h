@@ -0,0 +1,45 @@
+#pragma once
+// Convolver: DSP plug-in for Windows Media Player that convolves an impulse respose
+// filter it with the input stream.
+//
+// Copyright (C) 2005  John Pavel
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//
+//
+/////////////////////////////////////////////////////////////////////////////
+//
+// render.h : Convolve one sound file into another
+//
+/////////////////////////////////////////////////////////////////////////////
+
+#include "convolution\config.h"
+#include "convolution\convolution.h"
+#include "convolution\offline.h"
+#include "pipeline.h"
+
+// Convolve one sound file into another, using conv (which is flushed first).  nPartitions == 0 => overlap-save.
+// The output lags the input by half a partition, and is as long as the input rounded up to a whole number of
+// filter lengths, less that lag.  Returns the number of frames written.
+DWORD renderFile(Convolution<float>& conv, const TCHAR szInputFile[MAX_PATH], const TCHAR szOutputFile[MAX_PATH],
+				 const DWORD nPartitions, const float fAttenuation);
+
+// Convolve one sound file into another, using the offline engine (which is flushed first).  The output is not
+// delayed, and includes the whole of the filter tail.  If bMapFiles and the input is a 32-bit float WAV or headerless
+// file, the samples are read from, and written to, file mappings, rather than copied through libsndfile.
+// Otherwise reading, convolving and writing are pipelined, and stats says where the time went (stats.nChunks == 0
+// if the files were mapped).  Returns the number of frames written.
+DWORD renderOffline(OfflineConvolution<float>& conv, const TCHAR szInputFile[MAX_PATH], const TCHAR szOutputFile[MAX_PATH],
+					const float fAttenuation, const bool bMapFiles, PipelineStats& stats);
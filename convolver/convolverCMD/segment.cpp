@@ -0,0 +1,294 @@
+// Convolver: DSP plug-in for Windows Media Player that convolves an impulse respose
+// filter it with the input stream.
+//
+// Copyright (C) 2005  John Pavel
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//
+//
+/////////////////////////////////////////////////////////////////////////////
+//
+// segment.cpp : Render a single long sound file on several cores
+//
+
+#include "stdafx.h"
+#include "segment.h"
+#include "render.h"
+#include "convolution\wavefile.h"
+#include "debugging\fasttiming.h"
+#include <windows.h>
+#include <process.h>
+#include <algorithm>
+#include <cmath>
+
+#ifdef LIBSNDFILE
+
+namespace
+{
+	// Length of each segment, in filter lengths.  Flushing the tail out of each segment costs roughly
+	// 1/SEGMENT_FILTER_LENGTHS of the work, so longer segments waste less, at the price of more memory.
+	const DWORD SEGMENT_FILTER_LENGTHS = 16;
+
+	// The state handed to each worker thread
+	struct SegmentWorker
+	{
+		Holder< Convolution<float> >	conv;			// this worker's engine
+		std::vector<float>				InputSamples;	// the segment, followed by zeros
+		std::vector<float>				OutputSamples;	// the response to the segment, including its tail
+		DWORD							nPartitions;
+		float							fAttenuation;
+		bool							bActive;		// whether this worker has a segment in the current wave
+		std::string						szError;		// empty if rendered successfully
+
+		SegmentWorker(const ChannelPaths& Mixer, const DWORD nSegmentLength, const DWORD nTailLength,
+			const DWORD nPartitions, const float fAttenuation) :
+		conv(new Convolution<float>(Mixer)),
+			InputSamples((nSegmentLength + nTailLength + Mixer.nHalfPartitionLength()) * Mixer.nInputChannels()),
+			OutputSamples((nSegmentLength + nTailLength) * Mixer.nOutputChannels()),
+			nPartitions(nPartitions), fAttenuation(fAttenuation), bActive(false) {}
+	};
+
+	unsigned __stdcall segmentWorkerThread(void* pWorker)
+	{
+		SegmentWorker& worker = *static_cast<SegmentWorker*>(pWorker);
+		const ConvertSample_ieeefloat<float> convertor;
+		const DWORD nFrames = static_cast<DWORD>(worker.InputSamples.size() / worker.conv->Mixer.nInputChannels());
+
+		try
+		{
+			// Each segment starts from silence.  The output lags the input by half a partition, so
+			// the extra half partition of zeros at the end of InputSamples brings out all of the tail.
+			worker.conv->Flush();
+
+			// nPartitions == 0 => use overlap-save version
+			const DWORD cbGenerated = worker.nPartitions == 0 ?
+				worker.conv->doConvolution(reinterpret_cast<BYTE*>(&worker.InputSamples[0]),
+				reinterpret_cast<BYTE*>(&worker.OutputSamples[0]), &convertor, &convertor, nFrames, worker.fAttenuation)
+				:
+				worker.conv->doPartitionedConvolution(reinterpret_cast<BYTE*>(&worker.InputSamples[0]),
+				reinterpret_cast<BYTE*>(&worker.OutputSamples[0]), &convertor, &convertor, nFrames, worker.fAttenuation);
+
+			if (cbGenerated != worker.OutputSamples.size() * sizeof(float))
+				worker.szError = "Internal error: unexpected segment output length";
+		}
+		catch(const std::exception& error)
+		{
+			worker.szError = error.what();
+		}
+		catch(...)
+		{
+			worker.szError = "Failed";
+		}
+
+		return 0;
+	}
+
+	// Convolve the segments of all the active workers in parallel, and wait for them all to finish
+	void renderWave(boost::ptr_vector<SegmentWorker>& workers)
+	{
+		std::vector<HANDLE> hThreads;
+		for(boost::ptr_vector<SegmentWorker>::size_type i = 0; i < workers.size(); ++i)
+		{
+			if (!workers[i].bActive)
+				continue;
+
+			const uintptr_t hThread = ::_beginthreadex(NULL, 0, segmentWorkerThread, &workers[i], 0, NULL);
+			if (hThread == 0)
+			{
+				segmentWorkerThread(&workers[i]);	// Do it in this thread, then
+			}
+			else
+			{
+				hThreads.push_back(reinterpret_cast<HANDLE>(hThread));
+			}
+		}
+
+		// WaitForMultipleObjects can only wait on MAXIMUM_WAIT_OBJECTS at a time
+		for(std::vector<HANDLE>::size_type i = 0; i < hThreads.size(); i += MAXIMUM_WAIT_OBJECTS)
+		{
+			::WaitForMultipleObjects(static_cast<DWORD>(std::min<std::vector<HANDLE>::size_type>(MAXIMUM_WAIT_OBJECTS, hThreads.size() - i)),
+				&hThreads[i], TRUE, INFINITE);
+		}
+		for(std::vector<HANDLE>::size_type i = 0; i < hThreads.size(); ++i)
+			::CloseHandle(hThreads[i]);
+
+		for(boost::ptr_vector<SegmentWorker>::size_type i = 0; i < workers.size(); ++i)
+		{
+			if (workers[i].bActive && !workers[i].szError.empty())
+				throw convolutionException(workers[i].szError);
+		}
+	}
+
+	// The largest absolute difference between the samples of two sound files, which must be the same length
+	float maxDifference(const TCHAR szFile1[MAX_PATH], const TCHAR szFile2[MAX_PATH], const DWORD nSampleRate)
+	{
+		SF_INFO sf_info1; ::ZeroMemory(&sf_info1, sizeof(sf_info1));
+		SF_INFO sf_info2; ::ZeroMemory(&sf_info2, sizeof(sf_info2));
+		CWaveFileHandle Wav1(szFile1, SFM_READ, &sf_info1, nSampleRate);
+		CWaveFileHandle Wav2(szFile2, SFM_READ, &sf_info2, nSampleRate);
+
+		if (sf_info1.frames != sf_info2.frames || sf_info1.channels != sf_info2.channels)
+			throw wavfileException("Segmented output differs in length from the sequential output", szFile2, "");
+
+		const sf_count_t nChunk = 65536;	// frames
+		std::vector<float> Samples1(static_cast<std::vector<float>::size_type>(nChunk * sf_info1.channels));
+		std::vector<float> Samples2(Samples1.size());
+
+		float fMaxDifference = 0;
+		for(sf_count_t nFrames = 0; nFrames < sf_info1.frames; nFrames += nChunk)
+		{
+			const sf_count_t nToRead = std::min<sf_count_t>(nChunk, sf_info1.frames - nFrames);
+			if (Wav1.readf_float(&Samples1[0], nToRead) != nToRead)
+				throw wavfileException("Failed to read", szFile1, "");
+			if (Wav2.readf_float(&Samples2[0], nToRead) != nToRead)
+				throw wavfileException("Failed to read", szFile2, "");
+
+			for(std::vector<float>::size_type i = 0; i < static_cast<std::vector<float>::size_type>(nToRead * sf_info1.channels); ++i)
+				fMaxDifference = std::max(fMaxDifference, std::abs(Samples1[i] - Samples2[i]));
+		}
+
+		return fMaxDifference;
+	}
+}
+
+DWORD renderSegmented(const ChannelPaths& Mixer, const TCHAR szInputFile[MAX_PATH], const TCHAR szOutputFile[MAX_PATH],
+					  const DWORD nPartitions, const float fAttenuation, const unsigned int nThreads)
+{
+	assert(nThreads > 0);
+
+	SF_INFO sf_info; ::ZeroMemory(&sf_info, sizeof(sf_info));
+	CWaveFileHandle WavIn(szInputFile, SFM_READ, &sf_info, Mixer.nSamplesPerSec());
+
+	const int nInputChannels = Mixer.nInputChannels();
+	const int nOutputChannels = Mixer.nOutputChannels();
+	if(sf_info.channels != nInputChannels)
+		throw wavfileException("Number of channels does not match the filter paths", szInputFile, "");
+
+	const sf_count_t nInputFrames = sf_info.frames;
+
+	// Produce as much as the sequential path, which feeds whole filter lengths (padding the last with zeros),
+	// and whose output lags its input by half a partition
+	const DWORD cBufferLength = Mixer.nFilterLength();
+	const sf_count_t nOutputFrames = nInputFrames == 0 ? 0 :
+		((nInputFrames + cBufferLength - 1) / cBufferLength) * cBufferLength - Mixer.nHalfPartitionLength();
+
+	// The response to a segment outlasts it by the filter length, plus the input and output delays
+	// (each less than half a partition)
+	const DWORD nTailLength = Mixer.nFilterLength() + Mixer.nPartitionLength();
+	const DWORD nSegmentLength = SEGMENT_FILTER_LENGTHS * Mixer.nFilterLength();
+	const DWORD nWaveLength = nThreads * nSegmentLength;	// frames rendered in parallel at a time
+	assert(nWaveLength >= nTailLength);
+
+	// Write out in the same format as the input file, but with the right number of output channels
+	sf_info.channels = nOutputChannels;
+	CWaveFileHandle WavOut(szOutputFile, SFM_WRITE, &sf_info, sf_info.samplerate);
+
+	// Build the worker engines before starting
+	boost::ptr_vector<SegmentWorker> workers;
+	for(unsigned int i = 0; i < nThreads; ++i)
+		workers.push_back(new SegmentWorker(Mixer, nSegmentLength, nTailLength, nPartitions, fAttenuation));
+
+	// The output of the current wave, preceded by the tail carried over from the previous one
+	std::vector<float> Accumulator((nWaveLength + nTailLength) * nOutputChannels);
+
+	sf_count_t nFramesRead = 0;
+	sf_count_t nFramesWritten = 0;
+	while (nFramesRead < nInputFrames)
+	{
+		// Read the next segment for each worker
+		for(unsigned int i = 0; i < nThreads; ++i)
+		{
+			SegmentWorker& worker = workers[i];
+			const sf_count_t nToRead = std::min<sf_count_t>(nSegmentLength, nInputFrames - nFramesRead);
+			worker.bActive = nToRead > 0;
+			if (!worker.bActive)
+				continue;
+
+			if (WavIn.readf_float(&worker.InputSamples[0], nToRead) != nToRead)
+				throw wavfileException("Failed to read input segment", szInputFile, "");
+			std::fill(worker.InputSamples.begin() + static_cast<std::vector<float>::size_type>(nToRead * nInputChannels),
+				worker.InputSamples.end(), 0.0f);
+			nFramesRead += nToRead;
+		}
+
+		renderWave(workers);
+
+		// Sum the overlapping responses, in segment order
+		for(unsigned int i = 0; i < nThreads; ++i)
+		{
+			if (!workers[i].bActive)
+				continue;
+
+			const std::vector<float>& OutputSamples = workers[i].OutputSamples;
+			float* pAccumulator = &Accumulator[i * nSegmentLength * nOutputChannels];
+			for(std::vector<float>::size_type j = 0; j < OutputSamples.size(); ++j)
+				pAccumulator[j] += OutputSamples[j];
+		}
+
+		const sf_count_t nToWrite = std::min<sf_count_t>(nWaveLength, nOutputFrames - nFramesWritten);
+		if (WavOut.writef_float(&Accumulator[0], nToWrite) != nToWrite)
+			throw wavfileException("Failed to write output buffer", szOutputFile, "");
+		nFramesWritten += nToWrite;
+
+		// Carry the tail over into the next wave
+		std::copy(Accumulator.begin() + nWaveLength * nOutputChannels, Accumulator.end(), Accumulator.begin());
+		std::fill(Accumulator.begin() + nTailLength * nOutputChannels, Accumulator.end(), 0.0f);
+	}
+
+	// The last of the output is in the tail of the last wave
+	const sf_count_t nToWrite = std::min<sf_count_t>(nTailLength, nOutputFrames - nFramesWritten);
+	if (nToWrite > 0)
+	{
+		if (WavOut.writef_float(&Accumulator[0], nToWrite) != nToWrite)
+			throw wavfileException("Failed to write output buffer", szOutputFile, "");
+		nFramesWritten += nToWrite;
+	}
+
+	assert(nFramesWritten == nOutputFrames);
+	return static_cast<DWORD>(nFramesWritten);
+}
+
+void sweepSegmented(Convolution<float>& conv, const TCHAR szInputFile[MAX_PATH], const TCHAR szOutputFile[MAX_PATH],
+					const DWORD nPartitions, const float fAttenuation, const unsigned int nThreads)
+{
+	apHiResElapsedTime t;
+	const DWORD nFrames = renderFile(conv, szInputFile, szOutputFile, nPartitions, fAttenuation);
+	const double fSequential = t.msec();
+	const double fAudio = 1000.0 * nFrames / conv.Mixer.nSamplesPerSec();	// milliseconds
+
+	// Put the segmented output alongside the sequential, keeping the extension (which determines the format)
+	std::basic_string< _TCHAR > szSegmentedFile(szOutputFile);
+	const std::basic_string< _TCHAR >::size_type idx = szSegmentedFile.find_last_of(TEXT("."));
+	szSegmentedFile.insert(idx == std::basic_string< _TCHAR >::npos ? szSegmentedFile.length() : idx, TEXT("_segmented"));
+
+	std::wcerr << "Threads\tmilliseconds\tx realtime\tspeedup\tmax difference" << std::endl;
+	std::wcerr << "sequential\t" << fSequential << "\t" << (fSequential > 0 ? fAudio / fSequential : 0) << "\t1\t0" << std::endl;
+
+	for(unsigned int nThread = 1; nThread <= nThreads; ++nThread)
+	{
+		t.reset();
+		renderSegmented(conv.Mixer, szInputFile, szSegmentedFile.c_str(), nPartitions, fAttenuation, nThread);
+		const double fElapsed = t.msec();
+
+		const float fMaxDifference = maxDifference(szOutputFile, szSegmentedFile.c_str(), conv.Mixer.nSamplesPerSec());
+
+		std::wcerr << nThread << "\t" << fElapsed << "\t" << (fElapsed > 0 ? fAudio / fElapsed : 0) << "\t"
+			<< (fElapsed > 0 ? fSequential / fElapsed : 0) << "\t" << fMaxDifference << std::endl;
+	}
+
+	::DeleteFile(szSegmentedFile.c_str());
+}
+
+#endif
@@ -0,0 +1,45 @@
+#pragma once
+// Convolver: DSP plug-in for Windows Media Player that convolves an impulse respose
+// filter it with the input stream.
+//
+// Copyright (C) 2005  John Pavel
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//
+//
+/////////////////////////////////////////////////////////////////////////////
+//
+// segment.h : Render a single long sound file on several cores
+//
+// Convolution is linear, so the input is cut into segments that are each
+// convolved by a worker engine (sharing the filter spectra) on its own thread,
+// followed by enough zeros to flush out the filter tail.  The tails overlap the
+// following segments and are summed in.  The output has the same length as, and
+// (to within float rounding) the same content as, that of the sequential path.
+//
+/////////////////////////////////////////////////////////////////////////////
+
+#include "convolution\config.h"
+#include "convolution\convolution.h"
+
+// Segmented render of szInputFile to szOutputFile using nThreads worker engines sharing Mixer.
+// Returns the number of frames written.  nPartitions == 0 => overlap-save.
+DWORD renderSegmented(const ChannelPaths& Mixer, const TCHAR szInputFile[MAX_PATH], const TCHAR szOutputFile[MAX_PATH],
+					  const DWORD nPartitions, const float fAttenuation, const unsigned int nThreads);
+
+// Render szInputFile sequentially, then segmented with 1..nThreads threads, checking each result against the
+// sequential one and reporting the speedup.  The sequential result is left in szOutputFile.
+void sweepSegmented(Convolution<float>& conv, const TCHAR szInputFile[MAX_PATH], const TCHAR szOutputFile[MAX_PATH],
+					const DWORD nPartitions, const float fAttenuation, const unsigned int nThreads);
@@ -21,48 +21,335 @@
 //
 // generate_test_IRs.cpp : Defines the entry point for the console application.
 //
+// Writes a perfect Dirac delta, or a corpus of synthetic impulse responses
+// (exponentially decaying noise, sparse echoes and dense short FIRs) in a
+// range of lengths, channel counts and sample rates, with a config for each
+// that refers to its filter by a relative path, so that the benchmarks can be
+// run anywhere.  The corpus is deterministic for a given seed.
+//
 
 #include "stdafx.h"
 #include "Common\dxstdafx.h"
+#include <math.h>
+#include <vector>
 
 int generate_perfect_dirac_delta(int nSamplesPerSec, WORD nChannels, int nSilence);
+int generate_corpus(const TCHAR* szDirectory, const std::vector<double>& SampleRates, const std::vector<double>& Lengths,
+					const std::vector<double>& RT60s, unsigned int nSeed);
 
-int _tmain(int argc, _TCHAR* argv[])
+namespace
 {
-	if (argc != 4)
+	// The n->n layouts for which a config is written
+	const WORD Layouts[] = { 1, 2, 6, 26 };
+	const int nLayouts = sizeof(Layouts) / sizeof(Layouts[0]);
+
+	// Dense short FIRs (eg, equalization or crossovers) are a fixed few taps long
+	const int FIRLengths[] = { 64, 512 };
+	const int nFIRLengths = sizeof(FIRLengths) / sizeof(FIRLengths[0]);
+
+	const double PI = 3.14159265358979323846;
+	const double LN_1000 = 6.90775527898213705205;	// a 60dB decay
+
+	// xorshift, so that the corpus is the same wherever it is generated
+	class Noise
+	{
+	public:
+		explicit Noise(unsigned int nSeed) : x_(nSeed == 0 ? 2463534242U : nSeed) {}
+
+		// Uniform on [-1, 1)
+		float operator()()
+		{
+			x_ ^= x_ << 13;
+			x_ ^= x_ >> 17;
+			x_ ^= x_ << 5;
+			return static_cast<float>(x_ / 2147483648.0 - 1.0);
+		}
+
+	private:
+		unsigned int x_;
+	};
+
+	// A direct impulse, followed (after 5ms) by noise that decays by 60dB in fRT60 seconds
+	void decaying_noise(float* ir, int nLength, int nSamplesPerSec, double fRT60, Noise& noise)
+	{
+		const int nPreDelay = nSamplesPerSec / 200;
+		ir[0] = 1.0f;
+		for (int i = 1; i < nLength; ++i)
+		{
+			ir[i] = i < nPreDelay ? 0.0f :
+				static_cast<float>(0.3 * noise() * exp(-LN_1000 * i / (fRT60 * nSamplesPerSec)));
+		}
+	}
+
+	// A direct impulse and a scattering of discrete echoes, of either sign, decaying by 60dB over the filter
+	void sparse_echoes(float* ir, int nLength, Noise& noise)
+	{
+		for (int i = 0; i < nLength; ++i)
+			ir[i] = 0.0f;
+		ir[0] = 1.0f;
+
+		const int nEchoes = nLength / 2048 + 8 > 64 ? 64 : nLength / 2048 + 8;
+		for (int nEcho = 0; nEcho < nEchoes; ++nEcho)
+		{
+			const int i = 1 + static_cast<int>((noise() + 1.0f) / 2 * (nLength - 2));
+			ir[i] += static_cast<float>((noise() < 0 ? -0.6 : 0.6) * exp(-LN_1000 * i / nLength));
+		}
+	}
+
+	// A Hamming-windowed sinc lowpass, with a cut-off somewhere between 5% and 45% of the sample rate
+	void dense_fir(float* ir, int nLength, Noise& noise)
+	{
+		const double fCutoff = 0.05 + 0.2 * (noise() + 1.0f);
+		const double fCentre = (nLength - 1) / 2.0;
+		for (int i = 0; i < nLength; ++i)
+		{
+			const double x = i - fCentre;
+			const double fSinc = x == 0 ? 2 * fCutoff : sin(2 * PI * fCutoff * x) / (PI * x);
+			ir[i] = static_cast<float>(fSinc * (0.54 - 0.46 * cos(2 * PI * i / (nLength - 1))));
+		}
+	}
+
+	// Interleaved IEEE float samples
+	HRESULT write_ir(TCHAR* szFileName, const std::vector<float>& samples, int nSamplesPerSec, WORD nChannels)
+	{
+		HRESULT hr = S_OK;
+
+		WAVEFORMATEX  wfx;
+		ZeroMemory( &wfx, sizeof(wfx));
+		wfx.wFormatTag = WAVE_FORMAT_IEEE_FLOAT;
+		wfx.nSamplesPerSec = nSamplesPerSec;
+		wfx.wBitsPerSample =  sizeof(float) * 8; 
+		wfx.nChannels = nChannels;
+		wfx.nBlockAlign = wfx.nChannels * (wfx.wBitsPerSample / 8);
+		wfx.nAvgBytesPerSec = wfx.nBlockAlign * wfx.nSamplesPerSec;
+
+		CWaveFile impulseFile;
+		if (FAILED(hr = impulseFile.Open(szFileName, &wfx, WAVEFILE_WRITE)))
+		{
+			return DXTRACE_ERR_MSGBOX(TEXT("Failed to open impulse file for writing"), hr);
+		}
+
+		UINT nSizeWrote = 0;
+		if (FAILED(hr = impulseFile.Write(static_cast<UINT>(samples.size() * sizeof(float)),
+			(BYTE *) const_cast<float*>(&samples[0]), &nSizeWrote)))
+		{
+			return DXTRACE_ERR_MSGBOX(TEXT("Failed to write to impulse file"), hr);
+		}
+
+		return impulseFile.Close();
+	}
+
+	// nChannels paths, each taking channel n of the filter from input n to output n
+	HRESULT write_config(const TCHAR* szFileName, const TCHAR* szFilterFileName, int nSamplesPerSec, WORD nChannels)
+	{
+		FILE* config = _tfopen(szFileName, TEXT("w"));
+		if (config == NULL)
+		{
+			return DXTRACE_ERR_MSGBOX(TEXT("Failed to open config file for writing"), E_FAIL);
+		}
+
+		_ftprintf(config, TEXT("%i %i %i 0\n"), nSamplesPerSec, nChannels, nChannels);
+		for (int nDelays = 0; nDelays < 2; ++nDelays)	// input, then output, delays
+		{
+			for (WORD nChannel = 0; nChannel < nChannels; ++nChannel)
+				_ftprintf(config, nChannel == 0 ? TEXT("0") : TEXT(" 0"));
+			_ftprintf(config, TEXT("\n"));
+		}
+		for (WORD nChannel = 0; nChannel < nChannels; ++nChannel)
+		{
+			_ftprintf(config, TEXT("%s\n%i\n%i.0\n%i.0\n"), szFilterFileName, nChannel, nChannel, nChannel);
+		}
+
+		return fclose(config) == 0 ? S_OK : E_FAIL;
+	}
+
+	// One file of the corpus, and its config, from a family that generates one channel at a time
+	template <typename Generate>
+	HRESULT write_corpus_entry(const TCHAR* szDirectory, const TCHAR* szName, int nLength, int nSamplesPerSec,
+		WORD nChannels, Generate generate)
 	{
-		_tprintf(TEXT("Usage: generate_test_IRs <SamplesPerSec> <Channels> <Silence>\n"));
-		return 1;
+		HRESULT hr = S_OK;
+
+		std::vector<float> channel(nLength);
+		std::vector<float> samples(static_cast<std::vector<float>::size_type>(nLength) * nChannels);
+		for (WORD nChannel = 0; nChannel < nChannels; ++nChannel)
+		{
+			generate(&channel[0]);
+			for (int i = 0; i < nLength; ++i)
+				samples[i * nChannels + nChannel] = channel[i];
+		}
+
+		TCHAR szFilterFileName[MAX_PATH];
+		_stprintf(szFilterFileName, TEXT("filters\\%s-%i-%ich-%i.wav"), szName, nSamplesPerSec, nChannels, nLength);
+		TCHAR szPath[MAX_PATH];
+		_stprintf(szPath, TEXT("%s\\%s"), szDirectory, szFilterFileName);
+		if (FAILED(hr = write_ir(szPath, samples, nSamplesPerSec, nChannels)))
+			return hr;
+
+		_stprintf(szPath, TEXT("%s\\%s-%i-%ich-%i.txt"), szDirectory, szName, nSamplesPerSec, nChannels, nLength);
+		if (FAILED(hr = write_config(szPath, szFilterFileName, nSamplesPerSec, nChannels)))
+			return hr;
+
+		_tprintf(TEXT("%s\n"), szPath);
+		return hr;
 	}
 
+	// Binders for write_corpus_entry, as there is no boost here
+	struct DecayingNoise
+	{
+		int nLength; int nSamplesPerSec; double fRT60; Noise& noise;
+		DecayingNoise(int nLength, int nSamplesPerSec, double fRT60, Noise& noise) :
+			nLength(nLength), nSamplesPerSec(nSamplesPerSec), fRT60(fRT60), noise(noise) {}
+		void operator()(float* ir) const { decaying_noise(ir, nLength, nSamplesPerSec, fRT60, noise); }
+	};
+
+	struct SparseEchoes
+	{
+		int nLength; Noise& noise;
+		SparseEchoes(int nLength, Noise& noise) : nLength(nLength), noise(noise) {}
+		void operator()(float* ir) const { sparse_echoes(ir, nLength, noise); }
+	};
+
+	struct DenseFIR
+	{
+		int nLength; Noise& noise;
+		DenseFIR(int nLength, Noise& noise) : nLength(nLength), noise(noise) {}
+		void operator()(float* ir) const { dense_fir(ir, nLength, noise); }
+	};
+
+	// Parse a comma-separated list of numbers, replacing values.  false => malformed
+	bool parse_list(const TCHAR* szList, std::vector<double>& values)
+	{
+		values.clear();
+		while (*szList != 0)
+		{
+			TCHAR* szEnd = NULL;
+			const double value = _tcstod(szList, &szEnd);
+			if (szEnd == szList || value <= 0 || (*szEnd != 0 && *szEnd != TEXT(',')))
+				return false;
+			values.push_back(value);
+			szList = *szEnd == 0 ? szEnd : szEnd + 1;
+		}
+		return !values.empty();
+	}
+}
 
+int _tmain(int argc, _TCHAR* argv[])
+{
+	if (argc >= 3 && _tcscmp(argv[1], TEXT("--corpus")) == 0)
+	{
+		const double DefaultSampleRates[] = { 44100, 48000, 96000 };
+		const double DefaultLengths[] = { 4096, 65536 };
+		const double DefaultRT60s[] = { 0.3, 1.0, 2.5 };
+		std::vector<double> SampleRates(DefaultSampleRates, DefaultSampleRates + sizeof(DefaultSampleRates) / sizeof(DefaultSampleRates[0]));
+		std::vector<double> Lengths(DefaultLengths, DefaultLengths + sizeof(DefaultLengths) / sizeof(DefaultLengths[0]));
+		std::vector<double> RT60s(DefaultRT60s, DefaultRT60s + sizeof(DefaultRT60s) / sizeof(DefaultRT60s[0]));
+		unsigned int nSeed = 1;
 
+		bool bUsage = false;
+		for (int nArg = 3; nArg < argc && !bUsage; nArg += 2)
+		{
+			if (nArg + 1 == argc)
+				bUsage = true;
+			else if (_tcscmp(argv[nArg], TEXT("--rates")) == 0)
+				bUsage = !parse_list(argv[nArg + 1], SampleRates);
+			else if (_tcscmp(argv[nArg], TEXT("--lengths")) == 0)
+				bUsage = !parse_list(argv[nArg + 1], Lengths);
+			else if (_tcscmp(argv[nArg], TEXT("--rt60")) == 0)
+				bUsage = !parse_list(argv[nArg + 1], RT60s);
+			else if (_tcscmp(argv[nArg], TEXT("--seed")) == 0)
+				nSeed = _tcstoul(argv[nArg + 1], NULL, 10);
+			else
+				bUsage = true;
+		}
 
+		if (!bUsage)
+			return generate_corpus(argv[2], SampleRates, Lengths, RT60s, nSeed);
+	}
+	else if (argc == 4)
+	{
 #ifdef UNICODE 
-	CHAR strTmp[2*(sizeof(10)+1)];	// SIZE equals (2*(sizeof(tstr)+1)). This ensures enough
-									// room for the multibyte characters if they are two
-									// bytes long and a terminating null character.
+		CHAR strTmp[2*(sizeof(10)+1)];	// SIZE equals (2*(sizeof(tstr)+1)). This ensures enough
+										// room for the multibyte characters if they are two
+										// bytes long and a terminating null character.
 
-	wcstombs(strTmp, (const wchar_t *) argv[1], sizeof(strTmp)); 
-	int nSamplesPerSec =  atoi(strTmp);
-	wcstombs(strTmp, (const wchar_t *) argv[2], sizeof(strTmp)); 
-	int nChannels=  atoi(strTmp);
-	wcstombs(strTmp, (const wchar_t *) argv[3], sizeof(strTmp)); 
-	int nSilence=  atoi(strTmp); 
+		wcstombs(strTmp, (const wchar_t *) argv[1], sizeof(strTmp)); 
+		int nSamplesPerSec =  atoi(strTmp);
+		wcstombs(strTmp, (const wchar_t *) argv[2], sizeof(strTmp)); 
+		int nChannels=  atoi(strTmp);
+		wcstombs(strTmp, (const wchar_t *) argv[3], sizeof(strTmp)); 
+		int nSilence=  atoi(strTmp); 
 
 #else 
 
-	int nSamplesPerSec = atoi(argv[1]);
-	int nChannels= atoi(argv[2]);
-	int nSilence= atoi(argv[3]);
+		int nSamplesPerSec = atoi(argv[1]);
+		int nChannels= atoi(argv[2]);
+		int nSilence= atoi(argv[3]);
 
 #endif
 
-	generate_perfect_dirac_delta(nSamplesPerSec, nChannels, nSilence);
-	return 0;
+		generate_perfect_dirac_delta(nSamplesPerSec, nChannels, nSilence);
+		return 0;
+	}
+
+	_tprintf(TEXT("Usage: generate_test_IRs <SamplesPerSec> <Channels> <Silence>\n"));
+	_tprintf(TEXT("       generate_test_IRs --corpus <directory> [--rates 44100,48000,96000] [--lengths 4096,65536]\n"));
+	_tprintf(TEXT("                         [--rt60 0.3,1.0,2.5] [--seed 1]\n"));
+	_tprintf(TEXT("       The corpus has decaying noise with each RT60 (seconds), and sparse echoes, of each length,\n"));
+	_tprintf(TEXT("       and dense FIRs, at each sample rate, with 1, 2, 6 and 26 channels, in directory\\filters,\n"));
+	_tprintf(TEXT("       and a config for each in directory, for convolverCMD or perftest\n"));
+	return 1;
 }
 
 
+int generate_corpus(const TCHAR* szDirectory, const std::vector<double>& SampleRates, const std::vector<double>& Lengths,
+					const std::vector<double>& RT60s, unsigned int nSeed)
+{
+	HRESULT hr = S_OK;
+
+	TCHAR szFilters[MAX_PATH];
+	_stprintf(szFilters, TEXT("%s\\filters"), szDirectory);
+	if ((!::CreateDirectory(szDirectory, NULL) && ::GetLastError() != ERROR_ALREADY_EXISTS) ||
+		(!::CreateDirectory(szFilters, NULL) && ::GetLastError() != ERROR_ALREADY_EXISTS))
+	{
+		return DXTRACE_ERR_MSGBOX(TEXT("Failed to create the corpus directories"), HRESULT_FROM_WIN32(::GetLastError()));
+	}
+
+	Noise noise(nSeed);
+	for (std::vector<double>::size_type nRate = 0; nRate < SampleRates.size(); ++nRate)
+	{
+		const int nSamplesPerSec = static_cast<int>(SampleRates[nRate]);
+		for (int nLayout = 0; nLayout < nLayouts; ++nLayout)
+		{
+			const WORD nChannels = Layouts[nLayout];
+			for (std::vector<double>::size_type nLength = 0; nLength < Lengths.size(); ++nLength)
+			{
+				const int nSamples = static_cast<int>(Lengths[nLength]);
+				for (std::vector<double>::size_type nRT60 = 0; nRT60 < RT60s.size(); ++nRT60)
+				{
+					TCHAR szName[32];
+					_stprintf(szName, TEXT("decay-rt%ims"), static_cast<int>(RT60s[nRT60] * 1000 + 0.5));
+					if (FAILED(hr = write_corpus_entry(szDirectory, szName, nSamples, nSamplesPerSec, nChannels,
+						DecayingNoise(nSamples, nSamplesPerSec, RT60s[nRT60], noise))))
+						return hr;
+				}
+
+				if (FAILED(hr = write_corpus_entry(szDirectory, TEXT("echoes"), nSamples, nSamplesPerSec, nChannels,
+					SparseEchoes(nSamples, noise))))
+					return hr;
+			}
+
+			for (int nFIRLength = 0; nFIRLength < nFIRLengths; ++nFIRLength)
+			{
+				if (FAILED(hr = write_corpus_entry(szDirectory, TEXT("fir"), FIRLengths[nFIRLength], nSamplesPerSec, nChannels,
+					DenseFIR(FIRLengths[nFIRLength], noise))))
+					return hr;
+			}
+		}
+	}
+
+	return hr;
+}
 
 int generate_perfect_dirac_delta(int nSamplesPerSec, WORD nChannels, int nSilence)
 {
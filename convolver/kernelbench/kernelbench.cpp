@@ -0,0 +1,599 @@
+// Convolver: DSP plug-in for Windows Media Player that convolves an impulse respose
+// filter it with the input stream.
+//
+// Copyright (C) 2005  John Pavel
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//
+/////////////////////////////////////////////////////////////////////////////
+//
+// kernelbench.cpp : Time the inner loops of the convolution engines in isolation
+//
+// Each kernel is timed over a sweep of partition lengths and channel counts,
+// with warm caches (the same buffers on every call) and with cold caches
+// (stepping through a working set larger than the caches), and the results
+// are reported, as CSV, in ns/sample and GB/s.
+//
+
+#include "stdafx.h"
+#include "convolution\config.h"
+#if defined(DEBUG) || defined(_DEBUG)
+#include "debugging\debugging.h"
+#endif
+#include "debugging\fasttiming.h"
+#include "convolution\holder.h"
+#include "convolution\sample.h"
+#include "convolution\ffthelp.h"
+#include "convolution\kernels.h"
+#include "convolution\mixingmatrix.h"
+#include <iostream>
+#include <sstream>
+#include <fstream>
+#include <iomanip>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <time.h>
+#include <boost\random.hpp>
+
+namespace
+{
+	// The kernels that can be timed
+	const TCHAR* const Kernels[] = { TEXT("mix_input"), TEXT("mix_output"), TEXT("complex_mul"), TEXT("complex_mul_add"),
+		TEXT("complex_mul_add_half"), TEXT("fft_r2c"), TEXT("fft_c2r"),
+		TEXT("get_float"), TEXT("get_pcm16"), TEXT("get_pcm24"), TEXT("get_pcm32"),
+		TEXT("put_float"), TEXT("put_pcm16"), TEXT("put_pcm24"), TEXT("put_pcm32") };
+	const unsigned int nKernels = sizeof(Kernels) / sizeof(Kernels[0]);
+
+	// nCopies equally-sized, 16-byte aligned blocks of noise.  Warm caches => every call uses the first block;
+	// cold => the calls step through all of them, so that each finds its data evicted by the others
+	class WorkingSet
+	{
+	public:
+		WorkingSet(const DWORD nFloats, const DWORD nCopies) : nStride_((nFloats + 3) & ~3), nCopies_(nCopies),
+			p_(static_cast<float*>(fftwf_malloc(sizeof(float) * nStride_ * nCopies_)))
+		{
+			if (p_ == NULL)
+				throw std::bad_alloc();
+
+			typedef boost::lagged_fibonacci607 base_generator_type;
+			base_generator_type generator(static_cast<unsigned int>(std::time(NULL)));
+			boost::uniform_real<float> uni_dist(-0.5f, 0.5f);
+			boost::variate_generator<base_generator_type&, boost::uniform_real<float> > uni(generator, uni_dist);
+			std::generate(p_, p_ + nStride_ * nCopies_, uni);
+		}
+
+		~WorkingSet()
+		{
+			fftwf_free(p_);
+		}
+
+		float* operator[](const DWORD nCopy) const
+		{
+			assert(nCopy < nCopies_);
+			return p_ + nStride_ * nCopy;
+		}
+
+		DWORD nCopies() const
+		{
+			return nCopies_;
+		}
+
+	private:
+		const DWORD	nStride_;		// floats, rounded up to keep each copy aligned
+		const DWORD	nCopies_;
+		float* const p_;
+
+		WorkingSet(const WorkingSet&); // no impl.
+		const WorkingSet& operator=(const WorkingSet&); // no impl.
+	};
+
+	// A gain of 0.5 between one path and each of nChannels channels
+	std::vector<MixingMatrix::Entry> gains(const WORD nChannels, const bool bOutput)
+	{
+		std::vector<MixingMatrix::Entry> Gains;
+		for (WORD nChannel = 0; nChannel < nChannels; ++nChannel)
+		{
+			Gains.push_back(bOutput ? MixingMatrix::Entry(nChannel, 0, 0.5f) : MixingMatrix::Entry(0, nChannel, 0.5f));
+		}
+		return Gains;
+	}
+
+	// A kernel, and the layout of the floats that it works on in each copy of the working set
+	class Kernel
+	{
+	public:
+		virtual ~Kernel() {}
+
+		virtual DWORD nFloats() const = 0;			// per copy
+		virtual void prepare(float* /* p */) const {}	// once per copy, before timing
+		virtual void operator()(float* p) const = 0;
+		virtual double nSamples() const = 0;		// per call
+		virtual double nBytes() const = 0;			// loaded and stored per call
+	};
+
+	// As Convolution::mixInput, mixing nChannels inputs into the accumulator of one path through a MixingMatrix.
+	// The circular input buffer is taken as half-way round, so the matrix is applied to each half
+	class MixInput : public Kernel
+	{
+	public:
+		MixInput(const DWORD nPartitionLength, const WORD nChannels) : N_(nPartitionLength), nChannels_(nChannels),
+			Mix_(1, nChannels, gains(nChannels, false)), Sources_(nChannels) {}
+
+		DWORD nFloats() const { return (nChannels_ + 1) * N_; }
+		void operator()(float* p) const
+		{
+			float* pAccumulator = p + nChannels_ * N_;
+			const DWORD nHalf = N_ / 2;
+			for (WORD nChannel = 0; nChannel < nChannels_; ++nChannel)
+				Sources_[nChannel] = p + nChannel * N_ + nHalf;
+			Mix_.apply(&Sources_[0], &pAccumulator, N_ - nHalf);
+			pAccumulator += N_ - nHalf;
+			for (WORD nChannel = 0; nChannel < nChannels_; ++nChannel)
+				Sources_[nChannel] = p + nChannel * N_;
+			Mix_.apply(&Sources_[0], &pAccumulator, nHalf);
+		}
+		double nSamples() const { return static_cast<double>(nChannels_) * N_; }
+		double nBytes() const { return sizeof(float) * (nChannels_ + 1.0) * N_; }
+
+	private:
+		const DWORD N_;
+		const WORD nChannels_;
+		const MixingMatrix Mix_;
+		mutable std::vector<const float*> Sources_;
+	};
+
+	// As Convolution::mixOutput, mixing the second half of the output of one path into nChannels accumulators
+	class MixOutput : public Kernel
+	{
+	public:
+		MixOutput(const DWORD nPartitionLength, const WORD nChannels) : N_(nPartitionLength), nChannels_(nChannels),
+			Mix_(nChannels, 1, gains(nChannels, true)), Accumulators_(nChannels) {}
+
+		DWORD nFloats() const { return (nChannels_ + 1) * N_; }
+		void operator()(float* p) const
+		{
+			const float* pOutput = p + nChannels_ * N_ + N_ / 2;
+			for (WORD nChannel = 0; nChannel < nChannels_; ++nChannel)
+				Accumulators_[nChannel] = p + nChannel * N_;
+			Mix_.apply(&pOutput, &Accumulators_[0], N_ - N_ / 2);
+		}
+		double nSamples() const { return static_cast<double>(nChannels_) * (N_ / 2); }
+		double nBytes() const { return sizeof(float) * (nChannels_ + 1.0) * (N_ / 2); }
+
+	private:
+		const DWORD N_;
+		const WORD nChannels_;
+		const MixingMatrix Mix_;
+		mutable std::vector<float*> Accumulators_;
+	};
+
+	// The spectral product of one partition, by the kernel that the engines choose for the partition length.
+	// Each complex array is padded to keep the next aligned
+	class ComplexMul : public Kernel
+	{
+	public:
+		ComplexMul(const DWORD nPartitionLength, const bool bAdd) : N_(nPartitionLength), nComplex_(N_ / 2 + 1),
+			nStride_((2 * nComplex_ + 3) & ~3), bAdd_(bAdd),
+			Kernel_(bAdd ? select_complex_mul_add(nPartitionLength) : select_complex_mul(nPartitionLength)) {}
+
+		DWORD nFloats() const { return 3 * nStride_; }
+		void operator()(float* p) const
+		{
+			const fftwf_complex* const in1 = reinterpret_cast<const fftwf_complex*>(p);
+			const fftwf_complex* const in2 = reinterpret_cast<const fftwf_complex*>(p + nStride_);
+			fftwf_complex* const result = reinterpret_cast<fftwf_complex*>(p + 2 * nStride_);
+			Kernel_(in1, in2, result, nComplex_);
+		}
+		double nSamples() const { return N_; }
+		double nBytes() const { return (bAdd_ ? 4.0 : 3.0) * sizeof(fftwf_complex) * nComplex_; }
+
+	private:
+		const DWORD N_;
+		const DWORD nComplex_;
+		const DWORD nStride_;
+		const bool bAdd_;
+		const ComplexKernel Kernel_;
+	};
+
+	// The same product, accumulated, with the filter spectrum stored at half precision, as the engines do for the
+	// partitions from Filter::nHalfPrecisionFrom on
+	class ComplexMulHalf : public Kernel
+	{
+	public:
+		explicit ComplexMulHalf(const DWORD nPartitionLength) : N_(nPartitionLength), nComplex_(N_ / 2 + 1),
+			nStride_((2 * nComplex_ + 3) & ~3), nHalfStride_((nStride_ / 2 + 3) & ~3),
+			fUnscale_(static_cast<float>(::ldexp(1.0, 112 - 15))) {}
+
+		DWORD nFloats() const { return 2 * nStride_ + nHalfStride_; }
+		void prepare(float* p) const
+		{
+			// Noise of +/-0.5, scaled by 2^15 into the range of a half
+			WORD* const in2 = reinterpret_cast<WORD*>(p + nStride_);
+			for (DWORD i = 0; i < 2 * nComplex_; ++i)
+				in2[i] = half_from_float(p[i] * 32768.0f);
+		}
+		void operator()(float* p) const
+		{
+			const fftwf_complex* const in1 = reinterpret_cast<const fftwf_complex*>(p);
+			const WORD* const in2 = reinterpret_cast<const WORD*>(p + nStride_);
+			fftwf_complex* const result = reinterpret_cast<fftwf_complex*>(p + nStride_ + nHalfStride_);
+			complex_mul_half<true>(in1, in2, fUnscale_, result, nComplex_);
+		}
+		double nSamples() const { return N_; }
+		double nBytes() const { return 3.5 * sizeof(fftwf_complex) * nComplex_; }
+
+	private:
+		const DWORD N_;
+		const DWORD nComplex_;
+		const DWORD nStride_;
+		const DWORD nHalfStride_;
+		const float fUnscale_;				// undoes the scaling of prepare (see float_from_half)
+	};
+
+	// The forward or reverse real transform of one partition.  The engines transform in place, but that would
+	// compound from call to call, so these transform out of place and preserve their input
+	class FFT : public Kernel
+	{
+	public:
+		FFT(const DWORD nPartitionLength, const bool bForward, const unsigned int nPlanningRigour) : N_(nPartitionLength),
+			nStride_((2 * (N_ / 2 + 1) + 3) & ~3), bForward_(bForward)
+		{
+			const unsigned int nFlags = (PlanningRigour::Flag[nPlanningRigour] & ~FFTW_DESTROY_INPUT) | FFTW_PRESERVE_INPUT;
+
+			// Plan on scratch arrays, as planning overwrites them; the copies have the same alignment
+			WorkingSet scratch(nFloats(), 1);
+			if (bForward_)
+				plan_ = fftwf_plan_dft_r2c_1d(N_, scratch[0], reinterpret_cast<fftwf_complex*>(scratch[0] + nStride_), nFlags);
+			else
+				plan_ = fftwf_plan_dft_c2r_1d(N_, reinterpret_cast<fftwf_complex*>(scratch[0]), scratch[0] + nStride_, nFlags);
+			if (plan_ == NULL)
+				throw convolutionException("Failed to plan FFT");
+		}
+
+		~FFT()
+		{
+			fftwf_destroy_plan(plan_);
+		}
+
+		DWORD nFloats() const { return 2 * nStride_; }
+		void operator()(float* p) const
+		{
+			if (bForward_)
+				fftwf_execute_dft_r2c(plan_, p, reinterpret_cast<fftwf_complex*>(p + nStride_));
+			else
+				fftwf_execute_dft_c2r(plan_, reinterpret_cast<fftwf_complex*>(p), p + nStride_);
+		}
+		double nSamples() const { return N_; }
+		double nBytes() const { return sizeof(float) * N_ + sizeof(fftwf_complex) * (N_ / 2 + 1); }
+
+	private:
+		const DWORD N_;
+		const DWORD nStride_;
+		const bool bForward_;
+		fftwf_plan plan_;
+	};
+
+	ConvertSample<float>* makeConvertor(const std::basic_string<TCHAR>& szFormat)
+	{
+		if (szFormat == TEXT("pcm16"))
+			return new ConvertSample_pcm16<float>();
+		if (szFormat == TEXT("pcm24"))
+			return new ConvertSample_pcm24<float, 24>();
+		if (szFormat == TEXT("pcm32"))
+			return new ConvertSample_pcm32<float, 32>();
+		if (szFormat == TEXT("float"))
+			return new ConvertSample_ieeefloat<float>();
+		throw convolutionException("Unknown sample format: " + std::string(CT2CA(szFormat.c_str())));
+	}
+
+	// ConvertSample::GetSamples or PutSamples, the block entry points the engines call, over nFrames frames of
+	// nChannels.  The floats hold the channels one after another and are followed by the host's interleaved containers
+	class Convert : public Kernel
+	{
+	public:
+		Convert(const DWORD nFrames, const WORD nChannels, const std::basic_string<TCHAR>& szFormat, const bool bGet) :
+		  nFrames_(nFrames), nSamples_(nFrames * nChannels), nChannels_(nChannels), convertor_(makeConvertor(szFormat)),
+			  bGet_(bGet), channels_(nChannels) {}
+
+		DWORD nFloats() const
+		{
+			return nSamples_ + (nSamples_ * convertor_->nContainerSize() + sizeof(float) - 1) / sizeof(float);
+		}
+		void prepare(float* p) const
+		{
+			// The containers must hold valid samples for GetSamples
+			BYTE* pbContainer = reinterpret_cast<BYTE*>(p + nSamples_);
+			DWORD nBytesGenerated = 0;
+			convertor_->PutSamples(pbContainer, channels(p), nChannels_, nFrames_, nBytesGenerated);
+		}
+		void operator()(float* p) const
+		{
+			DWORD nBytes = 0;
+			if (bGet_)
+			{
+				const BYTE* pbContainer = reinterpret_cast<const BYTE*>(p + nSamples_);
+				convertor_->GetSamples(channels(p), pbContainer, nChannels_, nFrames_, 1.0f, nBytes);
+			}
+			else
+			{
+				BYTE* pbContainer = reinterpret_cast<BYTE*>(p + nSamples_);
+				convertor_->PutSamples(pbContainer, channels(p), nChannels_, nFrames_, nBytes);
+			}
+		}
+		double nSamples() const { return nSamples_; }
+		double nBytes() const { return static_cast<double>(nSamples_) * (sizeof(float) + convertor_->nContainerSize()); }
+
+	private:
+		float* const* channels(float* p) const
+		{
+			for (WORD nChannel = 0; nChannel < nChannels_; ++nChannel)
+				channels_[nChannel] = p + nChannel * nFrames_;
+			return &channels_[0];
+		}
+
+		const DWORD nFrames_;
+		const DWORD nSamples_;
+		const WORD nChannels_;
+		Holder< ConvertSample<float> > convertor_;
+		const bool bGet_;
+		mutable std::vector<float*> channels_;
+	};
+
+	// Only the mixing and conversion kernels depend on the number of channels
+	bool isMultichannel(const std::basic_string<TCHAR>& szKernel)
+	{
+		return szKernel.compare(0, 3, TEXT("mix")) == 0 || szKernel.compare(0, 4, TEXT("get_")) == 0 ||
+			szKernel.compare(0, 4, TEXT("put_")) == 0;
+	}
+
+	Kernel* makeKernel(const std::basic_string<TCHAR>& szKernel, const DWORD nPartitionLength, const WORD nChannels,
+		const unsigned int nPlanningRigour)
+	{
+		if (szKernel == TEXT("mix_input"))
+			return new MixInput(nPartitionLength, nChannels);
+		if (szKernel == TEXT("mix_output"))
+			return new MixOutput(nPartitionLength, nChannels);
+		if (szKernel == TEXT("complex_mul"))
+			return new ComplexMul(nPartitionLength, false);
+		if (szKernel == TEXT("complex_mul_add"))
+			return new ComplexMul(nPartitionLength, true);
+		if (szKernel == TEXT("complex_mul_add_half"))
+			return new ComplexMulHalf(nPartitionLength);
+		if (szKernel == TEXT("fft_r2c"))
+			return new FFT(nPartitionLength, true, nPlanningRigour);
+		if (szKernel == TEXT("fft_c2r"))
+			return new FFT(nPartitionLength, false, nPlanningRigour);
+		if (szKernel.compare(0, 4, TEXT("get_")) == 0)
+			return new Convert(nPartitionLength, nChannels, szKernel.substr(4), true);
+		if (szKernel.compare(0, 4, TEXT("put_")) == 0)
+			return new Convert(nPartitionLength, nChannels, szKernel.substr(4), false);
+		throw convolutionException("Unknown kernel: " + std::string(CT2CA(szKernel.c_str())));
+	}
+
+	struct KernelResult
+	{
+		std::basic_string<TCHAR> szKernel;
+		DWORD			nPartitionLength;
+		WORD			nChannels;
+		bool			bCold;
+		DWORD			nCopies;			// in the working set
+		DWORD			nCalls;
+		double			fNsPerSample;
+		double			fGBPerSecond;
+	};
+
+	// Call the kernel repeatedly, for at least fSeconds, stepping through the working set
+	void timeKernel(const Kernel& kernel, const WorkingSet& data, const double fSeconds, KernelResult& result)
+	{
+		kernel(data[0]);		// page in, and warm the caches for the warm case
+
+		const DWORD nCallsPerCheck = 8;
+		DWORD nCalls = 0;
+		apHiResElapsedTime t;
+		do
+		{
+			for (DWORD nCall = 0; nCall < nCallsPerCheck; ++nCall)
+				kernel(data[nCalls++ % data.nCopies()]);
+		}
+		while (t.sec() < fSeconds);
+		const double fMicroseconds = t.usec();
+
+		result.nCopies = data.nCopies();
+		result.nCalls = nCalls;
+		result.fNsPerSample = fMicroseconds * 1000.0 / (nCalls * kernel.nSamples());
+		result.fGBPerSecond = kernel.nBytes() * nCalls / (fMicroseconds * 1000.0);
+	}
+
+	// Parse a comma-separated list, replacing values.  false => malformed
+	template <typename T>
+	bool parseList(const TCHAR* szList, std::vector<T>& values)
+	{
+		values.clear();
+		std::wistringstream list(szList);
+		std::wstring szItem;
+		while (std::getline(list, szItem, TEXT(',')))
+		{
+			std::wistringstream item(szItem);
+			T value;
+			item >> value;
+			if (item.fail())
+				return false;
+			values.push_back(value);
+		}
+		return !values.empty();
+	}
+
+	void writeResultsCSV(std::ostream& out, const std::vector<KernelResult>& results)
+	{
+		out << "kernel,partition_length,channels,cache,working_set_copies,calls,ns_per_sample,gb_per_s" << std::endl;
+		for (std::vector<KernelResult>::size_type i = 0; i < results.size(); ++i)
+		{
+			const KernelResult& r = results[i];
+			out << CT2CA(r.szKernel.c_str()) << "," << r.nPartitionLength << "," << r.nChannels << ","
+				<< (r.bCold ? "cold" : "warm") << "," << r.nCopies << "," << r.nCalls << ","
+				<< std::setprecision(4) << r.fNsPerSample << "," << r.fGBPerSecond << std::endl;
+		}
+	}
+}
+
+
+int	_tmain(int argc, _TCHAR* argv[])
+{
+	HRESULT	hr = S_OK;
+
+	// The default sweep
+	std::vector< std::basic_string<TCHAR> > szKernels(Kernels, Kernels + nKernels);
+	std::vector<DWORD> nPartitionLengths;
+	for (DWORD nPartitionLength = 64; nPartitionLength <= 65536; nPartitionLength *= 4)
+		nPartitionLengths.push_back(nPartitionLength);
+	const WORD nDefaultChannels[] = { 1, 2, 6, 8, 32 };
+	std::vector<WORD> nChannels(nDefaultChannels, nDefaultChannels + sizeof(nDefaultChannels) / sizeof(nDefaultChannels[0]));
+	double fSeconds = 0.25;
+	DWORD nColdMegabytes = 64;
+	unsigned int nPlanningRigour = 0;
+	const TCHAR* szCSVFile = NULL;
+
+	int nArg = 1;
+	bool bUsage = false;
+	while (nArg < argc && _tcsncmp(argv[nArg], TEXT("--"), 2) == 0)
+	{
+		if (nArg + 1 == argc)
+		{
+			bUsage = true;		// every option takes a value
+			break;
+		}
+		const TCHAR* szValue = argv[nArg + 1];
+		if (_tcscmp(argv[nArg], TEXT("--kernels")) == 0)
+		{
+			bUsage = bUsage || !parseList(szValue, szKernels);
+			for (std::vector< std::basic_string<TCHAR> >::size_type i = 0; i < szKernels.size(); ++i)
+				bUsage = bUsage || std::find(Kernels, Kernels + nKernels, szKernels[i]) == Kernels + nKernels;
+		}
+		else if (_tcscmp(argv[nArg], TEXT("--lengths")) == 0)
+		{
+			bUsage = bUsage || !parseList(szValue, nPartitionLengths);
+			for (std::vector<DWORD>::size_type i = 0; i < nPartitionLengths.size(); ++i)
+				bUsage = bUsage || nPartitionLengths[i] < 4 || nPartitionLengths[i] % 2 != 0;
+		}
+		else if (_tcscmp(argv[nArg], TEXT("--channels")) == 0)
+			bUsage = bUsage || !parseList(szValue, nChannels) ||
+			std::find(nChannels.begin(), nChannels.end(), 0) != nChannels.end();
+		else if (_tcscmp(argv[nArg], TEXT("--seconds")) == 0)
+		{
+			std::wistringstream szSeconds(szValue);
+			szSeconds >> fSeconds;
+			bUsage = bUsage || szSeconds.fail() || fSeconds <= 0;
+		}
+		else if (_tcscmp(argv[nArg], TEXT("--cold")) == 0)
+		{
+			std::wistringstream szColdMegabytes(szValue);
+			szColdMegabytes >> nColdMegabytes;
+			bUsage = bUsage || szColdMegabytes.fail() || nColdMegabytes == 0;
+		}
+		else if (_tcscmp(argv[nArg], TEXT("--rigour")) == 0)
+		{
+			std::wistringstream szPlanningRigour(szValue);
+			szPlanningRigour >> nPlanningRigour;
+			bUsage = bUsage || szPlanningRigour.fail() || nPlanningRigour > PlanningRigour::nDegrees - 1;
+		}
+		else if (_tcscmp(argv[nArg], TEXT("--csv")) == 0)
+			szCSVFile = szValue;
+		else
+			bUsage = true;
+		nArg += 2;
+	}
+
+	if (bUsage || nArg != argc)
+	{
+		std::wcerr << "Usage: kernelbench [--kernels mix_input,..] [--lengths 64,256,..] [--channels 1,2,..] [--seconds s]" << std::endl;
+		std::wcerr << "                   [--cold MB] [--rigour 0-" << PlanningRigour::nDegrees - 1 << "] [--csv results.csv]" << std::endl;
+		std::wcerr << "       --kernels = any of";
+		for (unsigned int i = 0; i < nKernels; ++i)
+			std::wcerr << " " << Kernels[i];
+		std::wcerr << " (default all)" << std::endl;
+		std::wcerr << "       --lengths = partition lengths, or frames per buffer for get_/put_ (default 64,256,..,65536)" << std::endl;
+		std::wcerr << "       --channels = for the mix_, get_ and put_ kernels (default 1,2,6,8,32)" << std::endl;
+		std::wcerr << "       --seconds = timed per case (default 0.25)" << std::endl;
+		std::wcerr << "       --cold = working set for the cold-cache cases; larger than the caches (default 64)" << std::endl;
+		std::wcerr << "       --csv = where to write the results (default stdout)" << std::endl;
+		return 1;
+	}
+
+	try
+	{
+		std::vector<KernelResult> results;
+
+		for (std::vector< std::basic_string<TCHAR> >::size_type nKernel = 0; nKernel < szKernels.size(); ++nKernel)
+		{
+			const bool bMultichannel = isMultichannel(szKernels[nKernel]);
+			for (std::vector<DWORD>::size_type nLength = 0; nLength < nPartitionLengths.size(); ++nLength)
+			{
+				for (std::vector<WORD>::size_type nChannel = 0; nChannel < (bMultichannel ? nChannels.size() : 1); ++nChannel)
+				{
+					const Holder<Kernel> kernel(makeKernel(szKernels[nKernel], nPartitionLengths[nLength],
+						bMultichannel ? nChannels[nChannel] : 1, nPlanningRigour));
+
+					const DWORD cbCopy = kernel->nFloats() * sizeof(float);
+					for (int nCold = 0; nCold < 2; ++nCold)
+					{
+						KernelResult result;
+						result.szKernel = szKernels[nKernel];
+						result.nPartitionLength = nPartitionLengths[nLength];
+						result.nChannels = bMultichannel ? nChannels[nChannel] : 1;
+						result.bCold = nCold == 1;
+
+						const DWORD nCopies = result.bCold ? std::max<DWORD>(2, (nColdMegabytes << 20) / cbCopy + 1) : 1;
+						WorkingSet data(kernel->nFloats(), nCopies);
+						for (DWORD nCopy = 0; nCopy < nCopies; ++nCopy)
+							kernel->prepare(data[nCopy]);
+
+						std::wcerr << result.szKernel << " " << result.nPartitionLength << "x" << result.nChannels <<
+							(result.bCold ? " cold" : " warm") << std::endl;
+						timeKernel(*kernel, data, fSeconds, result);
+						results.push_back(result);
+					}
+				}
+			}
+		}
+
+		if (szCSVFile == NULL || _tcscmp(szCSVFile, TEXT("-")) == 0)
+			writeResultsCSV(std::cout, results);
+		else
+		{
+			std::ofstream out(szCSVFile);
+			if (!out)
+				throw convolutionException("Failed to create " + std::string(CT2CA(szCSVFile)));
+			writeResultsCSV(out, results);
+		}
+	}
+	catch (convolutionException& error)
+	{
+		std::wcerr << "Convolver error: " << error.what() << std::endl;
+		hr = E_FAIL;
+	}
+	catch(const std::exception& error)
+	{
+		std::wcerr << "Standard exception: " << error.what() << std::endl;
+		hr = E_OUTOFMEMORY;
+	}
+	catch (...)
+	{
+		std::wcerr << "Failed." <<std::endl;
+		hr = E_FAIL;
+	}
+
+	return hr;
+}
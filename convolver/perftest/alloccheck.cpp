@@ -0,0 +1,271 @@
+// Convolver: DSP plug-in for Windows Media Player that convolves an impulse respose
+// filter it with the input stream.
+//
+// Copyright (C) 2005  John Pavel
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//
+/////////////////////////////////////////////////////////////////////////////
+//
+// alloccheck.cpp : Check that the real-time engine does not use the heap
+//
+
+#include "stdafx.h"
+#include "alloccheck.h"
+#include <new>
+#include <vector>
+
+namespace
+{
+	// This thread's counts, while a guard is armed
+	__declspec(thread) bool bGuardArmed = false;
+	__declspec(thread) DWORD nGuardAllocations = 0;
+	__declspec(thread) DWORD nGuardFrees = 0;
+
+#if defined(DEBUG) | defined(_DEBUG)
+	_CRT_ALLOC_HOOK pfnPreviousHook = NULL;
+
+	// Sees every CRT heap operation, including those of new and delete
+	int __cdecl allocationHook(int nAllocType, void* pvData, size_t nSize, int nBlockUse, long lRequest,
+		const unsigned char* szFileName, int nLine)
+	{
+		if (bGuardArmed && nBlockUse != _CRT_BLOCK)	// _CRT_BLOCK => the CRT's own bookkeeping
+		{
+			if (nAllocType == _HOOK_FREE)
+				++nGuardFrees;
+			else
+				++nGuardAllocations;				// _HOOK_ALLOC or _HOOK_REALLOC
+		}
+		return pfnPreviousHook == NULL ? TRUE : pfnPreviousHook(nAllocType, pvData, nSize, nBlockUse, lRequest, szFileName, nLine);
+	}
+#endif
+
+	WAVEFORMATEXTENSIBLE extensibleFormat(const SampleFormatId& id, const WORD nChannels, const DWORD nSamplesPerSec)
+	{
+		WAVEFORMATEXTENSIBLE wfex;
+		::ZeroMemory(&wfex, sizeof(wfex));
+		wfex.Format.wFormatTag = WAVE_FORMAT_EXTENSIBLE;
+		wfex.Format.nChannels = nChannels;
+		wfex.Format.nSamplesPerSec = nSamplesPerSec;
+		wfex.Format.wBitsPerSample = id.wBitsPerSample;
+		wfex.Format.nBlockAlign = nChannels * id.wBitsPerSample / 8;
+		wfex.Format.nAvgBytesPerSec = wfex.Format.nBlockAlign * nSamplesPerSec;
+		wfex.Format.cbSize = 22;
+		wfex.Samples.wValidBitsPerSample = id.wValidBitsPerSample;
+		wfex.SubFormat = id.SubType;
+		return wfex;
+	}
+
+	// The heap operations made by nCalls processing calls, in the steady state.  The output convertor dithers
+	// and shapes; the input convertor does neither
+	DWORD checkCase(const ChannelPaths& Mixer, const ConvertSampleMaker<float>& formats, const SampleFormatId& id,
+		const Ditherer<float>::DitherType nDither, const NoiseShaper<float>::NoiseShapingType nNoiseShaper,
+		const DWORD nBufferFrames, const bool bOverlapSave, const DWORD nCalls)
+	{
+		Holder< ConvertSample<float> > input;
+		WAVEFORMATEXTENSIBLE wfex = extensibleFormat(id, Mixer.nInputChannels(), Mixer.nSamplesPerSec());
+		if (FAILED(formats.SelectSampleConvertor(&wfex.Format, input)))
+			throw convolutionException("Unsupported input format");
+
+		Holder< ConvertSample<float> > output;
+		wfex = extensibleFormat(id, Mixer.nOutputChannels(), Mixer.nSamplesPerSec());
+		if (FAILED(formats.SelectSampleConvertor(&wfex.Format, output, nNoiseShaper, nDither)))
+			throw convolutionException("Unsupported output format");
+
+		Convolution<float> conv(Mixer);
+		std::vector<BYTE> pbInput(nBufferFrames * Mixer.nInputChannels() * input->nContainerSize());
+		std::vector<BYTE> pbOutput(nBufferFrames * Mixer.nOutputChannels() * output->nContainerSize());
+
+		// Noise at -6dB, from a linear congruential generator, as the input need only be non-trivial
+		BYTE* pbInputPointer = &pbInput[0];
+		DWORD nBytesGenerated = 0;
+		DWORD nSeed = 1;
+		for (DWORD nFrame = 0; nFrame < nBufferFrames; ++nFrame)
+		{
+			for (WORD nChannel = 0; nChannel < Mixer.nInputChannels(); ++nChannel)
+			{
+				nSeed = nSeed * 1664525 + 1013904223;
+				input->PutSample(pbInputPointer, (static_cast<float>(nSeed >> 8) / (1 << 24)) - 0.5f, nChannel, nBytesGenerated);
+			}
+		}
+
+		AllocationGuard guard;
+		for (DWORD nCall = 0; nCall < nCalls; ++nCall)
+		{
+			if (bOverlapSave)
+				conv.doConvolution(&pbInput[0], &pbOutput[0], input.get_ptr(), output.get_ptr(), nBufferFrames, 0);
+			else
+				conv.doPartitionedConvolution(&pbInput[0], &pbOutput[0], input.get_ptr(), output.get_ptr(), nBufferFrames, 0);
+		}
+		return guard.nAllocations() + guard.nFrees();
+	}
+}
+
+#if !(defined(DEBUG) | defined(_DEBUG))
+// Release builds count through the global operator new and delete
+void* operator new(size_t nSize)
+{
+	if (bGuardArmed)
+		++nGuardAllocations;
+	void* p = malloc(nSize == 0 ? 1 : nSize);
+	if (p == NULL)
+		throw std::bad_alloc();
+	return p;
+}
+
+void* operator new[](size_t nSize)
+{
+	return operator new(nSize);
+}
+
+void* operator new(size_t nSize, const std::nothrow_t&) throw()
+{
+	if (bGuardArmed)
+		++nGuardAllocations;
+	return malloc(nSize == 0 ? 1 : nSize);
+}
+
+void* operator new[](size_t nSize, const std::nothrow_t& nothrow) throw()
+{
+	return operator new(nSize, nothrow);
+}
+
+void operator delete(void* p) throw()
+{
+	if (p == NULL)
+		return;
+	if (bGuardArmed)
+		++nGuardFrees;
+	free(p);
+}
+
+void operator delete[](void* p) throw()
+{
+	operator delete(p);
+}
+
+void operator delete(void* p, const std::nothrow_t&) throw()
+{
+	operator delete(p);
+}
+
+void operator delete[](void* p, const std::nothrow_t&) throw()
+{
+	operator delete(p);
+}
+#endif
+
+AllocationGuard::AllocationGuard()
+{
+	assert(!bGuardArmed);
+	nGuardAllocations = 0;
+	nGuardFrees = 0;
+#if defined(DEBUG) | defined(_DEBUG)
+	pfnPreviousHook = ::_CrtSetAllocHook(allocationHook);
+#endif
+	bGuardArmed = true;
+}
+
+AllocationGuard::~AllocationGuard()
+{
+	bGuardArmed = false;
+#if defined(DEBUG) | defined(_DEBUG)
+	::_CrtSetAllocHook(pfnPreviousHook);
+#endif
+}
+
+DWORD AllocationGuard::nAllocations() const
+{
+	return nGuardAllocations;
+}
+
+DWORD AllocationGuard::nFrees() const
+{
+	return nGuardFrees;
+}
+
+unsigned int runAllocationChecks(const BenchmarkSweep& sweep, const DWORD nCalls)
+{
+	const ConvertSampleMaker<float> formats;
+	unsigned int nFailures = 0;
+
+	for (std::vector< std::basic_string<TCHAR> >::size_type nConfig = 0; nConfig < sweep.szConfigs.size(); ++nConfig)
+	{
+		for (std::vector<unsigned int>::size_type nBackend = 0; nBackend < sweep.nFFTBackends.size(); ++nBackend)
+		{
+			for (std::vector<DWORD>::size_type nPartition = 0; nPartition < sweep.nPartitions.size(); ++nPartition)
+			{
+				const DWORD nPartitions = sweep.nPartitions[nPartition];
+				std::wcerr << sweep.szConfigs[nConfig] << ", " << FFTBackend::Get(sweep.nFFTBackends[nBackend]).szName() << ", "
+					<< nPartitions << " partition(s): ";
+				try
+				{
+					ConvolutionList<float> conv(sweep.szConfigs[nConfig].c_str(), nPartitions == 0 ? 1 : nPartitions,
+						sweep.nPlanningRigour, sweep.nFFTBackends[nBackend]);
+					conv.selectConvolutionIndex(0);
+					const ChannelPaths& Mixer = conv.SelectedConvolution().Mixer;
+
+					unsigned int nCases = 0;
+					unsigned int nCaseFailures = 0;
+					for (DWORD nFormat = 0; nFormat < formats.size(); ++nFormat)
+					{
+						const SampleFormatId& id = formats[nFormat];
+						if (id.wFormatTag != WAVE_FORMAT_EXTENSIBLE)
+							continue;		// The other tags select the same convertors
+
+						for (unsigned int nDither = 0; nDither < Ditherer<float>::nDitherers; ++nDither)
+						{
+							for (unsigned int nNoiseShaper = 0; nNoiseShaper < NoiseShaper<float>::nNoiseShapers; ++nNoiseShaper)
+							{
+								for (std::vector<DWORD>::size_type nBuffer = 0; nBuffer < sweep.nBufferFrames.size(); ++nBuffer)
+								{
+									++nCases;
+									const DWORD nOperations = checkCase(Mixer, formats, id,
+										static_cast<Ditherer<float>::DitherType>(nDither),
+										static_cast<NoiseShaper<float>::NoiseShapingType>(nNoiseShaper),
+										sweep.nBufferFrames[nBuffer], nPartitions == 0, nCalls);
+									if (nOperations != 0)
+									{
+										if (nCaseFailures++ == 0)
+											std::wcerr << std::endl;
+										std::wcerr << "  " << (id.SubType == KSDATAFORMAT_SUBTYPE_IEEE_FLOAT ? "float" : "pcm")
+											<< id.wBitsPerSample << "/" << id.wValidBitsPerSample << ", "
+											<< Ditherer<float>::Description[nDither] << " dither, "
+											<< NoiseShaper<float>::Description[nNoiseShaper] << ", "
+											<< sweep.nBufferFrames[nBuffer] << " frames: " << nOperations
+											<< " heap operation(s) in " << nCalls << " calls" << std::endl;
+									}
+								}
+							}
+						}
+					}
+
+					if (nCaseFailures == 0)
+						std::wcerr << nCases << " cases allocation-free" << std::endl;
+					else
+						std::wcerr << "  " << nCaseFailures << " of " << nCases << " cases used the heap" << std::endl;
+					nFailures += nCaseFailures;
+				}
+				catch(const std::exception& error)
+				{
+					std::wcerr << error.what() << std::endl;
+					++nFailures;
+				}
+			}
+		}
+	}
+
+	return nFailures;
+}
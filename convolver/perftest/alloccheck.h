@@ -0,0 +1,54 @@
+#pragma once
+// Convolver: DSP plug-in for Windows Media Player that convolves an impulse respose
+// filter it with the input stream.
+//
+// Copyright (C) 2005  John Pavel
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//
+/////////////////////////////////////////////////////////////////////////////
+//
+// alloccheck.h : Check that the real-time engine does not use the heap
+//
+// A heap allocation on the audio thread is a latency spike, so, once it has
+// been constructed, the engine, its sample convertors, ditherers and noise
+// shapers must neither allocate nor free.  The check hooks the allocator and
+// counts what the processing calls do, for every sample format, ditherer and
+// noise shaper, over the configs, partitions and buffer sizes of the sweep.
+//
+/////////////////////////////////////////////////////////////////////////////
+
+#include "benchmark.h"
+
+// Counts the heap allocations and frees made by this thread between construction and destruction.
+// Debug builds hook the CRT heap, and so see malloc and free as well as new and delete.  Release
+// builds see only the global operator new and delete, which perftest replaces.
+class AllocationGuard
+{
+public:
+	AllocationGuard();
+	~AllocationGuard();
+
+	DWORD nAllocations() const;
+	DWORD nFrees() const;
+
+private:
+	AllocationGuard(const AllocationGuard&);					// no impl.
+	const AllocationGuard& operator=(const AllocationGuard&);	// no impl.
+};
+
+// Run nCalls processing calls of each case, reporting each on std::wcerr.  Returns the number of cases
+// that allocated or freed
+unsigned int runAllocationChecks(const BenchmarkSweep& sweep, const DWORD nCalls);
@@ -0,0 +1,259 @@
+// Convolver: DSP plug-in for Windows Media Player that convolves an impulse respose
+// filter it with the input stream.
+//
+// Copyright (C) 2005  John Pavel
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//
+/////////////////////////////////////////////////////////////////////////////
+//
+// baseline.cpp : Compare benchmark results with those stored for the machine
+//
+
+#include "stdafx.h"
+#include "baseline.h"
+#include <cmath>
+#include <iomanip>
+#include <sstream>
+
+namespace
+{
+	// The position just after "key": in a line written by writeBenchmarksJSON, or npos
+	std::string::size_type findValue(const std::string& line, const char* szKey)
+	{
+		const std::string szTag = std::string("\"") + szKey + "\": ";
+		const std::string::size_type nPos = line.find(szTag);
+		return nPos == std::string::npos ? nPos : nPos + szTag.length();
+	}
+
+	bool readString(const std::string& line, const char* szKey, std::string& value)
+	{
+		std::string::size_type nPos = findValue(line, szKey);
+		if (nPos == std::string::npos || nPos >= line.length() || line[nPos] != '"')
+			return false;
+
+		value.clear();
+		for (++nPos; nPos < line.length() && line[nPos] != '"'; ++nPos)
+		{
+			if (line[nPos] == '\\' && nPos + 1 < line.length())
+			{
+				switch (line[++nPos])
+				{
+				case 'n': value += '\n'; break;
+				case 'r': value += '\r'; break;
+				case 't': value += '\t'; break;
+				default: value += line[nPos];
+				}
+			}
+			else
+			{
+				value += line[nPos];
+			}
+		}
+		return nPos < line.length();
+	}
+
+	template <typename T>
+	bool readNumber(const std::string& line, const char* szKey, T& value)
+	{
+		const std::string::size_type nPos = findValue(line, szKey);
+		if (nPos == std::string::npos)
+			return false;
+		std::istringstream number(line.substr(nPos));
+		number >> value;
+		return !number.fail();
+	}
+
+	bool sameConfig(const BenchmarkResult& a, const BenchmarkResult& b)
+	{
+		return a.szConfig == b.szConfig && a.szFFTBackend == b.szFFTBackend && a.nPartitions == b.nPartitions;
+	}
+
+	bool sameCase(const BenchmarkResult& a, const BenchmarkResult& b)
+	{
+		return sameConfig(a, b) && a.nBufferFrames == b.nBufferFrames && a.szFormat == b.szFormat && a.nThreads == b.nThreads;
+	}
+
+	std::string describeConfig(const BenchmarkResult& r)
+	{
+		std::ostringstream description;
+		description << CT2CA(r.szConfig.c_str()) << " " << CT2CA(r.szFFTBackend.c_str()) << " p" << r.nPartitions;
+		return description.str();
+	}
+
+	std::string describeCase(const BenchmarkResult& r)
+	{
+		std::ostringstream description;
+		description << describeConfig(r) << " " << r.nBufferFrames << " " << CT2CA(r.szFormat.c_str()) << " x" << r.nThreads;
+		return description.str();
+	}
+
+	// One line of the table.  fChange is the relative change in the metric
+	void printRow(std::ostream& out, const std::string& szBenchmark, const char* szMetric, const double fBaseline,
+		const double fCurrent, const double fChange, const char* szVerdict)
+	{
+		out << std::left << std::setw(56) << szBenchmark << " " << std::setw(10) << szMetric << std::right << std::fixed
+			<< std::setprecision(2) << std::setw(12) << fBaseline << std::setw(12) << fCurrent
+			<< std::showpos << std::setprecision(1) << std::setw(9) << 100 * fChange << "%" << std::noshowpos
+			<< "  " << szVerdict << std::endl;
+	}
+
+	// fBetter is the relative improvement (eg, +0.1 for 10% faster)
+	const char* verdict(const double fBetter, const double fThreshold, unsigned int& nRegressions)
+	{
+		if (fBetter < -fThreshold)
+		{
+			++nRegressions;
+			return "REGRESSION";
+		}
+		return fBetter > fThreshold ? "improved" : "";
+	}
+
+	// The first result in results like r, or NULL
+	const BenchmarkResult* find(const std::vector<BenchmarkResult>& results, const BenchmarkResult& r,
+		bool (*same)(const BenchmarkResult&, const BenchmarkResult&))
+	{
+		for (std::vector<BenchmarkResult>::size_type i = 0; i < results.size(); ++i)
+		{
+			if (same(results[i], r))
+				return &results[i];
+		}
+		return NULL;
+	}
+}
+
+std::string machineProfile()
+{
+	char szComputerName[MAX_COMPUTERNAME_LENGTH + 1];
+	DWORD nSize = sizeof(szComputerName);
+	if (!::GetComputerNameA(szComputerName, &nSize))
+		strcpy(szComputerName, "unknown");
+
+	SYSTEM_INFO si;
+	::GetSystemInfo(&si);
+
+	std::ostringstream profile;
+	profile << szComputerName << "-" << si.dwNumberOfProcessors << "cpu";
+	return profile.str();
+}
+
+void readBenchmarksJSON(std::istream& in, std::string& szProfile, std::vector<BenchmarkResult>& results)
+{
+	szProfile.clear();
+	results.clear();
+
+	std::string line;
+	bool bResults = false;
+	while (std::getline(in, line))
+	{
+		if (!bResults)
+		{
+			readString(line, "profile", szProfile);
+			bResults = findValue(line, "results") != std::string::npos;
+			continue;
+		}
+		if (findValue(line, "config") == std::string::npos)
+			continue;
+
+		BenchmarkResult r;
+		std::string szConfig;
+		std::string szFFTBackend(CT2CA(FFTBackend::Get(0).szName()));	// for baselines from before the backends
+		std::string szFormat;
+		if (!(readString(line, "config", szConfig) && readNumber(line, "partitions", r.nPartitions) &&
+			readNumber(line, "buffer_frames", r.nBufferFrames) && readString(line, "format", szFormat) &&
+			readNumber(line, "threads", r.nThreads) && readNumber(line, "load_ms", r.fLoadMilliseconds) &&
+			readNumber(line, "x_realtime", r.fRealtime) && readNumber(line, "p99", r.fLatencyP99)))
+			throw convolutionException("Malformed baseline result: " + line);
+		readNumber(line, "repeats", r.nRepeats);
+		readNumber(line, "spread", r.fSpread);
+		readString(line, "error", r.szError);
+		readString(line, "fft", szFFTBackend);
+
+		r.szConfig = CA2CT(szConfig.c_str());
+		r.szFFTBackend = CA2CT(szFFTBackend.c_str());
+		r.szFormat = CA2CT(szFormat.c_str());
+		results.push_back(r);
+	}
+
+	if (!bResults)
+		throw convolutionException("Not a benchmark baseline");
+}
+
+unsigned int compareBenchmarks(std::ostream& out, const std::vector<BenchmarkResult>& baseline,
+							   const std::vector<BenchmarkResult>& results, const double fThreshold)
+{
+	unsigned int nRegressions = 0;
+
+	out << std::left << std::setw(56) << "benchmark" << " " << std::setw(10) << "metric" << std::right
+		<< std::setw(12) << "baseline" << std::setw(12) << "current" << std::setw(10) << "delta" << std::endl;
+
+	for (std::vector<BenchmarkResult>::size_type i = 0; i < results.size(); ++i)
+	{
+		const BenchmarkResult& r = results[i];
+
+		// The load time is shared by all the cases of a config, so compare it with the first
+		if (find(results, r, sameConfig) == &r)
+		{
+			const BenchmarkResult* b = find(baseline, r, sameConfig);
+			if (b == NULL || (!b->szError.empty() && b->nBufferFrames == 0))
+				out << std::left << std::setw(56) << describeConfig(r) << " load_ms    (not in baseline)" << std::endl;
+			else if (!r.szError.empty() && r.nBufferFrames == 0)
+			{
+				++nRegressions;
+				out << std::left << std::setw(56) << describeConfig(r) << " load_ms    FAILED: " << r.szError << std::endl;
+			}
+			else
+			{
+				// Lower is better
+				const double fChange = b->fLoadMilliseconds > 0 ? r.fLoadMilliseconds / b->fLoadMilliseconds - 1 : 0;
+				printRow(out, describeConfig(r), "load_ms", b->fLoadMilliseconds, r.fLoadMilliseconds, fChange,
+					verdict(-fChange, fThreshold, nRegressions));
+			}
+		}
+
+		if (r.nBufferFrames == 0)
+			continue;		// the config failed to load
+
+		const BenchmarkResult* b = find(baseline, r, sameCase);
+		if (b == NULL || !b->szError.empty())
+		{
+			out << std::left << std::setw(56) << describeCase(r) << " x_realtime (not in baseline)" << std::endl;
+		}
+		else if (!r.szError.empty())
+		{
+			++nRegressions;
+			out << std::left << std::setw(56) << describeCase(r) << " x_realtime FAILED: " << r.szError << std::endl;
+		}
+		else
+		{
+			const double fChange = b->fRealtime > 0 ? r.fRealtime / b->fRealtime - 1 : 0;
+			printRow(out, describeCase(r), "x_realtime", b->fRealtime, r.fRealtime, fChange,
+				verdict(fChange, fThreshold, nRegressions));
+
+			// Tail latency is reported, but not gated, as it is at the mercy of the scheduler
+			const double fLatencyChange = b->fLatencyP99 > 0 ? r.fLatencyP99 / b->fLatencyP99 - 1 : 0;
+			printRow(out, describeCase(r), "p99_us", b->fLatencyP99, r.fLatencyP99, fLatencyChange, "");
+		}
+	}
+
+	for (std::vector<BenchmarkResult>::size_type i = 0; i < baseline.size(); ++i)
+	{
+		if (baseline[i].nBufferFrames != 0 && find(results, baseline[i], sameCase) == NULL)
+			out << std::left << std::setw(56) << describeCase(baseline[i]) << " (not run)" << std::endl;
+	}
+
+	out << std::resetiosflags(std::ios::fixed) << nRegressions << " regression(s) beyond " << 100 * fThreshold << "%" << std::endl;
+	return nRegressions;
+}
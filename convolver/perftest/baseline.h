@@ -0,0 +1,45 @@
+#pragma once
+// Convolver: DSP plug-in for Windows Media Player that convolves an impulse respose
+// filter it with the input stream.
+//
+// Copyright (C) 2005  John Pavel
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//
+/////////////////////////////////////////////////////////////////////////////
+//
+// baseline.h : Compare benchmark results with those stored for the machine
+//
+// A baseline is the JSON written by writeBenchmarksJSON on the same machine
+// profile.  Cases are matched by config, partitions, buffer size, format and
+// threads; throughput and the time to load the config are gated.
+//
+/////////////////////////////////////////////////////////////////////////////
+
+#include "benchmark.h"
+#include <string>
+#include <vector>
+#include <iostream>
+
+// The default profile: the computer's name and number of processors
+std::string machineProfile();
+
+// Read back what writeBenchmarksJSON wrote
+void readBenchmarksJSON(std::istream& in, std::string& szProfile, std::vector<BenchmarkResult>& results);
+
+// Print a table of the changes from the baseline, flagging any throughput that has fallen, or load time that
+// has risen, by more than fThreshold (eg, 0.05).  Returns the number of regressions
+unsigned int compareBenchmarks(std::ostream& out, const std::vector<BenchmarkResult>& baseline,
+							   const std::vector<BenchmarkResult>& results, const double fThreshold);
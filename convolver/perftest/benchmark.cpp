@@ -0,0 +1,550 @@
+// Convolver: DSP plug-in for Windows Media Player that convolves an impulse respose
+// filter it with the input stream.
+//
+// Copyright (C) 2005  John Pavel
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//
+/////////////////////////////////////////////////////////////////////////////
+//
+// benchmark.cpp : Sweep the real-time engine over the parameters that size a host
+//
+
+#include "stdafx.h"
+#include "benchmark.h"
+#include "debugging\fasttiming.h"
+#include <process.h>
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <sstream>
+#include <boost\random.hpp>
+
+namespace
+{
+	ConvertSample<float>* makeConvertor(const std::basic_string<TCHAR>& szFormat)
+	{
+		if (szFormat == TEXT("pcm16"))
+			return new ConvertSample_pcm16<float>();
+		if (szFormat == TEXT("pcm24"))
+			return new ConvertSample_pcm24<float, 24>();
+		if (szFormat == TEXT("pcm32"))
+			return new ConvertSample_pcm32<float, 32>();
+		if (szFormat == TEXT("float"))
+			return new ConvertSample_ieeefloat<float>();
+		throw convolutionException("Unknown sample format: " + std::string(CT2CA(szFormat.c_str())));
+	}
+
+	// The state handed to each stream's thread
+	struct BenchmarkStream
+	{
+		Holder< Convolution<float> >	conv;			// this stream's worker engine
+		Holder< ConvertSample<float> >	convertor;		// between the host's format and float
+		std::vector<BYTE>				input;			// one host buffer of noise
+		std::vector<BYTE>				output;
+		std::vector<float>				latencies;		// microseconds per timed call
+		DWORD							nBufferFrames;
+		bool							bOverlapSave;
+		float							fAttenuation;
+		double							fSeconds;
+		HANDLE							hStart;			// signalled once all the streams are warmed up
+		volatile LONG*					nReady;			// shared by all the streams
+		std::string						szError;
+
+		BenchmarkStream(const ChannelPaths& Mixer, const std::basic_string<TCHAR>& szFormat, const DWORD nBufferFrames,
+			const bool bOverlapSave, const float fAttenuation, const double fSeconds, HANDLE hStart, volatile LONG* nReady) :
+		conv(new Convolution<float>(Mixer)), convertor(makeConvertor(szFormat)),
+			input(nBufferFrames * Mixer.nInputChannels() * convertor->nContainerSize()),
+			output(nBufferFrames * Mixer.nOutputChannels() * convertor->nContainerSize()),
+			nBufferFrames(nBufferFrames), bOverlapSave(bOverlapSave), fAttenuation(fAttenuation), fSeconds(fSeconds),
+			hStart(hStart), nReady(nReady)
+		{
+			// Noise at -6dB, so that the integer formats neither clip nor lose much precision
+			typedef boost::lagged_fibonacci607 base_generator_type;
+			base_generator_type generator(static_cast<unsigned int>(std::time(NULL)));
+			boost::uniform_real<float> uni_dist(-0.5f, 0.5f);
+			boost::variate_generator<base_generator_type&, boost::uniform_real<float> > uni(generator, uni_dist);
+
+			BYTE* pbInput = &input[0];
+			DWORD nBytesGenerated = 0;
+			for (DWORD nFrame = 0; nFrame < nBufferFrames; ++nFrame)
+				for (WORD nChannel = 0; nChannel < Mixer.nInputChannels(); ++nChannel)
+					convertor->PutSample(pbInput, uni(), nChannel, nBytesGenerated);
+		}
+
+		void process()
+		{
+			if (bOverlapSave)
+				conv->doConvolution(&input[0], &output[0], convertor.get_ptr(), convertor.get_ptr(), nBufferFrames, fAttenuation);
+			else
+				conv->doPartitionedConvolution(&input[0], &output[0], convertor.get_ptr(), convertor.get_ptr(), nBufferFrames, fAttenuation);
+		}
+	};
+
+	unsigned __stdcall benchmarkThread(void* pStream)
+	{
+		BenchmarkStream& stream = *static_cast<BenchmarkStream*>(pStream);
+		bool bReady = false;
+
+		try
+		{
+			// Warm up over a couple of filter lengths, so that the engine is in its steady state, and
+			// use the time taken to size the latency record, so that the timed loop does not allocate
+			const DWORD nWarmupCalls = std::max<DWORD>(16, 2 * stream.conv->Mixer.nFilterLength() / stream.nBufferFrames + 1);
+			apHiResElapsedTime t;
+			for (DWORD nCall = 0; nCall < nWarmupCalls; ++nCall)
+				stream.process();
+			const double fMeanMicroseconds = std::max(t.usec() / nWarmupCalls, 0.1);
+			stream.latencies.reserve(static_cast<std::vector<float>::size_type>(2 * stream.fSeconds * 1000000.0 / fMeanMicroseconds) + 1024);
+
+			::InterlockedIncrement(stream.nReady);
+			bReady = true;
+			::WaitForSingleObject(stream.hStart, INFINITE);
+
+			apHiResElapsedTime run;
+			apHiResElapsedTime call;
+			while (run.sec() < stream.fSeconds)
+			{
+				call.reset();
+				stream.process();
+				stream.latencies.push_back(static_cast<float>(call.usec()));
+			}
+		}
+		catch(const std::exception& error)
+		{
+			stream.szError = error.what();
+		}
+		catch(...)
+		{
+			stream.szError = "Failed";
+		}
+
+		if (!bReady)
+			::InterlockedIncrement(stream.nReady);		// so as not to hold up the others
+
+		return 0;
+	}
+
+	// The p-th quantile of sorted values (nearest rank)
+	double percentile(const std::vector<float>& sorted, const double p)
+	{
+		if (sorted.empty())
+			return 0;
+		const std::vector<float>::size_type nRank = static_cast<std::vector<float>::size_type>(ceil(p * sorted.size()));
+		return sorted[nRank == 0 ? 0 : nRank - 1];
+	}
+
+	void runCase(const ChannelPaths& Mixer, const float fAttenuation, const double fSeconds, BenchmarkResult& result)
+	{
+		HANDLE hStart = ::CreateEvent(NULL, TRUE, FALSE, NULL);
+		if (hStart == NULL)
+			throw convolutionException("Failed to create start event");
+
+		volatile LONG nReady = 0;
+		boost::ptr_vector<BenchmarkStream> streams;
+		std::vector<HANDLE> hThreads;
+		try
+		{
+			for (unsigned int i = 0; i < result.nThreads; ++i)
+				streams.push_back(new BenchmarkStream(Mixer, result.szFormat, result.nBufferFrames, result.nPartitions == 0,
+				fAttenuation, fSeconds, hStart, &nReady));
+
+			for (unsigned int i = 0; i < result.nThreads; ++i)
+			{
+				const uintptr_t hThread = ::_beginthreadex(NULL, 0, benchmarkThread, &streams[i], 0, NULL);
+				if (hThread == 0)
+					break;
+				hThreads.push_back(reinterpret_cast<HANDLE>(hThread));
+			}
+		}
+		catch(...)
+		{
+			::SetEvent(hStart);
+			if (!hThreads.empty())
+				::WaitForMultipleObjects(static_cast<DWORD>(hThreads.size()), &hThreads[0], TRUE, INFINITE);
+			for (std::vector<HANDLE>::size_type i = 0; i < hThreads.size(); ++i)
+				::CloseHandle(hThreads[i]);
+			::CloseHandle(hStart);
+			throw;
+		}
+
+		// Start the clock once every stream is warmed up
+		while (nReady < static_cast<LONG>(hThreads.size()))
+			::Sleep(1);
+		apHiResElapsedTime t;
+		::SetEvent(hStart);
+		if (!hThreads.empty())
+			::WaitForMultipleObjects(static_cast<DWORD>(hThreads.size()), &hThreads[0], TRUE, INFINITE);
+		result.fSeconds = t.sec();
+
+		for (std::vector<HANDLE>::size_type i = 0; i < hThreads.size(); ++i)
+			::CloseHandle(hThreads[i]);
+		::CloseHandle(hStart);
+
+		if (hThreads.size() != result.nThreads)
+		{
+			result.szError = "Failed to start all the threads";
+			return;
+		}
+
+		std::vector<float> latencies;
+		for (unsigned int i = 0; i < result.nThreads; ++i)
+		{
+			if (!streams[i].szError.empty())
+			{
+				result.szError = streams[i].szError;
+				return;
+			}
+			latencies.insert(latencies.end(), streams[i].latencies.begin(), streams[i].latencies.end());
+		}
+		std::sort(latencies.begin(), latencies.end());
+
+		result.nCalls = static_cast<DWORD>(latencies.size());
+		result.fRealtime = result.fSeconds > 0 ?
+			static_cast<double>(result.nCalls) * result.nBufferFrames / (result.fSeconds * result.nSamplesPerSec) : 0;
+		result.fBudgetMicroseconds = 1000000.0 * result.nBufferFrames / result.nSamplesPerSec;
+		result.fLatencyP50 = percentile(latencies, 0.5);
+		result.fLatencyP99 = percentile(latencies, 0.99);
+		result.fLatencyP999 = percentile(latencies, 0.999);
+		result.fLatencyMax = latencies.empty() ? 0 : latencies.back();
+		result.nOverruns = static_cast<DWORD>(latencies.end() -
+			std::upper_bound(latencies.begin(), latencies.end(), static_cast<float>(result.fBudgetMicroseconds)));
+	}
+
+	// The output of the engine with half precision spectra / its difference from that of the engine with the single
+	// precision spectra of ReferenceMixer, in dB, both convolving the same noise for two filter lengths
+	double measureHalfPrecisionSNR(const ChannelPaths& Mixer, const ChannelPaths& ReferenceMixer, const bool bOverlapSave)
+	{
+		Convolution<float> conv(Mixer);
+		Convolution<float> reference(ReferenceMixer);
+		const ConvertSample_ieeefloat<float> convertor;
+
+		const DWORD nBufferFrames = Mixer.nPartitionLength();
+		std::vector<float> input(nBufferFrames * Mixer.nInputChannels());
+		std::vector<float> output(nBufferFrames * Mixer.nOutputChannels());
+		std::vector<float> expected(nBufferFrames * Mixer.nOutputChannels());
+
+		typedef boost::lagged_fibonacci607 base_generator_type;
+		base_generator_type generator(static_cast<unsigned int>(std::time(NULL)));
+		boost::uniform_real<float> uni_dist(-0.5f, 0.5f);
+		boost::variate_generator<base_generator_type&, boost::uniform_real<float> > uni(generator, uni_dist);
+
+		double fSignal = 0;
+		double fNoise = 0;
+		for (DWORD nFrame = 0; nFrame < 2 * Mixer.nFilterLength(); nFrame += nBufferFrames)
+		{
+			std::generate(input.begin(), input.end(), uni);
+			const BYTE* const pbInput = reinterpret_cast<const BYTE*>(&input[0]);
+			if (bOverlapSave)
+			{
+				conv.doConvolution(pbInput, reinterpret_cast<BYTE*>(&output[0]), &convertor, &convertor, nBufferFrames, 0);
+				reference.doConvolution(pbInput, reinterpret_cast<BYTE*>(&expected[0]), &convertor, &convertor, nBufferFrames, 0);
+			}
+			else
+			{
+				conv.doPartitionedConvolution(pbInput, reinterpret_cast<BYTE*>(&output[0]), &convertor, &convertor, nBufferFrames, 0);
+				reference.doPartitionedConvolution(pbInput, reinterpret_cast<BYTE*>(&expected[0]), &convertor, &convertor,
+					nBufferFrames, 0);
+			}
+			for (std::vector<float>::size_type i = 0; i < output.size(); ++i)
+			{
+				fSignal += static_cast<double>(expected[i]) * expected[i];
+				fNoise += (static_cast<double>(output[i]) - expected[i]) * (static_cast<double>(output[i]) - expected[i]);
+			}
+		}
+		return fNoise > 0 ? 10 * log10(fSignal / fNoise) : 0;
+	}
+
+	// The median of values (the lower of the middle two, so that it is one of the values)
+	double median(std::vector<double> values)
+	{
+		if (values.empty())
+			return 0;
+		std::sort(values.begin(), values.end());
+		return values[(values.size() - 1) / 2];
+	}
+
+	// The median absolute deviation, as a fraction of the median
+	double relativeSpread(const std::vector<double>& values)
+	{
+		const double fMedian = median(values);
+		std::vector<double> deviations(values.size());
+		for (std::vector<double>::size_type i = 0; i < values.size(); ++i)
+			deviations[i] = fabs(values[i] - fMedian);
+		return fMedian == 0 ? 0 : median(deviations) / fMedian;
+	}
+
+	// Whether to measure again: at least three times (if allowed) and then until the measurements are stable
+	bool repeat(const std::vector<double>& values, const BenchmarkSweep& sweep)
+	{
+		const std::vector<double>::size_type nMinRepeats = std::min<unsigned int>(3, sweep.nMaxRepeats);
+		return values.size() < nMinRepeats ||
+			(values.size() < sweep.nMaxRepeats && relativeSpread(values) > sweep.fStability);
+	}
+
+	// For JSON strings (eg, paths, with their backslashes)
+	std::string escapeJSON(const std::string& s)
+	{
+		std::string escaped;
+		for (std::string::size_type i = 0; i < s.length(); ++i)
+		{
+			switch (s[i])
+			{
+			case '\\': escaped += "\\\\"; break;
+			case '"': escaped += "\\\""; break;
+			case '\n': escaped += "\\n"; break;
+			case '\r': escaped += "\\r"; break;
+			case '\t': escaped += "\\t"; break;
+			default: escaped += s[i];
+			}
+		}
+		return escaped;
+	}
+
+	// For CSV fields that may contain commas or quotes
+	std::string quoteCSV(const std::string& s)
+	{
+		if (s.find_first_of(",\"\r\n") == std::string::npos)
+			return s;
+		std::string quoted = "\"";
+		for (std::string::size_type i = 0; i < s.length(); ++i)
+		{
+			if (s[i] == '"')
+				quoted += '"';
+			quoted += s[i];
+		}
+		return quoted + "\"";
+	}
+}
+
+void runBenchmarks(const BenchmarkSweep& sweep, std::vector<BenchmarkResult>& results)
+{
+	for (std::vector< std::basic_string<TCHAR> >::size_type nConfig = 0; nConfig < sweep.szConfigs.size(); ++nConfig)
+	{
+		for (std::vector<unsigned int>::size_type nBackend = 0; nBackend < sweep.nFFTBackends.size(); ++nBackend)
+		{
+			for (std::vector<DWORD>::size_type nPartition = 0; nPartition < sweep.nPartitions.size(); ++nPartition)
+			{
+				BenchmarkResult base;
+				base.szConfig = sweep.szConfigs[nConfig];
+				base.szFFTBackend = FFTBackend::Get(sweep.nFFTBackends[nBackend]).szName();
+				base.nPartitions = sweep.nPartitions[nPartition];
+
+				std::wcerr << base.szConfig << ", " << base.szFFTBackend << ", " << base.nPartitions << " partition(s): ";
+				try
+				{
+					// The memory needed is known before anything is allocated, so cases over the budget are never built
+					const Footprint Needed = ConvolutionList<float>::footprint(base.szConfig.c_str(),
+						base.nPartitions == 0 ? 1 : base.nPartitions, sweep.nFFTBackends[nBackend], sweep.nHalfPrecisionFrom);
+					base.nFootprintBytes = Needed.nTotal();
+					std::wcerr << Needed.DisplayFootprint().c_str() << ", ";
+					if (sweep.nMemoryBudget > 0 && Needed.nTotal() > sweep.nMemoryBudget)
+						throw convolutionException("Over the memory budget");
+
+					// Load and plan the filters, for all the cases that share them.  The load is timed, as the
+					// startup cost of the host, and so it too is repeated until stable
+					Holder< ConvolutionList<float> > conv;
+					std::vector<double> fLoadMilliseconds;
+					do
+					{
+						conv.set_ptr(NULL);		// release the previous load first, so as not to hold two
+						apHiResElapsedTime t;
+						conv.set_ptr(new ConvolutionList<float>(base.szConfig.c_str(), base.nPartitions == 0 ? 1 : base.nPartitions,
+							sweep.nPlanningRigour, sweep.nFFTBackends[nBackend], 0, sweep.nHalfPrecisionFrom));
+						fLoadMilliseconds.push_back(t.msec());
+					}
+					while (repeat(fLoadMilliseconds, sweep));
+					base.fLoadMilliseconds = median(fLoadMilliseconds);
+					conv->selectConvolutionIndex(0);
+
+					float fAttenuation = 0;
+					const HRESULT hr = conv->SelectedConvolution().calculateOptimumAttenuation(fAttenuation, base.nPartitions == 0);
+					if (FAILED(hr))
+						throw convolutionException("Failed to calculate optimum attenuation");
+
+					const ChannelPaths& Mixer = conv->SelectedConvolution().Mixer;
+					base.nInputChannels = Mixer.nInputChannels();
+					base.nOutputChannels = Mixer.nOutputChannels();
+					base.nPaths = Mixer.nPaths();
+					base.nFilterLength = Mixer.nFilterLength();
+					base.nPartitionLength = Mixer.nPartitionLength();
+					base.nSamplesPerSec = Mixer.nSamplesPerSec();
+					std::wcerr << "loaded in " << base.fLoadMilliseconds << " ms" << std::endl;
+
+					// What the half precision spectra cost, against a load at single precision
+					if (sweep.nHalfPrecisionFrom < Mixer.nPartitions)
+					{
+						const ConvolutionList<float> reference(base.szConfig.c_str(), base.nPartitions == 0 ? 1 : base.nPartitions,
+							sweep.nPlanningRigour, sweep.nFFTBackends[nBackend]);
+						base.fHalfPrecisionSNR = measureHalfPrecisionSNR(Mixer, reference[0].Mixer,
+							base.nPartitions == 0);
+						std::wcerr << "  half precision from partition " << sweep.nHalfPrecisionFrom << ": "
+							<< std::setprecision(4) << base.fHalfPrecisionSNR << " dB SNR (" << Mixer.fHalfPrecisionSNR()
+							<< " dB from the spectra)" << std::endl;
+					}
+
+					for (std::vector< std::basic_string<TCHAR> >::size_type nFormat = 0; nFormat < sweep.szFormats.size(); ++nFormat)
+					{
+						for (std::vector<DWORD>::size_type nBuffer = 0; nBuffer < sweep.nBufferFrames.size(); ++nBuffer)
+						{
+							for (std::vector<unsigned int>::size_type nThread = 0; nThread < sweep.nThreads.size(); ++nThread)
+							{
+								BenchmarkResult result = base;
+								result.szFormat = sweep.szFormats[nFormat];
+								result.nBufferFrames = sweep.nBufferFrames[nBuffer];
+								result.nThreads = sweep.nThreads[nThread];
+								result.nFootprintBytes = Needed.nTotal(result.nThreads + 1);	// the workers, and conv
+								try
+								{
+									if (sweep.nMemoryBudget > 0 && result.nFootprintBytes > sweep.nMemoryBudget)
+										throw convolutionException("Over the memory budget: needs " +
+										Needed.DisplayFootprint(result.nThreads + 1));
+
+									std::vector<BenchmarkResult> runs;
+									std::vector<double> fRealtimes;
+									do
+									{
+										BenchmarkResult run = result;
+										runCase(Mixer, fAttenuation, sweep.fSeconds, run);
+										if (!run.szError.empty())
+										{
+											result.szError = run.szError;
+											break;
+										}
+										runs.push_back(run);
+										fRealtimes.push_back(run.fRealtime);
+									}
+									while (repeat(fRealtimes, sweep));
+
+									if (result.szError.empty())
+									{
+										// Report the run with the median throughput, so that its latencies go with it
+										const double fMedian = median(fRealtimes);
+										std::vector<BenchmarkResult>::size_type nMedian = 0;
+										while (runs[nMedian].fRealtime != fMedian)
+											++nMedian;
+										result = runs[nMedian];
+										result.nRepeats = static_cast<unsigned int>(runs.size());
+										result.fSpread = relativeSpread(fRealtimes);
+									}
+								}
+								catch(const std::exception& error)
+								{
+									result.szError = error.what();
+								}
+
+								std::wcerr << "  " << result.szFormat << ", " << result.nBufferFrames << " frames, "
+									<< result.nThreads << " thread(s): ";
+								if (result.szError.empty())
+								{
+									std::wcerr << std::setprecision(4) << result.fRealtime << " x realtime, p99 "
+										<< result.fLatencyP99 << " us of " << result.fBudgetMicroseconds << " us";
+									if (result.nRepeats > 1)
+										std::wcerr << " (" << result.nRepeats << " runs, spread " << 100 * result.fSpread << "%)";
+									std::wcerr << std::endl;
+								}
+								else
+								{
+									std::wcerr << result.szError.c_str() << std::endl;
+								}
+								results.push_back(result);
+							}
+						}
+					}
+				}
+				catch(const std::exception& error)
+				{
+					base.szError = error.what();
+					std::wcerr << base.szError.c_str() << std::endl;
+					results.push_back(base);
+				}
+			}
+		}
+	}
+}
+
+void writeBenchmarksJSON(std::ostream& out, const BenchmarkSweep& sweep, const std::vector<BenchmarkResult>& results)
+{
+	SYSTEM_INFO si;
+	::GetSystemInfo(&si);
+
+	out << std::setprecision(6);
+	out << "{" << std::endl;
+	out << "  \"benchmark\": \"perftest\"," << std::endl;
+	out << "  \"profile\": \"" << escapeJSON(sweep.szProfile) << "\"," << std::endl;
+	out << "  \"processors\": " << si.dwNumberOfProcessors << "," << std::endl;
+	out << "  \"planning_rigour\": " << sweep.nPlanningRigour << "," << std::endl;
+	out << "  \"seconds_per_case\": " << sweep.fSeconds << "," << std::endl;
+	out << "  \"max_repeats\": " << sweep.nMaxRepeats << "," << std::endl;
+	out << "  \"stability\": " << sweep.fStability << "," << std::endl;
+	if (sweep.nHalfPrecisionFrom != nNoHalfPrecision)
+		out << "  \"half_precision_from\": " << sweep.nHalfPrecisionFrom << "," << std::endl;
+	out << "  \"results\": [";
+	for (std::vector<BenchmarkResult>::size_type i = 0; i < results.size(); ++i)
+	{
+		const BenchmarkResult& r = results[i];
+		out << (i == 0 ? "" : ",") << std::endl << "    {";
+		out << "\"config\": \"" << escapeJSON(std::string(CT2CA(r.szConfig.c_str()))) << "\", ";
+		out << "\"fft\": \"" << escapeJSON(std::string(CT2CA(r.szFFTBackend.c_str()))) << "\", ";
+		out << "\"partitions\": " << r.nPartitions << ", ";
+		out << "\"buffer_frames\": " << r.nBufferFrames << ", ";
+		out << "\"format\": \"" << escapeJSON(std::string(CT2CA(r.szFormat.c_str()))) << "\", ";
+		out << "\"threads\": " << r.nThreads << ", ";
+		out << "\"input_channels\": " << r.nInputChannels << ", ";
+		out << "\"output_channels\": " << r.nOutputChannels << ", ";
+		out << "\"paths\": " << r.nPaths << ", ";
+		out << "\"filter_length\": " << r.nFilterLength << ", ";
+		out << "\"partition_length\": " << r.nPartitionLength << ", ";
+		out << "\"sample_rate\": " << r.nSamplesPerSec << ", ";
+		out << "\"load_ms\": " << r.fLoadMilliseconds << ", ";
+		out << "\"footprint_bytes\": " << r.nFootprintBytes << ", ";
+		if (r.fHalfPrecisionSNR != 0)
+			out << "\"snr_db\": " << r.fHalfPrecisionSNR << ", ";
+		out << "\"calls\": " << r.nCalls << ", ";
+		out << "\"seconds\": " << r.fSeconds << ", ";
+		out << "\"x_realtime\": " << r.fRealtime << ", ";
+		out << "\"budget_us\": " << r.fBudgetMicroseconds << ", ";
+		out << "\"latency_us\": {\"p50\": " << r.fLatencyP50 << ", \"p99\": " << r.fLatencyP99
+			<< ", \"p99.9\": " << r.fLatencyP999 << ", \"max\": " << r.fLatencyMax << "}, ";
+		out << "\"overruns\": " << r.nOverruns << ", ";
+		out << "\"repeats\": " << r.nRepeats << ", ";
+		out << "\"spread\": " << r.fSpread;
+		if (!r.szError.empty())
+			out << ", \"error\": \"" << escapeJSON(r.szError) << "\"";
+		out << "}";
+	}
+	out << std::endl << "  ]" << std::endl << "}" << std::endl;
+}
+
+void writeBenchmarksCSV(std::ostream& out, const std::vector<BenchmarkResult>& results)
+{
+	out << std::setprecision(6);
+	out << "config,fft,partitions,buffer_frames,format,threads,input_channels,output_channels,paths,filter_length,"
+		"partition_length,sample_rate,load_ms,footprint_bytes,snr_db,calls,seconds,x_realtime,budget_us,p50_us,p99_us,p99.9_us,max_us,overruns,repeats,spread,error"
+		<< std::endl;
+	for (std::vector<BenchmarkResult>::size_type i = 0; i < results.size(); ++i)
+	{
+		const BenchmarkResult& r = results[i];
+		out << quoteCSV(std::string(CT2CA(r.szConfig.c_str()))) << "," << quoteCSV(std::string(CT2CA(r.szFFTBackend.c_str()))) << ","
+			<< r.nPartitions << "," << r.nBufferFrames << ","
+			<< quoteCSV(std::string(CT2CA(r.szFormat.c_str()))) << "," << r.nThreads << ","
+			<< r.nInputChannels << "," << r.nOutputChannels << "," << r.nPaths << "," << r.nFilterLength << ","
+			<< r.nPartitionLength << "," << r.nSamplesPerSec << "," << r.fLoadMilliseconds << "," << r.nFootprintBytes << ","
+			<< r.fHalfPrecisionSNR << ","
+			<< r.nCalls << "," << r.fSeconds << "," << r.fRealtime << "," << r.fBudgetMicroseconds << ","
+			<< r.fLatencyP50 << "," << r.fLatencyP99 << "," << r.fLatencyP999 << "," << r.fLatencyMax << ","
+			<< r.nOverruns << "," << r.nRepeats << "," << r.fSpread << "," << quoteCSV(r.szError) << std::endl;
+	}
+}
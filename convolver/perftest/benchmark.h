@@ -0,0 +1,106 @@
+#pragma once
+// Convolver: DSP plug-in for Windows Media Player that convolves an impulse respose
+// filter it with the input stream.
+//
+// Copyright (C) 2005  John Pavel
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//
+/////////////////////////////////////////////////////////////////////////////
+//
+// benchmark.h : Sweep the real-time engine over the parameters that size a host
+//
+// Each case streams host-sized buffers of noise through one worker engine per
+// thread, for a fixed time, and records the duration of every call.  The
+// results give the sustained throughput, as a multiple of real time, and the
+// latency percentiles against the real-time budget of a buffer.  Cases can be
+// repeated until their throughput is stable, for comparison with a baseline.
+//
+/////////////////////////////////////////////////////////////////////////////
+
+#include "convolution\config.h"
+#include "convolution\convolution.h"
+#include <string>
+#include <vector>
+#include <iostream>
+
+// The sample formats of the host buffers that can be benchmarked
+const TCHAR* const BenchmarkFormats[] = { TEXT("float"), TEXT("pcm16"), TEXT("pcm24"), TEXT("pcm32") };
+const unsigned int nBenchmarkFormats = sizeof(BenchmarkFormats) / sizeof(BenchmarkFormats[0]);
+
+// The dimensions of the sweep
+struct BenchmarkSweep
+{
+	std::vector< std::basic_string<TCHAR> >	szConfigs;		// config files (or filter sound files)
+	std::vector<unsigned int>				nFFTBackends;	// indexes FFTBackend::Get, each run on the same cases
+	std::vector<DWORD>						nPartitions;	// 0 => overlap-save
+	std::vector<DWORD>						nBufferFrames;	// frames passed to each call, as by a host
+	std::vector< std::basic_string<TCHAR> >	szFormats;		// from BenchmarkFormats
+	std::vector<unsigned int>				nThreads;		// concurrent streams, each with its own worker engine
+	double									fSeconds;		// timed, per run of a case
+	unsigned int							nMaxRepeats;	// runs of each case (and loads of each config), at most
+	double									fStability;		// stop repeating once the spread of the runs is within this
+	unsigned int							nPlanningRigour;
+	ULONGLONG								nMemoryBudget;	// bytes; cases whose engines would need more are skipped
+	DWORD									nHalfPrecisionFrom;	// the first filter partition stored at half precision
+	std::string								szProfile;		// the machine, for matching against baselines
+};
+
+// One point in the sweep, and what was measured
+struct BenchmarkResult
+{
+	std::basic_string<TCHAR> szConfig;
+	std::basic_string<TCHAR> szFFTBackend;
+	DWORD			nPartitions;
+	DWORD			nBufferFrames;
+	std::basic_string<TCHAR> szFormat;
+	unsigned int	nThreads;
+
+	WORD			nInputChannels;
+	WORD			nOutputChannels;
+	DWORD			nPaths;
+	DWORD			nFilterLength;
+	DWORD			nPartitionLength;
+	DWORD			nSamplesPerSec;
+	double			fLoadMilliseconds;		// to load and plan the filters (the median of the loads)
+	ULONGLONG		nFootprintBytes;		// of the filters, plans and engines (see ConvolutionList::footprint)
+	double			fHalfPrecisionSNR;		// dB, against the output of single precision spectra; 0 => not measured
+
+	DWORD			nCalls;					// timed, over all threads
+	double			fSeconds;				// wall clock
+	double			fRealtime;				// aggregate frames / (seconds * sample rate), over all threads
+	double			fBudgetMicroseconds;	// the duration of a buffer
+	double			fLatencyP50;			// microseconds per call
+	double			fLatencyP99;
+	double			fLatencyP999;
+	double			fLatencyMax;
+	DWORD			nOverruns;				// calls that took longer than a buffer lasts
+	unsigned int	nRepeats;				// runs; the figures above are from the run with the median throughput
+	double			fSpread;				// median absolute deviation of the throughput of the runs / median
+
+	std::string		szError;				// non-empty => the case could not be run
+
+	BenchmarkResult() : nPartitions(0), nBufferFrames(0), nThreads(0), nInputChannels(0), nOutputChannels(0), nPaths(0),
+		nFilterLength(0), nPartitionLength(0), nSamplesPerSec(0), fLoadMilliseconds(0), nFootprintBytes(0), fHalfPrecisionSNR(0), nCalls(0), fSeconds(0), fRealtime(0),
+		fBudgetMicroseconds(0), fLatencyP50(0), fLatencyP99(0), fLatencyP999(0), fLatencyMax(0), nOverruns(0),
+		nRepeats(0), fSpread(0) {}
+};
+
+// Run every case in the sweep, reporting progress on std::wcerr
+void runBenchmarks(const BenchmarkSweep& sweep, std::vector<BenchmarkResult>& results);
+
+// Machine-readable reports
+void writeBenchmarksJSON(std::ostream& out, const BenchmarkSweep& sweep, const std::vector<BenchmarkResult>& results);
+void writeBenchmarksCSV(std::ostream& out, const std::vector<BenchmarkResult>& results);
@@ -15,8 +15,14 @@
 #include "debugging\fasttiming.h"
 #include "convolution\wavefile.h"
 #include "convolution\convolution.h"
+#include "benchmark.h"
+#include "baseline.h"
+#include "alloccheck.h"
+#include "shapercheck.h"
 #include <iostream>
 #include <sstream>
+#include <fstream>
+#include <algorithm>
 
 #ifdef MINGW_FFTW
 // For MinGW-compile FFTW, which does not do its own initialization
@@ -27,6 +33,144 @@ static int my_fftwf_read_char(void *f) { return fgetc((FILE *) f); }
 #define fftwf_import_wisdom_from_file(f) fftwf_import_wisdom(my_fftwf_read_char, (void*) (f))
 #endif
 
+namespace
+{
+	// Parse a comma-separated list, replacing values.  false => malformed
+	template <typename T>
+	bool parseList(const TCHAR* szList, std::vector<T>& values)
+	{
+		values.clear();
+		std::wistringstream list(szList);
+		std::wstring szItem;
+		while (std::getline(list, szItem, TEXT(',')))
+		{
+			std::wistringstream item(szItem);
+			T value;
+			item >> value;
+			if (item.fail())
+				return false;
+			values.push_back(value);
+		}
+		return !values.empty();
+	}
+
+	bool validFormats(const std::vector< std::basic_string<TCHAR> >& szFormats)
+	{
+		for (std::vector< std::basic_string<TCHAR> >::size_type i = 0; i < szFormats.size(); ++i)
+		{
+			if (std::find(BenchmarkFormats, BenchmarkFormats + nBenchmarkFormats, szFormats[i]) == BenchmarkFormats + nBenchmarkFormats)
+				return false;
+		}
+		return true;
+	}
+
+	// FFT backends by name, or "all".  false => unknown
+	bool parseBackends(const TCHAR* szList, std::vector<unsigned int>& nBackends)
+	{
+		nBackends.clear();
+		if (_tcsicmp(szList, TEXT("all")) == 0)
+		{
+			for (unsigned int i = 0; i < FFTBackend::nBackends; ++i)
+				nBackends.push_back(i);
+			return true;
+		}
+
+		std::wistringstream list(szList);
+		std::wstring szItem;
+		while (std::getline(list, szItem, TEXT(',')))
+		{
+			try
+			{
+				nBackends.push_back(FFTBackend::Lookup(szItem.c_str()));
+			}
+			catch(const std::range_error&)
+			{
+				return false;
+			}
+		}
+		return !nBackends.empty();
+	}
+
+	// A config file (or filter sound file), or every .txt config in a directory
+	void listConfigs(const TCHAR* szPath, std::vector< std::basic_string<TCHAR> >& szConfigs)
+	{
+		const DWORD dwAttributes = ::GetFileAttributes(szPath);
+		if (dwAttributes == INVALID_FILE_ATTRIBUTES)
+			throw channelPathsException("Not found", szPath);
+
+		if ((dwAttributes & FILE_ATTRIBUTE_DIRECTORY) == 0)
+		{
+			szConfigs.push_back(szPath);
+			return;
+		}
+
+		std::basic_string<TCHAR> szDirectory(szPath);
+		if (!szDirectory.empty() && szDirectory[szDirectory.length() - 1] != TEXT('\\'))
+			szDirectory += TEXT('\\');
+
+		WIN32_FIND_DATA fd;
+		HANDLE hFind = ::FindFirstFile((szDirectory + TEXT("*.txt")).c_str(), &fd);
+		if (hFind == INVALID_HANDLE_VALUE)
+			throw channelPathsException("No configs in directory", szPath);
+
+		std::vector< std::basic_string<TCHAR> > szFound;
+		do
+		{
+			if ((fd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) == 0)
+				szFound.push_back(szDirectory + fd.cFileName);
+		}
+		while (::FindNextFile(hFind, &fd));
+		::FindClose(hFind);
+
+		std::sort(szFound.begin(), szFound.end());
+		szConfigs.insert(szConfigs.end(), szFound.begin(), szFound.end());
+	}
+
+	// A baseline file, or the one for the profile in a baseline directory
+	void readBaseline(const TCHAR* szPath, const std::string& szProfile, std::vector<BenchmarkResult>& baseline)
+	{
+		std::basic_string<TCHAR> szFile(szPath);
+		const DWORD dwAttributes = ::GetFileAttributes(szPath);
+		if (dwAttributes != INVALID_FILE_ATTRIBUTES && (dwAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0)
+		{
+			if (!szFile.empty() && szFile[szFile.length() - 1] != TEXT('\\'))
+				szFile += TEXT('\\');
+			szFile += CA2CT((szProfile + ".json").c_str());
+		}
+
+		std::ifstream in(szFile.c_str());
+		if (!in)
+			throw convolutionException("No baseline " + std::string(CT2CA(szFile.c_str())));
+
+		std::string szBaselineProfile;
+		readBenchmarksJSON(in, szBaselineProfile, baseline);
+		if (szBaselineProfile != szProfile)
+			throw convolutionException("The baseline " + std::string(CT2CA(szFile.c_str())) + " is for " + szBaselineProfile +
+			", not " + szProfile + " (see --profile)");
+	}
+
+	// szFile == NULL or "-" => stdout
+	void writeResults(const TCHAR* szFile, const BenchmarkSweep& sweep, const std::vector<BenchmarkResult>& results, const bool bJSON)
+	{
+		if (szFile == NULL || _tcscmp(szFile, TEXT("-")) == 0)
+		{
+			if (bJSON)
+				writeBenchmarksJSON(std::cout, sweep, results);
+			else
+				writeBenchmarksCSV(std::cout, results);
+			return;
+		}
+
+		std::ofstream out(szFile);
+		if (!out)
+			throw convolutionException("Failed to create " + std::string(CT2CA(szFile)));
+		if (bJSON)
+			writeBenchmarksJSON(out, sweep, results);
+		else
+			writeBenchmarksCSV(out, results);
+	}
+}
+
 
 int	_tmain(int argc, _TCHAR* argv[])
 {
@@ -57,17 +201,161 @@ int	_tmain(int argc, _TCHAR* argv[])
 #endif
 
 	HRESULT	hr = S_OK;
-	double fElapsedLoad	= 0;
-	double fTotalElapsedLoad = 0;
-	double fElapsedCalc = 0;
-	double fTotalElapsedCalc = 0;
-	apHiResElapsedTime t;
 
-	//CWaveFileHandle	FilterWav;
+	SYSTEM_INFO si;
+	::GetSystemInfo(&si);
+
+	// The default sweep
+	BenchmarkSweep sweep;
+	const DWORD nDefaultPartitions[] = { 0, 1, 2, 4, 8, 16 };
+	sweep.nPartitions.assign(nDefaultPartitions, nDefaultPartitions + sizeof(nDefaultPartitions) / sizeof(nDefaultPartitions[0]));
+	const DWORD nDefaultBufferFrames[] = { 64, 128, 256, 512, 1024, 4096 };
+	sweep.nBufferFrames.assign(nDefaultBufferFrames, nDefaultBufferFrames + sizeof(nDefaultBufferFrames) / sizeof(nDefaultBufferFrames[0]));
+	sweep.szFormats.assign(BenchmarkFormats, BenchmarkFormats + nBenchmarkFormats);
+	for (unsigned int nThreads = 1; nThreads <= si.dwNumberOfProcessors; nThreads *= 2)
+		sweep.nThreads.push_back(nThreads);
+	sweep.fSeconds = 1;
+	sweep.nMaxRepeats = 0;		// => 1, or 10 against a baseline
+	sweep.fStability = 0.02;
+	sweep.nPlanningRigour = 0;
+	sweep.nMemoryBudget = 0;
+	sweep.nHalfPrecisionFrom = nNoHalfPrecision;
+	sweep.nFFTBackends.push_back(0);
+	sweep.szProfile = machineProfile();
+
+	const TCHAR* szJSONFile = NULL;
+	const TCHAR* szCSVFile = NULL;
+	const TCHAR* szBaseline = NULL;
+	double fThreshold = 0.05;
+	DWORD nAllocCheckCalls = 0;		// 0 => benchmark, rather than check for heap use
+	DWORD nShaperCheckFrames = 0;	// 0 => benchmark, rather than check the vectorized noise shapers
+
+	// Options precede the config files
+	int nArg = 1;
+	bool bUsage = false;
+	while (nArg < argc && _tcsncmp(argv[nArg], TEXT("--"), 2) == 0)
+	{
+		if (nArg + 1 == argc)
+		{
+			bUsage = true;		// every option takes a value
+			break;
+		}
+		const TCHAR* szValue = argv[nArg + 1];
+		if (_tcscmp(argv[nArg], TEXT("--partitions")) == 0)
+			bUsage = bUsage || !parseList(szValue, sweep.nPartitions);
+		else if (_tcscmp(argv[nArg], TEXT("--buffers")) == 0)
+			bUsage = bUsage || !parseList(szValue, sweep.nBufferFrames) ||
+			std::find(sweep.nBufferFrames.begin(), sweep.nBufferFrames.end(), 0) != sweep.nBufferFrames.end();
+		else if (_tcscmp(argv[nArg], TEXT("--formats")) == 0)
+			bUsage = bUsage || !parseList(szValue, sweep.szFormats) || !validFormats(sweep.szFormats);
+		else if (_tcscmp(argv[nArg], TEXT("--threads")) == 0)
+			bUsage = bUsage || !parseList(szValue, sweep.nThreads) ||
+			std::find(sweep.nThreads.begin(), sweep.nThreads.end(), 0) != sweep.nThreads.end();
+		else if (_tcscmp(argv[nArg], TEXT("--seconds")) == 0)
+		{
+			std::wistringstream szSeconds(szValue);
+			szSeconds >> sweep.fSeconds;
+			bUsage = bUsage || szSeconds.fail() || sweep.fSeconds <= 0;
+		}
+		else if (_tcscmp(argv[nArg], TEXT("--fft")) == 0)
+			bUsage = bUsage || !parseBackends(szValue, sweep.nFFTBackends);
+		else if (_tcscmp(argv[nArg], TEXT("--rigour")) == 0)
+		{
+			std::wistringstream szPlanningRigour(szValue);
+			szPlanningRigour >> sweep.nPlanningRigour;
+			bUsage = bUsage || szPlanningRigour.fail() || sweep.nPlanningRigour > PlanningRigour::nDegrees - 1;
+		}
+		else if (_tcscmp(argv[nArg], TEXT("--budget")) == 0)
+		{
+			std::wistringstream szBudget(szValue);
+			double fMegabytes = 0;
+			szBudget >> fMegabytes;
+			bUsage = bUsage || szBudget.fail() || fMegabytes <= 0;
+			sweep.nMemoryBudget = static_cast<ULONGLONG>(fMegabytes * 1048576);
+		}
+		else if (_tcscmp(argv[nArg], TEXT("--half")) == 0)
+		{
+			std::wistringstream szHalfPrecisionFrom(szValue);
+			szHalfPrecisionFrom >> sweep.nHalfPrecisionFrom;
+			bUsage = bUsage || szHalfPrecisionFrom.fail();
+		}
+		else if (_tcscmp(argv[nArg], TEXT("--repeats")) == 0)
+		{
+			std::wistringstream szRepeats(szValue);
+			szRepeats >> sweep.nMaxRepeats;
+			bUsage = bUsage || szRepeats.fail() || sweep.nMaxRepeats == 0;
+		}
+		else if (_tcscmp(argv[nArg], TEXT("--stability")) == 0)
+		{
+			std::wistringstream szStability(szValue);
+			szStability >> sweep.fStability;
+			bUsage = bUsage || szStability.fail() || sweep.fStability < 0;
+			sweep.fStability /= 100;
+		}
+		else if (_tcscmp(argv[nArg], TEXT("--baseline")) == 0)
+			szBaseline = szValue;
+		else if (_tcscmp(argv[nArg], TEXT("--threshold")) == 0)
+		{
+			std::wistringstream szThreshold(szValue);
+			szThreshold >> fThreshold;
+			bUsage = bUsage || szThreshold.fail() || fThreshold < 0;
+			fThreshold /= 100;
+		}
+		else if (_tcscmp(argv[nArg], TEXT("--profile")) == 0)
+			sweep.szProfile = CT2CA(szValue);
+		else if (_tcscmp(argv[nArg], TEXT("--alloc-check")) == 0)
+		{
+			std::wistringstream szCalls(szValue);
+			szCalls >> nAllocCheckCalls;
+			bUsage = bUsage || szCalls.fail() || nAllocCheckCalls == 0;
+		}
+		else if (_tcscmp(argv[nArg], TEXT("--shaper-check")) == 0)
+		{
+			std::wistringstream szFrames(szValue);
+			szFrames >> nShaperCheckFrames;
+			bUsage = bUsage || szFrames.fail() || nShaperCheckFrames == 0;
+		}
+		else if (_tcscmp(argv[nArg], TEXT("--json")) == 0)
+			szJSONFile = szValue;
+		else if (_tcscmp(argv[nArg], TEXT("--csv")) == 0)
+			szCSVFile = szValue;
+		else
+			bUsage = true;
+		nArg += 2;
+	}
 
-	if (argc !=	5)
+	if (bUsage || (nArg == argc && nShaperCheckFrames == 0))
 	{
-		std::wcerr << "Usage: perftest MaxnPartitions nIterations nTuningRigour config.txt|IR.wav" << std::endl;
+		std::wcerr << "Usage: perftest [--partitions 0,1,2,..] [--buffers 64,128,..] [--formats float,pcm16,pcm24,pcm32]" << std::endl;
+		std::wcerr << "                [--threads 1,2,..] [--seconds s] [--rigour 0-" << PlanningRigour::nDegrees - 1 << "] [--fft name,..|all]" << std::endl;
+		std::wcerr << "                [--budget MB] [--half partition] [--repeats n] [--stability %] [--baseline file.json|directory] [--threshold %] [--profile name]" << std::endl;
+		std::wcerr << "                [--json results.json] [--csv results.csv] [--alloc-check calls] config.txt|IR.wav|directory ..." << std::endl;
+		std::wcerr << "       perftest --shaper-check frames" << std::endl;
+		std::wcerr << "       --partitions = 0 for overlap-save, or the number of partitions (default 0,1,2,4,8,16)" << std::endl;
+		std::wcerr << "       --buffers = frames per call, as passed by a host (default 64,128,256,512,1024,4096)" << std::endl;
+		std::wcerr << "       --formats = host sample formats (default all)" << std::endl;
+		std::wcerr << "       --threads = concurrent streams, each with its own engine (default powers of 2 up to the cores)" << std::endl;
+		std::wcerr << "       --seconds = timed per run of a case (default 1)" << std::endl;
+		std::wcerr << "       --fft = the FFT backends to run every case with (";
+		for (unsigned int i = 0; i < FFTBackend::nBackends; ++i)
+			std::wcerr << (i == 0 ? "" : ", ") << FFTBackend::Get(i).szName();
+		std::wcerr << "; default " << FFTBackend::Get(0).szName() << ")" << std::endl;
+		std::wcerr << "       --budget = skip the cases whose filters, plans and engines would need more than this many MB" << std::endl;
+		std::wcerr << "       --half = store the filter spectra at half precision from this partition on (0 for all), and measure" << std::endl;
+		std::wcerr << "                the SNR of the output against that of single precision spectra" << std::endl;
+		std::wcerr << "       --repeats = runs of each case, at most, until stable (default 1, or 10 with --baseline)" << std::endl;
+		std::wcerr << "       --stability = stop repeating when the spread of the runs is within this (default 2)" << std::endl;
+		std::wcerr << "       --baseline = compare with the results stored by --json, or those for this profile in a directory" << std::endl;
+		std::wcerr << "                    (directory\\profile.json); exits with 2 if any regressed by more than --threshold" << std::endl;
+		std::wcerr << "       --threshold = the fall in throughput, or rise in load time, that is a regression (default 5)" << std::endl;
+		std::wcerr << "       --profile = the machine (default " << sweep.szProfile.c_str() << ")" << std::endl;
+		std::wcerr << "       --json, --csv = where to write the results (- for stdout).  Default CSV to stdout, unless --baseline" << std::endl;
+		std::wcerr << "       --alloc-check = instead of benchmarking, make this many calls of every sample format, ditherer and" << std::endl;
+		std::wcerr << "                       noise shaper, for each config, partitions and buffer size; exits with 3 if any" << std::endl;
+		std::wcerr << "                       allocated or freed heap memory" << std::endl;
+		std::wcerr << "       --shaper-check = instead of benchmarking, shape this many frames of noise with every PCM format," << std::endl;
+		std::wcerr << "                        ditherer and noise shaper, scalar and vectorized; exits with 4 if the outputs differ" << std::endl;
+		std::wcerr << "       a directory => every .txt config in it (eg, configs\\)" << std::endl;
 		return 1;
 	}
 
@@ -92,110 +380,38 @@ int	_tmain(int argc, _TCHAR* argv[])
 		}
 #endif
 
-		std::wistringstream	szPartitions(argv[1]);
-		unsigned int max_nPartitions;	// Can't use WORD as that seems to break >>
-		szPartitions >>	max_nPartitions;
-		if (max_nPartitions	< 0 || max_nPartitions > 1000)
-		{
-			std::cerr << "max_nPartitions (" << max_nPartitions << ") must be between 0 and 1000" << std::endl;
-			throw(std::length_error("invalid max_nPartitions"));
-		}
+		for (; nArg < argc; ++nArg)
+			listConfigs(argv[nArg], sweep.szConfigs);
 
-		std::wistringstream	szIterations(argv[2]);
-		int nIterations;
-		szIterations >>	nIterations;
-		if (nIterations	< 1 || nIterations > 1000)
+		if (nShaperCheckFrames > 0)
 		{
-			std::wcerr << "nIterations (" << nIterations << ") must be between 1 and 1000" << std::endl;
-			throw(std::length_error("invalid nIterations"));
+			if (runShaperChecks(nShaperCheckFrames) > 0)
+				hr = 4;		// the vectorized noise shapers are not equivalent
 		}
-
-		//PlanningRigour pr;
-		std::wistringstream	szPlanningRigour(argv[3]);
-		unsigned int nPlanningRigour;
-		szPlanningRigour >>	nPlanningRigour;
-		if (nPlanningRigour	< 0 || nPlanningRigour > PlanningRigour::nDegrees - 1)
+		else if (nAllocCheckCalls > 0)
 		{
-			std::wcerr << "nTuningRigour (" << nPlanningRigour << ") must be between 0 and " << PlanningRigour::nDegrees - 1 << std::endl;
-			throw(std::length_error("invalid nTuningRigour"));
+			if (runAllocationChecks(sweep, nAllocCheckCalls) > 0)
+				hr = 3;		// the engine used the heap
 		}
-
-
-		//#ifdef LIBSNDFILE
-		//		SF_INFO sfinfo;
-		//		ZeroMemory(&sfinfo, sizeof(SF_INFO));
-		//		CWaveFileHandle FilterWav(argv[4], SFM_READ, &sfinfo);
-		//		std::cerr << waveFormatDescription(sfinfo, 	"Filter file format: ") << std::endl;
-		//#else
-		//		std::basic_string< _TCHAR >FilterFileName(argv[4],	_tcslen(argv[4]));
-		//		if(	FAILED(	hr = FilterWav->Open( argv[4], NULL, WAVEFILE_READ ) ) )
-		//		{
-		//			std::wcerr << "Failed to open "	<< FilterFileName << " for reading"	<< std::endl;
-		//			throw(hr);
-		//		}
-		//
-		//		WAVEFORMATEX *pWave	= FilterWav->GetFormat();
-		//		std::cerr << waveFormatDescription(reinterpret_cast<WAVEFORMATEXTENSIBLE*>(pWave), 
-		//			FilterWav->GetSize() / FilterWav->GetFormat()->nBlockAlign,	"Filter file format: ") << std::endl;
-		//#endif
-
-		ConvolutionList<float> conv(argv[4], 1, nPlanningRigour);
-		std::cerr << conv.DisplayConvolutionList() << std::endl;
-
-		float fAttenuation	= 0;
-
-		for(int i=0; i<conv.nConvolutionList(); ++i)
+		else
 		{
-
-			conv.selectConvolutionIndex(i);
-			std::cerr << std::endl << conv.SelectedConvolution().Mixer.DisplayChannelPaths();
-
-#ifdef LIBSNDFILE
-			std::cout << std::endl << "Partitions\tRate\tSecCalc\tSecLoad\tAttenuation\tFilter Length\tPartition Length\tIteration" << std::endl;
-#else
-			std::cout << std::endl << "Partitions\tSecCalc\tSecLoad\tAttenuation\tFilter Length\tPartition Length\tIteration" << std::endl;
-#endif
-
-			fTotalElapsedLoad = 0;
-			fTotalElapsedCalc = 0;
-
-			for (WORD nPartitions = 0; nPartitions <= max_nPartitions; ++nPartitions)
-			{
-				for (WORD nIteration = 1; nIteration<=nIterations; ++nIteration)
-				{
-					t.reset();
-					ConvolutionList<float> convp(argv[4], 
-						nPartitions == 0 ? 1 : nPartitions, 
-						nPlanningRigour); // Used to calculate nPartitionLength
-					fElapsedLoad = t.sec();
-					fTotalElapsedLoad += fElapsedLoad;
-
-					convp.selectConvolutionIndex(i);
-
-					t.reset();
-					hr = convp.SelectedConvolution().calculateOptimumAttenuation(fAttenuation, nPartitions == 0);
-					fElapsedCalc = t.sec();
-					fTotalElapsedCalc += fElapsedCalc;
-
-					if (FAILED(hr))
-					{
-						std::wcerr << "Failed to calculate optimum attenuation (" << std::hex << hr	<< std::dec << ")" << std::endl;
-						throw (hr);
-					}
-					std::cout  << std::setprecision(3) << nPartitions << "\t"
-#ifdef LIBSNDFILE
-						<< (static_cast<float>(convp.SelectedConvolution().Mixer.Paths()[0].filter.sf_FilterFormat().frames * NSAMPLES) / fElapsedCalc) /
-						static_cast<float>(convp.SelectedConvolution().Mixer.Paths()[0].filter.sf_FilterFormat().samplerate) << "\t"
-#endif
-						<< fElapsedCalc << "\t" << fElapsedLoad << "\t" 
-						<< fAttenuation << "\t" << convp.SelectedConvolution().Mixer.nFilterLength() << "\t" 
-						<< convp.SelectedConvolution().Mixer.nPartitionLength() << "\t" << nIteration  << std::endl;
-				}
-			}
-
-			std::cout << std::endl << "Total load time: " << fTotalElapsedLoad  << "s" << std::endl;
-			std::cout << "Total execution time: " << fTotalElapsedCalc << "s" << std::endl;
-
+			// Read the baseline first, so as not to run the sweep for nothing
+			std::vector<BenchmarkResult> baseline;
+			if (szBaseline != NULL)
+				readBaseline(szBaseline, sweep.szProfile, baseline);
+			if (sweep.nMaxRepeats == 0)
+				sweep.nMaxRepeats = szBaseline == NULL ? 1 : 10;
+
+			std::vector<BenchmarkResult> results;
+			runBenchmarks(sweep, results);
+
+			if (szJSONFile != NULL)
+				writeResults(szJSONFile, sweep, results, true);
+			if (szCSVFile != NULL || (szJSONFile == NULL && szBaseline == NULL))
+				writeResults(szCSVFile, sweep, results, false);
+
+			if (szBaseline != NULL && compareBenchmarks(std::cout, baseline, results, fThreshold) > 0)
+				hr = 2;		// regressed
 		}
 
 #ifdef MINGW_FFTW
@@ -219,6 +435,7 @@ int	_tmain(int argc, _TCHAR* argv[])
 	catch (convolutionException& error)
 	{
 		std::wcerr << "Convolver error: " << error.what() << std::endl;
+		hr = E_FAIL;
 	}
 	catch (HRESULT& hr) // from Convolution
 	{
@@ -0,0 +1,160 @@
+// Convolver: DSP plug-in for Windows Media Player that convolves an impulse respose
+// filter it with the input stream.
+//
+// Copyright (C) 2005  John Pavel
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//
+
+/////////////////////////////////////////////////////////////////////////////
+//
+// shapercheck.cpp : Check the vectorized noise shapers against the scalar ones
+//
+
+#include "stdafx.h"
+#include "shapercheck.h"
+#include "convolution\sample.h"
+#include <iostream>
+#include <iomanip>
+#include <vector>
+
+namespace
+{
+	const DWORD nSamplesPerSec = 44100;
+	const DWORD nCallFrames = 256;			// as a host might pass
+	const WORD nChannelCounts[] = { 1, 2, 6, 8 };
+	const unsigned int nDitherSeed = 1;		// any fixed seed, so that the scalar and vectorized dither agree
+
+	WAVEFORMATEXTENSIBLE extensibleFormat(const SampleFormatId& id, const WORD nChannels)
+	{
+		WAVEFORMATEXTENSIBLE wfex;
+		::ZeroMemory(&wfex, sizeof(wfex));
+		wfex.Format.wFormatTag = WAVE_FORMAT_EXTENSIBLE;
+		wfex.Format.nChannels = nChannels;
+		wfex.Format.nSamplesPerSec = nSamplesPerSec;
+		wfex.Format.wBitsPerSample = id.wBitsPerSample;
+		wfex.Format.nBlockAlign = nChannels * id.wBitsPerSample / 8;
+		wfex.Format.nAvgBytesPerSec = wfex.Format.nBlockAlign * nSamplesPerSec;
+		wfex.Format.cbSize = 22;
+		wfex.Samples.wValidBitsPerSample = id.wValidBitsPerSample;
+		wfex.SubFormat = id.SubType;
+		return wfex;
+	}
+
+	// Render the channels through a freshly-made output convertor, with the ditherers seeded alike.
+	// Returns the seconds taken
+	double render(const ConvertSampleMaker<float>& formats, const SampleFormatId& id,
+		const Ditherer<float>::DitherType nDither, const NoiseShaper<float>::NoiseShapingType nNoiseShaper,
+		const std::vector< std::vector<float> >& channels, const bool bVectorized, std::vector<BYTE>& pbOutput)
+	{
+		const WORD nChannels = static_cast<WORD>(channels.size());
+		const DWORD nFrames = static_cast<DWORD>(channels[0].size());
+
+		Holder< ConvertSample<float> > output;
+		WAVEFORMATEXTENSIBLE wfex = extensibleFormat(id, nChannels);
+		if (FAILED(formats.SelectSampleConvertor(&wfex.Format, output, nNoiseShaper, nDither, bVectorized, nDitherSeed)))
+			throw convolutionException("Unsupported output format");
+
+		pbOutput.resize(nFrames * nChannels * output->nContainerSize());
+		BYTE* pbOutputPointer = &pbOutput[0];
+		DWORD nBytesGenerated = 0;
+		std::vector<const float*> srcChannels(nChannels);
+
+		LARGE_INTEGER nStart, nStop, nFrequency;
+		::QueryPerformanceFrequency(&nFrequency);
+		::QueryPerformanceCounter(&nStart);
+		for (DWORD nFrame = 0; nFrame < nFrames; nFrame += nCallFrames)
+		{
+			for (WORD nChannel = 0; nChannel < nChannels; ++nChannel)
+				srcChannels[nChannel] = &channels[nChannel][nFrame];
+			output->PutSamples(pbOutputPointer, &srcChannels[0], nChannels, std::min<DWORD>(nCallFrames, nFrames - nFrame),
+				nBytesGenerated);
+		}
+		::QueryPerformanceCounter(&nStop);
+		return static_cast<double>(nStop.QuadPart - nStart.QuadPart) / nFrequency.QuadPart;
+	}
+}
+
+unsigned int runShaperChecks(const DWORD nFrames)
+{
+	const ConvertSampleMaker<float> formats;
+	unsigned int nFailures = 0;
+
+	try
+	{
+		for (DWORD nFormat = 0; nFormat < formats.size(); ++nFormat)
+		{
+			const SampleFormatId& id = formats[nFormat];
+			if (id.wFormatTag != WAVE_FORMAT_EXTENSIBLE || id.SubType != KSDATAFORMAT_SUBTYPE_PCM)
+				continue;		// The other tags select the same convertors, and floats are not shaped
+
+			std::wcerr << "pcm" << id.wBitsPerSample << "/" << id.wValidBitsPerSample << ": ";
+			unsigned int nCases = 0;
+			unsigned int nCaseFailures = 0;
+			double fScalarSeconds = 0;
+			double fVectorSeconds = 0;
+			for (unsigned int nCount = 0; nCount < sizeof(nChannelCounts) / sizeof(nChannelCounts[0]); ++nCount)
+			{
+				// Noise at +6dB, from a linear congruential generator, so that the shapers clip too
+				std::vector< std::vector<float> > channels(nChannelCounts[nCount], std::vector<float>(nFrames));
+				DWORD nNoise = 1;
+				for (WORD nChannel = 0; nChannel < nChannelCounts[nCount]; ++nChannel)
+				{
+					for (DWORD nFrame = 0; nFrame < nFrames; ++nFrame)
+					{
+						nNoise = nNoise * 1664525 + 1013904223;
+						channels[nChannel][nFrame] = 2.0f * ((static_cast<float>(nNoise >> 8) / (1 << 24)) - 0.5f);
+					}
+				}
+
+				for (unsigned int nDither = 0; nDither < Ditherer<float>::nDitherers; ++nDither)
+				{
+					for (unsigned int nNoiseShaper = 0; nNoiseShaper < NoiseShaper<float>::nNoiseShapers; ++nNoiseShaper)
+					{
+						++nCases;
+						std::vector<BYTE> pbScalar, pbVector;
+						fScalarSeconds += render(formats, id, static_cast<Ditherer<float>::DitherType>(nDither),
+							static_cast<NoiseShaper<float>::NoiseShapingType>(nNoiseShaper), channels, false, pbScalar);
+						fVectorSeconds += render(formats, id, static_cast<Ditherer<float>::DitherType>(nDither),
+							static_cast<NoiseShaper<float>::NoiseShapingType>(nNoiseShaper), channels, true, pbVector);
+						if (pbScalar != pbVector)
+						{
+							if (nCaseFailures++ == 0)
+								std::wcerr << std::endl;
+							std::wcerr << "  " << Ditherer<float>::Description[nDither] << " dither, "
+								<< NoiseShaper<float>::Description[nNoiseShaper] << ", "
+								<< nChannelCounts[nCount] << " channel(s): vectorized output differs" << std::endl;
+						}
+					}
+				}
+			}
+
+			if (nCaseFailures == 0)
+				std::wcerr << nCases << " cases identical";
+			else
+				std::wcerr << "  " << nCaseFailures << " of " << nCases << " cases differed";
+			std::wcerr << "; scalar " << std::fixed << std::setprecision(1) << 1e9 * fScalarSeconds / (nCases * nFrames)
+				<< "ns/frame, vectorized " << 1e9 * fVectorSeconds / (nCases * nFrames) << "ns/frame" << std::endl;
+			nFailures += nCaseFailures;
+		}
+	}
+	catch(const std::exception& error)
+	{
+		std::wcerr << error.what() << std::endl;
+		++nFailures;
+	}
+
+	return nFailures;
+}
@@ -0,0 +1,38 @@
+#pragma once
+// Convolver: DSP plug-in for Windows Media Player that convolves an impulse respose
+// filter it with the input stream.
+//
+// Copyright (C) 2005  John Pavel
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//
+
+/////////////////////////////////////////////////////////////////////////////
+//
+// shapercheck.h : Check the vectorized noise shapers against the scalar ones
+//
+// VectorNoiseShape shapes all the channels of a frame at once, but does the
+// arithmetic of the scalar shapers in the same order, so, with the ditherers
+// seeded alike, the two must produce the same bytes.  The check renders noise
+// through every PCM output format, ditherer and noise shaper both ways, and
+// compares, timing each.
+//
+/////////////////////////////////////////////////////////////////////////////
+
+#include "convolution\config.h"
+
+// Shape nFrames frames of each case, reporting on std::wcerr.  Returns the number of cases whose
+// vectorized output differed from the scalar
+unsigned int runShaperChecks(const DWORD nFrames);